@@ -0,0 +1,16 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_API_V1_DBUS_JOB1_H_
+#define LINGLONG_API_V1_DBUS_JOB1_H_
+
+#include "linglong/api/dbus/v1/gen_org_deepin_linglong_job1.h"
+
+namespace linglong::api::dbus::v1 {
+using Job = OrgDeepinLinglongJob1Interface;
+}
+
+#endif
@@ -34,6 +34,10 @@ public:
     Q_SERIALIZE_PROPERTY(QString, remoteRepoEndpoint);
     Q_SERIALIZE_PROPERTY(QString, remoteRepoName);
 
+    // 下载源码及拉取依赖时的总速率上限，单位字节每秒，0 表示不限制
+    Q_PROPERTY(quint64 bandwidthLimit MEMBER bandwidthLimit);
+    quint64 bandwidthLimit = 0;
+
     QString repoPath() const;
 
     QString ostreePath() const;
@@ -10,6 +10,7 @@
 #include "linglong/util/error.h"
 #include "linglong/util/file.h"
 #include "linglong/util/http/http_client.h"
+#include "linglong/util/http/rate_limiter.h"
 #include "linglong/util/runner.h"
 #include "project.h"
 #include "source_fetcher_p.h"
@@ -133,19 +134,17 @@ std::tuple<QString, linglong::util::Error> SourceFetcherPrivate::fetchArchiveFil
                          QNetworkRequest::NoLessSafeRedirectPolicy);
     request.setHeader(QNetworkRequest::UserAgentHeader, "Wget/1.21.4");
 
+    RATE_LIMITER->setRate(BuilderConfig::instance()->bandwidthLimit);
     auto reply = util::networkMgr().get(request);
 
     QObject::connect(reply, &QNetworkReply::metaDataChanged, [reply]() {
         qDebug() << reply->header(QNetworkRequest::ContentLengthHeader);
     });
 
-    QObject::connect(reply, &QNetworkReply::readyRead, [this, reply]() {
-        file->write(reply->readAll());
+    util::RateLimitTicket ticket(1);
+    util::readThrottled(reply, ticket, [this](const QByteArray &data) {
+        file->write(data);
     });
-
-    QEventLoop loop;
-    QEventLoop::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
     // 将缓存写入文件
     file->close();
 
@@ -6,8 +6,14 @@
 
 #include "linglong/cli/cli.h"
 
+#include "linglong/api/dbus/v1/job.h"
+#include "linglong/runtime/launch_trace.h"
+#include "linglong/util/progress.h"
 #include "linglong/utils/command/env.h"
 
+#include <QEventLoop>
+#include <QFileInfo>
+
 #include <grp.h>
 #include <sys/wait.h>
 
@@ -22,7 +28,7 @@ A CLI program to run application and manage linglong pagoda and tiers.
 
 Usage:
     ll-cli [--json] --version
-    ll-cli [--json] run APP [--no-dbus-proxy] [--dbus-proxy-cfg=PATH] [--] [COMMAND...]
+    ll-cli [--json] run APP [--no-dbus-proxy] [--dbus-proxy-cfg=PATH] [--trace=PATH] [--] [COMMAND...]
     ll-cli [--json] ps
     ll-cli [--json] exec (APP | PAGODA) [--working-directory=PATH] [--] COMMAND...
     ll-cli [--json] enter (APP | PAGODA) [--working-directory=PATH] [--] [COMMAND...]
@@ -48,6 +54,7 @@ Options:
     --no-dbus                 Use peer to peer DBus, this is used only in case that DBus daemon is not available.
     --no-dbus-proxy           Do not enable linglong-dbus-proxy.
     --dbus-proxy-cfg=PATH     Path of config of linglong-dbus-proxy.
+    --trace=PATH              Write a Chrome trace of the launch stages to PATH, also enabled by LINGLONG_TRACE_LAUNCH=PATH.
     --working-directory=PATH  Specify working directory.
     --type=TYPE               Filter result with tiers type. One of "lib", "app" or "dev". [default: app]
     --state=STATE             Filter result with the tiers install state. Should be "local" or "remote". [default: local]
@@ -115,6 +122,87 @@ auto parseDataFromProxyCfgFile(const QString &dbusProxyCfgPath) -> Result<DBusPr
     return config;
 }
 
+/**
+ * @brief 订阅任务信号并等待任务结束
+ *
+ * @param pkgMan 任务所在的服务
+ * @param path 任务对象路径
+ *
+ * @return Reply 任务结果
+ */
+auto waitForJob(linglong::api::dbus::v1::PackageManager &pkgMan, const QString &path)
+  -> linglong::service::Reply
+{
+    using linglong::api::dbus::v1::Job;
+
+    Job job(pkgMan.service(), path, pkgMan.connection());
+    QEventLoop loop;
+    linglong::service::Reply result{ -1, "" };
+    bool finished = false;
+    bool disProgress = false;
+
+    // 隐藏光标
+    std::cout << "\033[?25l";
+    QObject::connect(&job,
+                     &Job::Progress,
+                     [&disProgress](qulonglong bytesTransferred,
+                                    uint fetchedObjects,
+                                    uint requestedObjects,
+                                    qulonglong bytesPerSecond,
+                                    qlonglong etaSeconds) {
+                         auto text = linglong::util::progressText(bytesTransferred,
+                                                                  fetchedObjects,
+                                                                  requestedObjects,
+                                                                  bytesPerSecond,
+                                                                  etaSeconds);
+                         std::cout << "\r\33[K" << text.toStdString();
+                         std::cout.flush();
+                         disProgress = true;
+                     });
+    QObject::connect(&job, &Job::State, [&disProgress](int /*code*/, const QString &message) {
+        std::cout << "\r\33[K" << message.toStdString();
+        std::cout.flush();
+        disProgress = true;
+    });
+    auto onFinished = [&](int code, const QString &message) {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        result = { code, message };
+        loop.quit();
+    };
+    QObject::connect(&job, &Job::Finished, onFinished);
+
+    // 订阅信号前任务可能已经结束，主动查询一次
+    QDBusPendingReply<bool> isFinished = job.IsFinished();
+    isFinished.waitForFinished();
+    if (isFinished.isError()) {
+        result.message = isFinished.error().message();
+        finished = true;
+    } else if (isFinished.value()) {
+        QDBusPendingReply<linglong::service::Reply> state = job.GetState();
+        state.waitForFinished();
+        if (state.isError()) {
+            result.message = state.error().message();
+            finished = true;
+        } else {
+            onFinished(state.value().code, state.value().message);
+        }
+    }
+
+    if (!finished) {
+        loop.exec();
+    }
+
+    // 显示光标
+    std::cout << "\033[?25h";
+    if (disProgress) {
+        std::cout << std::endl;
+    }
+    return result;
+}
+
 QList<pid_t> childrenOf(pid_t p)
 {
     auto childrenPath = QString("/proc/%1/task/%1/children").arg(p);
@@ -322,6 +410,18 @@ int Cli::run(std::map<std::string, docopt::value> &args)
     if (!envList.isEmpty()) {
         paramOption.appEnv = envList;
     }
+
+    // 启动耗时追踪只对本次启动生效，trace 文件由服务写入，需要使用绝对路径
+    QString tracePath = qEnvironmentVariable(runtime::LaunchTrace::kEnvName);
+    if (args["--trace"].isString()) {
+        tracePath = QString::fromStdString(args["--trace"].asString());
+    }
+    if (!tracePath.isEmpty()) {
+        if (tracePath != "1") {
+            tracePath = QFileInfo(tracePath).absoluteFilePath();
+        }
+        paramOption.appEnv.append(QString("%1=%2").arg(runtime::LaunchTrace::kEnvName, tracePath));
+    }
     // 判断是否设置了no-proxy参数
     paramOption.noDbusProxy = args["--no-dbus-proxy"].asBool();
 
@@ -482,6 +582,34 @@ int Cli::install(std::map<std::string, docopt::value> &args)
         this->printer.printErr(Err(-1, "failed to get app id").value());
         return -1;
     }
+    // 多个应用一起安装时共享依赖解析，依赖只下载一次
+    if (tiers.size() > 1) {
+        QList<linglong::service::InstallParamOption> installParamOptions;
+        for (auto &tier : tiers) {
+            linglong::package::Ref ref(QString::fromStdString(tier));
+            installParamOption.channel = ref.channel;
+            installParamOption.appModule = ref.module;
+            installParamOption.appId = ref.appId;
+            installParamOption.version = ref.version;
+            installParamOption.arch = ref.arch;
+            installParamOptions << installParamOption;
+        }
+        qInfo().noquote() << "install" << installParamOptions.size()
+                          << "apps, please wait a few minutes...";
+        QDBusPendingReply<linglong::service::Reply> dbusReply =
+          this->pkgMan.InstallMany(installParamOptions);
+        dbusReply.waitForFinished();
+        linglong::service::Reply reply = dbusReply.value();
+        if (reply.code == STATUS_CODE(kPkgInstalling)) {
+            reply = waitForJob(this->pkgMan, reply.message);
+        }
+        if (reply.code != STATUS_CODE(kPkgInstallSuccess)) {
+            this->printer.printErr(Err(reply.code, reply.message).value());
+            return -1;
+        }
+        this->printer.printReply(reply);
+        return 0;
+    }
     for (auto &tier : tiers) {
         linglong::package::Ref ref(QString::fromStdString(tier));
         // 增加 channel/module
@@ -499,27 +627,9 @@ int Cli::install(std::map<std::string, docopt::value> &args)
         dbusReply.waitForFinished();
         reply = dbusReply.value();
         qDebug() << reply.message;
-        QThread::sleep(1);
-        // 查询一次进度
-        dbusReply = this->pkgMan.GetDownloadStatus(installParamOption, 0);
-        dbusReply.waitForFinished();
-        reply = dbusReply.value();
-        bool disProgress = false;
-        // 隐藏光标
-        std::cout << "\033[?25l";
-        while (reply.code == STATUS_CODE(kPkgInstalling)) {
-            std::cout << "\r\33[K" << reply.message.toStdString();
-            std::cout.flush();
-            QThread::sleep(1);
-            dbusReply = this->pkgMan.GetDownloadStatus(installParamOption, 0);
-            dbusReply.waitForFinished();
-            reply = dbusReply.value();
-            disProgress = true;
-        }
-        // 显示光标
-        std::cout << "\033[?25h";
-        if (disProgress) {
-            std::cout << std::endl;
+        // 安装在后台任务中进行，message 为任务对象路径
+        if (reply.code == STATUS_CODE(kPkgInstalling)) {
+            reply = waitForJob(this->pkgMan, reply.message);
         }
         if (reply.code != STATUS_CODE(kPkgInstallSuccess)) {
             if (reply.message.isEmpty()) {
@@ -545,6 +655,35 @@ int Cli::upgrade(std::map<std::string, docopt::value> &args)
         return -1;
     }
 
+    if (tiers.size() > 1) {
+        QList<linglong::service::ParamOption> paramOptions;
+        for (auto &tier : tiers) {
+            linglong::package::Ref ref(QString::fromStdString(tier));
+            paramOption.arch = linglong::util::hostArch();
+            paramOption.version = ref.version;
+            paramOption.appId = ref.appId;
+            paramOption.channel = ref.channel;
+            paramOption.appModule = ref.module;
+            paramOptions << paramOption;
+        }
+        pkgMan.setTimeout(1000 * 60 * 60 * 24);
+        qInfo().noquote() << "upgrade" << paramOptions.size()
+                          << "apps, please wait a few minutes...";
+        QDBusPendingReply<linglong::service::Reply> dbusReply = pkgMan.UpdateAll(paramOptions);
+        dbusReply.waitForFinished();
+        linglong::service::Reply reply = dbusReply.value();
+        if (reply.code == STATUS_CODE(kPkgUpdating)) {
+            signal(SIGINT, doIntOperate);
+            reply = waitForJob(pkgMan, reply.message);
+        }
+        if (reply.code != STATUS_CODE(kErrorPkgUpdateSuccess)) {
+            this->printer.printErr(Err(-1, reply.message).value());
+            return -1;
+        }
+        this->printer.printReply(reply);
+        return 0;
+    }
+
     for (auto &tier : tiers) {
         linglong::package::Ref ref(QString::fromStdString(tier));
         paramOption.arch = linglong::util::hostArch();
@@ -561,27 +700,7 @@ int Cli::upgrade(std::map<std::string, docopt::value> &args)
         reply = dbusReply.value();
         if (reply.code == STATUS_CODE(kPkgUpdating)) {
             signal(SIGINT, doIntOperate);
-            QThread::sleep(1);
-            dbusReply = pkgMan.GetDownloadStatus(paramOption, 1);
-            dbusReply.waitForFinished();
-            reply = dbusReply.value();
-            bool disProgress = false;
-            // 隐藏光标
-            std::cout << "\033[?25l";
-            while (reply.code == STATUS_CODE(kPkgUpdating)) {
-                std::cout << "\r\33[K" << reply.message.toStdString();
-                std::cout.flush();
-                QThread::sleep(1);
-                dbusReply = pkgMan.GetDownloadStatus(paramOption, 1);
-                dbusReply.waitForFinished();
-                reply = dbusReply.value();
-                disProgress = true;
-            }
-            // 显示光标
-            std::cout << "\033[?25h";
-            if (disProgress) {
-                std::cout << std::endl;
-            }
+            reply = waitForJob(pkgMan, reply.message);
         }
         if (reply.code != STATUS_CODE(kErrorPkgUpdateSuccess)) {
             this->printer.printErr(Err(-1, reply.message).value());
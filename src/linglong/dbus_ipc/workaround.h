@@ -22,6 +22,8 @@ inline void registerDBusParam()
     qDBusRegisterMetaType<linglong::service::Reply>();
     qDBusRegisterMetaType<linglong::service::RunParamOption>();
     qDBusRegisterMetaType<linglong::service::ParamOption>();
+    qDBusRegisterMetaType<QList<linglong::service::InstallParamOption>>();
+    qDBusRegisterMetaType<QList<linglong::service::ParamOption>>();
 }
 
 #endif
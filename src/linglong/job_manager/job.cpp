@@ -6,45 +6,268 @@
 
 #include "linglong/job_manager/job.h"
 
+#include "linglong/util/progress.h"
+#include "linglong/util/status_code.h"
+
+#include <gio/gio.h>
+
+#include <QDebug>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
 namespace linglong::job_manager {
 
+namespace {
+// 任务表，任务在构造和析构时登记、注销
+QMutex jobTableMutex;
+QMap<QString, Job *> jobTable;
+} // namespace
+
 class JobPrivate
 {
 public:
-    explicit JobPrivate(Job *parent)
+    explicit JobPrivate(const QString &id, Job *parent)
         : q_ptr(parent)
+        , id(id)
+        , cancellable(g_cancellable_new())
     {
     }
 
+    ~JobPrivate() { g_object_unref(cancellable); }
+
     Job *q_ptr = nullptr;
 
-    int progress;
+    const QString id;
+
+    mutable QMutex mutex;
+    linglong::service::Reply state{ 0, "" };
+    QString status;
+    bool finished = false;
+    int bandwidthWeight = 1;
+
+    // 暂停期间执行方上报的状态，恢复后生效
+    linglong::service::Reply stateBeforePause{ 0, "" };
+    bool paused = false;
+    bool cancelled = false;
+    GCancellable *cancellable = nullptr;
+    QWaitCondition resumed;
 };
 
-Job::Job(std::function<void()> f)
-    : func(f)
-    , dd_ptr(new JobPrivate(this))
+Job::Job(const QString &id, QObject *parent)
+    : QObject(parent)
+    , dd_ptr(new JobPrivate(id, this))
+{
+    QMutexLocker locker(&jobTableMutex);
+    jobTable.insert(id, this);
+}
+
+Job::~Job()
+{
+    Q_D(Job);
+    QMutexLocker locker(&jobTableMutex);
+    jobTable.remove(d->id);
+}
+
+QString Job::id() const
+{
+    Q_D(const Job);
+    return d->id;
+}
+
+QString Job::path() const
+{
+    Q_D(const Job);
+    return "/org/deepin/linglong/Job/List/" + d->id;
+}
+
+void Job::setBandwidthWeight(int weight)
 {
+    Q_D(Job);
+    QMutexLocker locker(&d->mutex);
+    d->bandwidthWeight = weight;
 }
 
-int Job::Progress() const
+int Job::bandwidthWeight() const
 {
     Q_D(const Job);
-    return d->progress;
+    QMutexLocker locker(&d->mutex);
+    return d->bandwidthWeight;
+}
+
+void Job::setState(int code, const QString &message)
+{
+    Q_D(Job);
+    {
+        QMutexLocker locker(&d->mutex);
+        if (d->finished) {
+            return;
+        }
+        if (d->paused) {
+            d->stateBeforePause = { code, message };
+            return;
+        }
+        d->state = { code, message };
+        d->status = message;
+    }
+    Q_EMIT State(code, message);
+}
+
+void Job::setProgress(quint64 bytesTransferred,
+                      quint32 fetchedObjects,
+                      quint32 requestedObjects,
+                      quint64 bytesPerSecond,
+                      qint64 etaSeconds)
+{
+    Q_D(Job);
+    {
+        QMutexLocker locker(&d->mutex);
+        if (d->finished) {
+            return;
+        }
+        d->status = util::progressText(bytesTransferred,
+                                 fetchedObjects,
+                                 requestedObjects,
+                                 bytesPerSecond,
+                                 etaSeconds);
+    }
+    Q_EMIT Progress(bytesTransferred, fetchedObjects, requestedObjects, bytesPerSecond, etaSeconds);
+}
+
+void Job::finish(const linglong::service::Reply &reply)
+{
+    Q_D(Job);
+    {
+        QMutexLocker locker(&d->mutex);
+        if (d->finished) {
+            return;
+        }
+        d->finished = true;
+        d->state = reply;
+        d->status = reply.message;
+    }
+    Q_EMIT Finished(reply.code, reply.message);
+}
+
+void Job::pause()
+{
+    Q_D(Job);
+    {
+        QMutexLocker locker(&d->mutex);
+        if (d->finished || d->cancelled || d->paused) {
+            return;
+        }
+        d->paused = true;
+        d->stateBeforePause = d->state;
+        d->state = { STATUS_CODE(kJobPaused), "paused" };
+        d->status = d->state.message;
+        g_cancellable_cancel(d->cancellable);
+    }
+    qInfo() << "pause job:" << id();
+    Q_EMIT State(STATUS_CODE(kJobPaused), "paused");
+}
+
+void Job::resume()
+{
+    Q_D(Job);
+    linglong::service::Reply state;
+    {
+        QMutexLocker locker(&d->mutex);
+        if (d->finished || d->cancelled || !d->paused) {
+            return;
+        }
+        d->paused = false;
+        // 已触发的令牌不能复用，恢复后的下载使用新令牌
+        g_object_unref(d->cancellable);
+        d->cancellable = g_cancellable_new();
+        d->state = d->stateBeforePause;
+        d->status = d->state.message;
+        state = d->state;
+        d->resumed.wakeAll();
+    }
+    qInfo() << "resume job:" << id();
+    Q_EMIT State(state.code, state.message);
+}
+
+void Job::cancel()
+{
+    Q_D(Job);
+    {
+        QMutexLocker locker(&d->mutex);
+        if (d->finished || d->cancelled) {
+            return;
+        }
+        d->cancelled = true;
+        d->paused = false;
+        d->state = { STATUS_CODE(kJobCancelled), "cancelling" };
+        d->status = d->state.message;
+        g_cancellable_cancel(d->cancellable);
+        d->resumed.wakeAll();
+    }
+    qInfo() << "cancel job:" << id();
+    Q_EMIT State(STATUS_CODE(kJobCancelled), "cancelling");
+}
+
+bool Job::isCancelled() const
+{
+    Q_D(const Job);
+    QMutexLocker locker(&d->mutex);
+    return d->cancelled;
+}
+
+GCancellable *Job::cancellable() const
+{
+    Q_D(const Job);
+    QMutexLocker locker(&d->mutex);
+    return G_CANCELLABLE(g_object_ref(d->cancellable));
+}
+
+bool Job::waitWhilePaused()
+{
+    Q_D(Job);
+    QMutexLocker locker(&d->mutex);
+    while (d->paused && !d->cancelled) {
+        d->resumed.wait(&d->mutex);
+    }
+    return !d->cancelled;
+}
+
+QPointer<Job> Job::find(const QString &idOrPath)
+{
+    QMutexLocker locker(&jobTableMutex);
+    auto job = jobTable.value(idOrPath);
+    if (!job) {
+        job = jobTable.value(idOrPath.section('/', -1));
+    }
+    return job;
+}
+
+QStringList Job::list()
+{
+    QMutexLocker locker(&jobTableMutex);
+    return jobTable.keys();
 }
 
 QString Job::Status() const
 {
-    return QString();
+    Q_D(const Job);
+    QMutexLocker locker(&d->mutex);
+    return d->status;
 }
 
-void Job::run()
+linglong::service::Reply Job::GetState() const
 {
-    func();
-    Q_EMIT this->Finish();
-    this->deleteLater();
+    Q_D(const Job);
+    QMutexLocker locker(&d->mutex);
+    return d->state;
 }
 
-Job::~Job() = default;
+bool Job::IsFinished() const
+{
+    Q_D(const Job);
+    QMutexLocker locker(&d->mutex);
+    return d->finished;
+}
 
 }; // namespace linglong::job_manager
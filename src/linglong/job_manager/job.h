@@ -7,30 +7,149 @@
 #ifndef LINGLONG_SRC_PACKAGE_MANAGER_IMPL_JOB_H_
 #define LINGLONG_SRC_PACKAGE_MANAGER_IMPL_JOB_H_
 
+#include "linglong/dbus_ipc/reply.h"
+
+#include <QObject>
+#include <QPointer>
 #include <QScopedPointer>
-#include <QThread>
+
+typedef struct _GCancellable GCancellable;
 
 namespace linglong::job_manager {
 
 class JobPrivate;
 
-class Job : public QThread
+/**
+ * @brief 安装、更新等耗时任务在 dbus 上的任务对象
+ * @details 任务在线程池中执行，通过 Progress、State、Finished 信号向客户端推送进度，
+ *          客户端订阅信号后应调用一次 GetState 以获取订阅前的状态。
+ *          暂停与取消通过取消令牌通知执行方，执行方在对象边界处检查令牌并调用 waitWhilePaused
+ */
+class Job : public QObject
 {
     Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.deepin.linglong.Job1")
+
 public:
-    Job(std::function<void()> f);
+    explicit Job(const QString &id, QObject *parent = nullptr);
     ~Job() override;
 
+    /**
+     * @brief 任务 id
+     */
+    QString id() const;
+
+    /**
+     * @brief 任务对象在 dbus 上的路径
+     */
+    QString path() const;
+
+    /**
+     * @brief 更新任务状态，可在任意线程调用
+     *
+     * @param code 状态码
+     * @param message 状态信息
+     */
+    void setState(int code, const QString &message);
+
+    /**
+     * @brief 更新下载进度，可在任意线程调用
+     *
+     * @param bytesTransferred 已下载字节数
+     * @param fetchedObjects 已下载对象数
+     * @param requestedObjects 需要下载的对象数
+     * @param bytesPerSecond 下载速率
+     * @param etaSeconds 预计剩余时间，未知时为 -1
+     */
+    void setProgress(quint64 bytesTransferred,
+                     quint32 fetchedObjects,
+                     quint32 requestedObjects,
+                     quint64 bytesPerSecond,
+                     qint64 etaSeconds);
+
+    /**
+     * @brief 设置任务下载时与其他任务共享带宽的权重
+     */
+    void setBandwidthWeight(int weight);
+    int bandwidthWeight() const;
+
+    /**
+     * @brief 结束任务，可在任意线程调用
+     *
+     * @param reply 任务结果
+     */
+    void finish(const linglong::service::Reply &reply);
+
+    /**
+     * @brief 暂停任务，触发当前取消令牌，执行中的下载在对象边界处停止，已下载的对象保留
+     */
+    void pause();
+
+    /**
+     * @brief 恢复已暂停的任务
+     */
+    void resume();
+
+    /**
+     * @brief 取消任务，触发取消令牌并唤醒等待恢复的执行方
+     */
+    void cancel();
+
+    /**
+     * @brief 任务是否已被取消
+     */
+    bool isCancelled() const;
+
+    /**
+     * @brief 获取当前的取消令牌，暂停或取消时被触发
+     *
+     * @return GCancellable 新的引用，由调用方释放
+     */
+    GCancellable *cancellable() const;
+
+    /**
+     * @brief 任务暂停时阻塞直到恢复或取消，供执行方在对象边界处调用
+     *
+     * @return bool true:继续执行 false:任务已取消
+     */
+    bool waitWhilePaused();
+
+    /**
+     * @brief 按 id 或 dbus 路径查找任务，仅在主线程调用
+     */
+    static QPointer<Job> find(const QString &idOrPath);
+
+    /**
+     * @brief 所有未释放任务的 id
+     */
+    static QStringList list();
+
 public Q_SLOTS:
+    /**
+     * @brief 查询任务当前状态的可读描述
+     */
     QString Status() const;
-    int Progress() const;
-    void run() override;
 
-Q_SIGNALS: // SIGNALS
-    void Finish();
+    /**
+     * @brief 查询任务当前状态
+     *
+     * @return Reply 状态码及状态信息，任务结束后为任务结果
+     */
+    linglong::service::Reply GetState() const;
 
-public:
-    std::function<void()> func;
+    /**
+     * @brief 查询任务是否结束
+     */
+    bool IsFinished() const;
+
+Q_SIGNALS: // SIGNALS
+    void Progress(qulonglong bytesTransferred,
+                  uint fetchedObjects,
+                  uint requestedObjects,
+                  qulonglong bytesPerSecond,
+                  qlonglong etaSeconds);
+    void State(int code, const QString &message);
+    void Finished(int code, const QString &message);
 
 private:
     QScopedPointer<JobPrivate> dd_ptr;
@@ -7,27 +7,16 @@
 #include "linglong/job_manager/job_manager.h"
 
 #include "linglong/job_manager/job.h"
-#include "linglong/repo/ostree_repohelper.h"
+#include "linglong/job_manager/job_scheduler.h"
+#include "linglong/util/config/config.h"
+#include "linglong/util/http/rate_limiter.h"
 
-#include <QDBusConnection>
-#include <QProcess>
-#include <QTimer>
-#include <QUuid>
+#include <QDebug>
 
 namespace linglong::job_manager {
 
-QString JobManager::CreateJob(std::function<void()> f)
-{
-    auto jobId = QUuid::createUuid().toString(QUuid::Id128);
-    auto jobPath = "/org/deepin/linglong/Job/List/" + jobId;
-    auto jr = new Job(f);
-    jr->start();
-
-    return jobId;
-}
-
 // dbus-send --system --type=method_call --print-reply --dest=org.deepin.linglong.PackageManager
-// /org/deepin/linglong/JobManager org.deepin.linglong.JobManager.Start string:"org.deepin.demo"
+// /org/deepin/linglong/JobManager org.deepin.linglong.JobManager.Start string:"<job id>"
 void JobManager::Start(const QString &jobId)
 {
     if (jobId.isNull() || jobId.isEmpty()) {
@@ -35,34 +24,15 @@ void JobManager::Start(const QString &jobId)
         return;
     }
 
-    int processId = OSTREE_REPO_HELPER->getOstreeJobId(jobId);
-    if (processId == -1) {
+    auto job = Job::find(jobId);
+    if (!job) {
         qWarning() << jobId << " not exist";
         return;
     }
-    qInfo() << "restart job:" << jobId << ", process:" << processId;
-    QProcess process;
-    QStringList argStrList = { "-CONT", QString::number(processId) };
-    process.start("kill", argStrList);
-    if (!process.waitForStarted()) {
-        qCritical() << "kill -CONT failed!";
-        return;
-    }
-    if (!process.waitForFinished(3000)) {
-        qCritical() << "run finish failed!";
-        return;
-    }
-
-    auto retStatus = process.exitStatus();
-    auto retCode = process.exitCode();
-    if (retStatus != 0 || retCode != 0) {
-        qCritical() << " run failed, retCode:" << retCode
-                    << ", info msg:" << QString::fromLocal8Bit(process.readAllStandardOutput())
-                    << ", err msg:" << QString::fromLocal8Bit(process.readAllStandardError());
-    }
+    job->resume();
 }
 
-// 下载应用的时候 正在下载runtime 如何停止？
+// 暂停后正在下载的对象在边界处停止，已下载的对象保留在临时仓库中，恢复后继续下载
 void JobManager::Stop(const QString &jobId)
 {
     if (jobId.isNull() || jobId.isEmpty()) {
@@ -70,34 +40,15 @@ void JobManager::Stop(const QString &jobId)
         return;
     }
 
-    int processId = OSTREE_REPO_HELPER->getOstreeJobId(jobId);
-    if (processId == -1) {
+    auto job = Job::find(jobId);
+    if (!job) {
         qWarning() << jobId << " not exist";
         return;
     }
-    qInfo() << "pause job:" << jobId << ", process:" << processId;
-    QProcess process;
-    QStringList argStrList = { "-STOP", QString::number(processId) };
-    process.start("kill", argStrList);
-    if (!process.waitForStarted()) {
-        qCritical() << "kill -STOP failed!";
-        return;
-    }
-    if (!process.waitForFinished(3000)) {
-        qCritical() << "run finish failed!";
-        return;
-    }
-
-    auto retStatus = process.exitStatus();
-    auto retCode = process.exitCode();
-    if (retStatus != 0 || retCode != 0) {
-        qCritical() << " run failed, retCode:" << retCode
-                    << ", info msg:" << QString::fromLocal8Bit(process.readAllStandardOutput())
-                    << ", err msg:" << QString::fromLocal8Bit(process.readAllStandardError());
-    }
+    job->pause();
 }
 
-// Fix to do 取消之后再下载问题
+// 取消后由执行任务的线程清理临时仓库，任务以 kJobCancelled 结束
 void JobManager::Cancel(const QString &jobId)
 {
     if (jobId.isNull() || jobId.isEmpty()) {
@@ -105,37 +56,34 @@ void JobManager::Cancel(const QString &jobId)
         return;
     }
 
-    int processId = OSTREE_REPO_HELPER->getOstreeJobId(jobId);
-    if (processId == -1) {
+    auto job = Job::find(jobId);
+    if (!job) {
         qWarning() << jobId << " not exist";
         return;
     }
+    job->cancel();
+}
 
-    qInfo() << "cancel job:" << jobId << ", process:" << processId;
-    QProcess process;
-    QStringList argStrList = { "-9", QString::number(processId) };
-    process.start("kill", argStrList);
-    if (!process.waitForStarted()) {
-        qCritical() << "kill failed!";
-        return;
-    }
-    if (!process.waitForFinished(3000)) {
-        qCritical() << "run finish failed!";
-        return;
-    }
+QStringList JobManager::List()
+{
+    return Job::list();
+}
 
-    auto retStatus = process.exitStatus();
-    auto retCode = process.exitCode();
-    if (retStatus != 0 || retCode != 0) {
-        qCritical() << " run failed, retCode:" << retCode
-                    << ", info msg:" << QString::fromLocal8Bit(process.readAllStandardOutput())
-                    << ", err msg:" << QString::fromLocal8Bit(process.readAllStandardError());
-    }
+// 各优先级任务的排队深度、等待时间以及当前占用的资源
+QVariantMap JobManager::GetSchedulerStatus()
+{
+    auto status = JOB_SCHEDULER->statistics();
+    status.insert("bandwidth", RATE_LIMITER->statistics());
+    return status;
 }
 
-QStringList JobManager::List()
+// 立即作用于正在执行的下载，并写入配置文件，0 表示不限制
+void JobManager::SetBandwidthLimit(qulonglong bytesPerSecond)
 {
-    return OSTREE_REPO_HELPER->getOstreeJobList();
+    RATE_LIMITER->setRate(bytesPerSecond);
+    auto &config = util::config::ConfigInstance();
+    config.bandwidthLimit = bytesPerSecond;
+    config.save();
 }
 
 } // namespace linglong::job_manager
@@ -27,13 +27,14 @@ class JobManager : public QObject, protected QDBusContext
 
 public:
     using QObject::QObject;
-    QString CreateJob(std::function<void()> f);
 
 public Q_SLOTS:
     QStringList List();
     void Start(const QString &jobId);
     void Stop(const QString &jobId);
     void Cancel(const QString &jobId);
+    QVariantMap GetSchedulerStatus();
+    void SetBandwidthLimit(qulonglong bytesPerSecond);
 };
 
 } // namespace linglong::job_manager
@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "linglong/job_manager/job_scheduler.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QRunnable>
+
+namespace linglong::job_manager {
+
+namespace {
+QString priorityName(JobPriority priority)
+{
+    switch (priority) {
+    case JobPriority::Prefetch:
+        return "prefetch";
+    case JobPriority::BackgroundUpdate:
+        return "background";
+    case JobPriority::Interactive:
+        return "interactive";
+    }
+    return "unknown";
+}
+
+class Task : public QRunnable
+{
+public:
+    explicit Task(std::function<void()> fn)
+        : fn(std::move(fn))
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override { fn(); }
+
+private:
+    std::function<void()> fn;
+};
+} // namespace
+
+struct JobScheduler::Flight
+{
+    bool done = false;
+    linglong::service::Reply result;
+    QWaitCondition finished;
+};
+
+JobScheduler::JobScheduler()
+{
+    for (auto priority :
+         { JobPriority::Prefetch, JobPriority::BackgroundUpdate, JobPriority::Interactive }) {
+        counters.insert(priority, {});
+    }
+}
+
+void JobScheduler::setMaxThreadCount(int count)
+{
+    pool.setMaxThreadCount(count);
+}
+
+void JobScheduler::submit(JobPriority priority, const QString &name, std::function<void()> task)
+{
+    {
+        QMutexLocker locker(&mutex);
+        ++counters[priority].queued;
+    }
+
+    QElapsedTimer queuedTimer;
+    queuedTimer.start();
+    auto runnable = new Task([this, priority, name, queuedTimer, task = std::move(task)]() {
+        const qint64 waitMs = queuedTimer.elapsed();
+        {
+            QMutexLocker locker(&mutex);
+            auto &counter = counters[priority];
+            --counter.queued;
+            ++counter.running;
+            counter.totalWaitMs += waitMs;
+            counter.maxWaitMs = qMax(counter.maxWaitMs, waitMs);
+        }
+        qInfo().noquote() << QString("start %1 job %2 after waiting %3 ms")
+                               .arg(priorityName(priority), name)
+                               .arg(waitMs);
+
+        task();
+
+        QMutexLocker locker(&mutex);
+        auto &counter = counters[priority];
+        --counter.running;
+        ++counter.finished;
+    });
+    pool.start(runnable, static_cast<int>(priority));
+}
+
+linglong::service::Reply
+JobScheduler::runOnce(const QString &key, const std::function<linglong::service::Reply()> &task)
+{
+    QSharedPointer<Flight> flight;
+    {
+        QMutexLocker locker(&mutex);
+        flight = flights.value(key);
+        if (flight) {
+            qInfo() << "wait for running task" << key;
+            while (!flight->done) {
+                flight->finished.wait(&mutex);
+            }
+            return flight->result;
+        }
+        flight.reset(new Flight);
+        flights.insert(key, flight);
+    }
+
+    auto result = task();
+
+    QMutexLocker locker(&mutex);
+    flight->result = result;
+    flight->done = true;
+    flights.remove(key);
+    flight->finished.wakeAll();
+    return result;
+}
+
+void JobScheduler::lockResource(const QString &key)
+{
+    QMutexLocker locker(&mutex);
+    while (lockedResources.contains(key)) {
+        resourceReleased.wait(&mutex);
+    }
+    lockedResources.insert(key);
+}
+
+void JobScheduler::unlockResource(const QString &key)
+{
+    QMutexLocker locker(&mutex);
+    lockedResources.remove(key);
+    resourceReleased.wakeAll();
+}
+
+QVariantMap JobScheduler::statistics() const
+{
+    QVariantMap result;
+    QMutexLocker locker(&mutex);
+    for (auto it = counters.cbegin(); it != counters.cend(); ++it) {
+        const auto &counter = it.value();
+        const qint64 started = counter.finished + counter.running;
+        QVariantMap item;
+        item["queued"] = counter.queued;
+        item["running"] = counter.running;
+        item["finished"] = counter.finished;
+        item["averageWaitMs"] = started > 0 ? counter.totalWaitMs / started : 0;
+        item["maxWaitMs"] = counter.maxWaitMs;
+        result[priorityName(it.key())] = item;
+    }
+    result["lockedResources"] = QStringList(lockedResources.values());
+    result["runningOnce"] = QStringList(flights.keys());
+    return result;
+}
+
+bool JobScheduler::waitForDone(int msecs)
+{
+    return pool.waitForDone(msecs);
+}
+
+int bandwidthWeight(JobPriority priority)
+{
+    switch (priority) {
+    case JobPriority::Interactive:
+        return 8;
+    case JobPriority::BackgroundUpdate:
+        return 2;
+    case JobPriority::Prefetch:
+        break;
+    }
+    return 1;
+}
+
+ResourceLocker::ResourceLocker(const QString &key)
+    : key(key)
+{
+    JOB_SCHEDULER->lockResource(key);
+}
+
+ResourceLocker::~ResourceLocker()
+{
+    JOB_SCHEDULER->unlockResource(key);
+}
+
+} // namespace linglong::job_manager
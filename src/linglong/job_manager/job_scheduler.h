@@ -0,0 +1,134 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_JOB_MANAGER_JOB_SCHEDULER_H_
+#define LINGLONG_SRC_JOB_MANAGER_JOB_SCHEDULER_H_
+
+#include "linglong/dbus_ipc/reply.h"
+#include "linglong/util/singleton.h"
+
+#include <QMap>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <QWaitCondition>
+
+#include <functional>
+
+namespace linglong::job_manager {
+
+/**
+ * @brief 任务优先级，数值越大越先执行
+ */
+enum class JobPriority : int {
+    Prefetch = 0,         ///< 预取
+    BackgroundUpdate = 1, ///< 后台更新
+    Interactive = 2,      ///< 用户交互触发的安装
+};
+
+/**
+ * @brief 任务优先级对应的下载带宽权重
+ */
+int bandwidthWeight(JobPriority priority);
+
+/**
+ * @brief PackageManager 的任务调度器
+ * @details 按优先级从线程池中调度任务，提供按资源加锁以及相同依赖安装的单飞合并，
+ *          并统计各优先级的排队深度与等待时间
+ */
+class JobScheduler : public linglong::util::Singleton<JobScheduler>
+{
+public:
+    JobScheduler();
+
+    /**
+     * @brief 设置最大并发任务数
+     */
+    void setMaxThreadCount(int count);
+
+    /**
+     * @brief 提交任务，已排队的任务中优先级高的先执行
+     *
+     * @param priority 任务优先级
+     * @param name 任务名，用于日志
+     * @param task 任务执行流程
+     */
+    void submit(JobPriority priority, const QString &name, std::function<void()> task);
+
+    /**
+     * @brief 同一 key 的任务同时只执行一次，执行期间到达的调用等待并共享其结果
+     *
+     * @param key 任务标识，如依赖的 runtime ref
+     * @param task 任务执行流程
+     *
+     * @return Reply 任务结果
+     */
+    linglong::service::Reply runOnce(const QString &key,
+                                     const std::function<linglong::service::Reply()> &task);
+
+    /**
+     * @brief 获取资源锁，资源被占用时阻塞，不可重入
+     */
+    void lockResource(const QString &key);
+
+    /**
+     * @brief 释放资源锁
+     */
+    void unlockResource(const QString &key);
+
+    /**
+     * @brief 各优先级的排队数、执行数及等待时间统计
+     */
+    QVariantMap statistics() const;
+
+    /**
+     * @brief 等待所有任务执行结束
+     */
+    bool waitForDone(int msecs = -1);
+
+private:
+    struct Flight;
+
+    struct Counter
+    {
+        int queued = 0;
+        int running = 0;
+        qint64 finished = 0;
+        qint64 totalWaitMs = 0;
+        qint64 maxWaitMs = 0;
+    };
+
+    QThreadPool pool;
+
+    mutable QMutex mutex;
+    QMap<JobPriority, Counter> counters;
+    QMap<QString, QSharedPointer<Flight>> flights;
+    QSet<QString> lockedResources;
+    QWaitCondition resourceReleased;
+};
+
+/**
+ * @brief 资源锁的 RAII 封装
+ */
+class ResourceLocker
+{
+public:
+    explicit ResourceLocker(const QString &key);
+    ~ResourceLocker();
+
+    ResourceLocker(const ResourceLocker &) = delete;
+    ResourceLocker &operator=(const ResourceLocker &) = delete;
+
+private:
+    QString key;
+};
+
+} // namespace linglong::job_manager
+
+#define JOB_SCHEDULER linglong::job_manager::JobScheduler::instance()
+#endif
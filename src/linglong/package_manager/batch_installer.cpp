@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "batch_installer.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+
+namespace linglong::service {
+
+QMap<QString, Reply> BatchInstaller::run(const QList<Target> &targets,
+                                         const QStringList &dependencies,
+                                         QMap<QString, QString> dependencyErrors) const
+{
+    QMutex mutex;
+
+    // 并行安装依赖，依赖由多个应用共用，只安装一次
+    QStringList pending = dependencies;
+    pending.removeDuplicates();
+    QtConcurrent::blockingMap(pending, [&](const QString &dep) {
+        QString err;
+        if (!installDependency(dep, err)) {
+            QMutexLocker locker(&mutex);
+            dependencyErrors.insert(dep, err);
+        }
+    });
+
+    // 依赖就绪的应用并行部署
+    QMap<QString, Reply> results;
+    QStringList ready;
+    for (const auto &target : targets) {
+        auto failed = std::find_if(target.deps.cbegin(),
+                                   target.deps.cend(),
+                                   [&dependencyErrors](const QString &dep) {
+                                       return dependencyErrors.contains(dep);
+                                   });
+        if (failed != target.deps.cend()) {
+            Reply reply;
+            reply.code = dependencyErrorCode(*failed);
+            reply.message = dependencyErrors.value(*failed);
+            results.insert(target.appId, reply);
+            continue;
+        }
+        ready << target.appId;
+    }
+
+    QtConcurrent::blockingMap(ready, [&](const QString &appId) {
+        auto reply = deploy(appId);
+        QMutexLocker locker(&mutex);
+        results.insert(appId, reply);
+    });
+    return results;
+}
+
+} // namespace linglong::service
@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_PACKAGE_MANAGER_BATCH_INSTALLER_H_
+#define LINGLONG_SRC_PACKAGE_MANAGER_BATCH_INSTALLER_H_
+
+#include "linglong/dbus_ipc/reply.h"
+
+#include <QMap>
+#include <QStringList>
+
+#include <functional>
+
+namespace linglong::service {
+
+/**
+ * @brief 批量安装中依赖安装与应用部署的调度
+ * @details 各应用的依赖取并集后并行安装，每个依赖只安装一次；依赖失败的应用直接得到该依赖的
+ *          错误，其余应用并行部署，单个应用失败不影响其它应用
+ */
+class BatchInstaller
+{
+public:
+    struct Target
+    {
+        QString appId;
+        QStringList deps; ///< 依赖的 key
+    };
+
+    /**
+     * @brief 安装单个依赖，可在任意线程调用
+     *
+     * @return bool 失败时 err 为错误信息
+     */
+    std::function<bool(const QString &dep, QString &err)> installDependency;
+
+    /**
+     * @brief 部署单个应用，可在任意线程调用
+     */
+    std::function<Reply(const QString &appId)> deploy;
+
+    /**
+     * @brief 依赖失败时对应应用的错误码
+     */
+    std::function<int(const QString &dep)> dependencyErrorCode;
+
+    /**
+     * @brief 安装依赖并部署应用
+     *
+     * @param targets 待安装的应用
+     * @param dependencies 需要安装的依赖
+     * @param dependencyErrors 已知失败的依赖及错误信息，如元数据中找不到的依赖
+     *
+     * @return QMap<QString, Reply> 每个应用的结果，key 为 appId
+     */
+    QMap<QString, Reply> run(const QList<Target> &targets,
+                             const QStringList &dependencies,
+                             QMap<QString, QString> dependencyErrors = {}) const;
+};
+
+} // namespace linglong::service
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "install_journal.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QUuid>
+
+namespace linglong::service {
+
+namespace {
+const char *const kSuffix = ".json";
+} // namespace
+
+QJsonObject InstallJournal::Transaction::toJson() const
+{
+    QJsonArray steps;
+    for (auto step : completed) {
+        steps.append(stepName(step));
+    }
+    return QJsonObject{
+        { "id", id },
+        { "kind", kind },
+        { "ref", ref },
+        { "installPath", installPath },
+        { "tmpRepoDir", tmpRepoDir },
+        { "user", user },
+        { "appInfo", appInfo },
+        { "completed", steps },
+        { "rolledBack", rolledBack },
+        { "updated", updated.toString(Qt::ISODate) },
+    };
+}
+
+InstallJournal::Transaction InstallJournal::Transaction::fromJson(const QJsonObject &json)
+{
+    Transaction transaction;
+    transaction.id = json.value("id").toString();
+    transaction.kind = json.value("kind").toString();
+    transaction.ref = json.value("ref").toString();
+    transaction.installPath = json.value("installPath").toString();
+    transaction.tmpRepoDir = json.value("tmpRepoDir").toString();
+    transaction.user = json.value("user").toString();
+    transaction.appInfo = json.value("appInfo").toObject();
+    transaction.rolledBack = json.value("rolledBack").toBool();
+    transaction.updated = QDateTime::fromString(json.value("updated").toString(), Qt::ISODate);
+    for (const auto &value : json.value("completed").toArray()) {
+        for (auto step : { Resolve, Fetch, Checkout, Erofs, Database, Portal, Triggers }) {
+            if (stepName(step) == value.toString()) {
+                transaction.completed.append(step);
+            }
+        }
+    }
+    return transaction;
+}
+
+InstallJournal::InstallJournal(const QString &dir)
+    : dir(dir)
+{
+    QDir().mkpath(dir);
+}
+
+QString InstallJournal::stepName(Step step)
+{
+    switch (step) {
+    case Resolve:
+        return "resolve";
+    case Fetch:
+        return "fetch";
+    case Checkout:
+        return "checkout";
+    case Erofs:
+        return "erofs";
+    case Database:
+        return "database";
+    case Portal:
+        return "portal";
+    case Triggers:
+        return "triggers";
+    }
+    return QString();
+}
+
+QString InstallJournal::begin(Transaction transaction)
+{
+    QMutexLocker locker(&mutex);
+    // 继承同一 ref 上次回滚时保留的临时仓库
+    for (const auto &old : loadAll()) {
+        if (!old.rolledBack || old.ref != transaction.ref) {
+            continue;
+        }
+        if (transaction.tmpRepoDir.isEmpty() && QDir(old.tmpRepoDir).exists()) {
+            transaction.tmpRepoDir = old.tmpRepoDir;
+        }
+        remove(old.id);
+    }
+
+    transaction.id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    transaction.rolledBack = false;
+    if (!transaction.completed.contains(Resolve)) {
+        transaction.completed.append(Resolve);
+    }
+    save(transaction);
+    return transaction.id;
+}
+
+void InstallJournal::complete(const QString &id, Step step)
+{
+    QMutexLocker locker(&mutex);
+    Transaction transaction;
+    if (!load(id, transaction) || transaction.done(step)) {
+        return;
+    }
+    transaction.completed.append(step);
+    save(transaction);
+}
+
+void InstallJournal::setTmpRepoDir(const QString &id, const QString &tmpRepoDir)
+{
+    QMutexLocker locker(&mutex);
+    Transaction transaction;
+    if (!load(id, transaction)) {
+        return;
+    }
+    transaction.tmpRepoDir = tmpRepoDir;
+    save(transaction);
+}
+
+QString InstallJournal::tmpRepoDir(const QString &id) const
+{
+    QMutexLocker locker(&mutex);
+    Transaction transaction;
+    if (!load(id, transaction)) {
+        return QString();
+    }
+    return transaction.tmpRepoDir;
+}
+
+void InstallJournal::finish(const QString &id)
+{
+    QMutexLocker locker(&mutex);
+    remove(id);
+}
+
+void InstallJournal::rollBack(const QString &id)
+{
+    QMutexLocker locker(&mutex);
+    Transaction transaction;
+    if (!load(id, transaction)) {
+        return;
+    }
+    // 没有可继续使用的临时仓库时无需保留
+    if (!QDir(transaction.tmpRepoDir).exists()) {
+        remove(id);
+        return;
+    }
+    transaction.rolledBack = true;
+    transaction.updated = QDateTime::currentDateTime();
+    save(transaction);
+}
+
+QList<InstallJournal::Transaction> InstallJournal::interrupted() const
+{
+    QMutexLocker locker(&mutex);
+    QList<Transaction> result;
+    for (const auto &transaction : loadAll()) {
+        if (!transaction.rolledBack) {
+            result.append(transaction);
+        }
+    }
+    return result;
+}
+
+void InstallJournal::expireRolledBack(const QDateTime &now)
+{
+    QMutexLocker locker(&mutex);
+    for (const auto &transaction : loadAll()) {
+        if (!transaction.rolledBack
+            || transaction.updated.daysTo(now) < kRolledBackExpireDays) {
+            continue;
+        }
+        if (!transaction.tmpRepoDir.isEmpty()) {
+            QDir(transaction.tmpRepoDir).removeRecursively();
+        }
+        remove(transaction.id);
+    }
+}
+
+void InstallJournal::removeCheckout(const Transaction &transaction)
+{
+    QDir installDir(transaction.installPath);
+    if (transaction.installPath.isEmpty() || !installDir.exists()) {
+        return;
+    }
+    // ref 格式为 channel/appId/version/arch/module
+    const QString module = transaction.ref.section('/', 4, 4);
+    if (module == "devel" || !installDir.exists("devel")) {
+        installDir.removeRecursively();
+        return;
+    }
+    const auto entries = installDir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System
+                                                  | QDir::NoDotAndDotDot);
+    for (const auto &entry : entries) {
+        if (entry.fileName() == "devel") {
+            continue;
+        }
+        if (entry.isDir() && !entry.isSymLink()) {
+            QDir(entry.absoluteFilePath()).removeRecursively();
+        } else {
+            QFile::remove(entry.absoluteFilePath());
+        }
+    }
+}
+
+QList<InstallJournal::Transaction> InstallJournal::loadAll() const
+{
+    QList<Transaction> result;
+    const auto entries =
+      QDir(dir).entryInfoList({ QString("*") + kSuffix }, QDir::Files, QDir::Time | QDir::Reversed);
+    for (const auto &entry : entries) {
+        Transaction transaction;
+        if (load(entry.completeBaseName(), transaction)) {
+            result.append(transaction);
+        }
+    }
+    return result;
+}
+
+bool InstallJournal::load(const QString &id, Transaction &transaction) const
+{
+    QFile file(filePath(id));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QJsonParseError error;
+    auto doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        qWarning() << "broken install journal" << file.fileName() << error.errorString();
+        return false;
+    }
+    transaction = Transaction::fromJson(doc.object());
+    transaction.id = id;
+    return true;
+}
+
+void InstallJournal::save(const Transaction &transaction) const
+{
+    auto copy = transaction;
+    if (copy.updated.isNull() || !copy.rolledBack) {
+        copy.updated = QDateTime::currentDateTime();
+    }
+    // QSaveFile 先写临时文件再原子替换，异常退出时不会留下写了一半的日志
+    QSaveFile file(filePath(copy.id));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "failed to write install journal" << file.fileName() << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(copy.toJson()).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qWarning() << "failed to commit install journal" << file.fileName()
+                   << file.errorString();
+    }
+}
+
+void InstallJournal::remove(const QString &id) const
+{
+    QFile::remove(filePath(id));
+}
+
+QString InstallJournal::filePath(const QString &id) const
+{
+    return dir + "/" + id + kSuffix;
+}
+
+} // namespace linglong::service
@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_PACKAGE_MANAGER_INSTALL_JOURNAL_H_
+#define LINGLONG_SRC_PACKAGE_MANAGER_INSTALL_JOURNAL_H_
+
+#include <QDateTime>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+namespace linglong::service {
+
+/**
+ * @brief 安装事务日志
+ * @details 每个安装事务对应日志目录下的一个文件，每完成一个步骤即落盘。服务异常退出后，
+ *          根据已完成的步骤继续或回滚未完成的事务；回滚的事务保留下载用的临时仓库，
+ *          重试同一 ref 时从中继续下载
+ */
+class InstallJournal
+{
+public:
+    enum Step {
+        Resolve,  ///< 已确定安装的版本
+        Fetch,    ///< 数据已下载到本地仓库
+        Checkout, ///< 数据已签出到安装目录
+        Erofs,    ///< erofs 镜像已生成
+        Database, ///< 已写入安装数据库
+        Portal,   ///< 已处理安装 portal
+        Triggers, ///< 已链接配置文件并标记数据库更新
+    };
+
+    struct Transaction
+    {
+        QString id;
+        QString kind; ///< app 或 runtime
+        QString ref;  ///< channel/appId/version/arch/module
+        QString installPath;
+        QString tmpRepoDir;
+        QString user;
+        QJsonObject appInfo;
+        QList<Step> completed;
+        bool rolledBack = false;
+        QDateTime updated;
+
+        bool done(Step step) const { return completed.contains(step); }
+
+        QJsonObject toJson() const;
+        static Transaction fromJson(const QJsonObject &json);
+    };
+
+    // 回滚的事务保留的最长时间，超过后删除其临时仓库
+    static constexpr qint64 kRolledBackExpireDays = 7;
+
+    /**
+     * @param dir 日志目录
+     */
+    explicit InstallJournal(const QString &dir);
+
+    /**
+     * @brief 开始事务，同一 ref 存在已回滚的事务时继承其临时仓库
+     *
+     * @return QString 事务 id
+     */
+    QString begin(Transaction transaction);
+
+    /**
+     * @brief 记录步骤完成
+     */
+    void complete(const QString &id, Step step);
+
+    /**
+     * @brief 记录下载使用的临时仓库
+     */
+    void setTmpRepoDir(const QString &id, const QString &dir);
+    QString tmpRepoDir(const QString &id) const;
+
+    /**
+     * @brief 事务正常结束，删除日志
+     */
+    void finish(const QString &id);
+
+    /**
+     * @brief 标记事务已回滚，保留日志以便重试时继续下载
+     */
+    void rollBack(const QString &id);
+
+    /**
+     * @brief 未结束且未回滚的事务，即服务异常退出时中断的事务
+     */
+    QList<Transaction> interrupted() const;
+
+    /**
+     * @brief 删除超过保留时间的已回滚事务及其临时仓库
+     */
+    void expireRolledBack(const QDateTime &now = QDateTime::currentDateTime());
+
+    static QString stepName(Step step);
+
+    /**
+     * @brief 删除未完成的事务签出的数据
+     * @details runtime 模块的安装目录下可能已有同版本的 devel 模块，只删除 devel 之外的内容
+     */
+    static void removeCheckout(const Transaction &transaction);
+
+private:
+    QList<Transaction> loadAll() const;
+    bool load(const QString &id, Transaction &transaction) const;
+    void save(const Transaction &transaction) const;
+    void remove(const QString &id) const;
+    QString filePath(const QString &id) const;
+
+    QString dir;
+    mutable QMutex mutex;
+};
+
+} // namespace linglong::service
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "layer_reaper.h"
+
+#include "linglong/util/file.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QUuid>
+
+#include <cerrno>
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace linglong::service {
+
+namespace {
+// linux/ioprio.h 不在所有发行版的开发包中提供
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioClassIdle = 3;
+constexpr int kIoprioClassShift = 13;
+
+class Task : public QRunnable
+{
+public:
+    explicit Task(std::function<void()> fn)
+        : fn(std::move(fn))
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override { fn(); }
+
+private:
+    std::function<void()> fn;
+};
+} // namespace
+
+LayerReaper::LayerReaper(const QString &trashDir, std::function<void()> prune)
+    : trash(trashDir)
+    , prune(std::move(prune))
+{
+    QDir().mkpath(trash);
+    pool.setMaxThreadCount(1);
+}
+
+LayerReaper::~LayerReaper()
+{
+    waitForIdle();
+}
+
+bool LayerReaper::remove(const QString &path)
+{
+    QFileInfo info(path);
+    if (path.isEmpty() || !info.exists()) {
+        return true;
+    }
+
+    // 同一文件系统内的 rename 是原子操作，卸载流程无需等待删除完成
+    const QString target = trash + "/" + QUuid::createUuid().toString(QUuid::WithoutBraces) + "-"
+      + info.fileName();
+    if (!QDir().rename(path, target)) {
+        qWarning() << "move" << path << "to trash failed, remove it directly";
+        return linglong::util::removeDir(path);
+    }
+    qInfo() << "moved" << path << "to" << target;
+    schedule();
+    return true;
+}
+
+void LayerReaper::requestPrune()
+{
+    {
+        QMutexLocker locker(&mutex);
+        pruneRequested = true;
+    }
+    schedule();
+}
+
+void LayerReaper::reap()
+{
+    schedule();
+}
+
+void LayerReaper::waitForIdle()
+{
+    QMutexLocker locker(&mutex);
+    while (running) {
+        idle.wait(&mutex);
+    }
+}
+
+void LayerReaper::schedule()
+{
+    QMutexLocker locker(&mutex);
+    pending = true;
+    if (running) {
+        return;
+    }
+    running = true;
+    pool.start(new Task([this]() {
+        run();
+    }));
+}
+
+void LayerReaper::run()
+{
+    lowerPriority();
+    Q_FOREVER {
+        bool needPrune = false;
+        {
+            QMutexLocker locker(&mutex);
+            if (!pending) {
+                running = false;
+                idle.wakeAll();
+                return;
+            }
+            pending = false;
+            needPrune = pruneRequested;
+            pruneRequested = false;
+        }
+
+        const auto entries = QDir(trash).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot
+                                                       | QDir::Hidden | QDir::System);
+        for (const auto &entry : entries) {
+            if (entry.isDir() && !entry.isSymLink()) {
+                linglong::util::removeDir(entry.absoluteFilePath());
+            } else {
+                QFile::remove(entry.absoluteFilePath());
+            }
+        }
+
+        if (needPrune && prune) {
+            prune();
+        }
+    }
+}
+
+void LayerReaper::lowerPriority()
+{
+    // 线程池的线程空闲超时后会重建，每轮回收开始时重新设置
+    const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, tid, 19) != 0) {
+        qDebug() << "setpriority failed:" << errno;
+    }
+    const int ioprio = kIoprioClassIdle << kIoprioClassShift;
+    if (syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, ioprio) != 0) {
+        qDebug() << "ioprio_set failed:" << errno;
+    }
+}
+
+} // namespace linglong::service
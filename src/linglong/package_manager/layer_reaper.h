@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_PACKAGE_MANAGER_LAYER_REAPER_H_
+#define LINGLONG_SRC_PACKAGE_MANAGER_LAYER_REAPER_H_
+
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <functional>
+
+namespace linglong::service {
+
+/**
+ * @brief 卸载后的目录回收
+ * @details 卸载时将安装目录原子地重命名到回收目录后立即返回，实际的递归删除及仓库对象清理
+ *          在独立的低优先级线程中执行，该线程使用 idle 的 I/O 调度类别，不影响前台任务
+ */
+class LayerReaper
+{
+public:
+    /**
+     * @param trashDir 回收目录，需与安装目录位于同一文件系统
+     * @param prune 清理仓库中不再被引用的对象，在删除目录后执行
+     */
+    explicit LayerReaper(const QString &trashDir, std::function<void()> prune = {});
+    ~LayerReaper();
+
+    /**
+     * @brief 将目录移入回收目录并安排删除，重命名失败时直接删除
+     *
+     * @param path 待删除的目录
+     *
+     * @return bool 目录已从原位置移除
+     */
+    bool remove(const QString &path);
+
+    /**
+     * @brief 安排在下一轮回收后清理仓库对象，多次请求合并为一次
+     */
+    void requestPrune();
+
+    /**
+     * @brief 安排删除回收目录中的全部内容，用于清理上次退出时未删除的目录
+     */
+    void reap();
+
+    /**
+     * @brief 等待已安排的回收执行完毕
+     */
+    void waitForIdle();
+
+    QString trashDir() const { return trash; }
+
+private:
+    void schedule();
+    void run();
+
+    // 将当前线程调整为最低的 CPU 及 I/O 优先级
+    static void lowerPriority();
+
+    QString trash;
+    std::function<void()> prune;
+
+    QMutex mutex;
+    QWaitCondition idle;
+    bool running = false;
+    bool pending = false;
+    bool pruneRequested = false;
+
+    // 单线程执行，避免多个回收同时争抢磁盘
+    QThreadPool pool;
+};
+
+} // namespace linglong::service
+
+#endif
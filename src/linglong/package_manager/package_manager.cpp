@@ -6,13 +6,20 @@
 
 #include "package_manager.h"
 
+#include "linglong/adaptors/job_manager/job1.h"
 #include "linglong/dbus_ipc/dbus_system_helper_common.h"
+#include "linglong/job_manager/job_scheduler.h"
+#include "linglong/package_manager/batch_installer.h"
+#include "linglong/repo/mirror_list.h"
 #include "linglong/repo/ostree_repohelper.h"
 #include "linglong/repo/repo_client.h"
 #include "linglong/util/app_status.h"
 #include "linglong/util/appinfo_cache.h"
 #include "linglong/util/config/config.h"
 #include "linglong/util/file.h"
+#include "linglong/util/http/rate_limiter.h"
+#include "linglong/util/installed_app_registry.h"
+#include "linglong/util/qserializer/deprecated.h"
 #include "linglong/util/qserializer/json.h"
 #include "linglong/util/runner.h"
 #include "linglong/util/status_code.h"
@@ -24,12 +31,41 @@
 #include <QDBusReply>
 #include <QDebug>
 #include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QSet>
 #include <QSettings>
+#include <QTimer>
+#include <QUuid>
+
+#include <algorithm>
 
 #include <pwd.h>
 
 namespace linglong::service {
 
+namespace {
+// 应用导出到系统的配置文件目录
+auto appEntriesDir(const QString &layerPath) -> QString
+{
+    if (linglong::util::dirExists(layerPath + "/outputs/share")) {
+        return layerPath + "/outputs/share";
+    }
+    return layerPath + "/entries";
+}
+
+// 同一 ref 的下载、签出、预取及中断恢复共用的资源锁名
+auto refLockName(const QString &channel,
+                 const QString &appId,
+                 const QString &version,
+                 const QString &arch,
+                 const QString &module) -> QString
+{
+    return "ref:"
+      + package::Ref("", channel, appId, version, arch, module).toOSTreeRefLocalString();
+}
+} // namespace
+
 auto PackageManager::getAppJsonArray(const QString &jsonString, QJsonValue &jsonValue, QString &err)
   -> bool
 {
@@ -131,7 +167,10 @@ auto PackageManager::downloadAppData(const QString &pkgName,
                                      const QString &channel,
                                      const QString &module,
                                      const QString &dstPath,
-                                     QString &err) -> bool
+                                     QString &err,
+                                     job_manager::Job *job,
+                                     const QString &transaction,
+                                     const QString &baseVersion) -> bool
 {
     bool ret = OSTREE_REPO_HELPER->ensureRepoEnv(kLocalRepoPath, err);
     if (!ret) {
@@ -144,66 +183,203 @@ auto PackageManager::downloadAppData(const QString &pkgName,
       QString("%1/%2/%3/%4/%5").arg(channel).arg(pkgName).arg(pkgVer).arg(pkgArch).arg(module);
     qInfo() << "downloadAppData ref:" << matchRef;
 
-    // ret = repo.repoPull(repoPath, qrepoList[0], pkgName, err);
-    ret = OSTREE_REPO_HELPER->repoPullbyCmd(kLocalRepoPath, remoteRepoName, matchRef, err);
-    if (!ret) {
-        qCritical() << err;
-        return false;
+    // 同一 ref 同时只允许一个任务下载和签出
+    job_manager::ResourceLocker refLocker(refLockName(channel, pkgName, pkgVer, pkgArch, module));
+
+    PullControl control;
+    if (job) {
+        job->setState(STATUS_CODE(kPkgInstalling), "downloading " + matchRef);
+        control.progress = [job](const PullProgress &p) {
+            job->setProgress(p.bytesTransferred,
+                             p.fetchedObjects,
+                             p.requestedObjects,
+                             p.bytesPerSecond,
+                             p.etaSeconds);
+        };
+        control.cancellable = [job]() {
+            return job->cancellable();
+        };
+        control.waitForResume = [job]() {
+            return job->waitWhilePaused();
+        };
+        control.weight = job->bandwidthWeight();
+    }
+    if (peerDiscovery) {
+        control.peers = peerDiscovery->peers();
+    }
+    applyMirrors(control);
+    if (!transaction.isEmpty()) {
+        // 临时仓库记录在事务日志中，中断或失败后重试时在其基础上继续下载
+        control.resumeTmpRepo = installJournal->tmpRepoDir(transaction);
+        control.tmpRepoCreated = [this, transaction](const QString &dir) {
+            installJournal->setTmpRepoDir(transaction, dir);
+        };
+        control.keepTmpRepoOnFailure = true;
+    }
+    // 同一版本的数据不会变化，已预取到本地仓库时只需签出
+    if (OSTREE_REPO_HELPER->hasRef(kLocalRepoPath, matchRef)) {
+        qInfo() << matchRef << "already in local repo, skip pull";
+    } else {
+        ret = OSTREE_REPO_HELPER->repoPullbyCmd(kLocalRepoPath,
+                                                remoteRepoName,
+                                                matchRef,
+                                                err,
+                                                control);
+        if (!ret) {
+            qCritical() << err;
+            return false;
+        }
+    }
+    if (!transaction.isEmpty()) {
+        installJournal->complete(transaction, InstallJournal::Fetch);
     }
     // checkout 目录
-    // const QString dstPath = repoPath + "/AppData";
-    ret =
-      OSTREE_REPO_HELPER->checkOutAppData(kLocalRepoPath, remoteRepoName, matchRef, dstPath, err);
+    if (job) {
+        if (!job->waitWhilePaused()) {
+            err = "job cancelled";
+            return false;
+        }
+        job->setState(STATUS_CODE(kPkgInstalling), "checking out " + matchRef);
+    }
+    // 更新时基于被替换的版本增量签出，只落盘变化的文件；不按已安装的最高版本选择，
+    // 避免以其它 module 或无关版本为基准
+    if (!baseVersion.isEmpty() && baseVersion != pkgVer
+        && linglong::util::getAppInstalledStatus(pkgName,
+                                                 baseVersion,
+                                                 pkgArch,
+                                                 channel,
+                                                 module,
+                                                 "")) {
+        QString baseRef = QString("%1/%2/%3/%4/%5")
+                            .arg(channel)
+                            .arg(pkgName)
+                            .arg(baseVersion)
+                            .arg(pkgArch)
+                            .arg(module);
+        QString basePath = kAppInstallPath + pkgName + "/" + baseVersion + "/" + pkgArch;
+        if ("devel" == module) {
+            basePath.append("/" + module);
+        }
+        ret = OSTREE_REPO_HELPER->checkOutAppDataIncremental(kLocalRepoPath,
+                                                             remoteRepoName,
+                                                             baseRef,
+                                                             basePath,
+                                                             matchRef,
+                                                             dstPath,
+                                                             err);
+    } else {
+        ret = OSTREE_REPO_HELPER->checkOutAppData(kLocalRepoPath,
+                                                  remoteRepoName,
+                                                  matchRef,
+                                                  dstPath,
+                                                  err);
+    }
     if (!ret) {
         qCritical() << err;
         return false;
     }
+    if (!transaction.isEmpty()) {
+        // erofs 镜像在签出流程中生成，签出返回时两个步骤都已完成
+        installJournal->complete(transaction, InstallJournal::Checkout);
+        installJournal->complete(transaction, InstallJournal::Erofs);
+    }
     qInfo() << "downloadAppData success, path:" << dstPath;
 
     return ret;
 }
 
 auto PackageManager::installRuntime(QSharedPointer<linglong::package::AppMetaInfo> appInfo,
-                                    QString &err) -> bool
+                                    QString &err,
+                                    job_manager::Job *job) -> bool
 {
     QString savePath =
       kAppInstallPath + appInfo->appId + "/" + appInfo->version + "/" + appInfo->arch;
     if ("devel" == appInfo->module) {
         savePath.append("/" + appInfo->module);
     }
+    QString userName = linglong::util::getUserName();
+    if (noDBusMode) {
+        userName = "deepin-linglong";
+    }
+    appInfo->kind = "runtime";
+
+    InstallJournal::Transaction record;
+    record.kind = appInfo->kind;
+    record.ref = QString("%1/%2/%3/%4/%5")
+                   .arg(appInfo->channel)
+                   .arg(appInfo->appId)
+                   .arg(appInfo->version)
+                   .arg(appInfo->arch)
+                   .arg(appInfo->module);
+    record.installPath = savePath;
+    record.user = userName;
+    auto [appInfoData, jsonErr] = util::toJSON(appInfo);
+    record.appInfo = QJsonDocument::fromJson(appInfoData).object();
+    const QString transaction = installJournal->begin(record);
+
     bool ret = downloadAppData(appInfo->appId,
                                appInfo->version,
                                appInfo->arch,
                                appInfo->channel,
                                appInfo->module,
                                savePath,
-                               err);
+                               err,
+                               job,
+                               transaction);
     if (!ret) {
+        installJournal->rollBack(transaction);
         err = "installRuntime download runtime data err";
         return false;
     }
 
     // 更新本地数据库文件
-    QString userName = linglong::util::getUserName();
-    if (noDBusMode) {
-        userName = "deepin-linglong";
-    }
-    appInfo->kind = "runtime";
     linglong::util::insertAppRecord(appInfo, userName);
+    installJournal->complete(transaction, InstallJournal::Database);
+    installJournal->finish(transaction);
+    postInstallTriggers->markDirty(PostInstallTriggers::FontCaches);
 
     return true;
 }
 
-auto PackageManager::checkAppRuntime(const QString &runtime,
-                                     const QString &channel,
-                                     const QString &module,
-                                     QString &err) -> bool
+auto PackageManager::queryRemoteApps(const QString &appId,
+                                     const QString &version,
+                                     const QString &arch,
+                                     QList<QSharedPointer<linglong::package::AppMetaInfo>> &appList,
+                                     QString &err,
+                                     MetadataSnapshot *snapshot) -> bool
+{
+    const QString key = appId + "/" + version + "/" + arch;
+    if (snapshot && snapshot->contains(key)) {
+        appList = snapshot->value(key);
+        return true;
+    }
+
+    QString appData = "";
+    if (!getAppInfoFromServer(appId, version, arch, appData, err)) {
+        return false;
+    }
+    appList.clear();
+    if (!loadAppInfo(appData, appList, err)) {
+        return false;
+    }
+    if (snapshot) {
+        snapshot->insert(key, appList);
+    }
+    return true;
+}
+
+auto PackageManager::resolveRuntime(const QString &runtime,
+                                    const QString &channel,
+                                    const QString &module,
+                                    QString &err,
+                                    MetadataSnapshot *snapshot)
+  -> QSharedPointer<linglong::package::AppMetaInfo>
 {
     // runtime ref in repo org.deepin.Runtime/20/x86_64
     QStringList runtimeInfo = runtime.split("/");
     if (runtimeInfo.size() < 3) {
         err = "app runtime:" + runtime + " runtime format err";
-        return false;
+        return nullptr;
     }
     const QString runtimeId = runtimeInfo.at(0);
     const QString runtimeVer = runtimeInfo.at(1);
@@ -212,31 +388,26 @@ auto PackageManager::checkAppRuntime(const QString &runtime,
     // runtimeId 校验
     if (runtimeId.isEmpty()) {
         err = "app runtime:" + runtime + " runtimeId format err";
-        return false;
+        return nullptr;
     }
 
     QStringList runtimeVersion = runtimeVer.split(".");
     // runtime更新只匹配前面三位，info.json中的runtime version格式必须是3位或4位点分十进制
     if (runtimeVersion.size() < 3) {
         err = "app runtime:" + runtime + " runtime version format err";
-        return false;
+        return nullptr;
     }
 
     QString version = "";
     if (runtimeVersion.size() == 4) {
         version = runtimeVer;
     }
-    QString appData = "";
-    bool ret = getAppInfoFromServer(runtimeId, version, runtimeArch, appData, err);
-    if (!ret) {
-        return false;
-    }
     QList<QSharedPointer<linglong::package::AppMetaInfo>> appList;
-    ret = loadAppInfo(appData, appList, err);
+    bool ret = queryRemoteApps(runtimeId, version, runtimeArch, appList, err, snapshot);
     if (!ret || appList.size() < 1) {
         err = runtime + " not found in repo";
         qCritical() << err;
-        return false;
+        return nullptr;
     }
     // 查找最高版本，多版本场景安装应用appId要求完全匹配
     QSharedPointer<linglong::package::AppMetaInfo> appInfo =
@@ -244,28 +415,67 @@ auto PackageManager::checkAppRuntime(const QString &runtime,
     // fix 当前服务端不支持按channel查询，返回的结果是默认channel，需要刷新channel/module
     appInfo->channel = channel;
     appInfo->module = module;
-    // 判断app依赖的runtime是否安装 runtime 不区分用户
-    if (!linglong::util::getAppInstalledStatus(appInfo->appId,
-                                               appInfo->version,
-                                               appInfo->arch,
-                                               channel,
-                                               module,
-                                               "")) {
-        ret = installRuntime(appInfo, err);
+    return appInfo;
+}
+
+auto PackageManager::checkAppRuntime(const QString &runtime,
+                                     const QString &channel,
+                                     const QString &module,
+                                     QString &err,
+                                     job_manager::Job *job) -> bool
+{
+    auto appInfo = resolveRuntime(runtime, channel, module, err);
+    if (!appInfo) {
+        return false;
     }
-    return ret;
+    return installRuntimeOnce(appInfo, err, job);
 }
 
-auto PackageManager::checkAppBase(const QString &runtime,
-                                  const QString &channel,
-                                  const QString &module,
-                                  QString &err) -> bool
+auto PackageManager::installRuntimeOnce(QSharedPointer<linglong::package::AppMetaInfo> appInfo,
+                                        QString &err,
+                                        job_manager::Job *job) -> bool
+{
+    const QString key = QStringList{ "runtime",       appInfo->appId,   appInfo->version,
+                                     appInfo->arch,   appInfo->channel, appInfo->module }
+                          .join("/");
+    if (job) {
+        job->setState(STATUS_CODE(kPkgInstalling), "checking " + appInfo->appId);
+    }
+    // 多个应用依赖同一 runtime 时只安装一次，其余任务等待并共享结果
+    auto reply = JOB_SCHEDULER->runOnce(key, [this, appInfo, job]() {
+        Reply reply;
+        reply.code = STATUS_CODE(kSuccess);
+        // 判断app依赖的runtime是否安装 runtime 不区分用户
+        if (!linglong::util::getAppInstalledStatus(appInfo->appId,
+                                                   appInfo->version,
+                                                   appInfo->arch,
+                                                   appInfo->channel,
+                                                   appInfo->module,
+                                                   "")
+            && !installRuntime(appInfo, reply.message, job)) {
+            reply.code = STATUS_CODE(kInstallRuntimeFailed);
+        }
+        return reply;
+    });
+    if (reply.code != STATUS_CODE(kSuccess)) {
+        err = reply.message;
+        return false;
+    }
+    return true;
+}
+
+auto PackageManager::resolveBase(const QString &runtime,
+                                 const QString &channel,
+                                 const QString &module,
+                                 QString &err,
+                                 MetadataSnapshot *snapshot)
+  -> QSharedPointer<linglong::package::AppMetaInfo>
 {
     // 通过runtime获取base ref
     QStringList runtimeList = runtime.split("/");
     if (runtimeList.size() < 3) {
         err = "app runtime:" + runtime + " runtime format err";
-        return false;
+        return nullptr;
     }
     const QString runtimeId = runtimeList.at(0);
     const QString runtimeVer = runtimeList.at(1);
@@ -274,21 +484,15 @@ auto PackageManager::checkAppBase(const QString &runtime,
     // runtimeId 校验
     if (runtimeId.isEmpty()) {
         err = "app runtime:" + runtime + " runtimeId format err";
-        return false;
+        return nullptr;
     }
 
     QList<QSharedPointer<linglong::package::AppMetaInfo>> appList;
-    QString appData = "";
-
-    bool ret = getAppInfoFromServer(runtimeId, runtimeVer, runtimeArch, appData, err);
-    if (!ret) {
-        return false;
-    }
-    ret = loadAppInfo(appData, appList, err);
+    bool ret = queryRemoteApps(runtimeId, runtimeVer, runtimeArch, appList, err, snapshot);
     if (!ret || appList.size() < 1) {
         err = runtime + " not found in repo";
         qCritical() << err;
-        return false;
+        return nullptr;
     }
 
     QSharedPointer<linglong::package::AppMetaInfo> latestRuntimeInfo =
@@ -298,7 +502,7 @@ auto PackageManager::checkAppBase(const QString &runtime,
     QStringList baseList = baseRef.split('/');
     if (baseList.size() < 3) {
         err = "app base:" + baseRef + " base format err";
-        return false;
+        return nullptr;
     }
     const QString baseId = baseList.at(0);
     // FIXME(black_desk): this value comes from baseList will be "latest", which is not handled by
@@ -306,30 +510,40 @@ auto PackageManager::checkAppBase(const QString &runtime,
     const QString baseVer = "";
     const QString baseArch = baseList.at(2);
 
-    bool retbase = true;
-
     QList<QSharedPointer<linglong::package::AppMetaInfo>> baseRuntimeList;
-    QString baseData = "";
-
-    ret = getAppInfoFromServer(baseId, baseVer, baseArch, baseData, err);
-    if (!ret) {
-        return false;
-    }
-    ret = loadAppInfo(baseData, baseRuntimeList, err);
-    if (!ret || appList.size() < 1) {
+    ret = queryRemoteApps(baseId, baseVer, baseArch, baseRuntimeList, err, snapshot);
+    if (!ret || baseRuntimeList.size() < 1) {
         err = baseRef + " not found in repo";
         qCritical() << err;
-        return false;
+        return nullptr;
     }
     // fix to do base runtime debug info, base runtime update
     auto baseInfo = baseRuntimeList.at(0);
     baseInfo->channel = channel;
     baseInfo->module = module;
-    // 判断app依赖的runtime是否安装 runtime 不区分用户
-    if (!linglong::util::getAppInstalledStatus(baseId, baseVer, baseArch, channel, module, "")) {
-        retbase = installRuntime(baseInfo, err);
+    return baseInfo;
+}
+
+auto PackageManager::checkAppBase(const QString &runtime,
+                                  const QString &channel,
+                                  const QString &module,
+                                  QString &err,
+                                  job_manager::Job *job) -> bool
+{
+    auto baseInfo = resolveBase(runtime, channel, module, err);
+    if (!baseInfo) {
+        return false;
     }
-    return retbase;
+    // 判断app依赖的base是否安装 base 不区分用户
+    if (linglong::util::getAppInstalledStatus(baseInfo->appId,
+                                              "",
+                                              baseInfo->arch,
+                                              channel,
+                                              module,
+                                              "")) {
+        return true;
+    }
+    return installRuntimeOnce(baseInfo, err, job);
 }
 
 auto PackageManager::getLatestRuntime(
@@ -413,6 +627,101 @@ void PackageManager::addAppConfig(const QString &appId, const QString &version,
     }
 }
 
+void PackageManager::finishInstallTransaction(const InstallJournal::Transaction &transaction)
+{
+    auto appInfo = util::loadJsonBytes<linglong::package::AppMetaInfo>(
+      QJsonDocument(transaction.appInfo).toJson());
+    if (!appInfo) {
+        qWarning() << "install journal" << transaction.id << "has no app info";
+        installJournal->finish(transaction.id);
+        return;
+    }
+
+    // 更新本地数据库文件
+    if (!transaction.done(InstallJournal::Database)) {
+        if (!linglong::util::getAppInstalledStatus(appInfo->appId,
+                                                   appInfo->version,
+                                                   appInfo->arch,
+                                                   appInfo->channel,
+                                                   appInfo->module,
+                                                   "")) {
+            linglong::util::insertAppRecord(appInfo, transaction.user);
+        }
+        installJournal->complete(transaction.id, InstallJournal::Database);
+    }
+
+    if ("app" == transaction.kind) {
+        // process portal after install
+        if (!transaction.done(InstallJournal::Portal)) {
+            package::Ref ref("",
+                             appInfo->channel,
+                             appInfo->appId,
+                             appInfo->version,
+                             appInfo->arch,
+                             appInfo->module);
+            qDebug() << "call packageManagerHelperInterface.RebuildInstallPortal"
+                     << transaction.installPath;
+            QDBusReply<void> helperRet =
+              packageManagerHelper.RebuildInstallPortal(transaction.installPath,
+                                                        ref.toString(),
+                                                        {});
+            if (!helperRet.isValid()) {
+                qWarning() << "process post install portal failed:" << helperRet.error();
+            }
+            installJournal->complete(transaction.id, InstallJournal::Portal);
+        }
+
+        // 链接应用配置文件到系统配置目录
+        if (!transaction.done(InstallJournal::Triggers)) {
+            addAppConfig(appInfo->appId, appInfo->version, appInfo->arch);
+            postInstallTriggers->markDirty(
+              PostInstallTriggers::triggersFor(appEntriesDir(transaction.installPath)));
+        }
+    }
+    installJournal->finish(transaction.id);
+}
+
+void PackageManager::recoverInterruptedInstalls()
+{
+    installJournal->expireRolledBack();
+    for (const auto &transaction : installJournal->interrupted()) {
+        JOB_SCHEDULER->submit(
+          job_manager::JobPriority::Interactive,
+          "recover " + transaction.ref,
+          [this, transaction]() {
+              auto appInfo = util::loadJsonBytes<linglong::package::AppMetaInfo>(
+                QJsonDocument(transaction.appInfo).toJson());
+              // 与安装流程使用同一把锁，锁名由软件包信息生成
+              job_manager::ResourceLocker refLocker(appInfo ? refLockName(appInfo->channel,
+                                                                          appInfo->appId,
+                                                                          appInfo->version,
+                                                                          appInfo->arch,
+                                                                          appInfo->module)
+                                                            : "ref:" + transaction.ref);
+              if (transaction.done(InstallJournal::Erofs)
+                  && QDir(transaction.installPath).exists()) {
+                  qInfo() << "resume interrupted install of" << transaction.ref;
+                  finishInstallTransaction(transaction);
+                  return;
+              }
+
+              // 签出未完成，删除不完整的安装目录，临时仓库保留给下次安装继续下载
+              qInfo() << "roll back interrupted install of" << transaction.ref;
+              const bool registered = appInfo
+                && linglong::util::getAppInstalledStatus(appInfo->appId,
+                                                         appInfo->version,
+                                                         appInfo->arch,
+                                                         appInfo->channel,
+                                                         appInfo->module,
+                                                         "");
+              if (!registered) {
+                  InstallJournal::removeCheckout(transaction);
+              }
+              installJournal->rollBack(transaction.id);
+          });
+    }
+}
+
 void PackageManager::delAppConfig(const QString &appId, const QString &version, const QString &arch)
 {
     // 是否为多版本
@@ -472,23 +781,114 @@ auto PackageManager::getUserName(uid_t uid) -> QString
     return {};
 }
 
+void PackageManager::setAppState(const QString &key, const Reply &reply)
+{
+    QMutexLocker locker(&appStateMutex);
+    appState.insert(key, reply);
+}
+
+void PackageManager::clearAppState(const QString &key)
+{
+    QMutexLocker locker(&appStateMutex);
+    appState.remove(key);
+}
+
+auto PackageManager::appStateOf(const QString &key, Reply &reply) const -> bool
+{
+    QMutexLocker locker(&appStateMutex);
+    auto it = appState.constFind(key);
+    if (it == appState.constEnd()) {
+        return false;
+    }
+    reply = it.value();
+    return true;
+}
+
 PackageManager::PackageManager(api::dbus::v1::PackageManagerHelper &helper, QObject *parent)
     : QObject(parent)
-    , pool(new QThreadPool)
     , sysLinglongInstallation(linglong::util::getLinglongRootPath() + "/entries/share")
     , kAppInstallPath(linglong::util::getLinglongRootPath() + "/layers/")
     , kLocalRepoPath(linglong::util::getLinglongRootPath())
     , remoteRepoName(util::config::ConfigInstance().repos[package::kDefaultRepo]->repoName)
-    // FIXME(black_desk):
-    // When endpoint get updated by `ModifyRepo`,
-    // the endpoint used by repoClient is not updated.
-    , repoClient(util::config::ConfigInstance().repos[package::kDefaultRepo]->endpoint)
+    , repoClient(repo::RepoClient::withMirrors(package::kDefaultRepo))
     , packageManagerHelper(helper)
 {
     // 检查安装数据库信息
     linglong::util::checkInstalledAppDb();
     linglong::util::updateInstalledAppInfoDb();
-    pool->setMaxThreadCount(POOL_MAX_THREAD);
+    // 已安装软件包索引在安装、卸载线程中更新，变化通过 dbus 信号通知其它进程
+    auto registry = linglong::util::InstalledAppRegistry::instance();
+    registry->ensureLoaded();
+    connect(registry,
+            &linglong::util::InstalledAppRegistry::changed,
+            this,
+            &PackageManager::InstalledAppsChanged,
+            Qt::QueuedConnection);
+    JOB_SCHEDULER->setMaxThreadCount(POOL_MAX_THREAD);
+    RATE_LIMITER->setRate(util::config::ConfigInstance().bandwidthLimit);
+    postInstallTriggers = new PostInstallTriggers(sysLinglongInstallation, this);
+    // 宿主字体可能在服务未运行期间发生变化
+    postInstallTriggers->markDirty(PostInstallTriggers::FontCaches);
+    installJournal.reset(new InstallJournal(linglong::util::getLinglongRootPath() + "/.journal"));
+    recoverInterruptedInstalls();
+    layerReaper.reset(new LayerReaper(linglong::util::getLinglongRootPath() + "/.trash", []() {
+        QString err;
+        OSTREE_REPO_HELPER->repoPrune(err);
+    }));
+    // 删除上次退出前未删完的目录
+    layerReaper->reap();
+    prefetchRecord.reset(
+      new PrefetchRecord(linglong::util::getLinglongRootPath() + "/.prefetch.json"));
+
+    // 仓库地址的变更通过镜像列表对所有客户端生效
+    for (const auto &name : util::config::ConfigInstance().repos.keys()) {
+        updateMirrors(name);
+    }
+    const qint64 probeInterval = util::config::ConfigInstance().mirrorProbeInterval;
+    if (probeInterval > 0) {
+        // 探测耗时取决于网络状况，在线程池中执行
+        auto probe = []() {
+            const auto names = util::config::ConfigInstance().repos.keys();
+            QtConcurrent::run([names]() {
+                for (const auto &name : names) {
+                    MIRROR_LIST->probe(name);
+                }
+            });
+        };
+        auto probeTimer = new QTimer(this);
+        connect(probeTimer, &QTimer::timeout, this, probe);
+        probeTimer->start(static_cast<int>(probeInterval * 1000));
+        QTimer::singleShot(0, this, probe);
+    }
+
+    const auto &prefetchConfig = util::config::ConfigInstance().prefetch;
+    if (prefetchConfig->enabled) {
+        prefetcher = new Prefetcher(
+          [this]() {
+              prefetchUpdates();
+          },
+          this);
+        prefetcher->setAllowMetered(prefetchConfig->allowMetered);
+        prefetcher->setIdleOnly(prefetchConfig->idleOnly);
+        prefetcher->start(prefetchConfig->interval);
+    }
+
+    const auto &peerCacheConfig = util::config::ConfigInstance().peerCache;
+    if (peerCacheConfig->enabled) {
+        peerCacheServer = new repo::PeerCacheServer(kLocalRepoPath + "/repo", this);
+        if (!peerCacheServer->listen(QHostAddress::Any,
+                                     static_cast<quint16>(peerCacheConfig->port))) {
+            qWarning() << "peer cache: listen on" << peerCacheConfig->port
+                       << "failed:" << peerCacheServer->errorString();
+        }
+        peerDiscovery = new repo::PeerDiscovery(peerCacheServer->serverPort(), this);
+        peerDiscovery->setStaticPeers(peerCacheConfig->peers);
+        if (peerCacheConfig->multicast && peerCacheServer->isListening()) {
+            peerDiscovery->startMulticast(QHostAddress(peerCacheConfig->multicastGroup),
+                                          static_cast<quint16>(peerCacheConfig->multicastPort),
+                                          peerCacheConfig->announceInterval);
+        }
+    }
     // 检查应用缓存信息
     linglong::util::checkAppCache();
 }
@@ -531,9 +931,7 @@ auto PackageManager::ModifyRepo(const QString &name, const QString &url) -> Repl
 
     util::config::ConfigInstance().repos[name]->endpoint = url;
     util::config::ConfigInstance().save();
-
-    // FIXME: check setEndpoint comment.
-    repoClient.setEndpoint(url);
+    updateMirrors(name);
 
     bool ret = OSTREE_REPO_HELPER->ensureRepoEnv(kLocalRepoPath, reply.message);
     if (!ret) {
@@ -573,6 +971,43 @@ auto PackageManager::ModifyRepo(const QString &name, const QString &url) -> Repl
     return reply;
 }
 
+auto PackageManager::GetMirrorStatus() -> QVariantMap
+{
+    return MIRROR_LIST->statistics();
+}
+
+void PackageManager::updateMirrors(const QString &name)
+{
+    const auto &repoConfig = util::config::ConfigInstance().repos.value(name);
+    if (!repoConfig) {
+        return;
+    }
+    MIRROR_LIST->setMirrors(name,
+                            QStringList{ repoConfig->endpoint } + repoConfig->mirrors,
+                            "/repos/" + repoConfig->repoName + "/config");
+}
+
+void PackageManager::applyMirrors(PullControl &control) const
+{
+    // ostree 仓库位于镜像地址的 repos 目录下
+    const QString suffix = "/repos/" + remoteRepoName;
+    for (const auto &endpoint : MIRROR_LIST->endpoints(package::kDefaultRepo)) {
+        control.urls << endpoint + suffix;
+    }
+    control.urlResult = [suffix](const QString &url,
+                                 bool success,
+                                 quint64 bytes,
+                                 qint64 elapsedMs,
+                                 const QString &error) {
+        const auto endpoint = url.left(url.size() - suffix.size());
+        if (success) {
+            MIRROR_LIST->reportSuccess(package::kDefaultRepo, endpoint, -1, bytes, elapsedMs);
+        } else {
+            MIRROR_LIST->reportFailure(package::kDefaultRepo, endpoint, error);
+        }
+    };
+}
+
 auto PackageManager::GetDownloadStatus(const ParamOption &paramOption, int type) -> Reply
 {
     Reply reply;
@@ -594,90 +1029,84 @@ auto PackageManager::GetDownloadStatus(const ParamOption &paramOption, int type)
     QString version = paramOption.version.trimmed();
     QString channel = paramOption.channel.trimmed();
     QString appModule = paramOption.appModule.trimmed();
-    QString latestVersion = version;
-    if (version.isEmpty() || type == 1) {
-        if (type == 1) {
-            // 判断是否已安装 bug 146229
-            if (!linglong::util::getAppInstalledStatus(appId, "", arch, channel, appModule, "")) {
-                reply.message = appId + ", version:" + version + ", arch:" + arch
-                  + ", channel:" + channel + ", module:" + appModule + " not installed";
-                reply.code = STATUS_CODE(kPkgNotInstalled);
-                appState.insert(appId + "/" + version + "/" + arch, reply);
-                return reply;
-            }
-        }
-        QString appData = "";
-        // 安装不查缓存
-        auto ret = getAppInfoFromServer(appId, "", arch, appData, reply.message);
-        if (!ret) {
-            reply.code = STATUS_CODE(kPkgInstallFailed);
-            return reply;
-        }
 
-        QList<QSharedPointer<linglong::package::AppMetaInfo>> appList;
-        ret = loadAppInfo(appData, appList, reply.message);
-        if (!ret || appList.size() < 1) {
-            reply.message =
-              "app:" + appId + ", version:" + paramOption.version + " not found in repo";
-            qCritical() << reply.message;
-            reply.code = STATUS_CODE(kPkgInstallFailed);
-            return reply;
+    // 任务执行中或刚结束时直接返回任务状态，进度信息由任务对象记录
+    auto job = jobs.value(appId);
+    if (job) {
+        reply = job->GetState();
+        if (!job->IsFinished()) {
+            reply.code = type > 0 ? STATUS_CODE(kPkgUpdating) : STATUS_CODE(kPkgInstalling);
+            reply.message = job->Status();
         }
+        return reply;
+    }
 
-        // 查找最高版本
-        QSharedPointer<linglong::package::AppMetaInfo> appInfo = getLatestApp(appId, appList);
-        latestVersion = appInfo->version;
+    QString key = appId + "/" + version + "/" + arch;
+    if (appStateOf(key, reply)) {
+        return reply;
     }
 
-    if (type > 0) {
-        reply.message = appId + " is updating...";
-    } else {
-        reply.message = appId + " is installing...";
+    // 判断是否已安装 bug 146229
+    if (type == 1
+        && !linglong::util::getAppInstalledStatus(appId, "", arch, channel, appModule, "")) {
+        reply.message = appId + ", version:" + version + ", arch:" + arch + ", channel:" + channel
+          + ", module:" + appModule + " not installed";
+        reply.code = STATUS_CODE(kPkgNotInstalled);
+        return reply;
     }
 
-    // 获取到完成状态则返回
-    QString key = appId + "/" + version + "/" + arch;
-    int dstState = type > 0 ? STATUS_CODE(kErrorPkgUpdateSuccess) : STATUS_CODE(kPkgInstallSuccess);
-    if (appState.contains(key) && appState[key].code == dstState) {
-        return appState[key];
-    } else {
-        // Fix to do get more specific param 首次安装应用的时候 安装runtime 提示不准
-        QString fileName = QStringList{ channel, appId, latestVersion, arch, appModule }.join("-");
-        QString filePath = "/tmp/.linglong/" + fileName;
-        QFile progressFile(filePath);
-        if (progressFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QStringList ret = QString(progressFile.readAll())
-                                .split(QRegExp("[\r\n]"),
-#ifdef QT_DEPRECATED_VERSION_5_15
-                                       Qt::SkipEmptyParts
-#else
-                                       QString::SkipEmptyParts
-#endif
-                                );
-            if (ret.size() > 1) {
-                QStringList processList = ret.at(1).trimmed().split("\u001B8");
-                reply.message = processList.at(processList.size() - 1).trimmed();
-            }
-            qInfo() << reply.message;
-            progressFile.close();
-        }
-        if (type > 0) {
-            reply.code = STATUS_CODE(kPkgUpdating);
-        } else {
-            reply.code = STATUS_CODE(kPkgInstalling);
-        }
+    reply.message = "no running job for " + appId;
+    reply.code =
+      type > 0 ? STATUS_CODE(kErrorPkgUpdateFailed) : STATUS_CODE(kPkgInstallFailed);
+    return reply;
+}
+
+void PackageManager::runJob(job_manager::Job *job, const std::function<Reply()> &task)
+{
+    Reply reply;
+    // 任务在线程池中排队期间可能已被暂停或取消
+    if (job->waitWhilePaused()) {
+        reply = task();
     }
-    // 下载过程中有异常直接返回
-    if (appState.contains(key)) {
-        // 对于更新操作，下载完成了需要等待卸载完成
-        if (type == 1) {
-            if (appState[key].code == STATUS_CODE(kPkgInstallSuccess)) {
-                appState[key].code = STATUS_CODE(kPkgUpdating);
-            }
+    if (job->isCancelled()) {
+        reply.code = STATUS_CODE(kJobCancelled);
+        reply.message = "job " + job->id() + " cancelled";
+        qInfo() << reply.message;
+    }
+    job->finish(reply);
+}
+
+auto PackageManager::createJob(const QString &appId) -> job_manager::Job *
+{
+    auto *job = new job_manager::Job(QUuid::createUuid().toString(QUuid::Id128), this);
+    new linglong::adaptors::job_manger::Job1(job);
+
+    // 在调用方所在的连接上导出任务对象，nodbus 模式下即为点对点连接
+    QDBusConnection conn("");
+    bool exported = false;
+    if (calledFromDBus()) {
+        conn = connection();
+        exported = conn.registerObject(job->path(), job);
+        if (!exported) {
+            qWarning() << "register job" << job->path() << "failed:" << conn.lastError();
         }
-        return appState[key];
     }
-    return reply;
+
+    connect(job, &job_manager::Job::Finished, this, [this, appId, job, conn, exported]() {
+        // 给客户端留出查询结果的时间后再释放任务
+        QTimer::singleShot(1000 * 60, job, [this, appId, job, conn, exported]() mutable {
+            if (exported) {
+                conn.unregisterObject(job->path());
+            }
+            if (jobs.value(appId) == job) {
+                jobs.remove(appId);
+            }
+            job->deleteLater();
+        });
+    });
+
+    jobs.insert(appId, job);
+    return job;
 }
 
 auto PackageManager::Install(const InstallParamOption &installParamOption) -> Reply
@@ -690,226 +1119,473 @@ auto PackageManager::Install(const InstallParamOption &installParamOption) -> Re
         return reply;
     }
 
-    // FIXME: report error here.
-    QFuture<void> future = QtConcurrent::run(pool.data(), [=]() {
-        Reply reply;
-        QString userName = linglong::util::getUserName();
-        if (noDBusMode) {
-            userName = "deepin-linglong";
-        }
-
-        QString appId = installParamOption.appId.trimmed();
-        QString arch = installParamOption.arch.trimmed().toLower();
-        QString version = installParamOption.version.trimmed();
-        QString channel = installParamOption.channel.trimmed();
-        QString appModule = installParamOption.appModule.trimmed();
+    auto *job = createJob(appId);
+    job->setBandwidthWeight(job_manager::bandwidthWeight(job_manager::JobPriority::Interactive));
+    JOB_SCHEDULER->submit(job_manager::JobPriority::Interactive,
+                          "install " + appId,
+                          [this, installParamOption, job]() {
+                              runJob(job, [this, &installParamOption, job]() {
+                                  return installImpl(installParamOption, job);
+                              });
+                          });
+    reply.code = STATUS_CODE(kPkgInstalling);
+    reply.message = job->path();
+    return reply;
+}
 
-        if (arch.isEmpty()) {
-            arch = linglong::util::hostArch();
-        }
+namespace {
+// 补全安装参数中的默认值
+auto normalizeInstallParam(const InstallParamOption &installParamOption) -> InstallParamOption
+{
+    InstallParamOption option;
+    option.appId = installParamOption.appId.trimmed();
+    option.version = installParamOption.version.trimmed();
+    option.arch = installParamOption.arch.trimmed().toLower();
+    option.channel = installParamOption.channel.trimmed();
+    option.appModule = installParamOption.appModule.trimmed();
 
-        if (channel.isEmpty()) {
-            channel = "linglong";
-        }
-        if (appModule.isEmpty()) {
-            appModule = "runtime";
-        }
+    if (option.arch.isEmpty()) {
+        option.arch = linglong::util::hostArch();
+    }
+    if (option.channel.isEmpty()) {
+        option.channel = "linglong";
+    }
+    if (option.appModule.isEmpty()) {
+        option.appModule = "runtime";
+    }
+    return option;
+}
 
-        package::Ref ref("", channel, appId, version, arch, appModule);
+auto appStateKey(const InstallParamOption &option) -> QString
+{
+    return option.appId + "/" + option.version + "/" + option.arch;
+}
+} // namespace
 
-        qDebug() << "install" << ref.toSpecString();
+auto PackageManager::resolveInstallTarget(const InstallParamOption &installParamOption,
+                                          Reply &reply,
+                                          MetadataSnapshot *snapshot)
+  -> QSharedPointer<linglong::package::AppMetaInfo>
+{
+    const QString &appId = installParamOption.appId;
+    const QString &version = installParamOption.version;
+    const QString &arch = installParamOption.arch;
+    const QString &channel = installParamOption.channel;
+    const QString &appModule = installParamOption.appModule;
 
-        // 异常后重新安装需要清除上次状态
-        appState.remove(appId + "/" + version + "/" + arch);
+    if (arch != linglong::util::hostArch()) {
+        reply.message = "app arch:" + arch + " not support in host";
+        reply.code = STATUS_CODE(kUserInputParamErr);
+        return nullptr;
+    }
 
-        if (arch != linglong::util::hostArch()) {
-            reply.message = "app arch:" + arch + " not support in host";
-            reply.code = STATUS_CODE(kUserInputParamErr);
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
-        }
+    // 安装不查缓存
+    QList<QSharedPointer<linglong::package::AppMetaInfo>> appList;
+    auto ret = queryRemoteApps(appId, version, arch, appList, reply.message, snapshot);
+    if (!ret) {
+        reply.code = STATUS_CODE(kPkgInstallFailed);
+        return nullptr;
+    }
+    if (appList.size() < 1) {
+        reply.message = "app:" + appId + ", version:" + version + " not found in repo";
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kPkgInstallFailed);
+        return nullptr;
+    } else if (appList.first()->kind != "app") {
+        reply.message =
+          "This package is not an application, it should not be maually installed";
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kPkgInstallFailed);
+        return nullptr;
+    }
 
-        QString appData = "";
-        // 安装不查缓存
-        auto ret = getAppInfoFromServer(appId, version, arch, appData, reply.message);
-        if (!ret) {
-            reply.code = STATUS_CODE(kPkgInstallFailed);
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
-        }
+    // 查找最高版本，多版本场景安装应用appId要求完全匹配
+    QSharedPointer<linglong::package::AppMetaInfo> appInfo = getLatestApp(appId, appList);
+    // 不支持模糊安装
+    if (appId != appInfo->appId) {
+        reply.message = "app:" + appId + ", version:" + version + " not found in repo";
+        qCritical() << "found latest app:" << appInfo->appId << ", " << reply.message;
+        reply.code = STATUS_CODE(kPkgInstallFailed);
+        return nullptr;
+    }
+
+    // 判断指定版本是否已安装
+    if (linglong::util::getAppInstalledStatus(appInfo->appId,
+                                              appInfo->version,
+                                              "",
+                                              channel,
+                                              appModule,
+                                              "")) {
+        reply.code = STATUS_CODE(kPkgAlreadyInstalled);
+        reply.message =
+          appInfo->appId + ", version: " + appInfo->version + " already installed";
+        qCritical() << reply.message;
+        return nullptr;
+    }
 
-        QList<QSharedPointer<linglong::package::AppMetaInfo>> appList;
-        ret = loadAppInfo(appData, appList, reply.message);
-        if (!ret || appList.size() < 1) {
-            reply.message = "app:" + appId + ", version:" + version + " not found in repo";
-            qCritical() << reply.message;
-            reply.code = STATUS_CODE(kPkgInstallFailed);
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
-        } else if (appList.first()->kind != "app") {
-            reply.message =
-              "This package is not an application, it should not be maually installed";
-            qCritical() << reply.message;
-            reply.code = STATUS_CODE(kPkgInstallFailed);
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
-        }
+    // 当本地已安装且未指定版本安装时，本地版本比服务器最高版本高，则不允许安装
+    if (linglong::util::getAppInstalledStatus(appInfo->appId, "", "", channel, appModule, "")
+        && version.isEmpty()) {
+        QList<QSharedPointer<linglong::package::AppMetaInfo>> pkgList;
+        // 根据已安装文件查询已经安装软件包信息
+        linglong::util::getInstalledAppInfo(appId, "", arch, channel, appModule, "", pkgList);
 
-        // 查找最高版本，多版本场景安装应用appId要求完全匹配
-        QSharedPointer<linglong::package::AppMetaInfo> appInfo = getLatestApp(appId, appList);
-        // 不支持模糊安装
-        if (appId != appInfo->appId) {
-            reply.message = "app:" + appId + ", version:" + version + " not found in repo";
-            qCritical() << "found latest app:" << appInfo->appId << ", " << reply.message;
-            reply.code = STATUS_CODE(kPkgInstallFailed);
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
-        }
+        auto installedApp = pkgList.at(0);
 
-        // 判断指定版本是否已安装
-        if (linglong::util::getAppInstalledStatus(appInfo->appId,
-                                                  appInfo->version,
-                                                  "",
-                                                  channel,
-                                                  appModule,
-                                                  "")) {
+        if (linglong::util::compareVersion(installedApp->version, appInfo->version) >= 0) {
             reply.code = STATUS_CODE(kPkgAlreadyInstalled);
             reply.message =
-              appInfo->appId + ", version: " + appInfo->version + " already installed";
+              appInfo->appId + ", version: " + installedApp->version + " already installed";
             qCritical() << reply.message;
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
+            return nullptr;
         }
+    }
 
-        // 当本地已安装且未指定版本安装时，本地版本比服务器最高版本高，则不允许安装
-        if (linglong::util::getAppInstalledStatus(appInfo->appId, "", "", channel, appModule, "")
-            && version.isEmpty()) {
-            QList<QSharedPointer<linglong::package::AppMetaInfo>> pkgList;
-            // 根据已安装文件查询已经安装软件包信息
-            linglong::util::getInstalledAppInfo(appId, "", arch, channel, appModule, "", pkgList);
-
-            auto installedApp = pkgList.at(0);
-
-            if (linglong::util::compareVersion(installedApp->version, appInfo->version) >= 0) {
-                reply.code = STATUS_CODE(kPkgAlreadyInstalled);
-                reply.message =
-                  appInfo->appId + ", version: " + installedApp->version + " already installed";
-                qCritical() << reply.message;
-                appState.insert(appId + "/" + version + "/" + arch, reply);
-                return reply;
-            }
-        }
+    return appInfo;
+}
+
+auto PackageManager::deployApp(QSharedPointer<linglong::package::AppMetaInfo> appInfo,
+                               const InstallParamOption &installParamOption,
+                               Reply &reply,
+                               job_manager::Job *job,
+                               const QString &baseVersion) -> bool
+{
+    QString userName = linglong::util::getUserName();
+    if (noDBusMode) {
+        userName = "deepin-linglong";
+    }
+    const QString &channel = installParamOption.channel;
+    const QString &appModule = installParamOption.appModule;
+    package::Ref ref("",
+                     channel,
+                     appInfo->appId,
+                     appInfo->version,
+                     appInfo->arch,
+                     appModule);
+
+    // 下载在线包数据到目标目录
+    QString savePath =
+      kAppInstallPath + appInfo->appId + "/" + appInfo->version + "/" + appInfo->arch;
+    if ("devel" == appModule) {
+        savePath.append("/" + appModule);
+    }
+    appInfo->kind = "app";
+    // fix 当前服务端不支持按channel查询，返回的结果是默认channel，需要刷新channel/module
+    appInfo->channel = channel;
+    appInfo->module = appModule;
+
+    // 每完成一步即记录到事务日志，服务异常退出后据此继续或回滚
+    InstallJournal::Transaction record;
+    record.kind = appInfo->kind;
+    record.ref = ref.toOSTreeRefLocalString();
+    record.installPath = savePath;
+    record.user = userName;
+    auto [appInfoData, jsonErr] = util::toJSON(appInfo);
+    record.appInfo = QJsonDocument::fromJson(appInfoData).object();
+    record.id = installJournal->begin(record);
+
+    qDebug() << "downloadAppData" << ref.toSpecString();
+    auto ret = downloadAppData(appInfo->appId,
+                               appInfo->version,
+                               appInfo->arch,
+                               channel,
+                               appModule,
+                               savePath,
+                               reply.message,
+                               job,
+                               record.id,
+                               baseVersion);
+    if (!ret) {
+        installJournal->rollBack(record.id);
+        qCritical() << "downloadAppData app:" << appInfo->appId
+                    << ", version:" << appInfo->version << " error";
+        reply.code = STATUS_CODE(kLoadPkgDataFailed);
+        return false;
+    }
+
+    if (job) {
+        job->setState(STATUS_CODE(kPkgInstalling), "installing " + appInfo->appId);
+    }
+    record.completed = { InstallJournal::Resolve,
+                         InstallJournal::Fetch,
+                         InstallJournal::Checkout,
+                         InstallJournal::Erofs };
+    finishInstallTransaction(record);
+
+    // 预取的数据已被本次安装使用，同一软件包更旧版本的预取数据不再需要
+    const QString package = PrefetchRecord::packageOf(record.ref);
+    const QString installedVersion = appInfo->version;
+    prefetchRecord->take(record.ref);
+    removePrefetchedRefs(prefetchRecord->takeIf([&](const QString &prefetched) {
+        return PrefetchRecord::packageOf(prefetched) == package
+          && linglong::util::compareVersion(PrefetchRecord::versionOf(prefetched),
+                                            installedVersion)
+          <= 0;
+    }));
+
+    reply.code = STATUS_CODE(kPkgInstallSuccess);
+    reply.message = "install " + appInfo->appId + ", version:" + appInfo->version + " success";
+    qInfo() << reply.message;
+    return true;
+}
+
+auto PackageManager::installImpl(const InstallParamOption &installParamOption,
+                                 job_manager::Job *job,
+                                 const QString &baseVersion) -> Reply
+{
+    Reply reply;
+    const auto option = normalizeInstallParam(installParamOption);
+    const QString stateKey = appStateKey(option);
+
+    package::Ref ref("",
+                     option.channel,
+                     option.appId,
+                     option.version,
+                     option.arch,
+                     option.appModule);
+
+    qDebug() << "install" << ref.toSpecString();
+
+    // 异常后重新安装需要清除上次状态
+    clearAppState(stateKey);
+
+    auto appInfo = resolveInstallTarget(option, reply);
+    if (!appInfo) {
+        setAppState(stateKey, reply);
+        return reply;
+    }
+
+    // 检查软件包依赖的runtime安装状态
+    qDebug() << "checkAppRuntime" << ref.toSpecString();
+    job->setState(STATUS_CODE(kPkgInstalling), "checking runtime " + appInfo->runtime);
+    auto ret =
+      checkAppRuntime(appInfo->runtime, option.channel, option.appModule, reply.message, job);
+    if (!ret) {
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kInstallRuntimeFailed);
+        setAppState(stateKey, reply);
+        return reply;
+    }
 
-        // 检查软件包依赖的runtime安装状态
-        qDebug() << "checkAppRuntime" << ref.toSpecString();
-        ret = checkAppRuntime(appInfo->runtime, channel, appModule, reply.message);
+    // 检查软件包依赖的base安装状态
+    qDebug() << "checkAppBase" << ref.toSpecString();
+    if (!linglong::util::isDeepinSysProduct()) {
+        ret =
+          checkAppBase(appInfo->runtime, option.channel, option.appModule, reply.message, job);
         if (!ret) {
             qCritical() << reply.message;
-            reply.code = STATUS_CODE(kInstallRuntimeFailed);
-            appState.insert(appId + "/" + version + "/" + arch, reply);
+            reply.code = STATUS_CODE(kInstallBaseFailed);
+            setAppState(stateKey, reply);
             return reply;
         }
+    }
 
-        // 检查软件包依赖的base安装状态
-        qDebug() << "checkAppBase" << ref.toSpecString();
-        if (!linglong::util::isDeepinSysProduct()) {
-            ret = checkAppBase(appInfo->runtime, channel, appModule, reply.message);
-            if (!ret) {
-                qCritical() << reply.message;
-                reply.code = STATUS_CODE(kInstallBaseFailed);
-                appState.insert(appId + "/" + version + "/" + arch, reply);
-                return reply;
-            }
-        }
+    // 配置数据库在防抖时间窗口结束后统一更新
+    deployApp(appInfo, option, reply, job, baseVersion);
+    setAppState(stateKey, reply);
+    return reply;
+}
 
-        // 下载在线包数据到目标目录
-        QString savePath =
-          kAppInstallPath + appInfo->appId + "/" + appInfo->version + "/" + appInfo->arch;
-        if ("devel" == appModule) {
-            savePath.append("/" + appModule);
-        }
-        qDebug() << "downloadAppData" << ref.toSpecString();
-        ret = downloadAppData(appInfo->appId,
-                              appInfo->version,
-                              appInfo->arch,
-                              channel,
-                              appModule,
-                              savePath,
-                              reply.message);
-        if (!ret) {
-            qCritical() << "downloadAppData app:" << appInfo->appId
-                        << ", version:" << appInfo->version << " error";
-            reply.code = STATUS_CODE(kLoadPkgDataFailed);
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
-        }
+auto PackageManager::installBatch(const QList<InstallParamOption> &installParamOptions,
+                                  MetadataSnapshot &snapshot,
+                                  job_manager::Job *job,
+                                  const QMap<QString, QString> &baseVersions)
+  -> QMap<QString, Reply>
+{
+    struct Target
+    {
+        InstallParamOption option;
+        QSharedPointer<linglong::package::AppMetaInfo> appInfo;
+        QStringList deps;
+    };
 
-        // 链接应用配置文件到系统配置目录
-        addAppConfig(appInfo->appId, appInfo->version, appInfo->arch);
-
-        // 更新desktop database
-        auto err = util::Exec("update-desktop-database",
-                              { sysLinglongInstallation + "/applications/" },
-                              1000 * 60 * 1);
-        if (err) {
-            qWarning() << "warning: update desktop database of " + sysLinglongInstallation
-                + "/applications/ failed!";
+    QMap<QString, Reply> results;
+    QList<Target> targets;
+    // 依赖的runtime/base取并集，key 为依赖对应的ref
+    QMap<QString, QSharedPointer<linglong::package::AppMetaInfo>> deps;
+    QMap<QString, QString> depErrors;
+    QSet<QString> baseDeps;
+
+    job->setState(STATUS_CODE(kPkgInstalling), "resolving dependencies");
+    for (const auto &param : installParamOptions) {
+        const auto option = normalizeInstallParam(param);
+        const QString stateKey = appStateKey(option);
+        clearAppState(stateKey);
+
+        Reply reply;
+        auto appInfo = resolveInstallTarget(option, reply, &snapshot);
+        if (!appInfo) {
+            setAppState(stateKey, reply);
+            results.insert(option.appId, reply);
+            continue;
         }
 
-        // 更新mime type database
-        if (linglong::util::dirExists(sysLinglongInstallation + "/mime/packages")) {
-            err = util::Exec("update-mime-database",
-                             { sysLinglongInstallation + "/mime/" },
-                             1000 * 60 * 1);
-            if (err) {
-                qWarning() << "warning: update mime type database of " + sysLinglongInstallation
-                    + "/mime/ failed!";
+        Target target{ option, appInfo, {} };
+        auto addDep = [&](QSharedPointer<linglong::package::AppMetaInfo> info,
+                          const QString &err,
+                          bool isBase) {
+            QString key = (isBase ? "base:" : "runtime:") + appInfo->runtime;
+            if (info) {
+                key = info->appId + "/" + info->version + "/" + info->arch + "/"
+                  + option.channel + "/" + option.appModule;
             }
-        }
+            target.deps << key;
+            if (isBase) {
+                baseDeps.insert(key);
+            }
+            if (!info) {
+                depErrors.insert(key, err);
+            } else if (!deps.contains(key)) {
+                deps.insert(key, info);
+            }
+        };
 
-        // 更新 glib-2.0/schemas
-        if (linglong::util::dirExists(sysLinglongInstallation + "/glib-2.0/schemas")) {
-            err = util::Exec("glib-compile-schemas",
-                             { sysLinglongInstallation + "/glib-2.0/schemas" },
-                             1000 * 60 * 1);
-            if (err) {
-                qWarning() << "warning: update schemas of " + sysLinglongInstallation
-                    + "/glib-2.0/schemas failed!";
+        QString err;
+        addDep(resolveRuntime(appInfo->runtime, option.channel, option.appModule, err, &snapshot),
+               err,
+               false);
+        if (!linglong::util::isDeepinSysProduct()) {
+            err.clear();
+            auto baseInfo =
+              resolveBase(appInfo->runtime, option.channel, option.appModule, err, &snapshot);
+            // base 不区分版本，任一版本已安装即可
+            if (!baseInfo
+                || !linglong::util::getAppInstalledStatus(baseInfo->appId,
+                                                          "",
+                                                          baseInfo->arch,
+                                                          option.channel,
+                                                          option.appModule,
+                                                          "")) {
+                addDep(baseInfo, err, true);
             }
         }
+        targets << target;
+    }
 
-        // 更新本地数据库文件
-        appInfo->kind = "app";
-        // fix 当前服务端不支持按channel查询，返回的结果是默认channel，需要刷新channel/module
-        appInfo->channel = channel;
-        appInfo->module = appModule;
+    // 依赖并行安装，已安装的依赖由 installRuntimeOnce 跳过；依赖就绪的应用并行下载部署
+    QMap<QString, Target> targetById;
+    QList<BatchInstaller::Target> batchTargets;
+    for (const auto &target : targets) {
+        targetById.insert(target.option.appId, target);
+        batchTargets.append({ target.option.appId, target.deps });
+    }
 
-        linglong::util::insertAppRecord(appInfo, userName);
+    BatchInstaller installer;
+    installer.installDependency = [this, &deps, job](const QString &key, QString &err) {
+        if (!job->waitWhilePaused()) {
+            err = "job cancelled";
+            return false;
+        }
+        if (!installRuntimeOnce(deps.value(key), err, job)) {
+            qCritical() << err;
+            return false;
+        }
+        return true;
+    };
+    installer.deploy = [this, &targetById, &baseVersions, job](const QString &appId) {
+        const auto target = targetById.value(appId);
+        Reply reply;
+        if (!job->waitWhilePaused()) {
+            reply.code = STATUS_CODE(kPkgInstallFailed);
+            reply.message = "install " + appId + " cancelled";
+        } else {
+            deployApp(target.appInfo, target.option, reply, job, baseVersions.value(appId));
+        }
+        setAppState(appStateKey(target.option), reply);
+        return reply;
+    };
+    installer.dependencyErrorCode = [&baseDeps](const QString &key) {
+        return baseDeps.contains(key) ? STATUS_CODE(kInstallBaseFailed)
+                                      : STATUS_CODE(kInstallRuntimeFailed);
+    };
 
-        // process portal after install
-        {
-            auto installPath = savePath;
-            qDebug() << "call packageManagerHelperInterface.RebuildInstallPortal" << installPath,
-              ref.toLocalFullRef();
-            QDBusReply<void> helperRet =
-              packageManagerHelper.RebuildInstallPortal(installPath, ref.toString(), {});
-            if (!helperRet.isValid()) {
-                qWarning() << "process post install portal failed:" << helperRet.error();
-            }
+    auto batchResults = installer.run(batchTargets, deps.keys(), depErrors);
+    for (auto it = batchResults.cbegin(); it != batchResults.cend(); ++it) {
+        const auto target = targetById.value(it.key());
+        if (it.value().code != STATUS_CODE(kPkgInstallSuccess)) {
+            setAppState(appStateKey(target.option), it.value());
         }
+        results.insert(it.key(), it.value());
+    }
 
-        reply.code = STATUS_CODE(kPkgInstallSuccess);
-        reply.message = "install " + appInfo->appId + ", version:" + appInfo->version + " success";
-        qInfo() << reply.message;
-        appState.insert(appId + "/" + version + "/" + arch, reply);
-        return reply;
+    // 配置数据库在整个批次结束后只更新一次
+    bool anyInstalled = std::any_of(results.cbegin(), results.cend(), [](const Reply &reply) {
+        return reply.code == STATUS_CODE(kPkgInstallSuccess);
     });
+    if (anyInstalled) {
+        postInstallTriggers->flush();
+    }
+    return results;
+}
+
+auto PackageManager::InstallMany(const QList<InstallParamOption> &installParamOptions) -> Reply
+{
+    Reply reply;
+    QStringList appIds;
+    for (const auto &option : installParamOptions) {
+        QString appId = option.appId.trimmed();
+        if (appId.isEmpty()) {
+            reply.message = "appId input err";
+            reply.code = STATUS_CODE(kUserInputParamErr);
+            return reply;
+        }
+        appIds << appId;
+    }
+    if (appIds.isEmpty()) {
+        reply.message = "appId input err";
+        reply.code = STATUS_CODE(kUserInputParamErr);
+        return reply;
+    }
+
+    auto *job = createJob("batch:" + appIds.join(","));
+    job->setBandwidthWeight(job_manager::bandwidthWeight(job_manager::JobPriority::Interactive));
+    JOB_SCHEDULER->submit(job_manager::JobPriority::Interactive,
+                          "install " + appIds.join(","),
+                          [this, installParamOptions, job]() {
+                              runJob(job, [this, &installParamOptions, job]() {
+                                  return installManyImpl(installParamOptions, job);
+                              });
+                          });
     reply.code = STATUS_CODE(kPkgInstalling);
-    reply.message = installParamOption.appId + " is installing";
+    reply.message = job->path();
+    return reply;
+}
+
+auto PackageManager::installManyImpl(const QList<InstallParamOption> &installParamOptions,
+                                     job_manager::Job *job) -> Reply
+{
+    MetadataSnapshot snapshot;
+    auto results = installBatch(installParamOptions, snapshot, job);
+
+    Reply reply;
+    reply.code = STATUS_CODE(kPkgInstallSuccess);
+    QStringList messages;
+    for (auto it = results.cbegin(); it != results.cend(); ++it) {
+        messages << it.value().message;
+        if (it.value().code != STATUS_CODE(kPkgInstallSuccess)) {
+            reply.code = STATUS_CODE(kPkgInstallFailed);
+        }
+    }
+    reply.message = messages.join("\n");
     return reply;
 }
 
 auto PackageManager::Uninstall(const UninstallParamOption &paramOption) -> Reply
+{
+    // 调用方用户只能在 DBus 调用的上下文中查询
+    QString caller;
+    if (paramOption.delAppData && !noDBusMode && calledFromDBus()) {
+        QDBusReply<uint> dbusReply = connection().interface()->serviceUid(message().service());
+        if (dbusReply.isValid()) {
+            caller = getUserName(dbusReply.value());
+        }
+        qDebug() << "Uninstall app call user:" << caller << dbusReply.error();
+    }
+    return uninstallImpl(paramOption, caller);
+}
+
+auto PackageManager::uninstallImpl(const UninstallParamOption &paramOption,
+                                   const QString &caller) -> Reply
 {
     Reply reply;
     QString appId = paramOption.appId.trimmed();
@@ -1010,8 +1686,11 @@ auto PackageManager::Uninstall(const UninstallParamOption &paramOption) -> Reply
                              .arg(appModule);
 
         qInfo() << "Uninstall app ref:" << matchRef;
-        ret =
-          OSTREE_REPO_HELPER->repoDeleteDatabyRef(kLocalRepoPath, qrepoList[0], matchRef, strErr);
+        ret = OSTREE_REPO_HELPER->repoDeleteDatabyRef(kLocalRepoPath,
+                                                      qrepoList[0],
+                                                      matchRef,
+                                                      strErr,
+                                                      false);
         if (!ret) {
             qCritical() << strErr;
             reply.code = STATUS_CODE(kPkgUninstallFailed);
@@ -1026,59 +1705,20 @@ auto PackageManager::Uninstall(const UninstallParamOption &paramOption) -> Reply
         // 更新安装数据库
         linglong::util::deleteAppRecord(appId, it->version, arch, channel, appModule, userName);
 
+        // 目录删除前记录应用提供的配置文件类型
+        postInstallTriggers->markDirty(PostInstallTriggers::triggersFor(
+          appEntriesDir(kAppInstallPath + it->appId + "/" + it->version + "/" + arch)));
         delAppConfig(appId, it->version, arch);
-        // 更新desktop database
-        auto err = util::Exec("update-desktop-database",
-                              { sysLinglongInstallation + "/applications/" },
-                              1000 * 60 * 1);
-        if (err) {
-            qWarning() << "warning: update desktop database of " + sysLinglongInstallation
-                + "/applications/ failed!";
-        }
-
-        // 更新mime type database
-        if (linglong::util::dirExists(sysLinglongInstallation + "/mime/packages")) {
-            err = util::Exec("update-mime-database",
-                             { sysLinglongInstallation + "/mime/" },
-                             1000 * 60 * 1);
-            if (!err) {
-                qWarning() << "warning: update mime type database of " + sysLinglongInstallation
-                    + "/mime/ failed!";
-            }
-        }
 
-        // 更新 glib-2.0/schemas
-        if (linglong::util::dirExists(sysLinglongInstallation + "/glib-2.0/schemas")) {
-            err = util::Exec("glib-compile-schemas",
-                             { sysLinglongInstallation + "/glib-2.0/schemas" },
-                             1000 * 60 * 1);
-            if (err) {
-                qWarning() << "warning: update schemas of " + sysLinglongInstallation
-                    + "/glib-2.0/schemas failed!";
-            }
-        }
-
-        // 删除应用对应的安装目录
+        // 删除应用对应的安装目录，目录先移入回收目录，由后台线程删除
         const QString installPath = kAppInstallPath + it->appId + "/" + it->version;
 
         // process portal before uninstall
         {
             QVariantMap variantMap;
-            if (paramOption.delAppData) {
-                if (!noDBusMode) {
-                    QDBusReply<uint> dbusReply =
-                      connection().interface()->serviceUid(message().service());
-                    QString caller = "";
-                    if (dbusReply.isValid()) {
-                        caller = getUserName(dbusReply.value());
-                    }
-                    qDebug() << "Uninstall app call user:" << caller << dbusReply.error();
-                    if (!caller.isEmpty()) {
-                        QString appDataPath =
-                          QString("/home/%1/.linglong/%2").arg(caller).arg(it->appId);
-                        variantMap.insert(linglong::util::kKeyDelData, appDataPath);
-                    }
-                }
+            if (paramOption.delAppData && !caller.isEmpty()) {
+                QString appDataPath = QString("/home/%1/.linglong/%2").arg(caller).arg(it->appId);
+                variantMap.insert(linglong::util::kKeyDelData, appDataPath);
             }
             auto packageRootPath = installPath + "/" + arch;
             qDebug() << "call packageManagerHelperInterface.RuinInstallPortal" << packageRootPath
@@ -1107,16 +1747,16 @@ auto PackageManager::Uninstall(const UninstallParamOption &paramOption) -> Reply
                         file.dir().remove(file.fileName());
                     } else {
                         if ("devel" != file.fileName()) {
-                            linglong::util::removeDir(file.absoluteFilePath());
+                            layerReaper->remove(file.absoluteFilePath());
                         }
                     }
                 }
             } else {
-                linglong::util::removeDir(installPath);
+                layerReaper->remove(installPath);
             }
         } else {
             // 卸载debug版本
-            linglong::util::removeDir(installPath + "/" + arch + "/devel");
+            layerReaper->remove(installPath + "/" + arch + "/devel");
         }
 
         QDir archDir(installPath + "/" + arch);
@@ -1134,6 +1774,15 @@ auto PackageManager::Uninstall(const UninstallParamOption &paramOption) -> Reply
         reply.message = "uninstall " + appId + ", version:" + it->version + " success";
         delVersionList.append(it->version);
     }
+    // 软件包的所有版本都已卸载时，之前预取的新版本不再需要
+    if (!linglong::util::getAppInstalledStatus(appId, "", arch, channel, appModule, "")) {
+        const QString package = QStringList{ channel, appId, arch, appModule }.join('/');
+        removePrefetchedRefs(prefetchRecord->takeIf([&package](const QString &prefetched) {
+            return PrefetchRecord::packageOf(prefetched) == package;
+        }));
+    }
+    // 目录删除及仓库对象清理耗时较长，在后台执行
+    layerReaper->requestPrune();
     reply.code = STATUS_CODE(kPkgUninstallSuccess);
     if (paramOption.delAllVersion && pkgList.size() > 1) {
         reply.message = "uninstall " + appId + " " + delVersionList.join(",") + " success";
@@ -1151,130 +1800,458 @@ auto PackageManager::Update(const ParamOption &paramOption) -> Reply
         return reply;
     }
 
-    // FIXME: report error here.
-    QFuture<void> future = QtConcurrent::run(pool.data(), [=]() {
-        Reply reply;
+    auto *job = createJob(appId);
+    job->setState(STATUS_CODE(kPkgUpdating), appId + " is updating");
+    job->setBandwidthWeight(
+      job_manager::bandwidthWeight(job_manager::JobPriority::BackgroundUpdate));
+    JOB_SCHEDULER->submit(job_manager::JobPriority::BackgroundUpdate,
+                          "update " + appId,
+                          [this, paramOption, job]() {
+                              runJob(job, [this, &paramOption, job]() {
+                                  return updateImpl(paramOption, job);
+                              });
+                          });
+    reply.code = STATUS_CODE(kPkgUpdating);
+    reply.message = job->path();
+    return reply;
+}
 
-        QString appId = paramOption.appId.trimmed();
-        QString arch = paramOption.arch.trimmed().toLower();
-        QString version = paramOption.version.trimmed();
-        if (arch.isEmpty()) {
-            arch = linglong::util::hostArch();
-        }
+auto PackageManager::updateImpl(const ParamOption &paramOption, job_manager::Job *job) -> Reply
+{
+    Reply reply;
 
-        QString channel = paramOption.channel.trimmed();
-        QString appModule = paramOption.appModule.trimmed();
-        if (channel.isEmpty()) {
-            channel = "linglong";
-        }
-        if (appModule.isEmpty()) {
-            appModule = "runtime";
-        }
+    QString appId = paramOption.appId.trimmed();
+    QString arch = paramOption.arch.trimmed().toLower();
+    QString version = paramOption.version.trimmed();
+    if (arch.isEmpty()) {
+        arch = linglong::util::hostArch();
+    }
 
-        // 异常后重新安装需要清除上次状态
-        appState.remove(appId + "/" + version + "/" + arch);
+    QString channel = paramOption.channel.trimmed();
+    QString appModule = paramOption.appModule.trimmed();
+    if (channel.isEmpty()) {
+        channel = "linglong";
+    }
+    if (appModule.isEmpty()) {
+        appModule = "runtime";
+    }
 
-        // 判断是否已安装
-        if (!linglong::util::getAppInstalledStatus(appId, version, arch, channel, appModule, "")) {
-            reply.message = appId + ", version:" + version + ", arch:" + arch
-              + ", channel:" + channel + ", module:" + appModule + " not installed";
-            qCritical() << reply.message;
-            reply.code = STATUS_CODE(kPkgNotInstalled);
+    // 异常后重新安装需要清除上次状态
+    clearAppState(appId + "/" + version + "/" + arch);
 
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
-        }
+    // 判断是否已安装
+    if (!linglong::util::getAppInstalledStatus(appId, version, arch, channel, appModule, "")) {
+        reply.message = appId + ", version:" + version + ", arch:" + arch
+          + ", channel:" + channel + ", module:" + appModule + " not installed";
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kPkgNotInstalled);
 
-        // 检查是否存在版本更新
-        QList<QSharedPointer<linglong::package::AppMetaInfo>> pkgList;
-        // 根据已安装文件查询已经安装软件包信息
-        linglong::util::getInstalledAppInfo(appId, version, arch, channel, appModule, "", pkgList);
-        if (pkgList.size() != 1) {
-            reply.message = "query local app:" + appId + " info err";
-            qCritical() << reply.message;
-            reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+        setAppState(appId + "/" + version + "/" + arch, reply);
+        return reply;
+    }
 
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
-        }
+    // 检查是否存在版本更新
+    QList<QSharedPointer<linglong::package::AppMetaInfo>> pkgList;
+    // 根据已安装文件查询已经安装软件包信息
+    linglong::util::getInstalledAppInfo(appId, version, arch, channel, appModule, "", pkgList);
+    if (pkgList.size() != 1) {
+        reply.message = "query local app:" + appId + " info err";
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
 
-        auto installedApp = pkgList.at(0);
-        QString currentVersion = installedApp->version;
-        QString appData = QString();
-        auto ret = getAppInfoFromServer(appId, "", arch, appData, reply.message);
-        if (!ret) {
-            reply.message = "query server app:" + appId + " info err";
-            qCritical() << reply.message;
-            reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+        setAppState(appId + "/" + version + "/" + arch, reply);
+        return reply;
+    }
+
+    auto installedApp = pkgList.at(0);
+    QString currentVersion = installedApp->version;
+    QString appData = QString();
+    auto ret = getAppInfoFromServer(appId, "", arch, appData, reply.message);
+    if (!ret) {
+        reply.message = "query server app:" + appId + " info err";
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+
+        setAppState(appId + "/" + version + "/" + arch, reply);
+        return reply;
+    }
+
+    QList<QSharedPointer<linglong::package::AppMetaInfo>> serverPkgList;
+    ret = loadAppInfo(appData, serverPkgList, reply.message);
+    if (!ret || serverPkgList.size() < 1) {
+        reply.message = "load app:" + appId + " info err";
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+
+        setAppState(appId + "/" + version + "/" + arch, reply);
+        return reply;
+    }
+
+    auto serverApp = getLatestApp(appId, serverPkgList);
+
+    if (linglong::util::compareVersion(currentVersion, serverApp->version) >= 0) {
+        reply.message =
+          "app:" + appId + ", latest version:" + currentVersion + " already installed";
+        qCritical() << reply.message;
+        // bug 149881
+        reply.code = STATUS_CODE(kErrorPkgUpdateSuccess);
+        setAppState(appId + "/" + version + "/" + arch, reply);
+        return reply;
+    }
+
+    InstallParamOption installParamOption;
+    installParamOption.appId = appId;
+    installParamOption.version = serverApp->version;
+    installParamOption.arch = arch;
+    installParamOption.channel = channel;
+    installParamOption.appModule = appModule;
+    reply = installImpl(installParamOption, job, currentVersion);
+    if (reply.code != STATUS_CODE(kPkgInstallSuccess)) {
+        reply.message =
+          "download app:" + appId + ", version:" + installParamOption.version + " err";
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
 
-            appState.insert(appId + "/" + version + "/" + arch, reply);
+        setAppState(appId + "/" + version + "/" + arch, reply);
+        return reply;
+    }
+
+    UninstallParamOption uninstallParamOption;
+    uninstallParamOption.appId = appId;
+    uninstallParamOption.version = currentVersion;
+    uninstallParamOption.channel = channel;
+    uninstallParamOption.appModule = appModule;
+    if (!job->waitWhilePaused()) {
+        reply.message = "update " + appId + " cancelled";
+        reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+        return reply;
+    }
+    job->setState(STATUS_CODE(kPkgUpdating), "uninstalling " + appId + " " + currentVersion);
+    reply = uninstallImpl(uninstallParamOption);
+    if (reply.code != STATUS_CODE(kPkgUninstallSuccess)) {
+        reply.message = "uninstall app:" + appId + ", version:" + currentVersion + " err";
+        qCritical() << reply.message;
+        reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+
+        setAppState(appId + "/" + version + "/" + arch, reply);
+        return reply;
+    }
+
+    reply.code = STATUS_CODE(kErrorPkgUpdateSuccess);
+    reply.message =
+      "update " + appId + " success, version:" + currentVersion + " --> " + serverApp->version;
+    setAppState(appId + "/" + version + "/" + arch, reply);
+    return reply;
+}
+
+auto PackageManager::UpdateAll(const QList<ParamOption> &paramOptions) -> Reply
+{
+    Reply reply;
+    QStringList appIds;
+    for (const auto &option : paramOptions) {
+        QString appId = option.appId.trimmed();
+        if (appId.isEmpty()) {
+            reply.message = "appId input err";
+            reply.code = STATUS_CODE(kUserInputParamErr);
             return reply;
         }
+        appIds << appId;
+    }
+
+    auto *job = createJob("batch:" + (appIds.isEmpty() ? QString("all") : appIds.join(",")));
+    job->setState(STATUS_CODE(kPkgUpdating), "checking updates");
+    job->setBandwidthWeight(
+      job_manager::bandwidthWeight(job_manager::JobPriority::BackgroundUpdate));
+    JOB_SCHEDULER->submit(job_manager::JobPriority::BackgroundUpdate,
+                          "update " + appIds.join(","),
+                          [this, paramOptions, job]() {
+                              runJob(job, [this, &paramOptions, job]() {
+                                  return updateAllImpl(paramOptions, job);
+                              });
+                          });
+    reply.code = STATUS_CODE(kPkgUpdating);
+    reply.message = job->path();
+    return reply;
+}
 
-        QList<QSharedPointer<linglong::package::AppMetaInfo>> serverPkgList;
-        ret = loadAppInfo(appData, serverPkgList, reply.message);
-        if (!ret || serverPkgList.size() < 1) {
-            reply.message = "load app:" + appId + " info err";
-            qCritical() << reply.message;
+auto PackageManager::updateAllImpl(const QList<ParamOption> &paramOptions,
+                                   job_manager::Job *job) -> Reply
+{
+    Reply reply;
+    QList<ParamOption> candidates = paramOptions;
+    // 未指定应用时检查所有已安装应用
+    if (candidates.isEmpty()) {
+        QString result;
+        QList<QSharedPointer<linglong::package::AppMetaInfo>> installedList;
+        if (!linglong::util::queryAllInstalledApp("", result, reply.message)
+            || !linglong::util::getAppMetaInfoListByJson(result, installedList)) {
             reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
-
-            appState.insert(appId + "/" + version + "/" + arch, reply);
+            qCritical() << reply.message;
             return reply;
         }
+        QSet<QString> seen;
+        for (const auto &app : installedList) {
+            const QString key = app->appId + "/" + app->channel + "/" + app->module;
+            if (app->kind != "app" || seen.contains(key)) {
+                continue;
+            }
+            seen.insert(key);
+            ParamOption option;
+            option.appId = app->appId;
+            option.arch = app->arch;
+            option.channel = app->channel;
+            option.appModule = app->module;
+            candidates << option;
+        }
+    }
 
-        auto serverApp = getLatestApp(appId, serverPkgList);
+    MetadataSnapshot snapshot;
+    QMap<QString, Reply> results;
+    QMap<QString, QString> currentVersions;
+    QList<InstallParamOption> installParamOptions;
+    for (const auto &paramOption : candidates) {
+        InstallParamOption option;
+        option.appId = paramOption.appId;
+        option.arch = paramOption.arch;
+        option.channel = paramOption.channel;
+        option.appModule = paramOption.appModule;
+        option = normalizeInstallParam(option);
+        const QString version = paramOption.version.trimmed();
+
+        Reply appReply;
+        QList<QSharedPointer<linglong::package::AppMetaInfo>> pkgList;
+        // 根据已安装文件查询已经安装软件包信息
+        if (!linglong::util::getInstalledAppInfo(option.appId,
+                                                 version,
+                                                 option.arch,
+                                                 option.channel,
+                                                 option.appModule,
+                                                 "",
+                                                 pkgList)) {
+            appReply.message = option.appId + ", version:" + version + ", arch:" + option.arch
+              + ", channel:" + option.channel + ", module:" + option.appModule + " not installed";
+            appReply.code = STATUS_CODE(kPkgNotInstalled);
+            qCritical() << appReply.message;
+            results.insert(option.appId, appReply);
+            continue;
+        }
+        const QString currentVersion = pkgList.at(0)->version;
 
+        QList<QSharedPointer<linglong::package::AppMetaInfo>> serverPkgList;
+        if (!queryRemoteApps(option.appId,
+                             "",
+                             option.arch,
+                             serverPkgList,
+                             appReply.message,
+                             &snapshot)
+            || serverPkgList.size() < 1) {
+            appReply.message = "query server app:" + option.appId + " info err";
+            appReply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+            qCritical() << appReply.message;
+            results.insert(option.appId, appReply);
+            continue;
+        }
+
+        auto serverApp = getLatestApp(option.appId, serverPkgList);
         if (linglong::util::compareVersion(currentVersion, serverApp->version) >= 0) {
-            reply.message =
-              "app:" + appId + ", latest version:" + currentVersion + " already installed";
-            qCritical() << reply.message;
-            // bug 149881
-            reply.code = STATUS_CODE(kErrorPkgUpdateSuccess);
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
+            appReply.message =
+              "app:" + option.appId + ", latest version:" + currentVersion + " already installed";
+            appReply.code = STATUS_CODE(kErrorPkgUpdateSuccess);
+            qInfo() << appReply.message;
+            results.insert(option.appId, appReply);
+            continue;
         }
 
-        InstallParamOption installParamOption;
-        installParamOption.appId = appId;
-        installParamOption.version = serverApp->version;
-        installParamOption.arch = arch;
-        installParamOption.channel = channel;
-        installParamOption.appModule = appModule;
-        reply = Install({ installParamOption });
-        if (reply.code != STATUS_CODE(kPkgInstallSuccess)) {
-            reply.message =
-              "download app:" + appId + ", version:" + installParamOption.version + " err";
-            qCritical() << reply.message;
-            reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+        option.version = serverApp->version;
+        installParamOptions << option;
+        currentVersions.insert(option.appId, currentVersion);
+    }
+
+    auto installResults = installBatch(installParamOptions, snapshot, job, currentVersions);
+    for (const auto &option : installParamOptions) {
+        const QString currentVersion = currentVersions.value(option.appId);
+        Reply appReply = installResults.value(option.appId);
+        if (appReply.code != STATUS_CODE(kPkgInstallSuccess)) {
+            appReply.message = "download app:" + option.appId + ", version:" + option.version
+              + " err: " + appReply.message;
+            appReply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+            qCritical() << appReply.message;
+            results.insert(option.appId, appReply);
+            continue;
+        }
 
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
+        if (!job->waitWhilePaused()) {
+            appReply.message = "update " + option.appId + " cancelled";
+            appReply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+            results.insert(option.appId, appReply);
+            continue;
         }
 
         UninstallParamOption uninstallParamOption;
-        uninstallParamOption.appId = appId;
+        uninstallParamOption.appId = option.appId;
         uninstallParamOption.version = currentVersion;
-        uninstallParamOption.channel = channel;
-        uninstallParamOption.appModule = appModule;
-        reply = Uninstall(uninstallParamOption);
-        if (reply.code != STATUS_CODE(kPkgUninstallSuccess)) {
-            reply.message = "uninstall app:" + appId + ", version:" + currentVersion + " err";
-            qCritical() << reply.message;
+        uninstallParamOption.channel = option.channel;
+        uninstallParamOption.appModule = option.appModule;
+        job->setState(STATUS_CODE(kPkgUpdating),
+                      "uninstalling " + option.appId + " " + currentVersion);
+        appReply = uninstallImpl(uninstallParamOption);
+        if (appReply.code != STATUS_CODE(kPkgUninstallSuccess)) {
+            appReply.message =
+              "uninstall app:" + option.appId + ", version:" + currentVersion + " err";
+            appReply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+            qCritical() << appReply.message;
+            results.insert(option.appId, appReply);
+            continue;
+        }
+
+        appReply.code = STATUS_CODE(kErrorPkgUpdateSuccess);
+        appReply.message = "update " + option.appId + " success, version:" + currentVersion
+          + " --> " + option.version;
+        results.insert(option.appId, appReply);
+    }
+
+    reply.code = STATUS_CODE(kErrorPkgUpdateSuccess);
+    QStringList messages;
+    for (auto it = results.cbegin(); it != results.cend(); ++it) {
+        messages << it.value().message;
+        if (it.value().code != STATUS_CODE(kErrorPkgUpdateSuccess)) {
             reply.code = STATUS_CODE(kErrorPkgUpdateFailed);
+        }
+    }
+    reply.message = messages.join("\n");
+    return reply;
+}
 
-            appState.insert(appId + "/" + version + "/" + arch, reply);
-            return reply;
+void PackageManager::prefetchUpdates()
+{
+    QString err;
+    if (!OSTREE_REPO_HELPER->ensureRepoEnv(kLocalRepoPath, err)) {
+        qWarning() << "prefetch:" << err;
+        return;
+    }
+
+    QString result;
+    QList<QSharedPointer<linglong::package::AppMetaInfo>> installedList;
+    if (!linglong::util::queryAllInstalledApp("", result, err)
+        || !linglong::util::getAppMetaInfoListByJson(result, installedList)) {
+        qWarning() << "prefetch: query installed apps failed" << err;
+        return;
+    }
+
+    PullControl control;
+    control.maxBytesPerSecond = util::config::ConfigInstance().prefetch->bandwidthLimit;
+    control.weight = job_manager::bandwidthWeight(job_manager::JobPriority::Prefetch);
+    if (peerDiscovery) {
+        control.peers = peerDiscovery->peers();
+    }
+    applyMirrors(control);
+
+    // installed: 已安装的软件包；resolved: 已查询到最新版本的软件包；wanted: 本次需要的预取数据
+    QSet<QString> installed;
+    QSet<QString> resolved;
+    QSet<QString> wanted;
+    for (const auto &app : installedList) {
+        installed.insert(QStringList{ app->channel, app->appId, app->arch, app->module }.join('/'));
+    }
+
+    QSet<QString> checked;
+    for (const auto &app : installedList) {
+        const QString key = app->appId + "/" + app->channel + "/" + app->module;
+        if (app->kind != "app" || app->arch != linglong::util::hostArch()
+            || checked.contains(key)) {
+            continue;
         }
+        checked.insert(key);
 
-        reply.code = STATUS_CODE(kErrorPkgUpdateSuccess);
-        reply.message =
-          "update " + appId + " success, version:" + currentVersion + " --> " + serverApp->version;
-        appState.insert(appId + "/" + version + "/" + arch, reply);
-        return reply;
-    });
-    reply.code = STATUS_CODE(kPkgUpdating);
-    reply.message = appId + " is updating";
-    return reply;
+        QList<QSharedPointer<linglong::package::AppMetaInfo>> pkgList;
+        linglong::util::getInstalledAppInfo(app->appId,
+                                            "",
+                                            app->arch,
+                                            app->channel,
+                                            app->module,
+                                            "",
+                                            pkgList);
+        QList<QSharedPointer<linglong::package::AppMetaInfo>> serverPkgList;
+        if (pkgList.isEmpty()
+            || !queryRemoteApps(app->appId, "", app->arch, serverPkgList, err)
+            || serverPkgList.isEmpty()) {
+            continue;
+        }
+        auto serverApp = getLatestApp(app->appId, serverPkgList);
+        if (serverApp->appId != app->appId) {
+            continue;
+        }
+        resolved.insert(QStringList{ app->channel, app->appId, app->arch, app->module }.join('/'));
+        if (linglong::util::compareVersion(pkgList.at(0)->version, serverApp->version) >= 0) {
+            continue;
+        }
+
+        QString matchRef = QString("%1/%2/%3/%4/%5")
+                             .arg(app->channel)
+                             .arg(app->appId)
+                             .arg(serverApp->version)
+                             .arg(app->arch)
+                             .arg(app->module);
+        wanted.insert(matchRef);
+        // 与安装任务共用 ref 锁，避免重复下载
+        job_manager::ResourceLocker refLocker(
+          refLockName(app->channel, app->appId, serverApp->version, app->arch, app->module));
+        if (OSTREE_REPO_HELPER->hasRef(kLocalRepoPath, matchRef)) {
+            continue;
+        }
+        qInfo() << "prefetch" << matchRef;
+        if (!OSTREE_REPO_HELPER->repoPullbyCmd(kLocalRepoPath,
+                                               remoteRepoName,
+                                               matchRef,
+                                               err,
+                                               control)) {
+            qWarning() << "prefetch" << matchRef << "failed:" << err;
+            continue;
+        }
+        prefetchRecord->add(matchRef);
+    }
+
+    // 软件包已卸载，或远端已有更新的版本时，之前预取的数据不再需要；查询失败的软件包保留
+    removePrefetchedRefs(prefetchRecord->takeIf([&](const QString &prefetched) {
+        const QString package = PrefetchRecord::packageOf(prefetched);
+        return !installed.contains(package)
+          || (resolved.contains(package) && !wanted.contains(prefetched));
+    }));
+}
+
+void PackageManager::removePrefetchedRefs(const QStringList &refs)
+{
+    if (refs.isEmpty()) {
+        return;
+    }
+
+    QString err;
+    QVector<QString> qrepoList;
+    if (!OSTREE_REPO_HELPER->getRemoteRepoList(kLocalRepoPath, qrepoList, err)
+        || qrepoList.isEmpty()) {
+        qWarning() << "remove prefetched refs:" << err;
+        return;
+    }
+    for (const auto &ref : refs) {
+        const auto parts = ref.split('/');
+        // 已安装的版本由卸载流程删除
+        if (linglong::util::getAppInstalledStatus(parts[1],
+                                                  parts[2],
+                                                  parts[3],
+                                                  parts[0],
+                                                  parts[4],
+                                                  "")) {
+            continue;
+        }
+        job_manager::ResourceLocker refLocker(
+          refLockName(parts[0], parts[1], parts[2], parts[3], parts[4]));
+        qInfo() << "remove prefetched" << ref;
+        if (!OSTREE_REPO_HELPER
+               ->repoDeleteDatabyRef(kLocalRepoPath, qrepoList[0], ref, err, false)) {
+            qWarning() << "remove prefetched" << ref << "failed:" << err;
+        }
+    }
+    layerReaper->requestPrune();
 }
 
 auto PackageManager::Query(const QueryParamOption &paramOption) -> QueryReply
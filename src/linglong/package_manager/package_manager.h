@@ -11,18 +11,32 @@
 #include "linglong/dbus_ipc/package_manager_param.h"
 #include "linglong/dbus_ipc/param_option.h"
 #include "linglong/dbus_ipc/reply.h"
+#include "linglong/job_manager/job.h"
+#include "linglong/package_manager/install_journal.h"
+#include "linglong/package_manager/layer_reaper.h"
+#include "linglong/package_manager/post_install_triggers.h"
+#include "linglong/package_manager/prefetch_record.h"
+#include "linglong/package_manager/prefetcher.h"
 #include "linglong/package/package.h"
+#include "linglong/repo/ostree_repohelper.h"
+#include "linglong/repo/peer_cache_server.h"
+#include "linglong/repo/peer_discovery.h"
 #include "linglong/repo/repo_client.h"
 
 #include <QDBusArgument>
 #include <QDBusContext>
 #include <QFuture>
+#include <QHash>
 #include <QList>
+#include <QMutex>
 #include <QObject>
+#include <QPointer>
 #include <QScopedPointer>
 #include <QThreadPool>
 #include <QtConcurrent/QtConcurrent>
 
+#include <functional>
+
 namespace linglong::service {
 /**
  * @brief The PackageManager class
@@ -67,6 +81,13 @@ public Q_SLOTS:
      */
     virtual auto ModifyRepo(const QString &name, const QString &url) -> Reply;
 
+    /**
+     * @brief 查询各仓库镜像的延迟、吞吐量及失败次数
+     *
+     * @return QVariantMap 仓库名到按优先级排列的镜像状态列表
+     */
+    auto GetMirrorStatus() -> QVariantMap;
+
     /**
      * @brief 查询软件包下载安装状态
      *
@@ -86,7 +107,7 @@ public Q_SLOTS:
      *
      * @return Reply dbus方法调用应答 \n
      *          code:状态码 \n
-     *          message:信息
+     *          message:任务对象路径，客户端通过 org.deepin.linglong.Job1 接口订阅进度
      */
     virtual auto Install(const InstallParamOption &installParamOption) -> Reply;
 
@@ -108,6 +129,25 @@ public Q_SLOTS:
      */
     auto Update(const ParamOption &paramOption) -> Reply;
 
+    /**
+     * @brief 批量安装软件包，所有目标基于同一份服务端元数据解析，依赖取并集后并行下载，
+     *        安装后的配置更新只执行一次
+     *
+     * @param installParamOptions 安装参数列表
+     *
+     * @return Reply 同Install
+     */
+    auto InstallMany(const QList<InstallParamOption> &installParamOptions) -> Reply;
+
+    /**
+     * @brief 批量更新软件包
+     *
+     * @param paramOptions 更新参数列表，为空时更新所有已安装的应用
+     *
+     * @return Reply 同Install
+     */
+    auto UpdateAll(const QList<ParamOption> &paramOptions) -> Reply;
+
     /**
      * @brief 查询软件包信息
      *
@@ -121,9 +161,6 @@ public Q_SLOTS:
     virtual auto Query(const QueryParamOption &paramOption) -> QueryReply;
 
 public:
-    // FIXME: ??? why this public?
-    QScopedPointer<QThreadPool> pool; ///< 下载、卸载、更新应用线程池
-
     /**
      * @brief 设置是否为nodbus安装模式
      *
@@ -131,7 +168,155 @@ public:
      */
     virtual void setNoDBusMode(bool enable);
 
+Q_SIGNALS:
+    /**
+     * @brief 已安装软件包发生变化，ll-service 据此刷新已安装软件包索引
+     *
+     * @param appId 发生变化的软件包包名
+     */
+    void InstalledAppsChanged(const QString &appId);
+
 private:
+    // 批量操作期间共享的服务端元数据快照，key 为 appId/version/arch
+    using MetadataSnapshot =
+      QHash<QString, QList<QSharedPointer<linglong::package::AppMetaInfo>>>;
+
+    /*
+     * 从服务端查询软件包信息，指定快照时优先使用快照中的结果
+     *
+     * @param appId: 软件包包名
+     * @param version: 软件包版本号
+     * @param arch: 软件包对应的架构
+     * @param appList: 查询结果
+     * @param err: 错误信息
+     * @param snapshot: 元数据快照，可为空
+     *
+     * @return bool: true:成功 false:失败
+     */
+    auto queryRemoteApps(const QString &appId,
+                         const QString &version,
+                         const QString &arch,
+                         QList<QSharedPointer<linglong::package::AppMetaInfo>> &appList,
+                         QString &err,
+                         MetadataSnapshot *snapshot = nullptr) -> bool;
+
+    /*
+     * 解析应用依赖的runtime
+     *
+     * @param runtime: 应用runtime字符串
+     * @param channel: 软件包对应的渠道
+     * @param module: 软件包类型
+     * @param err: 错误信息
+     * @param snapshot: 元数据快照，可为空
+     *
+     * @return AppMetaInfo: runtime信息，失败时为空
+     */
+    auto resolveRuntime(const QString &runtime,
+                        const QString &channel,
+                        const QString &module,
+                        QString &err,
+                        MetadataSnapshot *snapshot = nullptr)
+      -> QSharedPointer<linglong::package::AppMetaInfo>;
+
+    /*
+     * 解析应用runtime依赖的base
+     *
+     * @param runtime: 应用runtime字符串
+     * @param channel: 软件包对应的渠道
+     * @param module: 软件包类型
+     * @param err: 错误信息
+     * @param snapshot: 元数据快照，可为空
+     *
+     * @return AppMetaInfo: base信息，失败时为空
+     */
+    auto resolveBase(const QString &runtime,
+                     const QString &channel,
+                     const QString &module,
+                     QString &err,
+                     MetadataSnapshot *snapshot = nullptr)
+      -> QSharedPointer<linglong::package::AppMetaInfo>;
+
+    /*
+     * 解析待安装的应用，并检查是否已安装
+     *
+     * @param installParamOption: 规范化后的安装参数
+     * @param reply: 失败时的应答
+     * @param snapshot: 元数据快照，可为空
+     *
+     * @return AppMetaInfo: 待安装的应用信息，失败时为空
+     */
+    auto resolveInstallTarget(const InstallParamOption &installParamOption,
+                              Reply &reply,
+                              MetadataSnapshot *snapshot = nullptr)
+      -> QSharedPointer<linglong::package::AppMetaInfo>;
+
+    /*
+     * 下载应用数据并登记安装记录，不包括依赖安装及配置数据库更新
+     *
+     * @param appInfo: 待安装的应用信息
+     * @param installParamOption: 规范化后的安装参数
+     * @param reply: 失败时的应答
+     * @param job: 接收下载进度的任务对象，可为空
+     * @param baseVersion: 被替换的已安装版本，非空时基于该版本增量签出
+     *
+     * @return bool: true:成功 false:失败
+     */
+    auto deployApp(QSharedPointer<linglong::package::AppMetaInfo> appInfo,
+                   const InstallParamOption &installParamOption,
+                   Reply &reply,
+                   job_manager::Job *job = nullptr,
+                   const QString &baseVersion = QString()) -> bool;
+
+    /*
+     * 批量安装流程，依赖取并集后并行安装
+     *
+     * @param installParamOptions: 安装参数列表
+     * @param snapshot: 元数据快照
+     * @param job: 接收进度的任务对象
+     * @param baseVersions: 更新时被替换的已安装版本，key 为 appId
+     *
+     * @return QMap<QString, Reply>: 每个应用的安装结果，key 为 appId
+     */
+    auto installBatch(const QList<InstallParamOption> &installParamOptions,
+                      MetadataSnapshot &snapshot,
+                      job_manager::Job *job,
+                      const QMap<QString, QString> &baseVersions = {}) -> QMap<QString, Reply>;
+
+    /*
+     * 在线程池中执行的批量安装流程
+     */
+    auto installManyImpl(const QList<InstallParamOption> &installParamOptions,
+                         job_manager::Job *job) -> Reply;
+
+    /*
+     * 在线程池中执行的批量更新流程
+     */
+    auto updateAllImpl(const QList<ParamOption> &paramOptions, job_manager::Job *job) -> Reply;
+
+    /*
+     * 检查已安装应用的更新，将新版本数据下载到本地仓库但不签出
+     */
+    void prefetchUpdates();
+
+    /*
+     * 删除不再需要的预取数据，已安装的版本只移出记录，仓库对象在后台清理
+     *
+     * @param refs: 已移出预取记录的 ref
+     */
+    void removePrefetchedRefs(const QStringList &refs);
+
+    /*
+     * 按配置更新仓库的镜像列表
+     *
+     * @param name: 配置中的仓库名
+     */
+    void updateMirrors(const QString &name);
+
+    /*
+     * 为下载设置按状态排列的镜像地址，并将下载结果计入镜像统计
+     */
+    void applyMirrors(PullControl &control) const;
+
     /*
      * 从给定的软件包列表中查找最新版本的runtime
      *
@@ -206,6 +391,9 @@ private:
      * @param pkgArch: 软件包对应的架构
      * @param dstPath: 在线包数据部分存储路径
      * @param err: 错误信息
+     * @param job: 接收下载进度的任务对象，可为空
+     * @param transaction: 记录下载、签出进度的安装事务 id，可为空
+     * @param baseVersion: 被替换的同 module 已安装版本，非空时基于该版本增量签出
      *
      * @return bool: true:成功 false:失败
      */
@@ -215,18 +403,23 @@ private:
                          const QString &channel,
                          const QString &module,
                          const QString &dstPath,
-                         QString &err) -> bool;
+                         QString &err,
+                         job_manager::Job *job = nullptr,
+                         const QString &transaction = QString(),
+                         const QString &baseVersion = QString()) -> bool;
 
     /*
      * 安装应用runtime
      *
      * @param appInfo: runtime对象
      * @param err: 错误信息
+     * @param job: 接收下载进度的任务对象，可为空
      *
      * @return bool: true:成功 false:失败
      */
-    auto installRuntime(QSharedPointer<linglong::package::AppMetaInfo> appInfo, QString &err)
-      -> bool;
+    auto installRuntime(QSharedPointer<linglong::package::AppMetaInfo> appInfo,
+                        QString &err,
+                        job_manager::Job *job = nullptr) -> bool;
 
     /*
      * 检查应用runtime安装状态
@@ -235,13 +428,28 @@ private:
      * @param channel: 软件包对应的渠道
      * @param module: 软件包类型
      * @param err: 错误信息
+     * @param job: 接收下载进度的任务对象，可为空
      *
      * @return bool: true:安装成功或已安装返回true false:安装失败
      */
     auto checkAppRuntime(const QString &runtime,
                          const QString &channel,
                          const QString &module,
-                         QString &err) -> bool;
+                         QString &err,
+                         job_manager::Job *job = nullptr) -> bool;
+
+    /*
+     * 安装 runtime 或 base，并发安装同一 runtime 的任务合并为一次
+     *
+     * @param appInfo: runtime对象
+     * @param err: 错误信息
+     * @param job: 接收下载进度的任务对象，可为空
+     *
+     * @return bool: true:安装成功或已安装返回true false:安装失败
+     */
+    auto installRuntimeOnce(QSharedPointer<linglong::package::AppMetaInfo> appInfo,
+                            QString &err,
+                            job_manager::Job *job = nullptr) -> bool;
 
     /*
      * 针对非deepin发行版检查应用base安装状态
@@ -250,13 +458,66 @@ private:
      * @param channel: 软件包对应的渠道
      * @param module: 软件包类型
      * @param err: 错误信息
+     * @param job: 接收下载进度的任务对象，可为空
      *
      * @return bool: true:安装成功或已安装返回true false:安装失败
      */
     auto checkAppBase(const QString &runtime,
                       const QString &channel,
                       const QString &module,
-                      QString &err) -> bool;
+                      QString &err,
+                      job_manager::Job *job = nullptr) -> bool;
+
+    /*
+     * 在线程池中执行的安装流程
+     *
+     * @param installParamOption: 安装参数
+     * @param job: 接收进度的任务对象
+     * @param baseVersion: 更新时被替换的已安装版本，为空时完整签出
+     *
+     * @return Reply: 安装结果
+     */
+    auto installImpl(const InstallParamOption &installParamOption,
+                     job_manager::Job *job,
+                     const QString &baseVersion = QString()) -> Reply;
+
+    /*
+     * 卸载流程，可在任意线程调用，更新流程中卸载旧版本时直接调用
+     *
+     * @param paramOption: 卸载参数
+     * @param caller: 删除应用数据时数据所属的用户，为空时不删除应用数据
+     *
+     * @return Reply: 卸载结果
+     */
+    auto uninstallImpl(const UninstallParamOption &paramOption, const QString &caller = QString())
+      -> Reply;
+
+    /*
+     * 在线程池中执行的更新流程
+     *
+     * @param paramOption: 更新参数
+     * @param job: 接收进度的任务对象
+     *
+     * @return Reply: 更新结果
+     */
+    auto updateImpl(const ParamOption &paramOption, job_manager::Job *job) -> Reply;
+
+    /*
+     * 创建任务对象，dbus 调用时将其导出到调用方所在的连接上，任务结束一段时间后自动释放
+     *
+     * @param appId: 任务对应的软件包包名
+     *
+     * @return Job: 任务对象
+     */
+    auto createJob(const QString &appId) -> job_manager::Job *;
+
+    /*
+     * 在线程池中执行任务，排队期间被暂停时等待恢复，被取消时以 kJobCancelled 结束任务
+     *
+     * @param job: 任务对象
+     * @param task: 任务执行流程
+     */
+    void runJob(job_manager::Job *job, const std::function<Reply()> &task);
 
     /*
      * 安装应用时更新包括desktop文件在内的配置文件
@@ -267,6 +528,18 @@ private:
      */
     void addAppConfig(const QString &appId, const QString &version, const QString &arch);
 
+    /*
+     * 处理服务异常退出时中断的安装事务，已签出的继续完成安装，其余的回滚
+     */
+    void recoverInterruptedInstalls();
+
+    /*
+     * 继续完成已签出应用的安装，依次写入数据库、处理 portal 及更新配置数据库
+     *
+     * @param transaction: 安装事务
+     */
+    void finishInstallTransaction(const InstallJournal::Transaction &transaction);
+
     /*
      * 卸载应用时更新包括desktop文件在内的配置文件
      *
@@ -285,6 +558,31 @@ private:
      */
     auto getUserName(uid_t uid) -> QString;
 
+    /*
+     * 记录安装、更新任务的最终状态，可在任意线程调用
+     *
+     * @param key: appId/version/arch
+     * @param reply: 任务结果
+     */
+    void setAppState(const QString &key, const Reply &reply);
+
+    /*
+     * 清除安装、更新任务的状态，可在任意线程调用
+     *
+     * @param key: appId/version/arch
+     */
+    void clearAppState(const QString &key);
+
+    /*
+     * 查询安装、更新任务的状态，可在任意线程调用
+     *
+     * @param key: appId/version/arch
+     * @param reply: 任务结果
+     *
+     * @return bool: true:存在记录 false:不存在记录
+     */
+    auto appStateOf(const QString &key, Reply &reply) const -> bool;
+
 private:
     QString sysLinglongInstallation;
     QString kAppInstallPath;
@@ -293,12 +591,35 @@ private:
 
     repo::RepoClient repoClient;
 
-    // 记录子线程安装及更新状态 供查询进度信息使用
+    // 记录子线程安装及更新状态 供查询进度信息使用，安装线程与 DBus 所在线程都会访问
+    mutable QMutex appStateMutex;
     QMap<QString, Reply> appState;
 
+    // 正在执行或刚结束的任务，按 appId 索引，仅在主线程访问
+    QMap<QString, QPointer<job_manager::Job>> jobs;
+
     bool noDBusMode = false;
 
     api::dbus::v1::PackageManagerHelper &packageManagerHelper;
+
+    // 合并执行安装、卸载后的配置数据库更新
+    PostInstallTriggers *postInstallTriggers = nullptr;
+
+    // 后台预取更新，配置中未启用时为空
+    Prefetcher *prefetcher = nullptr;
+
+    // 局域网节点间共享 ostree 对象，配置中未启用时为空
+    repo::PeerCacheServer *peerCacheServer = nullptr;
+    repo::PeerDiscovery *peerDiscovery = nullptr;
+
+    // 安装事务日志，用于异常退出后继续或回滚安装
+    QScopedPointer<InstallJournal> installJournal;
+
+    // 卸载时移入回收目录的安装目录在后台删除
+    QScopedPointer<LayerReaper> layerReaper;
+
+    // 已预取但尚未安装的 ref，预取关闭后仍用于清理之前预取的数据
+    QScopedPointer<PrefetchRecord> prefetchRecord;
 };
 
 } // namespace linglong::service
@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "post_install_triggers.h"
+
+#include "linglong/runtime/font_cache.h"
+#include "linglong/util/file.h"
+#include "linglong/util/runner.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QtConcurrent/QtConcurrent>
+
+namespace linglong::service {
+
+namespace {
+// 目录下是否存在匹配的文件
+bool hasEntries(const QString &dir, const QStringList &nameFilters)
+{
+    if (!QDir(dir).exists()) {
+        return false;
+    }
+    QDirIterator it(dir,
+                    nameFilters,
+                    QDir::Files | QDir::NoDotAndDotDot | QDir::System,
+                    QDirIterator::Subdirectories);
+    return it.hasNext();
+}
+} // namespace
+
+PostInstallTriggers::PostInstallTriggers(const QString &shareDir, QObject *parent)
+    : QObject(parent)
+    , shareDir(shareDir)
+{
+    debounceTimer.setSingleShot(true);
+    debounceTimer.setInterval(kDefaultDebounceMsec);
+    // 数据库更新耗时较长，不在事件循环所在线程中执行
+    connect(&debounceTimer, &QTimer::timeout, this, [this]() {
+        if (running.isRunning()) {
+            // 上一次更新尚未结束，稍后再试
+            debounceTimer.start();
+            return;
+        }
+        running = QtConcurrent::run([this]() {
+            flush();
+        });
+    });
+}
+
+PostInstallTriggers::~PostInstallTriggers()
+{
+    debounceTimer.stop();
+    // 正在生成的字体缓存随之放弃，下次启动时重新检查
+    stopping.store(1);
+    running.waitForFinished();
+    {
+        QMutexLocker locker(&mutex);
+        dirty &= ~Triggers(FontCaches);
+    }
+    flush();
+}
+
+auto PostInstallTriggers::triggersFor(const QString &entriesDir) -> Triggers
+{
+    Triggers triggers;
+    if (hasEntries(entriesDir + "/applications", { "*.desktop" })) {
+        triggers |= DesktopDatabase;
+    }
+    if (hasEntries(entriesDir + "/mime/packages", { "*.xml" })) {
+        triggers |= MimeDatabase;
+    }
+    if (hasEntries(entriesDir + "/glib-2.0/schemas", { "*.xml", "*.override" })) {
+        triggers |= GSettingsSchemas;
+    }
+    return triggers;
+}
+
+void PostInstallTriggers::markDirty(Triggers triggers)
+{
+    if (!triggers) {
+        return;
+    }
+    {
+        QMutexLocker locker(&mutex);
+        dirty |= triggers;
+    }
+    // 定时器只能在所属线程中启动
+    QMetaObject::invokeMethod(
+      this,
+      [this]() {
+          debounceTimer.start();
+      },
+      Qt::QueuedConnection);
+}
+
+void PostInstallTriggers::flush()
+{
+    QMutexLocker runLocker(&runMutex);
+    Triggers triggers;
+    {
+        QMutexLocker locker(&mutex);
+        triggers = dirty;
+        dirty = {};
+    }
+
+    for (auto trigger : { DesktopDatabase, MimeDatabase, GSettingsSchemas, FontCaches }) {
+        if (triggers.testFlag(trigger)) {
+            runTrigger(trigger);
+        }
+    }
+}
+
+auto PostInstallTriggers::pending() const -> Triggers
+{
+    QMutexLocker locker(&mutex);
+    return dirty;
+}
+
+void PostInstallTriggers::setDebounceInterval(int msec)
+{
+    debounceTimer.setInterval(msec);
+}
+
+void PostInstallTriggers::runTrigger(Trigger trigger)
+{
+    switch (trigger) {
+    case DesktopDatabase: {
+        // 更新desktop database
+        auto err =
+          util::Exec("update-desktop-database", { shareDir + "/applications/" }, 1000 * 60 * 1);
+        if (err) {
+            qWarning() << "warning: update desktop database of " + shareDir
+                + "/applications/ failed!";
+        }
+        break;
+    }
+    case MimeDatabase: {
+        // 更新mime type database
+        if (!linglong::util::dirExists(shareDir + "/mime/packages")) {
+            break;
+        }
+        auto err = util::Exec("update-mime-database", { shareDir + "/mime/" }, 1000 * 60 * 1);
+        if (err) {
+            qWarning() << "warning: update mime type database of " + shareDir + "/mime/ failed!";
+        }
+        break;
+    }
+    case GSettingsSchemas: {
+        // 更新 glib-2.0/schemas
+        if (!linglong::util::dirExists(shareDir + "/glib-2.0/schemas")) {
+            break;
+        }
+        auto err =
+          util::Exec("glib-compile-schemas", { shareDir + "/glib-2.0/schemas" }, 1000 * 60 * 1);
+        if (err) {
+            qWarning() << "warning: update schemas of " + shareDir + "/glib-2.0/schemas failed!";
+        }
+        break;
+    }
+    case FontCaches: {
+        // 针对宿主字体生成各 runtime 的 fontconfig 缓存及图标主题缓存
+        runtime::FontCache().update(util::getLinglongRootPath() + "/layers", [this]() {
+            return stopping.load() != 0;
+        });
+        break;
+    }
+    }
+}
+
+} // namespace linglong::service
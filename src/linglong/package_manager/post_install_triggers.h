@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_PACKAGE_MANAGER_POST_INSTALL_TRIGGERS_H_
+#define LINGLONG_SRC_PACKAGE_MANAGER_POST_INSTALL_TRIGGERS_H_
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+
+namespace linglong::service {
+
+/**
+ * @brief 安装、卸载后的配置数据库更新队列
+ * @details 记录需要重新生成的 desktop、mime、schemas 数据库及 runtime 的字体缓存，在防抖时间
+ *          窗口结束或批量任务结束时统一执行一次，应用未提供对应类型文件时不会标记该数据库
+ */
+class PostInstallTriggers : public QObject
+{
+    Q_OBJECT
+public:
+    enum Trigger {
+        DesktopDatabase = 0x1, ///< update-desktop-database
+        MimeDatabase = 0x2,    ///< update-mime-database
+        GSettingsSchemas = 0x4, ///< glib-compile-schemas
+        FontCaches = 0x8        ///< 各 runtime 的 fontconfig 及图标主题缓存
+    };
+    Q_DECLARE_FLAGS(Triggers, Trigger)
+
+    static constexpr int kDefaultDebounceMsec = 2000;
+
+    /**
+     * @param shareDir 应用配置文件链接到的系统目录
+     */
+    explicit PostInstallTriggers(const QString &shareDir, QObject *parent = nullptr);
+    ~PostInstallTriggers() override;
+
+    /**
+     * @brief 根据应用导出的配置文件计算需要更新的数据库
+     *
+     * @param entriesDir 应用的 entries 或 outputs/share 目录
+     *
+     * @return Triggers 需要更新的数据库
+     */
+    static Triggers triggersFor(const QString &entriesDir);
+
+    /**
+     * @brief 标记数据库需要更新并重新开始防抖计时，可在任意线程调用
+     */
+    void markDirty(Triggers triggers);
+
+    /**
+     * @brief 立即执行所有待更新的数据库，可在任意线程调用
+     */
+    void flush();
+
+    /**
+     * @brief 当前待更新的数据库
+     */
+    Triggers pending() const;
+
+    void setDebounceInterval(int msec);
+
+protected:
+    /**
+     * @brief 执行单个数据库更新
+     */
+    virtual void runTrigger(Trigger trigger);
+
+private:
+    QString shareDir;
+
+    mutable QMutex mutex;
+    Triggers dirty;
+
+    // 保证同一时刻只有一个更新流程在执行
+    QMutex runMutex;
+    QTimer debounceTimer;
+    QFuture<void> running;
+    // 析构时置位，耗时的字体缓存生成据此提前结束
+    QAtomicInt stopping;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(PostInstallTriggers::Triggers)
+
+} // namespace linglong::service
+
+#endif
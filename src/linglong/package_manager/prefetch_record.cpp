@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "prefetch_record.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+namespace linglong::service {
+
+PrefetchRecord::PrefetchRecord(const QString &path)
+    : path(path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    for (const auto &value : QJsonDocument::fromJson(file.readAll()).array()) {
+        const QString ref = value.toString();
+        if (ref.split('/').size() == 5 && !records.contains(ref)) {
+            records.append(ref);
+        }
+    }
+}
+
+void PrefetchRecord::add(const QString &ref)
+{
+    QMutexLocker locker(&mutex);
+    if (records.contains(ref)) {
+        return;
+    }
+    records.append(ref);
+    save();
+}
+
+bool PrefetchRecord::take(const QString &ref)
+{
+    QMutexLocker locker(&mutex);
+    if (!records.removeOne(ref)) {
+        return false;
+    }
+    save();
+    return true;
+}
+
+QStringList PrefetchRecord::takeIf(const std::function<bool(const QString &)> &match)
+{
+    QMutexLocker locker(&mutex);
+    QStringList taken;
+    for (auto it = records.begin(); it != records.end();) {
+        if (match(*it)) {
+            taken.append(*it);
+            it = records.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (!taken.isEmpty()) {
+        save();
+    }
+    return taken;
+}
+
+QStringList PrefetchRecord::refs() const
+{
+    QMutexLocker locker(&mutex);
+    return records;
+}
+
+QString PrefetchRecord::packageOf(const QString &ref)
+{
+    const auto parts = ref.split('/');
+    if (parts.size() != 5) {
+        return QString();
+    }
+    return QStringList{ parts[0], parts[1], parts[3], parts[4] }.join('/');
+}
+
+QString PrefetchRecord::versionOf(const QString &ref)
+{
+    const auto parts = ref.split('/');
+    return parts.size() == 5 ? parts[2] : QString();
+}
+
+void PrefetchRecord::save() const
+{
+    QDir().mkpath(QFileInfo(path).path());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "failed to write prefetch record" << path << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(QJsonArray::fromStringList(records)).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qWarning() << "failed to commit prefetch record" << path << file.errorString();
+    }
+}
+
+} // namespace linglong::service
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_PACKAGE_MANAGER_PREFETCH_RECORD_H_
+#define LINGLONG_SRC_PACKAGE_MANAGER_PREFETCH_RECORD_H_
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+namespace linglong::service {
+
+/**
+ * @brief 预取到本地仓库但尚未安装的 ref
+ * @details 记录保存在单个文件中，卸载、安装新版本及下一次预取时据此删除不再需要的预取数据；
+ *          ref 格式为 channel/appId/version/arch/module，可在任意线程调用
+ */
+class PrefetchRecord
+{
+public:
+    /**
+     * @param path 记录文件路径
+     */
+    explicit PrefetchRecord(const QString &path);
+
+    void add(const QString &ref);
+
+    /**
+     * @brief 预取的数据已被安装使用，不再作为预取数据管理
+     *
+     * @return bool: ref 是否在记录中
+     */
+    bool take(const QString &ref);
+
+    /**
+     * @brief 取出满足条件的 ref
+     *
+     * @param match 判断条件，参数为 ref
+     *
+     * @return QStringList: 已从记录中移除的 ref
+     */
+    QStringList takeIf(const std::function<bool(const QString &)> &match);
+
+    QStringList refs() const;
+
+    /**
+     * @brief ref 对应的软件包，格式为 channel/appId/arch/module
+     */
+    static QString packageOf(const QString &ref);
+
+    static QString versionOf(const QString &ref);
+
+private:
+    void save() const;
+
+    const QString path;
+    mutable QMutex mutex;
+    QStringList records;
+};
+
+} // namespace linglong::service
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "prefetcher.h"
+
+#include "linglong/job_manager/job_scheduler.h"
+
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDebug>
+#include <QFile>
+#include <QThread>
+
+namespace linglong::service {
+
+namespace {
+// NetworkManager 中 NM_METERED_YES 及 NM_METERED_GUESS_YES
+constexpr uint kMeteredYes = 1;
+constexpr uint kMeteredGuessYes = 3;
+
+// 平均负载低于 CPU 核数的该比例时视为空闲
+constexpr double kIdleLoadRatio = 0.5;
+} // namespace
+
+Prefetcher::Prefetcher(std::function<void()> task, QObject *parent)
+    : QObject(parent)
+    , task(std::move(task))
+{
+    connect(&timer, &QTimer::timeout, this, &Prefetcher::trigger);
+}
+
+void Prefetcher::start(qint64 intervalSec)
+{
+    timer.start(static_cast<int>(qBound<qint64>(60, intervalSec, 24 * 60 * 60) * 1000));
+}
+
+void Prefetcher::stop()
+{
+    timer.stop();
+}
+
+void Prefetcher::setAllowMetered(bool allow)
+{
+    allowMetered = allow;
+}
+
+void Prefetcher::setIdleOnly(bool idleOnly)
+{
+    this->idleOnly = idleOnly;
+}
+
+bool Prefetcher::isMetered()
+{
+    QDBusInterface nm("org.freedesktop.NetworkManager",
+                      "/org/freedesktop/NetworkManager",
+                      "org.freedesktop.NetworkManager",
+                      QDBusConnection::systemBus());
+    if (!nm.isValid()) {
+        return false;
+    }
+    auto metered = nm.property("Metered");
+    if (!metered.isValid()) {
+        return false;
+    }
+    const uint value = metered.toUInt();
+    return value == kMeteredYes || value == kMeteredGuessYes;
+}
+
+bool Prefetcher::isIdle()
+{
+    QFile loadavg("/proc/loadavg");
+    if (!loadavg.open(QIODevice::ReadOnly)) {
+        return true;
+    }
+    bool ok = false;
+    const double load = loadavg.readAll().split(' ').value(0).toDouble(&ok);
+    if (!ok) {
+        return true;
+    }
+    return load < QThread::idealThreadCount() * kIdleLoadRatio;
+}
+
+bool Prefetcher::trigger()
+{
+    if (running) {
+        qDebug() << "prefetch is running, skip";
+        return false;
+    }
+    if (!allowMetered && isMetered()) {
+        qInfo() << "network is metered, skip prefetch";
+        return false;
+    }
+    if (idleOnly && !isIdle()) {
+        qInfo() << "system is busy, skip prefetch";
+        return false;
+    }
+
+    running = true;
+    JOB_SCHEDULER->submit(job_manager::JobPriority::Prefetch, "prefetch updates", [this]() {
+        task();
+        running = false;
+    });
+    return true;
+}
+
+} // namespace linglong::service
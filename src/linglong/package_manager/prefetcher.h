@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_PACKAGE_MANAGER_PREFETCHER_H_
+#define LINGLONG_SRC_PACKAGE_MANAGER_PREFETCHER_H_
+
+#include <QObject>
+#include <QTimer>
+
+#include <atomic>
+#include <functional>
+
+namespace linglong::service {
+
+/**
+ * @brief 后台更新预取调度
+ * @details 定时在满足网络及空闲条件时以预取优先级提交预取任务，同一时刻只执行一个预取任务
+ */
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @param task 预取流程，在任务线程中执行
+     */
+    explicit Prefetcher(std::function<void()> task, QObject *parent = nullptr);
+
+    /**
+     * @brief 设置检查间隔并开始定时预取
+     *
+     * @param intervalSec 检查间隔，单位秒
+     */
+    void start(qint64 intervalSec);
+
+    void stop();
+
+    void setAllowMetered(bool allow);
+
+    void setIdleOnly(bool idleOnly);
+
+    /**
+     * @brief 当前网络是否按流量计费，通过 NetworkManager 查询，无法查询时视为不计费
+     */
+    static bool isMetered();
+
+    /**
+     * @brief 系统是否空闲，以 1 分钟平均负载判断
+     */
+    static bool isIdle();
+
+public Q_SLOTS:
+    /**
+     * @brief 检查预取条件，满足时提交预取任务
+     *
+     * @return bool: true:已提交 false:条件不满足或上一次预取未结束
+     */
+    bool trigger();
+
+private:
+    std::function<void()> task;
+    QTimer timer;
+    std::atomic_bool running{ false };
+    bool allowMetered = false;
+    bool idleOnly = true;
+};
+
+} // namespace linglong::service
+
+#endif
@@ -0,0 +1,234 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "mirror_list.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace linglong {
+namespace repo {
+
+namespace {
+// 新样本在滑动平均中的权重
+constexpr double kSmoothing = 0.3;
+// 小于该大小的传输不足以估算吞吐量
+constexpr quint64 kMinThroughputSample = 64 * 1024;
+// 按下载该大小的对象估算耗时
+constexpr double kReferenceBytes = 1024 * 1024;
+
+qint64 smooth(qint64 current, qint64 sample)
+{
+    if (current < 0) {
+        return sample;
+    }
+    return static_cast<qint64>(current * (1 - kSmoothing) + sample * kSmoothing);
+}
+} // namespace
+
+void MirrorList::setMirrors(const QString &repo,
+                            const QStringList &endpoints,
+                            const QString &probePath)
+{
+    QMutexLocker locker(&mutex);
+    Repo updated;
+    updated.probePath = probePath;
+    const auto previous = repos.value(repo).mirrors;
+    for (const auto &endpoint : endpoints) {
+        const auto trimmed = endpoint.trimmed();
+        auto matches = [&trimmed](const Mirror &m) {
+            return m.endpoint == trimmed;
+        };
+        if (trimmed.isEmpty()
+            || std::any_of(updated.mirrors.cbegin(), updated.mirrors.cend(), matches)) {
+            continue;
+        }
+        auto it = std::find_if(previous.cbegin(), previous.cend(), matches);
+        Mirror mirror = it != previous.cend() ? *it : Mirror{};
+        mirror.endpoint = trimmed;
+        mirror.order = updated.mirrors.size();
+        updated.mirrors.append(mirror);
+    }
+    repos.insert(repo, updated);
+}
+
+double MirrorList::score(const Mirror &mirror)
+{
+    double estimate = static_cast<double>(mirror.latencyMs);
+    if (mirror.bytesPerSecond > 0) {
+        estimate += kReferenceBytes * 1000 / mirror.bytesPerSecond;
+    }
+    return estimate;
+}
+
+bool MirrorList::better(const Mirror &lhs, const Mirror &rhs)
+{
+    const bool lhsDown = lhs.consecutiveFailures >= kMaxConsecutiveFailures;
+    const bool rhsDown = rhs.consecutiveFailures >= kMaxConsecutiveFailures;
+    if (lhsDown != rhsDown) {
+        return rhsDown;
+    }
+    // 未测量的镜像保持配置顺序，排在已测量的镜像之后
+    const bool lhsMeasured = !lhsDown && lhs.latencyMs >= 0;
+    const bool rhsMeasured = !rhsDown && rhs.latencyMs >= 0;
+    if (lhsMeasured != rhsMeasured) {
+        return lhsMeasured;
+    }
+    if (lhsMeasured && score(lhs) != score(rhs)) {
+        return score(lhs) < score(rhs);
+    }
+    return lhs.order < rhs.order;
+}
+
+QStringList MirrorList::endpoints(const QString &repo) const
+{
+    QMutexLocker locker(&mutex);
+    auto mirrors = repos.value(repo).mirrors;
+    std::stable_sort(mirrors.begin(), mirrors.end(), &MirrorList::better);
+    QStringList result;
+    for (const auto &mirror : mirrors) {
+        result << mirror.endpoint;
+    }
+    return result;
+}
+
+QString MirrorList::best(const QString &repo) const
+{
+    return endpoints(repo).value(0);
+}
+
+auto MirrorList::find(const QString &repo, const QString &endpoint) -> Mirror *
+{
+    auto it = repos.find(repo);
+    if (it == repos.end()) {
+        return nullptr;
+    }
+    for (auto &mirror : it->mirrors) {
+        if (mirror.endpoint == endpoint) {
+            return &mirror;
+        }
+    }
+    return nullptr;
+}
+
+void MirrorList::reportSuccess(const QString &repo,
+                               const QString &endpoint,
+                               qint64 latencyMs,
+                               quint64 bytes,
+                               qint64 elapsedMs)
+{
+    QMutexLocker locker(&mutex);
+    auto mirror = find(repo, endpoint);
+    if (!mirror) {
+        return;
+    }
+    ++mirror->successes;
+    mirror->consecutiveFailures = 0;
+    mirror->lastCheckMsec = QDateTime::currentMSecsSinceEpoch();
+    if (latencyMs >= 0) {
+        mirror->latencyMs = smooth(mirror->latencyMs, latencyMs);
+    }
+    if (bytes >= kMinThroughputSample && elapsedMs > 0) {
+        const auto sample = static_cast<qint64>(bytes * 1000 / elapsedMs);
+        mirror->bytesPerSecond = static_cast<quint64>(
+          smooth(mirror->bytesPerSecond > 0 ? static_cast<qint64>(mirror->bytesPerSecond) : -1,
+                 sample));
+    }
+}
+
+void MirrorList::reportFailure(const QString &repo,
+                               const QString &endpoint,
+                               const QString &error)
+{
+    QMutexLocker locker(&mutex);
+    auto mirror = find(repo, endpoint);
+    if (!mirror) {
+        return;
+    }
+    ++mirror->failures;
+    ++mirror->consecutiveFailures;
+    mirror->lastError = error;
+    mirror->lastCheckMsec = QDateTime::currentMSecsSinceEpoch();
+    if (mirror->consecutiveFailures == kMaxConsecutiveFailures) {
+        qWarning() << "mirror" << endpoint << "of" << repo << "is unavailable:" << error;
+    }
+}
+
+void MirrorList::probe(const QString &repo, int timeoutMsec)
+{
+    QStringList targets;
+    QString probePath;
+    {
+        QMutexLocker locker(&mutex);
+        const auto &entry = repos.value(repo);
+        probePath = entry.probePath;
+        for (const auto &mirror : entry.mirrors) {
+            targets << mirror.endpoint;
+        }
+    }
+
+    // 探测在后台线程中执行，使用独立的 QNetworkAccessManager
+    QNetworkAccessManager manager;
+    for (const auto &endpoint : targets) {
+        QNetworkRequest request(QUrl(endpoint + probePath));
+        request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                             QNetworkRequest::NoLessSafeRedirectPolicy);
+        QElapsedTimer timer;
+        timer.start();
+        QScopedPointer<QNetworkReply> reply(manager.get(request));
+
+        QEventLoop loop;
+        QTimer::singleShot(timeoutMsec, &loop, [&reply]() {
+            reply->abort();
+        });
+        QObject::connect(reply.data(), &QNetworkReply::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+
+        const qint64 elapsed = timer.elapsed();
+        if (reply->error() != QNetworkReply::NoError) {
+            reportFailure(repo, endpoint, reply->errorString());
+            continue;
+        }
+        const auto bytes = static_cast<quint64>(reply->readAll().size());
+        reportSuccess(repo, endpoint, elapsed, bytes, elapsed);
+    }
+}
+
+QVariantMap MirrorList::statistics() const
+{
+    QMutexLocker locker(&mutex);
+    QVariantMap result;
+    for (auto it = repos.cbegin(); it != repos.cend(); ++it) {
+        auto mirrors = it->mirrors;
+        std::stable_sort(mirrors.begin(), mirrors.end(), &MirrorList::better);
+        QVariantList list;
+        for (const auto &mirror : mirrors) {
+            list.append(QVariantMap{
+              { "endpoint", mirror.endpoint },
+              { "available", mirror.consecutiveFailures < kMaxConsecutiveFailures },
+              { "latencyMs", mirror.latencyMs },
+              { "bytesPerSecond", mirror.bytesPerSecond },
+              { "successes", mirror.successes },
+              { "failures", mirror.failures },
+              { "consecutiveFailures", mirror.consecutiveFailures },
+              { "lastError", mirror.lastError },
+              { "lastCheck", mirror.lastCheckMsec },
+            });
+        }
+        result.insert(it.key(), list);
+    }
+    return result;
+}
+
+} // namespace repo
+} // namespace linglong
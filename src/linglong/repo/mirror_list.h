@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_REPO_MIRROR_LIST_H_
+#define LINGLONG_SRC_REPO_MIRROR_LIST_H_
+
+#include "linglong/util/singleton.h"
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+#include <QVariantMap>
+
+namespace linglong {
+namespace repo {
+
+/**
+ * @brief 仓库镜像列表及镜像状态
+ * @details 每个仓库按配置顺序记录多个镜像地址，根据探测及实际请求的延迟、吞吐量对镜像排序，
+ *          连续失败的镜像排在最后直到再次请求成功。所有客户端都从这里获取地址，
+ *          修改配置后立即对后续请求生效
+ */
+class MirrorList : public linglong::util::Singleton<MirrorList>
+{
+public:
+    // 连续失败达到该次数的镜像视为不可用
+    static constexpr int kMaxConsecutiveFailures = 3;
+
+    /**
+     * @brief 设置仓库的镜像地址，保留仍在列表中的镜像的统计
+     *
+     * @param repo 配置中的仓库名
+     * @param endpoints 镜像地址，按配置的优先级排列
+     * @param probePath 探测时请求的路径
+     */
+    void setMirrors(const QString &repo, const QStringList &endpoints, const QString &probePath);
+
+    /**
+     * @brief 按状态排列的镜像地址，最优的在前
+     */
+    QStringList endpoints(const QString &repo) const;
+
+    /**
+     * @brief 当前最优的镜像地址，仓库不存在时为空
+     */
+    QString best(const QString &repo) const;
+
+    /**
+     * @brief 记录请求成功
+     *
+     * @param latencyMs 请求延迟，小于 0 表示未测量
+     * @param bytes 传输的字节数
+     * @param elapsedMs 传输耗时
+     */
+    void reportSuccess(const QString &repo,
+                       const QString &endpoint,
+                       qint64 latencyMs,
+                       quint64 bytes = 0,
+                       qint64 elapsedMs = 0);
+
+    /**
+     * @brief 记录请求失败
+     */
+    void reportFailure(const QString &repo, const QString &endpoint, const QString &error);
+
+    /**
+     * @brief 依次请求各镜像的探测路径并记录延迟，阻塞至探测结束
+     *
+     * @param timeoutMsec 单个镜像的超时时间
+     */
+    void probe(const QString &repo, int timeoutMsec = 5000);
+
+    /**
+     * @brief 各仓库镜像的状态
+     */
+    QVariantMap statistics() const;
+
+private:
+    struct Mirror
+    {
+        QString endpoint;
+        int order = 0;
+        qint64 latencyMs = -1;
+        quint64 bytesPerSecond = 0;
+        int consecutiveFailures = 0;
+        quint64 successes = 0;
+        quint64 failures = 0;
+        QString lastError;
+        qint64 lastCheckMsec = 0;
+    };
+
+    struct Repo
+    {
+        QString probePath;
+        QList<Mirror> mirrors;
+    };
+
+    // 估算的请求耗时，越小越好
+    static double score(const Mirror &mirror);
+    static bool better(const Mirror &lhs, const Mirror &rhs);
+
+    Mirror *find(const QString &repo, const QString &endpoint);
+
+    mutable QMutex mutex;
+    QMap<QString, Repo> repos;
+};
+
+} // namespace repo
+} // namespace linglong
+
+#define MIRROR_LIST linglong::repo::MirrorList::instance()
+#endif
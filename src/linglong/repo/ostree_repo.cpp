@@ -286,10 +286,10 @@ private:
 
     std::tuple<QString, util::Error> resolveRev(const QString &ref)
     {
-        GError *gErr = nullptr;
-        char *commitID = nullptr;
+        // 启动应用时也会调用，释放返回的字符串及错误
+        g_autoptr(GError) gErr = nullptr;
+        g_autofree char *commitID = nullptr;
         std::string refStr = ref.toStdString();
-        // FIXME: should free commitID?
         if (!ostree_repo_resolve_rev(repoPtr, refStr.c_str(), false, &commitID, &gErr)) {
             return { "",
                      WrapError(NewError(gErr->code, gErr->message),
@@ -889,6 +889,18 @@ QString OSTreeRepo::rootOfLayer(const package::Ref &ref)
       QDir::separator());
 }
 
+QString OSTreeRepo::commitOfLayer(const package::Ref &ref)
+{
+    Q_D(OSTreeRepo);
+    // 只读取 ref 文件，不访问提交对象
+    auto [commit, err] = d->resolveRev(ref.toOSTreeRefLocalString());
+    if (err) {
+        qDebug() << "resolve" << ref.toOSTreeRefLocalString() << "failed:" << err;
+        return QString();
+    }
+    return commit;
+}
+
 bool OSTreeRepo::isRefExists(const package::Ref &ref)
 {
     Q_D(OSTreeRepo);
@@ -82,6 +82,8 @@ public:
 
     QString rootOfLayer(const package::Ref &ref) override;
 
+    QString commitOfLayer(const package::Ref &ref) override;
+
     bool isRefExists(const package::Ref &ref);
 
     QString remoteShowUrl(const QString &repoName);
@@ -10,11 +10,18 @@
 #include "linglong/util/config/config.h"
 #include "linglong/util/erofs.h"
 #include "linglong/util/file.h"
+#include "linglong/util/http/rate_limiter.h"
 #include "linglong/util/runner.h"
 #include "linglong/util/version/version.h"
+#include "linglong/utils/finally/finally.h"
 #include "ostree-repo.h"
 
+#include <QSet>
+
+#include <fcntl.h>
+#include <ostree-diff.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 const int MAX_ERRINFO_BUFSIZE = 512;
 
@@ -435,6 +442,32 @@ bool OstreeRepoHelper::resolveRef(const std::string &fullRef, std::vector<std::s
     return true;
 }
 
+/*
+ * 查询本地仓库中是否已存在软件包对应的ref
+ *
+ * @param repoPath: 本地仓库路径
+ * @param ref: 软件包对应的仓库索引
+ *
+ * @return bool: true:存在 false:不存在
+ */
+bool OstreeRepoHelper::hasRef(const QString &repoPath, const QString &ref)
+{
+    g_autoptr(GError) gErr = nullptr;
+    g_autoptr(GFile) repoFile = g_file_new_for_path((repoPath + "/repo").toStdString().c_str());
+    g_autoptr(OstreeRepo) repo = ostree_repo_new(repoFile);
+    if (!ostree_repo_open(repo, nullptr, &gErr)) {
+        qWarning() << "open repo" << repoPath << "failed:" << gErr->message;
+        return false;
+    }
+
+    g_autofree char *commit = nullptr;
+    if (!ostree_repo_resolve_rev(repo, ref.toStdString().c_str(), TRUE, &commit, &gErr)) {
+        qWarning() << "resolve" << ref << "failed:" << gErr->message;
+        return false;
+    }
+    return commit != nullptr;
+}
+
 /*
  * 将软件包数据从本地仓库签出到指定目录
  *
@@ -467,71 +500,335 @@ bool OstreeRepoHelper::checkOutAppData(const QString &repoPath,
         return false;
     }
 
-    // FIXME(Iceyer): now we create erofs image here because no oci/linglong blobs backend
-    // implemented, it must do by vfs repo
-    QString hash(QCryptographicHash::hash(dstPath.toLocal8Bit(), QCryptographicHash::Md5).toHex());
-    auto destImagePath =
-      QStringList{ util::getLinglongRootPath(), "vfs", "blobs" }.join(QDir::separator());
-    util::ensureDir(destImagePath);
-    destImagePath = QStringList{ destImagePath, hash }.join(QDir::separator());
-    qDebug() << "erofs mkfs" << dstPath << destImagePath;
-    err = erofs::mkfs(dstPath, destImagePath);
-    if (err) {
-        qCritical() << err;
+    buildErofsImage(dstPath);
+    return true;
+}
+
+namespace {
+/*
+ * 递归列出提交中的条目，父目录在子项之前
+ *
+ * @param root: 提交根目录
+ * @param dir: 当前处理的目录
+ * @param entries: 提交中的条目
+ * @param err: 错误信息
+ *
+ * @return bool: true:成功 false:失败
+ */
+bool collectCommitEntries(GFile *root, GFile *dir, QList<CommitEntry> &entries, QString &err)
+{
+    g_autoptr(GError) gErr = nullptr;
+    g_autoptr(GFileEnumerator) enumerator =
+      g_file_enumerate_children(dir,
+                                "standard::name,standard::type,unix::mode",
+                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                nullptr,
+                                &gErr);
+    if (!enumerator) {
+        err = QString("enumerate commit failed: %1").arg(gErr->message);
+        return false;
     }
 
+    while (true) {
+        GFileInfo *info = nullptr;
+        GFile *child = nullptr;
+        if (!g_file_enumerator_iterate(enumerator, &info, &child, nullptr, &gErr)) {
+            err = QString("enumerate commit failed: %1").arg(gErr->message);
+            return false;
+        }
+        if (!info) {
+            break;
+        }
+
+        g_autofree char *path = g_file_get_relative_path(root, child);
+        CommitEntry entry;
+        entry.path = QString::fromUtf8(path);
+        entry.isDir = g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY;
+        entry.mode = g_file_info_get_attribute_uint32(info, "unix::mode") & 07777;
+        entries.append(entry);
+        if (entry.isDir && !collectCommitEntries(root, child, entries, err)) {
+            return false;
+        }
+    }
     return true;
 }
 
+QString relativePathOf(GFile *root, GFile *file)
+{
+    g_autofree char *path = g_file_get_relative_path(root, file);
+    return QString::fromUtf8(path);
+}
+} // namespace
+
 /*
- * 通过父进程 id 查找子进程 id
+ * 按旧版本提交中的条目将旧版本签出目录中未变化的文件硬链接到目标目录
  *
- * @param qint64: 父进程 id
+ * @param srcDir: 旧版本签出目录
+ * @param dstDir: 目标目录
+ * @param entries: 旧版本提交中的条目，父目录在子项之前
+ * @param skip: 新版本中变化或删除的相对路径，目录的子项一并跳过
+ * @param err: 错误信息
  *
- * @return qint64: 子进程 id
+ * @return bool: true:成功 false:失败
  */
-qint64 OstreeRepoHelper::getChildPid(qint64 pid)
+bool OstreeRepoHelper::linkUnchangedEntries(const QString &srcDir,
+                                            const QString &dstDir,
+                                            const QList<CommitEntry> &entries,
+                                            const QSet<QString> &skip,
+                                            QString &err)
 {
-    QProcess process;
-    const QStringList argList = { "-P", QString::number(pid) };
-    process.start("pgrep", argList);
-    if (!process.waitForStarted()) {
-        qCritical() << "start pgrep failed!";
-        return 0;
+    // 目录在子项链接完成后再设置权限，避免只读目录无法写入
+    QList<const CommitEntry *> dirs;
+    for (const auto &entry : entries) {
+        QString parent = entry.path;
+        while (!parent.isEmpty() && !skip.contains(parent)) {
+            const int slash = parent.lastIndexOf('/');
+            parent = slash < 0 ? QString() : parent.left(slash);
+        }
+        if (!parent.isEmpty()) {
+            continue;
+        }
+
+        const QByteArray src = QFile::encodeName(srcDir + "/" + entry.path);
+        const QByteArray dst = QFile::encodeName(dstDir + "/" + entry.path);
+        if (entry.isDir) {
+            if (mkdir(dst.constData(), 0700) != 0 && errno != EEXIST) {
+                err = QString("mkdir %1 failed: %2").arg(dst.constData(), strerror(errno));
+                return false;
+            }
+            dirs.append(&entry);
+            continue;
+        }
+
+        // 不跟随符号链接，链接符号链接本身
+        if (linkat(AT_FDCWD, src.constData(), AT_FDCWD, dst.constData(), 0) != 0) {
+            err = QString("link %1 failed: %2").arg(src.constData(), strerror(errno));
+            return false;
+        }
     }
-    if (!process.waitForFinished(1000 * 60)) {
-        qCritical() << "run pgrep finish failed!";
-        return 0;
+
+    for (auto it = dirs.crbegin(); it != dirs.crend(); ++it) {
+        chmod(QFile::encodeName(dstDir + "/" + (*it)->path).constData(), (*it)->mode);
     }
+    return true;
+}
 
-    auto retStatus = process.exitStatus();
-    auto retCode = process.exitCode();
-    QString childPid = "";
-    if (retStatus != 0 || retCode != 0) {
-        qCritical() << "run pgrep failed, retCode:" << retCode << ", args:" << argList
-                    << ", info msg:" << QString::fromLocal8Bit(process.readAllStandardOutput())
-                    << ", err msg:" << QString::fromLocal8Bit(process.readAllStandardError());
-        return 0;
-    } else {
-        childPid = QString::fromLocal8Bit(process.readAllStandardOutput());
-        qDebug() << "getChildPid ostree pid:" << childPid;
+/*
+ * 对比两个版本的提交，硬链接旧版本中未变化的文件并签出变化的文件
+ *
+ * @param repoPath: 本地仓库路径
+ * @param baseRef: 旧版本对应的仓库索引
+ * @param basePath: 旧版本签出目录
+ * @param ref: 新版本对应的仓库索引
+ * @param dstPath: 签出数据保存目录
+ * @param changedCount: 变化的文件及目录数
+ * @param err: 错误信息
+ *
+ * @return bool: true:成功 false:失败
+ */
+bool OstreeRepoHelper::checkOutChanges(const QString &repoPath,
+                                       const QString &baseRef,
+                                       const QString &basePath,
+                                       const QString &ref,
+                                       const QString &dstPath,
+                                       int &changedCount,
+                                       QString &err)
+{
+    g_autoptr(GError) gErr = nullptr;
+    g_autoptr(GFile) repoFile = g_file_new_for_path((repoPath + "/repo").toStdString().c_str());
+    g_autoptr(OstreeRepo) repo = ostree_repo_new(repoFile);
+    if (!ostree_repo_open(repo, nullptr, &gErr)) {
+        err = QString("open repo %1 failed: %2").arg(repoPath, gErr->message);
+        return false;
+    }
+
+    const std::string baseRefStr = baseRef.toStdString();
+    const std::string refStr = ref.toStdString();
+    g_autofree char *commit = nullptr;
+    g_autoptr(GFile) baseRoot = nullptr;
+    g_autoptr(GFile) newRoot = nullptr;
+    if (!ostree_repo_resolve_rev(repo, refStr.c_str(), FALSE, &commit, &gErr)
+        || !ostree_repo_read_commit(repo, baseRefStr.c_str(), &baseRoot, nullptr, nullptr, &gErr)
+        || !ostree_repo_read_commit(repo, commit, &newRoot, nullptr, nullptr, &gErr)) {
+        err = QString("read commit failed: %1").arg(gErr->message);
+        return false;
+    }
+
+    // 等价于 ostree diff baseRef ref
+    g_autoptr(GPtrArray) modified =
+      g_ptr_array_new_with_free_func(reinterpret_cast<GDestroyNotify>(ostree_diff_item_unref));
+    g_autoptr(GPtrArray) removed = g_ptr_array_new_with_free_func(g_object_unref);
+    g_autoptr(GPtrArray) added = g_ptr_array_new_with_free_func(g_object_unref);
+    if (!ostree_diff_dirs(OSTREE_DIFF_FLAGS_NONE,
+                          baseRoot,
+                          newRoot,
+                          modified,
+                          removed,
+                          added,
+                          nullptr,
+                          &gErr)) {
+        err = QString("diff %1 %2 failed: %3").arg(baseRef, ref, gErr->message);
+        return false;
+    }
+    changedCount = modified->len + removed->len + added->len;
+
+    // 变化及删除的路径不从旧版本链接，变化及新增的路径从仓库签出
+    QSet<QString> skip;
+    QList<GFile *> checkoutFiles;
+    for (guint i = 0; i < modified->len; ++i) {
+        auto item = static_cast<OstreeDiffItem *>(g_ptr_array_index(modified, i));
+        skip.insert(relativePathOf(newRoot, item->target));
+        checkoutFiles.append(item->target);
+    }
+    for (guint i = 0; i < removed->len; ++i) {
+        skip.insert(relativePathOf(baseRoot, static_cast<GFile *>(g_ptr_array_index(removed, i))));
+    }
+    for (guint i = 0; i < added->len; ++i) {
+        checkoutFiles.append(static_cast<GFile *>(g_ptr_array_index(added, i)));
     }
 
-    return childPid.toLongLong();
+    // 只链接旧版本提交中的条目，签出目录中多出的文件不属于新版本
+    QList<CommitEntry> baseEntries;
+    if (!collectCommitEntries(baseRoot, baseRoot, baseEntries, err)
+        || !linkUnchangedEntries(basePath, dstPath, baseEntries, skip, err)) {
+        return false;
+    }
+
+    for (auto file : checkoutFiles) {
+        const QString relativePath = relativePathOf(newRoot, file);
+        const QFileInfo target(dstPath + "/" + relativePath);
+        util::ensureDir(target.path());
+        const int parentFd = open(QFile::encodeName(target.path()).constData(),
+                                  O_DIRECTORY | O_RDONLY | O_CLOEXEC);
+        if (parentFd < 0) {
+            err = QString("open %1 failed: %2").arg(target.path(), strerror(errno));
+            return false;
+        }
+        auto closeFd = utils::finally::finally([parentFd]() {
+            close(parentFd);
+        });
+
+        // 签出单个文件时目标为其所在目录，签出目录时目标为目录本身
+        const bool isDir =
+          g_file_query_file_type(file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, nullptr)
+          == G_FILE_TYPE_DIRECTORY;
+        const std::string destination =
+          isDir ? QFile::encodeName(target.fileName()).toStdString() : std::string(".");
+        const std::string subpath = ("/" + relativePath).toStdString();
+
+        OstreeRepoCheckoutAtOptions options = {};
+        options.mode = OSTREE_REPO_CHECKOUT_MODE_USER;
+        options.overwrite_mode = OSTREE_REPO_CHECKOUT_OVERWRITE_UNION_FILES;
+        options.subpath = subpath.c_str();
+        if (!ostree_repo_checkout_at(repo,
+                                     &options,
+                                     parentFd,
+                                     destination.c_str(),
+                                     commit,
+                                     nullptr,
+                                     &gErr)) {
+            err = QString("checkout %1 of %2 failed: %3").arg(relativePath, ref, gErr->message);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * 基于已签出的旧版本增量签出软件包数据，增量签出失败时退回完整签出
+ *
+ * @param repoPath: 远端仓库对应的本地仓库路径
+ * @param remoteName: 远端仓库名称
+ * @param baseRef: 旧版本对应的仓库索引
+ * @param basePath: 旧版本签出目录
+ * @param ref: 软件包对应的仓库索引
+ * @param dstPath: 签出数据保存目录
+ * @param err: 错误信息
+ *
+ * @return bool: true:成功 false:失败
+ */
+bool OstreeRepoHelper::checkOutAppDataIncremental(const QString &repoPath,
+                                                  const QString &remoteName,
+                                                  const QString &baseRef,
+                                                  const QString &basePath,
+                                                  const QString &ref,
+                                                  const QString &dstPath,
+                                                  QString &err)
+{
+    // 目标目录已有数据(如同版本的其它 module)时无法只链接未变化的文件
+    const bool dstEmpty =
+      QDir(dstPath).isEmpty(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    if (basePath != dstPath && linglong::util::dirExists(basePath) && dstEmpty) {
+        linglong::util::createDir(dstPath);
+        int changedCount = 0;
+        QString incrementalErr;
+        if (checkOutChanges(repoPath,
+                            baseRef,
+                            basePath,
+                            ref,
+                            dstPath,
+                            changedCount,
+                            incrementalErr)) {
+            qInfo() << "incremental checkout" << ref << "based on" << baseRef
+                    << ", changed entries:" << changedCount;
+            buildErofsImage(dstPath, changedCount == 0 ? basePath : QString());
+            return true;
+        }
+        qWarning() << "incremental checkout" << ref << "failed:" << incrementalErr
+                   << ", fallback to full checkout";
+        linglong::util::removeDir(dstPath);
+    }
+    return checkOutAppData(repoPath, remoteName, ref, dstPath, err);
+}
+
+/*
+ * 为签出目录生成 erofs 镜像
+ *
+ * @param dstPath: 签出数据目录
+ * @param basePath: 内容相同的旧版本签出目录，为空时完整生成
+ */
+void OstreeRepoHelper::buildErofsImage(const QString &dstPath, const QString &basePath)
+{
+    // FIXME(Iceyer): now we create erofs image here because no oci/linglong blobs backend
+    // implemented, it must do by vfs repo
+    const auto blobsPath =
+      QStringList{ util::getLinglongRootPath(), "vfs", "blobs" }.join(QDir::separator());
+    util::ensureDir(blobsPath);
+    auto imagePathOf = [&blobsPath](const QString &path) {
+        QString hash(QCryptographicHash::hash(path.toLocal8Bit(), QCryptographicHash::Md5).toHex());
+        return QStringList{ blobsPath, hash }.join(QDir::separator());
+    };
+    const auto destImagePath = imagePathOf(dstPath);
+
+    // 内容与旧版本相同，复用旧版本的镜像
+    if (!basePath.isEmpty()) {
+        const auto baseImagePath = imagePathOf(basePath);
+        if (QFile::exists(baseImagePath)) {
+            auto err = util::Exec("cp", { "--reflink=auto", baseImagePath, destImagePath });
+            if (!err) {
+                return;
+            }
+            qWarning() << "reuse erofs image" << baseImagePath << "failed:" << err;
+        }
+    }
+
+    qDebug() << "erofs mkfs" << dstPath << destImagePath;
+    auto err = erofs::mkfs(dstPath, destImagePath);
+    if (err) {
+        qCritical() << err;
+    }
 }
 
 /*
  * 启动一个 ostree 命令相关的任务
  *
  * @param cmd: 需要运行的命令
- * @param ref: ostree 软件包对应的 ref
  * @param argList: 参数列表
  * @param timeout: 任务超时时间
  *
  * @return bool: true:成功 false:失败
  */
 bool OstreeRepoHelper::startOstreeJob(const QString &cmd,
-                                      const QString &ref,
                                       const QStringList &argList,
                                       const int timeout)
 {
@@ -542,20 +839,10 @@ bool OstreeRepoHelper::startOstreeJob(const QString &cmd,
         return false;
     }
 
-    qint64 processId = process.processId();
-    // 通过 script pid 查找对应的 ostree pid
-    if ("script" == cmd) {
-        qint64 shPid = getChildPid(processId);
-        qint64 ostreePid = getChildPid(shPid);
-        jobMap.insert(ref, ostreePid); // FIXME(black_desk): ??? where is the lock???
-    }
     if (!process.waitForFinished(timeout)) {
         qCritical() << "run " + cmd + " finish failed!";
         return false;
     }
-    if ("script" == cmd) {
-        jobMap.remove(ref);
-    }
 
     auto retStatus = process.exitStatus();
     auto retCode = process.exitCode();
@@ -628,6 +915,313 @@ QString OstreeRepoHelper::createTmpRepo(const QString &parentRepo)
     return tmpPath + "/repoTmp";
 }
 
+namespace {
+struct PullProgressContext
+{
+    const PullProgressCallback *callback;
+    qint64 startTime;
+    util::RateLimitTicket *ticket;
+    guint64 lastBytesTransferred;
+};
+
+/*
+ * 向全局限速器登记新接收的数据，超出分配的速率时阻塞 pull 所在的 main context，
+ * 暂停后续数据的接收
+ */
+void throttlePull(PullProgressContext *context, guint64 bytesTransferred)
+{
+    // 同一任务可能依次执行多次 pull，已传输量变小说明开始了新的 pull
+    const guint64 delta = bytesTransferred >= context->lastBytesTransferred
+      ? bytesTransferred - context->lastBytesTransferred
+      : bytesTransferred;
+    context->lastBytesTransferred = bytesTransferred;
+    if (delta == 0) {
+        return;
+    }
+    const qint64 delayUs = context->ticket->reserve(delta);
+    if (delayUs > 0) {
+        // 单次最多等待 1 秒，避免长时间不处理取消，未偿还的部分在下次回调时继续等待
+        g_usleep(static_cast<gulong>(qMin<qint64>(delayUs, G_USEC_PER_SEC)));
+    }
+}
+
+bool isCancelledError(const GError *gErr)
+{
+    return g_error_matches(gErr, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+}
+
+/*
+ * OstreeAsyncProgress 状态变化回调，将 ostree 的进度字段转换为 PullProgress
+ */
+void onPullProgressChanged(OstreeAsyncProgress *asyncProgress, gpointer userData)
+{
+    auto context = static_cast<PullProgressContext *>(userData);
+    throttlePull(context, ostree_async_progress_get_uint64(asyncProgress, "bytes-transferred"));
+    if (!context->callback || !*context->callback) {
+        return;
+    }
+
+    guint64 bytesTransferred = 0;
+    guint64 startTime = 0;
+    guint fetched = 0;
+    guint requested = 0;
+    guint64 totalDeltaPartSize = 0;
+    guint64 fetchedDeltaPartSize = 0;
+    ostree_async_progress_get(asyncProgress,
+                              "bytes-transferred",
+                              "t",
+                              &bytesTransferred,
+                              "start-time",
+                              "t",
+                              &startTime,
+                              "fetched",
+                              "u",
+                              &fetched,
+                              "requested",
+                              "u",
+                              &requested,
+                              "total-delta-part-size",
+                              "t",
+                              &totalDeltaPartSize,
+                              "fetched-delta-part-size",
+                              "t",
+                              &fetchedDeltaPartSize,
+                              nullptr);
+
+    PullProgress progress;
+    progress.bytesTransferred = bytesTransferred;
+    progress.fetchedObjects = fetched;
+    progress.requestedObjects = requested;
+
+    // start-time 为 g_get_monotonic_time 的微秒数
+    const qint64 begin = startTime > 0 ? static_cast<qint64>(startTime) : context->startTime;
+    const qint64 elapsedSeconds = (g_get_monotonic_time() - begin) / G_USEC_PER_SEC;
+    if (elapsedSeconds > 0) {
+        progress.bytesPerSecond = bytesTransferred / elapsedSeconds;
+    }
+
+    // 有 delta 时按字节估算剩余时间，否则按对象数估算
+    if (totalDeltaPartSize > 0 && progress.bytesPerSecond > 0) {
+        const quint64 remaining =
+          totalDeltaPartSize > fetchedDeltaPartSize ? totalDeltaPartSize - fetchedDeltaPartSize : 0;
+        progress.etaSeconds = static_cast<qint64>(remaining / progress.bytesPerSecond);
+    } else if (fetched > 0 && requested >= fetched && elapsedSeconds > 0) {
+        progress.etaSeconds = elapsedSeconds * (requested - fetched) / fetched;
+    }
+
+    (*context->callback)(progress);
+}
+
+/*
+ * 构造 ostree_repo_pull_with_options 的参数
+ *
+ * @param ref: 软件包对应的仓库索引 ref
+ * @param flags: pull 标志
+ * @param commit: 指定 ref 对应的提交，为空时使用远端的 ref
+ * @param url: 替换远端的地址，为空时使用远端配置的地址
+ */
+GVariant *pullOptions(const QString &ref,
+                      int flags,
+                      const char *commit = nullptr,
+                      const QString &url = QString())
+{
+    const std::string refStr = ref.toStdString();
+    const char *refs[] = { refStr.c_str(), nullptr };
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&builder,
+                          "{s@v}",
+                          "flags",
+                          g_variant_new_variant(g_variant_new_int32(flags)));
+    g_variant_builder_add(&builder,
+                          "{s@v}",
+                          "refs",
+                          g_variant_new_variant(g_variant_new_strv(refs, -1)));
+    if (commit) {
+        const char *commits[] = { commit, nullptr };
+        g_variant_builder_add(&builder,
+                              "{s@v}",
+                              "override-commit-ids",
+                              g_variant_new_variant(g_variant_new_strv(commits, -1)));
+    }
+    if (!url.isEmpty()) {
+        const std::string urlStr = url.toStdString();
+        g_variant_builder_add(&builder,
+                              "{s@v}",
+                              "override-url",
+                              g_variant_new_variant(g_variant_new_string(urlStr.c_str())));
+    }
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/*
+ * 执行 pull，任务暂停后恢复时重新 pull，已下载的对象不会重复下载
+ */
+bool pullResumable(OstreeRepo *repo,
+                   const std::string &remoteName,
+                   GVariant *options,
+                   OstreeAsyncProgress *asyncProgress,
+                   const PullControl &control,
+                   GError **gErr)
+{
+    while (true) {
+        g_autoptr(GCancellable) cancellable =
+          control.cancellable ? control.cancellable() : nullptr;
+        if (ostree_repo_pull_with_options(repo,
+                                          remoteName.c_str(),
+                                          options,
+                                          asyncProgress,
+                                          cancellable,
+                                          gErr)) {
+            return true;
+        }
+        if (!isCancelledError(*gErr) || !control.waitForResume || !control.waitForResume()) {
+            return false;
+        }
+        qInfo() << "resume pull";
+        g_clear_error(gErr);
+    }
+}
+} // namespace
+
+/*
+ * 通过 libostree 将软件包数据 pull 到临时仓库，并上报下载进度
+ *
+ * @param tmpPath: 临时仓库路径
+ * @param remoteName: 远端仓库名称
+ * @param ref: 软件包对应的仓库索引 ref
+ * @param control: 下载进度及取消控制
+ * @param err: 错误信息
+ *
+ * @return bool: true:成功 false:失败
+ */
+bool OstreeRepoHelper::pullToTmpRepo(const QString &tmpPath,
+                                     const QString &remoteName,
+                                     const QString &ref,
+                                     const PullControl &control,
+                                     QString &err)
+{
+    g_autoptr(GError) gErr = nullptr;
+    g_autoptr(GFile) repoFile = g_file_new_for_path(tmpPath.toStdString().c_str());
+    g_autoptr(OstreeRepo) tmpRepo = ostree_repo_new(repoFile);
+    if (!ostree_repo_open(tmpRepo, nullptr, &gErr)) {
+        err = QString("open tmp repo %1 failed: %2").arg(tmpPath, gErr->message);
+        return false;
+    }
+
+    // pull 过程在当前线程的 main context 中迭代，进度回调也在该 context 中分发
+    g_autoptr(GMainContext) mainContext = g_main_context_new();
+    g_main_context_push_thread_default(mainContext);
+
+    // 与其他下载任务按权重共享全局速率
+    util::RateLimitTicket ticket(control.weight, control.maxBytesPerSecond);
+    PullProgressContext progressContext{ &control.progress, g_get_monotonic_time(), &ticket, 0 };
+    g_autoptr(OstreeAsyncProgress) asyncProgress =
+      ostree_async_progress_new_and_connect(onPullProgressChanged, &progressContext);
+
+    const std::string remoteNameStr = remoteName.toStdString();
+    // 未指定地址时使用远端配置的地址，否则依次尝试各镜像，已下载的对象不会重复下载
+    const QStringList urls = control.urls.isEmpty() ? QStringList{ QString() } : control.urls;
+    // 从镜像 pull 一次并上报结果，传输量按本次 pull 前后的差值计算；
+    // ref 或对象不存在等与镜像状态无关的错误不计入镜像的失败次数
+    auto pullFromUrl = [&](const QString &url, int flags) {
+        g_clear_error(&gErr);
+        g_autoptr(GVariant) options = pullOptions(ref, flags, nullptr, url);
+        const qint64 begin = g_get_monotonic_time();
+        const guint64 bytesBefore =
+          ostree_async_progress_get_uint64(asyncProgress, "bytes-transferred");
+        const bool ok =
+          pullResumable(tmpRepo, remoteNameStr, options, asyncProgress, control, &gErr);
+        const guint64 bytesAfter =
+          ostree_async_progress_get_uint64(asyncProgress, "bytes-transferred");
+        if (control.urlResult && !url.isEmpty() && (ok || isMirrorError(gErr))) {
+            control.urlResult(url,
+                              ok,
+                              bytesAfter >= bytesBefore ? bytesAfter - bytesBefore : bytesAfter,
+                              (g_get_monotonic_time() - begin) / 1000,
+                              ok ? QString() : QString(gErr->message));
+        }
+        if (!ok && !isCancelledError(gErr)) {
+            qWarning() << "pull" << ref << "from" << url << "failed:" << gErr->message;
+        }
+        return ok;
+    };
+
+    bool ret = false;
+    // 所有镜像都无法获取提交对象时不再重复尝试完整 pull
+    bool commitUnavailable = false;
+    if (!control.peers.isEmpty()) {
+        // 先从配置的远端获取提交对象，以其校验和为准从局域网节点下载其余对象，
+        // 节点提供的对象由 ostree 按校验和校验
+        bool commitFetched = false;
+        for (const auto &url : urls) {
+            commitFetched = pullFromUrl(url,
+                                        OSTREE_REPO_PULL_FLAGS_MIRROR
+                                          | OSTREE_REPO_PULL_FLAGS_COMMIT_ONLY);
+            if (commitFetched || isCancelledError(gErr)) {
+                break;
+            }
+        }
+        commitUnavailable = !commitFetched && !isCancelledError(gErr);
+        g_autofree char *commit = nullptr;
+        if (commitFetched
+            && ostree_repo_resolve_rev(tmpRepo, ref.toStdString().c_str(), TRUE, &commit, &gErr)
+            && commit) {
+            for (const auto &peer : control.peers) {
+                g_autoptr(GVariant) peerOptions =
+                  pullOptions(ref, OSTREE_REPO_PULL_FLAGS_MIRROR, commit, peer);
+                g_clear_error(&gErr);
+                ret = pullResumable(tmpRepo,
+                                    remoteNameStr,
+                                    peerOptions,
+                                    asyncProgress,
+                                    control,
+                                    &gErr);
+                if (ret) {
+                    qInfo() << "pull" << ref << "from peer" << peer;
+                    break;
+                }
+                if (isCancelledError(gErr)) {
+                    break;
+                }
+                qInfo() << "pull" << ref << "from peer" << peer << "failed:" << gErr->message;
+            }
+        }
+        if (!ret && !commitUnavailable && gErr && !isCancelledError(gErr)) {
+            // 节点未提供的对象从配置的远端下载，已下载的对象保留在临时仓库中
+            g_clear_error(&gErr);
+        }
+    }
+    for (const auto &url : urls) {
+        if (ret || commitUnavailable || (gErr && isCancelledError(gErr))) {
+            break;
+        }
+        ret = pullFromUrl(url, OSTREE_REPO_PULL_FLAGS_MIRROR);
+    }
+    ostree_async_progress_finish(asyncProgress);
+    g_main_context_pop_thread_default(mainContext);
+
+    if (!ret) {
+        err = QString("pull %1:%2 failed: %3").arg(remoteName, ref, gErr->message);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 判断 pull 失败是否由镜像本身导致
+ *
+ * @param gErr: pull 返回的错误
+ *
+ * @return bool: true:网络或镜像服务异常 false:已取消或请求的 ref、对象不存在
+ */
+bool OstreeRepoHelper::isMirrorError(const GError *gErr)
+{
+    // ref 或对象不存在通常是请求的版本未发布，换任何镜像都一样，不应降低该镜像的评分
+    return gErr && !g_error_matches(gErr, G_IO_ERROR, G_IO_ERROR_CANCELLED)
+      && !g_error_matches(gErr, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+}
+
 /*
  * 通过 ostree 命令将软件包数据从远端仓库 pull 到本地
  *
@@ -641,45 +1235,53 @@ QString OstreeRepoHelper::createTmpRepo(const QString &parentRepo)
 bool OstreeRepoHelper::repoPullbyCmd(const QString &destPath,
                                      const QString &remoteName,
                                      const QString &ref,
-                                     QString &err)
+                                     QString &err,
+                                     const PullControl &control)
 {
-    // 创建临时仓库
-    QString tmpPath = createTmpRepo(destPath + "/repo");
+    // 优先复用上次中断时留下的临时仓库，已下载的对象不再重复下载
+    QString tmpPath;
+    if (!control.resumeTmpRepo.isEmpty() && QDir(control.resumeTmpRepo + "/repoTmp").exists()) {
+        tmpPath = control.resumeTmpRepo + "/repoTmp";
+        qInfo() << "resume tmp repo path:" << tmpPath;
+    } else {
+        // 创建临时仓库
+        tmpPath = createTmpRepo(destPath + "/repo");
+    }
     if (tmpPath.isEmpty()) {
         err = "create tmp repo err";
         qCritical() << err;
         return false;
     }
 
-    // 将数据 pull 到临时仓库
+    QString tmpRepoDir = tmpPath.left(tmpPath.length() - QString("/repoTmp").length());
+    if (control.tmpRepoCreated) {
+        control.tmpRepoCreated(tmpRepoDir);
+    }
+
+    // 返回前删除临时仓库，调用方要求时失败的下载保留临时仓库以便重试
+    bool succeeded = false;
+    auto cleanup = utils::finally::finally([&tmpRepoDir, &succeeded, &control]() {
+        if (!succeeded && control.keepTmpRepoOnFailure) {
+            qInfo() << "keep tmp repo path:" << tmpRepoDir;
+            return;
+        }
+        qInfo() << "delete tmp repo path:" << tmpRepoDir;
+        linglong::util::removeDir(tmpRepoDir);
+    });
+
+    // 将数据 pull 到临时仓库，等价于
     // ostree --repo=/var/tmp/linglong-cache-I80JB1/repoTmp pull --mirror
     // repo:app/org.deepin.calculator/x86_64/1.2.2
-    const QString fullref = remoteName + ":" + ref;
-    // auto ret = Runner("ostree", {"--repo=" + QString(QLatin1String(tmpPath)), "pull", "--mirror",
-    // fullref}, 1000 * 60
-    // * 60 * 24);
-    // auto ret = startOstreeJob(ref, {"--repo=" + tmpPath, "pull", "--mirror", fullref},
-    //                           1000 * 60 * 60 * 24);
-    // script -q -f ostree.log -c "ostree --repo=/deepin/linglong/repo/repo pull --mirror
-    // repo:com.qq.weixin.work.deepin/4.0.0.6007/x86_64"
-    QString logPath = QString("/tmp/.linglong");
-    linglong::util::createDir(logPath);
-
-    // add for ll-test
-    QFile file(logPath);
-    QFile::Permissions permissions = file.permissions();
-    permissions |= QFile::WriteOther;
-    file.setPermissions(permissions);
-
-    QString logName = ref.split("/").join("-");
-    QString ostreeCmd = "ostree --repo=" + tmpPath + " pull --mirror " + fullref;
-    auto ret = startOstreeJob("script",
-                              ref,
-                              { "-q", "-f", logPath + "/" + logName, "-c", ostreeCmd },
-                              1000 * 60 * 60 * 24);
+    auto ret = pullToTmpRepo(tmpPath, remoteName, ref, control, err);
     if (!ret) {
-        err = "repoPullbyCmd pull error";
-        qCritical() << err;
+        qCritical() << "repoPullbyCmd pull error:" << err;
+        err = "repoPullbyCmd pull error: " + err;
+        return false;
+    }
+
+    // pull-local 不可中断，开始前确认任务未被取消
+    if (control.waitForResume && !control.waitForResume()) {
+        err = "repoPullbyCmd cancelled";
         return false;
     }
     qInfo() << "repoPullbyCmd pull success";
@@ -689,22 +1291,13 @@ bool OstreeRepoHelper::repoPullbyCmd(const QString &destPath,
     // QString(QLatin1String(tmpPath)), ref}, 1000
     // * 60 * 60);
     ret = startOstreeJob("ostree",
-                         ref,
                          { "--repo=" + destPath + "/repo", "pull-local", tmpPath, ref },
                          1000 * 60 * 60);
-
-    // 删除下载进度的重定向文件
-    QString filePath = "/tmp/.linglong/" + logName;
-    QFile(filePath).remove();
-
-    // 删除临时仓库
-    QString tmpRepoDir = tmpPath.left(tmpPath.length() - QString("/repoTmp").length());
-    qInfo() << "delete tmp repo path:" << tmpRepoDir;
-    linglong::util::removeDir(tmpRepoDir);
     if (!ret) {
         err = "repoPullbyCmd pull-local error";
         qCritical() << err;
     }
+    succeeded = ret;
     return ret;
 }
 
@@ -721,7 +1314,8 @@ bool OstreeRepoHelper::repoPullbyCmd(const QString &destPath,
 bool OstreeRepoHelper::repoDeleteDatabyRef(const QString &repoPath,
                                            const QString &remoteName,
                                            const QString &ref,
-                                           QString &err)
+                                           QString &err,
+                                           bool prune)
 {
     if (repoPath.isEmpty() || remoteName.isEmpty() || ref.isEmpty()) {
         qCritical() << "repoDeleteDatabyRef param error";
@@ -745,10 +1339,42 @@ bool OstreeRepoHelper::repoDeleteDatabyRef(const QString &repoPath,
     }
     qInfo() << "repoDeleteDatabyRef delete " << refTmp.c_str() << " success";
 
+    if (prune && !repoPrune(err)) {
+        return false;
+    }
+
+    // const QString fullref = remoteName + ":" + ref;
+    // auto ret = Runner("ostree", {"--repo=" + repoPath + "/repo", "refs", "--delete", ref}, 1000 *
+    // 60 * 30); if (!ret) {
+    //     qInfo() << "repoDeleteDatabyRef delete ref error";
+    //     err = "repoDeleteDatabyRef delete ref error";
+    //     return false;
+    // }
+    // ret = Runner("ostree", {"--repo=" + repoPath + "/repo", "prune", "--refs-only"}, 1000 * 60 *
+    // 30); if (!ret) {
+    //     qInfo() << "repoDeleteDatabyRef prune data error";
+    //     err = "repoDeleteDatabyRef prune data error";
+    //     return false;
+    // }
+    // qInfo() << "repoDeleteDatabyRef delete " << ref << " success";
+    return true;
+}
+
+/*
+ * 清理本地repo仓库中不再被任何ref引用的对象
+ *
+ * @param err: 错误信息
+ *
+ * @return bool: true:成功 false:失败
+ */
+bool OstreeRepoHelper::repoPrune(QString &err)
+{
     gint objectsTotal;
     gint objectsPruned;
     guint64 objsizeTotal;
     g_autofree char *formattedFreedSize = NULL;
+    GCancellable *cancellable = nullptr;
+    GError *error = nullptr;
     if (!ostree_repo_prune(pLingLongDir->repo,
                            OSTREE_REPO_PRUNE_FLAGS_REFS_ONLY,
                            0,
@@ -757,32 +1383,19 @@ bool OstreeRepoHelper::repoDeleteDatabyRef(const QString &repoPath,
                            &objsizeTotal,
                            cancellable,
                            &error)) {
-        qCritical() << "repoDeleteDatabyRef pruning repo failed:" << error->message;
+        qCritical() << "repoPrune pruning repo failed:" << error->message;
+        err = "repoPrune error:" + QString(QLatin1String(error->message));
+        g_clear_error(&error);
         return false;
     }
 
     formattedFreedSize = g_format_size_full(objsizeTotal, (GFormatSizeFlags)0);
-    qInfo() << "repoDeleteDatabyRef Total objects:" << objectsTotal;
+    qInfo() << "repoPrune Total objects:" << objectsTotal;
     if (objectsPruned == 0) {
-        qInfo() << "repoDeleteDatabyRef No unreachable objects";
+        qInfo() << "repoPrune No unreachable objects";
     } else {
         qInfo() << "Deleted " << objectsPruned << " objects," << formattedFreedSize << " freed";
     }
-
-    // const QString fullref = remoteName + ":" + ref;
-    // auto ret = Runner("ostree", {"--repo=" + repoPath + "/repo", "refs", "--delete", ref}, 1000 *
-    // 60 * 30); if (!ret) {
-    //     qInfo() << "repoDeleteDatabyRef delete ref error";
-    //     err = "repoDeleteDatabyRef delete ref error";
-    //     return false;
-    // }
-    // ret = Runner("ostree", {"--repo=" + repoPath + "/repo", "prune", "--refs-only"}, 1000 * 60 *
-    // 30); if (!ret) {
-    //     qInfo() << "repoDeleteDatabyRef prune data error";
-    //     err = "repoDeleteDatabyRef prune data error";
-    //     return false;
-    // }
-    // qInfo() << "repoDeleteDatabyRef delete " << ref << " success";
     return true;
 }
 } // namespace linglong
@@ -14,11 +14,15 @@
 #include <ostree-repo.h>
 
 #include <QDebug>
+#include <QList>
 #include <QMap>
+#include <QSet>
 #include <QString>
+#include <QStringList>
 #include <QTemporaryDir>
 #include <QVector>
 
+#include <functional>
 #include <iostream>
 #include <map>
 #include <string>
@@ -33,6 +37,54 @@ struct LingLongDir
     OstreeRepo *repo;
 };
 
+// ostree pull 下载进度
+struct PullProgress
+{
+    quint64 bytesTransferred = 0; // 已下载字节数
+    quint32 fetchedObjects = 0;   // 已下载对象数
+    quint32 requestedObjects = 0; // 需要下载的对象数
+    quint64 bytesPerSecond = 0;   // 下载速率
+    qint64 etaSeconds = -1;       // 预计剩余时间，未知时为 -1
+};
+
+// 提交中的一项，路径相对于提交根目录
+struct CommitEntry
+{
+    QString path;
+    bool isDir = false;
+    quint32 mode = 0; // 提交中记录的权限位
+};
+
+using PullProgressCallback = std::function<void(const PullProgress &)>;
+
+// ostree pull 任务控制，由发起下载的任务提供
+struct PullControl
+{
+    // 下载进度回调
+    PullProgressCallback progress;
+    // 获取本次下载使用的取消令牌(新的引用)，任务暂停或取消时被触发
+    std::function<GCancellable *()> cancellable;
+    // 在对象边界处调用，任务暂停时阻塞至恢复，返回 false 表示任务已取消
+    std::function<bool()> waitForResume;
+    // 下载速率上限，单位字节每秒，0 表示不限制
+    quint64 maxBytesPerSecond = 0;
+    // 与其他下载任务共享全局速率时的权重
+    int weight = 1;
+    // 局域网内提供对象的节点地址，在配置的远端之前依次尝试
+    QStringList peers;
+    // 远端仓库的镜像地址，最优的在前，失败时依次尝试下一个，为空时使用远端配置的地址
+    QStringList urls;
+    // 镜像下载结果回调，参数依次为地址、是否成功、本次传输的字节数、耗时毫秒数及错误信息，
+    // 与镜像状态无关的失败(如 ref 不存在)不回调
+    std::function<void(const QString &, bool, quint64, qint64, const QString &)> urlResult;
+    // 上次中断时留下的临时仓库目录，存在时在其基础上继续下载
+    QString resumeTmpRepo;
+    // 新建临时仓库后回调，参数为临时仓库目录
+    std::function<void(const QString &)> tmpRepoCreated;
+    // 下载失败时保留临时仓库，由调用方决定何时删除
+    bool keepTmpRepoOnFailure = false;
+};
+
 class OstreeRepoHelper : public linglong::util::Singleton<OstreeRepoHelper>
 {
 public:
@@ -76,6 +128,16 @@ public:
                        QMap<QString, QString> &outRefs,
                        QString &err);
 
+    /*
+     * 查询本地仓库中是否已存在软件包对应的ref
+     *
+     * @param repoPath: 本地仓库路径
+     * @param ref: 软件包对应的仓库索引
+     *
+     * @return bool: true:存在 false:不存在
+     */
+    bool hasRef(const QString &repoPath, const QString &ref);
+
     /*
      * 将软件包数据从本地仓库签出到指定目录
      *
@@ -93,6 +155,28 @@ public:
                          const QString &dstPath,
                          QString &err);
 
+    /*
+     * 基于已签出的旧版本增量签出软件包数据，两个版本间未变化的文件以硬链接方式复用，
+     * 只签出变化的文件，增量签出失败时退回完整签出
+     *
+     * @param repoPath: 远端仓库对应的本地仓库路径
+     * @param remoteName: 远端仓库名称
+     * @param baseRef: 旧版本对应的仓库索引
+     * @param basePath: 旧版本签出目录
+     * @param ref: 软件包对应的仓库索引
+     * @param dstPath: 签出数据保存目录
+     * @param err: 错误信息
+     *
+     * @return bool: true:成功 false:失败
+     */
+    bool checkOutAppDataIncremental(const QString &repoPath,
+                                    const QString &remoteName,
+                                    const QString &baseRef,
+                                    const QString &basePath,
+                                    const QString &ref,
+                                    const QString &dstPath,
+                                    QString &err);
+
     /*
      * 通过ostree命令将软件包数据从远端仓库pull到本地
      *
@@ -100,67 +184,70 @@ public:
      * @param remoteName: 远端仓库名称
      * @param ref: 软件包对应的仓库索引ref
      * @param err: 错误信息
+     * @param control: 下载进度及取消控制，回调在调用线程中执行
      *
      * @return bool: true:成功 false:失败
      */
     bool repoPullbyCmd(const QString &destPath,
                        const QString &remoteName,
                        const QString &ref,
-                       QString &err);
+                       QString &err,
+                       const PullControl &control = {});
 
     /*
-     * 获取下载任务对应的进程Id
+     * 删除本地repo仓库中软件包对应的ref分支信息及数据
      *
-     * @param ref: ostree软件包对应的ref
+     * @param repoPath: 仓库路径
+     * @param remoteName: 远端仓库名称
+     * @param ref: 软件包对应的仓库索引ref
+     * @param err: 错误信息
+     * @param prune: 是否立即清理不再被引用的对象，为 false 时由调用方稍后调用 repoPrune
      *
-     * @return int: ostree命令任务对应的进程id
+     * @return bool: true:成功 false:失败
      */
-    int getOstreeJobId(const QString &ref)
-    {
-        if (jobMap.contains(ref)) {
-            return jobMap[ref];
-        } else {
-            for (auto item : jobMap.keys()) {
-                if (item.indexOf(ref) > -1) {
-                    return jobMap[item];
-                }
-            }
-        }
-        return -1;
-    }
+    bool repoDeleteDatabyRef(const QString &repoPath,
+                             const QString &remoteName,
+                             const QString &ref,
+                             QString &err,
+                             bool prune = true);
 
     /*
-     * 获取正在下载的任务列表
+     * 清理本地repo仓库中不再被任何ref引用的对象
      *
-     * @return QStringList: 正在下载的应用对应的ref列表
+     * @param err: 错误信息
+     *
+     * @return bool: true:成功 false:失败
      */
-    QStringList getOstreeJobList()
-    {
-        if (jobMap.isEmpty()) {
-            return {};
-        }
-        return jobMap.keys();
-    }
+    bool repoPrune(QString &err);
 
     /*
-     * 删除本地repo仓库中软件包对应的ref分支信息及数据
+     * 判断 pull 失败是否由镜像本身导致，只有这类失败计入镜像的失败次数
      *
-     * @param repoPath: 仓库路径
-     * @param remoteName: 远端仓库名称
-     * @param ref: 软件包对应的仓库索引ref
+     * @param gErr: pull 返回的错误
+     *
+     * @return bool: true:网络或镜像服务异常 false:已取消或请求的 ref、对象不存在
+     */
+    static bool isMirrorError(const GError *gErr);
+
+    /*
+     * 按旧版本提交中的条目将旧版本签出目录中未变化的文件硬链接到目标目录，目录按提交中的权限重建，
+     * 签出目录中不属于该提交的文件(如 devel 模块、安装后生成的文件)不会被链接
+     *
+     * @param srcDir: 旧版本签出目录
+     * @param dstDir: 目标目录
+     * @param entries: 旧版本提交中的条目，父目录在子项之前
+     * @param skip: 新版本中变化或删除的相对路径，目录的子项一并跳过
      * @param err: 错误信息
      *
      * @return bool: true:成功 false:失败
      */
-    bool repoDeleteDatabyRef(const QString &repoPath,
-                             const QString &remoteName,
-                             const QString &ref,
-                             QString &err);
+    static bool linkUnchangedEntries(const QString &srcDir,
+                                     const QString &dstDir,
+                                     const QList<CommitEntry> &entries,
+                                     const QSet<QString> &skip,
+                                     QString &err);
 
 private:
-    // multi-thread
-    QMap<QString, int> jobMap;
-
     // lint 禁止拷贝
     OstreeRepoHelper(const OstreeRepoHelper &);
 
@@ -233,34 +320,69 @@ private:
      * 启动一个ostree 命令任务
      *
      * @param cmd: 需要运行的命令
-     * @param ref: ostree软件包对应的ref
      * @param argList: 参数列表
      * @param timeout: 任务超时时间
      *
      * @return bool: true:成功 false:失败
      */
     bool startOstreeJob(const QString &cmd,
-                        const QString &ref,
                         const QStringList &argList,
                         const int timeout);
 
     /*
-     * 在/tmp目录下创建一个临时repo子仓库
+     * 通过 libostree 将软件包数据 pull 到临时仓库，并上报下载进度
      *
-     * @param parentRepo: 父repo仓库路径
+     * @param tmpPath: 临时仓库路径
+     * @param remoteName: 远端仓库名称
+     * @param ref: 软件包对应的仓库索引ref
+     * @param control: 下载进度及取消控制
+     * @param err: 错误信息
      *
-     * @return QString: 临时repo路径
+     * @return bool: true:成功 false:失败
      */
-    QString createTmpRepo(const QString &parentRepo);
+    bool pullToTmpRepo(const QString &tmpPath,
+                       const QString &remoteName,
+                       const QString &ref,
+                       const PullControl &control,
+                       QString &err);
 
     /*
-     * 通过父进程id查找子进程id
+     * 对比两个版本的提交，硬链接旧版本中未变化的文件并签出变化的文件
      *
-     * @param qint64: 父进程id
+     * @param repoPath: 本地仓库路径
+     * @param baseRef: 旧版本对应的仓库索引
+     * @param basePath: 旧版本签出目录
+     * @param ref: 新版本对应的仓库索引
+     * @param dstPath: 签出数据保存目录
+     * @param changedCount: 变化的文件及目录数
+     * @param err: 错误信息
      *
-     * @return qint64: 子进程id
+     * @return bool: true:成功 false:失败
      */
-    qint64 getChildPid(qint64 pid);
+    bool checkOutChanges(const QString &repoPath,
+                         const QString &baseRef,
+                         const QString &basePath,
+                         const QString &ref,
+                         const QString &dstPath,
+                         int &changedCount,
+                         QString &err);
+
+    /*
+     * 为签出目录生成 erofs 镜像，内容与旧版本相同时直接复用旧版本的镜像
+     *
+     * @param dstPath: 签出数据目录
+     * @param basePath: 可复用镜像的旧版本签出目录，为空时完整生成
+     */
+    void buildErofsImage(const QString &dstPath, const QString &basePath = QString());
+
+    /*
+     * 在/tmp目录下创建一个临时repo子仓库
+     *
+     * @param parentRepo: 父repo仓库路径
+     *
+     * @return QString: 临时repo路径
+     */
+    QString createTmpRepo(const QString &parentRepo);
 
 private:
     // ostree 仓库对象信息
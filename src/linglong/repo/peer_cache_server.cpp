@@ -0,0 +1,361 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "peer_cache_server.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <ostree.h>
+
+#include <QDebug>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QTcpSocket>
+#include <QUrl>
+
+#include <functional>
+
+namespace linglong {
+namespace repo {
+
+namespace {
+// 请求头的最大长度
+constexpr int kMaxHeaderSize = 16 * 1024;
+// 长连接空闲超时
+constexpr int kIdleTimeoutMsec = 10 * 1000;
+// 同时处理的连接数，ostree pull 默认最多使用 8 个连接
+constexpr int kMaxConnections = 16;
+// 内容对象按块发送，每个连接最多缓存的未发送字节数
+constexpr qint64 kChunkSize = 64 * 1024;
+constexpr qint64 kMaxPendingBytes = 4 * kChunkSize;
+
+class ConnectionTask : public QRunnable
+{
+public:
+    explicit ConnectionTask(std::function<void()> fn)
+        : fn(std::move(fn))
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override { fn(); }
+
+private:
+    std::function<void()> fn;
+};
+
+QByteArray fromVariant(GVariant *variant)
+{
+    return QByteArray(static_cast<const char *>(g_variant_get_data(variant)),
+                      static_cast<int>(g_variant_get_size(variant)));
+}
+
+QByteArray statusLine(int status)
+{
+    switch (status) {
+    case 200:
+        return "HTTP/1.1 200 OK\r\n";
+    case 404:
+        return "HTTP/1.1 404 Not Found\r\n";
+    default:
+        return "HTTP/1.1 405 Method Not Allowed\r\n";
+    }
+}
+} // namespace
+
+PeerCacheServer::PeerCacheServer(const QString &repoPath, QObject *parent)
+    : QTcpServer(parent)
+    , repoPath(repoPath)
+{
+    pool.setMaxThreadCount(kMaxConnections);
+}
+
+PeerCacheServer::~PeerCacheServer()
+{
+    close();
+    pool.waitForDone();
+    if (repo) {
+        g_object_unref(repo);
+    }
+}
+
+auto PeerCacheServer::route(const QString &path) -> Route
+{
+    static const QRegularExpression objectPattern(
+      "^/objects/([0-9a-f]{2})/([0-9a-f]{62})\\.(commit|commitmeta|dirtree|dirmeta|filez)$");
+    static const QRegularExpression refPattern("^/refs/heads/([\\w.-]+(?:/[\\w.-]+)*)$");
+
+    Route route;
+    if (path == "/config") {
+        route.kind = Route::Config;
+        return route;
+    }
+
+    auto match = objectPattern.match(path);
+    if (match.hasMatch()) {
+        route.kind = Route::Object;
+        route.checksum = match.captured(1) + match.captured(2);
+        route.objectType = match.captured(3);
+        return route;
+    }
+
+    match = refPattern.match(path);
+    if (match.hasMatch() && !match.captured(1).split('/').contains("..")) {
+        route.kind = Route::Ref;
+        route.ref = match.captured(1);
+    }
+    return route;
+}
+
+OstreeRepo *PeerCacheServer::openRepo()
+{
+    QMutexLocker locker(&repoMutex);
+    if (repo) {
+        return repo;
+    }
+
+    g_autoptr(GError) gErr = nullptr;
+    g_autoptr(GFile) repoFile = g_file_new_for_path(repoPath.toStdString().c_str());
+    g_autoptr(OstreeRepo) localRepo = ostree_repo_new(repoFile);
+    if (!ostree_repo_open(localRepo, nullptr, &gErr)) {
+        qWarning() << "peer cache: open repo" << repoPath << "failed:" << gErr->message;
+        return nullptr;
+    }
+    repo = static_cast<OstreeRepo *>(g_steal_pointer(&localRepo));
+    return repo;
+}
+
+bool PeerCacheServer::load(const Route &route, QByteArray &data)
+{
+    if (route.kind == Route::Config) {
+        // 对下载方而言本服务是一个 archive-z2 仓库
+        data = "[core]\nrepo_version=1\nmode=archive-z2\n";
+        return true;
+    }
+    if (route.kind == Route::NotFound
+        || (route.kind == Route::Object && route.objectType == "filez")) {
+        return false;
+    }
+
+    auto localRepo = openRepo();
+    if (!localRepo) {
+        return false;
+    }
+
+    g_autoptr(GError) gErr = nullptr;
+    if (route.kind == Route::Ref) {
+        g_autofree char *rev = nullptr;
+        if (!ostree_repo_resolve_rev(localRepo, route.ref.toStdString().c_str(), TRUE, &rev, &gErr)
+            || !rev) {
+            return false;
+        }
+        data = QByteArray(rev) + "\n";
+        return true;
+    }
+
+    const std::string checksum = route.checksum.toStdString();
+    if (route.objectType == "commit") {
+        // 提交不完整时缺少部分对象，不向其他节点提供
+        g_autoptr(GVariant) commit = nullptr;
+        OstreeRepoCommitState state = OSTREE_REPO_COMMIT_STATE_NORMAL;
+        if (!ostree_repo_load_commit(localRepo, checksum.c_str(), &commit, &state, &gErr)
+            || (state & OSTREE_REPO_COMMIT_STATE_PARTIAL)) {
+            return false;
+        }
+        data = fromVariant(commit);
+        return true;
+    }
+
+    if (route.objectType == "commitmeta") {
+        g_autoptr(GVariant) metadata = nullptr;
+        if (!ostree_repo_read_commit_detached_metadata(localRepo,
+                                                       checksum.c_str(),
+                                                       &metadata,
+                                                       nullptr,
+                                                       &gErr)
+            || !metadata) {
+            return false;
+        }
+        data = fromVariant(metadata);
+        return true;
+    }
+
+    // 其余为 dirtree 及 dirmeta 对象
+    g_autoptr(GVariant) object = nullptr;
+    const auto type =
+      route.objectType == "dirtree" ? OSTREE_OBJECT_TYPE_DIR_TREE : OSTREE_OBJECT_TYPE_DIR_META;
+    if (!ostree_repo_load_variant_if_exists(localRepo, type, checksum.c_str(), &object, &gErr)
+        || !object) {
+        return false;
+    }
+    data = fromVariant(object);
+    return true;
+}
+
+GInputStream *PeerCacheServer::openContent(const Route &route)
+{
+    if (route.kind != Route::Object || route.objectType != "filez") {
+        return nullptr;
+    }
+    auto localRepo = openRepo();
+    if (!localRepo) {
+        return nullptr;
+    }
+
+    // 内容对象可能很大，转换为 archive-z2 格式的流后由调用方分块发送
+    g_autoptr(GError) gErr = nullptr;
+    g_autoptr(GInputStream) input = nullptr;
+    g_autoptr(GFileInfo) fileInfo = nullptr;
+    g_autoptr(GVariant) xattrs = nullptr;
+    if (!ostree_repo_load_file(localRepo,
+                               route.checksum.toStdString().c_str(),
+                               &input,
+                               &fileInfo,
+                               &xattrs,
+                               nullptr,
+                               &gErr)) {
+        return nullptr;
+    }
+    GInputStream *archive = nullptr;
+    if (!ostree_raw_file_to_archive_z2_stream(input, fileInfo, xattrs, &archive, nullptr, &gErr)) {
+        qWarning() << "peer cache: convert" << route.checksum << "failed:" << gErr->message;
+        return nullptr;
+    }
+    return archive;
+}
+
+quint64 PeerCacheServer::servedBytes() const
+{
+    return served;
+}
+
+void PeerCacheServer::incomingConnection(qintptr socketDescriptor)
+{
+    pool.start(new ConnectionTask([this, socketDescriptor]() {
+        serve(socketDescriptor);
+    }));
+}
+
+void PeerCacheServer::serve(qintptr socketDescriptor)
+{
+    QTcpSocket socket;
+    if (!socket.setSocketDescriptor(socketDescriptor)) {
+        qWarning() << "peer cache:" << socket.errorString();
+        return;
+    }
+
+    // 待发送的数据超过上限时等待写出，大对象不会整个缓存在内存中
+    auto send = [&socket](const QByteArray &data) {
+        socket.write(data);
+        while (socket.bytesToWrite() > kMaxPendingBytes) {
+            if (!socket.waitForBytesWritten(kIdleTimeoutMsec)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    QByteArray buffer;
+    while (true) {
+        int headerEnd = -1;
+        while ((headerEnd = buffer.indexOf("\r\n\r\n")) < 0) {
+            if (buffer.size() > kMaxHeaderSize || !socket.waitForReadyRead(kIdleTimeoutMsec)) {
+                return;
+            }
+            buffer += socket.readAll();
+        }
+        const auto lines = buffer.left(headerEnd).split('\n');
+        buffer.remove(0, headerEnd + 4);
+
+        const auto requestLine = lines.first().trimmed().split(' ');
+        if (requestLine.size() != 3) {
+            return;
+        }
+        const auto &method = requestLine.at(0);
+        bool keepAlive = requestLine.at(2) == "HTTP/1.1";
+        for (const auto &line : lines.mid(1)) {
+            const auto header = line.trimmed().toLower();
+            if (header.startsWith("connection:")) {
+                keepAlive = header.mid(qstrlen("connection:")).trimmed() != "close";
+            }
+        }
+
+        int status = 405;
+        QByteArray body;
+        g_autoptr(GInputStream) content = nullptr;
+        if (method == "GET" || method == "HEAD") {
+            const auto path = QUrl(QString::fromLatin1(requestLine.at(1))).path();
+            const auto requestRoute = route(path);
+            if (requestRoute.kind == Route::Object && requestRoute.objectType == "filez") {
+                content = openContent(requestRoute);
+                status = content ? 200 : 404;
+            } else {
+                status = load(requestRoute, body) ? 200 : 404;
+            }
+        }
+        if (status != 200) {
+            body.clear();
+        }
+
+        // 内容对象压缩后的大小事先未知，HTTP/1.1 下使用 chunked 编码，否则发送完后关闭连接
+        const bool chunked = content && requestLine.at(2) == "HTTP/1.1";
+        keepAlive = keepAlive && (!content || chunked);
+        QByteArray response = statusLine(status);
+        response += "Content-Type: application/octet-stream\r\n";
+        if (chunked) {
+            response += "Transfer-Encoding: chunked\r\n";
+        } else if (!content) {
+            response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+        }
+        response += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        if (method != "HEAD") {
+            response += body;
+            served += body.size();
+        }
+        if (!send(response)) {
+            return;
+        }
+
+        if (content && method != "HEAD") {
+            QByteArray chunk(kChunkSize, Qt::Uninitialized);
+            while (true) {
+                g_autoptr(GError) gErr = nullptr;
+                const gssize n =
+                  g_input_stream_read(content, chunk.data(), chunk.size(), nullptr, &gErr);
+                if (n < 0) {
+                    // 响应头已发出，只能断开连接，由下载方重试
+                    qWarning() << "peer cache: read content failed:" << gErr->message;
+                    return;
+                }
+                if (n == 0) {
+                    break;
+                }
+                const auto data = QByteArray::fromRawData(chunk.constData(), static_cast<int>(n));
+                if (!send(chunked ? QByteArray::number(qint64(n), 16) + "\r\n" + data + "\r\n"
+                                  : data)) {
+                    return;
+                }
+                served += static_cast<quint64>(n);
+            }
+            if (chunked && !send("0\r\n\r\n")) {
+                return;
+            }
+        }
+        while (socket.bytesToWrite() > 0) {
+            if (!socket.waitForBytesWritten(kIdleTimeoutMsec)) {
+                return;
+            }
+        }
+
+        if (!keepAlive) {
+            socket.disconnectFromHost();
+            return;
+        }
+    }
+}
+
+} // namespace repo
+} // namespace linglong
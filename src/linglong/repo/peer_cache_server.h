@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_REPO_PEER_CACHE_SERVER_H_
+#define LINGLONG_SRC_REPO_PEER_CACHE_SERVER_H_
+
+#include <QMutex>
+#include <QTcpServer>
+#include <QThreadPool>
+
+#include <atomic>
+
+typedef struct OstreeRepo OstreeRepo;
+typedef struct _GInputStream GInputStream;
+
+namespace linglong {
+namespace repo {
+
+/**
+ * @brief 向局域网内其他节点提供本地 ostree 对象的 HTTP 服务
+ * @details 按 archive-z2 仓库的目录布局提供本地 bare-user-only 仓库中的对象，内容对象在请求时
+ *          转换为 .filez 格式，其他节点可以直接将服务地址作为 ostree pull 的 url 使用。
+ *          只提供完整的提交，对象内容由下载方的 ostree 按校验和校验
+ */
+class PeerCacheServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    struct Route
+    {
+        enum Kind {
+            NotFound,
+            Config, ///< /config
+            Ref,    ///< /refs/heads/<ref>
+            Object, ///< /objects/<xx>/<checksum>.<type>
+        };
+
+        Kind kind = NotFound;
+        QString ref;
+        QString checksum;
+        QString objectType;
+    };
+
+    /**
+     * @param repoPath 本地 ostree 仓库路径，在第一次请求时打开
+     */
+    explicit PeerCacheServer(const QString &repoPath, QObject *parent = nullptr);
+    ~PeerCacheServer() override;
+
+    /**
+     * @brief 解析请求路径
+     */
+    static Route route(const QString &path);
+
+    /**
+     * @brief 读取请求的内容，内容对象(.filez)不读入内存，使用 openContent
+     *
+     * @return bool: true:成功 false:对象不存在或提交不完整
+     */
+    bool load(const Route &route, QByteArray &data);
+
+    /**
+     * @brief 打开内容对象，按 archive-z2 格式压缩后的数据以流的形式读取
+     *
+     * @return GInputStream*: 调用方释放，对象不存在时为空
+     */
+    GInputStream *openContent(const Route &route);
+
+    /**
+     * @brief 已发送的对象字节数
+     */
+    quint64 servedBytes() const;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    // 处理连接上的请求直到对端关闭或空闲超时，在线程池中执行
+    void serve(qintptr socketDescriptor);
+
+    OstreeRepo *openRepo();
+
+    QString repoPath;
+    QMutex repoMutex;
+    OstreeRepo *repo = nullptr;
+    QThreadPool pool;
+    std::atomic<quint64> served{ 0 };
+};
+
+} // namespace repo
+} // namespace linglong
+
+#endif
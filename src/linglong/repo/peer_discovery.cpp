@@ -0,0 +1,151 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "peer_discovery.h"
+
+#include <QDebug>
+#include <QNetworkDatagram>
+#include <QUrl>
+#include <QUuid>
+
+namespace linglong {
+namespace repo {
+
+namespace {
+const QByteArray kAnnouncementMagic = "linglong-peer/1";
+} // namespace
+
+PeerDiscovery::PeerDiscovery(quint16 httpPort, QObject *parent)
+    : QObject(parent)
+    , id(QUuid::createUuid().toString(QUuid::WithoutBraces))
+    , httpPort(httpPort)
+{
+    clock.start();
+    connect(&timer, &QTimer::timeout, this, &PeerDiscovery::announce);
+    connect(&socket, &QUdpSocket::readyRead, this, &PeerDiscovery::readPendingDatagrams);
+}
+
+void PeerDiscovery::setStaticPeers(const QStringList &urls)
+{
+    QMutexLocker locker(&mutex);
+    staticPeers.clear();
+    for (const auto &url : urls) {
+        const auto trimmed = url.trimmed();
+        if (!trimmed.isEmpty()) {
+            staticPeers << (trimmed.endsWith('/') ? trimmed.chopped(1) : trimmed);
+        }
+    }
+}
+
+bool PeerDiscovery::startMulticast(const QHostAddress &group, quint16 port, qint64 intervalSec)
+{
+    this->group = group;
+    groupPort = port;
+    expireMsec = 3 * intervalSec * 1000;
+
+    // 同一台机器上可以运行多个实例，组播端口需要共享
+    if (!socket.bind(QHostAddress::AnyIPv4,
+                     port,
+                     QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint)) {
+        qWarning() << "peer discovery: bind" << port << "failed:" << socket.errorString();
+        return false;
+    }
+    if (!socket.joinMulticastGroup(group)) {
+        qWarning() << "peer discovery: join" << group << "failed:" << socket.errorString();
+        return false;
+    }
+    socket.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+    socket.setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+
+    timer.start(static_cast<int>(intervalSec * 1000));
+    announce();
+    return true;
+}
+
+QStringList PeerDiscovery::peers() const
+{
+    QMutexLocker locker(&mutex);
+    QStringList result = staticPeers;
+    const qint64 now = clock.elapsed();
+    for (const auto &peer : announced) {
+        if (now - peer.lastSeenMsec <= expireMsec && !result.contains(peer.url)) {
+            result << peer.url;
+        }
+    }
+    return result;
+}
+
+QString PeerDiscovery::instanceId() const
+{
+    return id;
+}
+
+QByteArray PeerDiscovery::announcement(const QString &instanceId, quint16 httpPort)
+{
+    return kAnnouncementMagic + " " + instanceId.toLatin1() + " " + QByteArray::number(httpPort);
+}
+
+bool PeerDiscovery::parseAnnouncement(const QByteArray &datagram,
+                                      QString &instanceId,
+                                      quint16 &httpPort)
+{
+    const auto fields = datagram.trimmed().split(' ');
+    if (fields.size() != 3 || fields.at(0) != kAnnouncementMagic || fields.at(1).isEmpty()) {
+        return false;
+    }
+    bool ok = false;
+    const auto port = fields.at(2).toUShort(&ok);
+    if (!ok || port == 0) {
+        return false;
+    }
+    instanceId = QString::fromLatin1(fields.at(1));
+    httpPort = port;
+    return true;
+}
+
+void PeerDiscovery::handleAnnouncement(const QByteArray &datagram, const QHostAddress &sender)
+{
+    QString peerId;
+    quint16 peerPort = 0;
+    if (!parseAnnouncement(datagram, peerId, peerPort) || peerId == id) {
+        return;
+    }
+
+    QHostAddress address = sender;
+    bool isIPv4 = false;
+    const auto ipv4 = sender.toIPv4Address(&isIPv4);
+    if (isIPv4) {
+        address = QHostAddress(ipv4);
+    }
+    QUrl url;
+    url.setScheme("http");
+    url.setHost(address.toString());
+    url.setPort(peerPort);
+
+    QMutexLocker locker(&mutex);
+    auto &peer = announced[peerId];
+    if (peer.url != url.toString()) {
+        qInfo() << "peer discovery: found" << url.toString();
+    }
+    peer.url = url.toString();
+    peer.lastSeenMsec = clock.elapsed();
+}
+
+void PeerDiscovery::announce()
+{
+    socket.writeDatagram(announcement(id, httpPort), group, groupPort);
+}
+
+void PeerDiscovery::readPendingDatagrams()
+{
+    while (socket.hasPendingDatagrams()) {
+        const auto datagram = socket.receiveDatagram();
+        handleAnnouncement(datagram.data(), datagram.senderAddress());
+    }
+}
+
+} // namespace repo
+} // namespace linglong
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_REPO_PEER_DISCOVERY_H_
+#define LINGLONG_SRC_REPO_PEER_DISCOVERY_H_
+
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QUdpSocket>
+
+namespace linglong {
+namespace repo {
+
+/**
+ * @brief 局域网对象服务节点发现
+ * @details 节点来自静态配置及组播通告。每个实例定时向组播组通告自身的服务端口，
+ *          收到其他实例的通告后记录其地址，超过三个通告间隔未再收到的节点不再使用
+ */
+class PeerDiscovery : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @param httpPort 本机对象服务的端口
+     */
+    explicit PeerDiscovery(quint16 httpPort, QObject *parent = nullptr);
+
+    void setStaticPeers(const QStringList &urls);
+
+    /**
+     * @brief 加入组播组，开始定时通告并监听其他节点的通告
+     *
+     * @param group 组播地址
+     * @param port 组播端口
+     * @param intervalSec 通告间隔，单位秒
+     *
+     * @return bool: true:成功 false:失败
+     */
+    bool startMulticast(const QHostAddress &group, quint16 port, qint64 intervalSec);
+
+    /**
+     * @brief 当前可用的节点地址，静态配置的节点在前，可在任意线程调用
+     */
+    QStringList peers() const;
+
+    /**
+     * @brief 本实例的标识，用于忽略自身的通告
+     */
+    QString instanceId() const;
+
+    /**
+     * @brief 记录收到的通告
+     *
+     * @param datagram 通告内容
+     * @param sender 通告的发送地址
+     */
+    void handleAnnouncement(const QByteArray &datagram, const QHostAddress &sender);
+
+    static QByteArray announcement(const QString &instanceId, quint16 httpPort);
+
+    static bool parseAnnouncement(const QByteArray &datagram,
+                                  QString &instanceId,
+                                  quint16 &httpPort);
+
+public Q_SLOTS:
+    void announce();
+
+private Q_SLOTS:
+    void readPendingDatagrams();
+
+private:
+    struct Peer
+    {
+        QString url;
+        qint64 lastSeenMsec = 0;
+    };
+
+    const QString id;
+    const quint16 httpPort;
+
+    QUdpSocket socket;
+    QTimer timer;
+    QHostAddress group;
+    quint16 groupPort = 0;
+    qint64 expireMsec = 90 * 1000;
+    QElapsedTimer clock;
+
+    mutable QMutex mutex;
+    QStringList staticPeers;
+    QMap<QString, Peer> announced;
+};
+
+} // namespace repo
+} // namespace linglong
+
+#endif
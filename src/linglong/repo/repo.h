@@ -50,6 +50,9 @@ public:
 
     virtual QString rootOfLayer(const package::Ref &ref) = 0;
 
+    // 已安装 layer 的提交校验和，ref 中需有 channel 及 module，无法获取时返回空
+    virtual QString commitOfLayer(const package::Ref &ref) = 0;
+
     virtual package::Ref latestOfRef(const QString &appId, const QString &appVersion) = 0;
 };
 
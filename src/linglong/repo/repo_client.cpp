@@ -7,11 +7,13 @@
 #include "repo_client.h"
 
 #include "linglong/package/package.h"
+#include "linglong/repo/mirror_list.h"
 #include "linglong/util/config/config.h"
 #include "linglong/util/file.h"
 #include "linglong/util/http/http_client.h"
 #include "linglong/util/qserializer/deprecated.h"
 
+#include <QElapsedTimer>
 #include <QJsonObject>
 
 namespace linglong {
@@ -54,12 +56,6 @@ QJsonObject getUserInfo()
 std::tuple<util::Error, QList<QSharedPointer<package::AppMetaInfo>>>
 RepoClient::QueryApps(const package::Ref &ref)
 {
-    // TODO: query cache Here
-    QUrl url(endpoint);
-    // FIXME: normalize the path
-    url.setPath(url.path() + "/api/v0/apps/fuzzysearchapp");
-    QNetworkRequest request(url);
-
     QJsonObject obj;
     obj["AppId"] = ref.appId;
     obj["version"] = ref.version;
@@ -67,28 +63,53 @@ RepoClient::QueryApps(const package::Ref &ref)
     obj["repoName"] = ref.repo;
 
     QJsonDocument doc(obj);
-    QByteArray data = doc.toJson();
-
-    util::HttpRestClient hc;
-    auto reply = hc.post(request, data);
-    if (reply->error()) {
-        return { NewError(-1, reply->errorString()), {} };
-    }
-    data = reply->readAll();
-    qDebug() << "QueryApps: get response from server:" << QString(data);
-    auto resp = util::loadJsonBytes<repo::Response>(data);
-
-    if (!resp) {
-        return { NewError(-1, "Failed to load application list from response."), {} };
+    const QByteArray body = doc.toJson();
+
+    util::Error err = NewError(-1, "no repo endpoint available");
+    for (const auto &endpoint : endpoints()) {
+        // TODO: query cache Here
+        QUrl url(endpoint);
+        // FIXME: normalize the path
+        url.setPath(url.path() + "/api/v0/apps/fuzzysearchapp");
+        QNetworkRequest request(url);
+
+        QElapsedTimer timer;
+        timer.start();
+        util::HttpRestClient hc;
+        auto reply = hc.post(request, body);
+        if (reply->error()) {
+            err = NewError(-1, reply->errorString());
+            if (!mirrorRepo.isEmpty()) {
+                MIRROR_LIST->reportFailure(mirrorRepo, endpoint, reply->errorString());
+                qWarning() << "QueryApps: mirror" << endpoint << "failed:" << reply->errorString();
+            }
+            continue;
+        }
+        auto data = reply->readAll();
+        if (!mirrorRepo.isEmpty()) {
+            MIRROR_LIST->reportSuccess(mirrorRepo,
+                                       endpoint,
+                                       timer.elapsed(),
+                                       static_cast<quint64>(data.size()),
+                                       timer.elapsed());
+        }
+        qDebug() << "QueryApps: get response from server:" << QString(data);
+        auto resp = util::loadJsonBytes<repo::Response>(data);
+
+        if (!resp) {
+            return { NewError(-1, "Failed to load application list from response."), {} };
+        }
+
+        return { Success(), resp->data };
     }
 
-    return { Success(), resp->data };
+    return { err, {} };
 }
 
 std::tuple<util::Error, QString> RepoClient::Auth(const package::Ref &ref)
 {
     //    QUrl url(QString("%1/%2").arg(endpoint, "api/v1/sign-in"));
-    QUrl url(QString("%1/%2").arg(endpoint, "auth"));
+    QUrl url(QString("%1/%2").arg(endpoints().value(0), "auth"));
 
     QNetworkRequest request(url);
 
@@ -113,9 +134,19 @@ RepoClient::RepoClient(const QString &endpoint)
 {
 }
 
-void RepoClient::setEndpoint(const QString &endpoint)
+RepoClient RepoClient::withMirrors(const QString &repoName)
 {
-    this->endpoint = endpoint;
+    RepoClient client(QString{});
+    client.mirrorRepo = repoName;
+    return client;
+}
+
+QStringList RepoClient::endpoints() const
+{
+    if (mirrorRepo.isEmpty()) {
+        return { endpoint };
+    }
+    return MIRROR_LIST->endpoints(mirrorRepo);
 }
 
 } // namespace repo
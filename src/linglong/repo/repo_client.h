@@ -51,13 +51,12 @@ class RepoClient
 public:
     explicit RepoClient(const QString &endpoint);
 
-    // FIXME(black_desk):
-    // This method is just a workaround used to
-    // update RepoClient::endpoint
-    // when endpoint get updated
-    // by PackageManager::RepoModify.
-    // It's not thread-safe.
-    void setEndpoint(const QString &endpoint);
+    /*
+     * 使用镜像列表中的地址，每次请求时按镜像状态选择，失败时依次尝试下一个镜像
+     *
+     * @param repoName: 配置中的仓库名
+     */
+    static RepoClient withMirrors(const QString &repoName);
 
     std::tuple<util::Error, QList<QSharedPointer<package::AppMetaInfo>>>
     QueryApps(const package::Ref &ref);
@@ -65,7 +64,11 @@ public:
     std::tuple<util::Error, QString> Auth(const package::Ref &ref);
 
 private:
+    // 本次请求依次尝试的地址
+    QStringList endpoints() const;
+
     QString endpoint;
+    QString mirrorRepo;
 };
 
 } // namespace repo
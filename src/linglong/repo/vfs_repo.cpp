@@ -129,6 +129,13 @@ QString VfsRepo::rootOfLayer(const package::Ref &ref)
     return mountPoint;
 }
 
+QString VfsRepo::commitOfLayer(const package::Ref &ref)
+{
+    // TODO: parse form meta data
+    Q_UNUSED(ref);
+    return QString();
+}
+
 package::Ref VfsRepo::latestOfRef(const QString &appId, const QString &appVersion)
 {
     // TODO: parse form meta data
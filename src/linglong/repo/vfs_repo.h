@@ -46,6 +46,8 @@ public:
 
     virtual QString rootOfLayer(const package::Ref &ref);
 
+    virtual QString commitOfLayer(const package::Ref &ref);
+
     virtual package::Ref latestOfRef(const QString &appId, const QString &appVersion);
 
 private:
@@ -10,6 +10,13 @@
 #include "linglong/package/info.h"
 #include "linglong/repo/repo.h"
 #include "linglong/runtime/app_config.h"
+#include "linglong/runtime/box_pool.h"
+#include "linglong/runtime/font_cache.h"
+#include "linglong/runtime/launch_spec_cache.h"
+#include "linglong/runtime/ld_cache.h"
+#include "linglong/runtime/launch_trace.h"
+#include "linglong/runtime/mount_template.h"
+#include "linglong/runtime/namespace_exec.h"
 #include "linglong/util/file.h"
 #include "linglong/util/qserializer/json.h"
 #include "linglong/util/qserializer/yaml.h"
@@ -19,6 +26,7 @@
 #include "linglong/utils/std_helper/qdebug_helper.h"
 #include "linglong/utils/xdg/desktop_entry.h"
 #include "ocppi/runtime/config/ConfigLoader.hpp"
+#include "ocppi/runtime/config/types/Generators.hpp"
 
 #include <linux/prctl.h>
 #include <sys/prctl.h>
@@ -29,6 +37,8 @@
 #include <QProcess>
 #include <QStandardPaths>
 
+#include <cerrno>
+#include <cstring>
 #include <mutex>
 #include <sstream>
 
@@ -60,38 +70,72 @@ auto init() -> int
 }
 } // namespace PrivateAppInit
 
+// 追踪启动耗时时等待应用进程出现的最长时间
+constexpr int kTraceExecTimeoutMsec = 10000;
+
+// 启动配置缓存记录的 layer 提交与已安装的是否一致
+static bool layerCommitsUnchanged(repo::Repo *repo, const QList<QPair<QString, QString>> &commits)
+{
+    for (const auto &commit : commits) {
+        const auto parts = commit.first.split('/');
+        if (parts.size() != 5) {
+            return false;
+        }
+        const package::Ref layer("", parts[0], parts[1], parts[2], parts[3], parts[4]);
+        if (repo->commitOfLayer(layer) != commit.second) {
+            qDebug() << "launch spec cache: commit changed" << commit.first;
+            return false;
+        }
+    }
+    return true;
+}
+
 enum RunArch {
     UNKNOWN,
     ARM64,
     X86_64,
 };
 
-auto App::init() -> bool
+auto App::init(const QByteArray &cachedSpec) -> bool
 {
-    QFile builtinOCIConfigTemplateJSONFile(":/config.json");
-    if (!builtinOCIConfigTemplateJSONFile.open(QIODevice::ReadOnly)) {
-        // NOTE(black_desk): Go check qrc if this occurs.
-        qFatal("builtin OCI configuration template file missing.");
-    }
-
-    auto bytes = builtinOCIConfigTemplateJSONFile.readAll();
-    std::stringstream tmpStream;
-    tmpStream << bytes.toStdString();
-
-    ocppi::runtime::config::ConfigLoader loader;
-    auto config = loader.load(tmpStream);
-    if (!config.has_value()) {
-        qCritical() << "builtin OCI configuration template is invalid.";
+    LaunchTrace::Span span("App::init");
+    bool loaded = false;
+    if (!cachedSpec.isEmpty()) {
         try {
-            std::rethrow_exception(config.error());
+            r = nlohmann::json::from_cbor(cachedSpec.cbegin(), cachedSpec.cend())
+                  .get<ocppi::runtime::config::types::Config>();
+            loaded = true;
         } catch (const std::exception &e) {
-            qFatal("%s", e.what());
-        } catch (...) {
-            qFatal("Unknown error");
+            qWarning() << "cached OCI configuration template is invalid:" << e.what();
         }
     }
 
-    r = std::move(config.value());
+    if (!loaded) {
+        QFile builtinOCIConfigTemplateJSONFile(":/config.json");
+        if (!builtinOCIConfigTemplateJSONFile.open(QIODevice::ReadOnly)) {
+            // NOTE(black_desk): Go check qrc if this occurs.
+            qFatal("builtin OCI configuration template file missing.");
+        }
+
+        auto bytes = builtinOCIConfigTemplateJSONFile.readAll();
+        std::stringstream tmpStream;
+        tmpStream << bytes.toStdString();
+
+        ocppi::runtime::config::ConfigLoader loader;
+        auto config = loader.load(tmpStream);
+        if (!config.has_value()) {
+            qCritical() << "builtin OCI configuration template is invalid.";
+            try {
+                std::rethrow_exception(config.error());
+            } catch (const std::exception &e) {
+                qFatal("%s", e.what());
+            } catch (...) {
+                qFatal("Unknown error");
+            }
+        }
+
+        r = std::move(config.value());
+    }
 
     container.reset(new Container(this));
     container->create(package->ref);
@@ -101,6 +145,7 @@ auto App::init() -> bool
 
 int App::prepare()
 {
+    LaunchTrace::Span span("prepare");
     // FIXME: get info from module/package
     auto runtimeRef = package::Ref(runtime->ref);
     QString runtimeRootPath = repo->rootOfLayer(runtimeRef);
@@ -225,6 +270,7 @@ int App::prepare()
 
 auto App::stageSystem() -> int
 {
+    LaunchTrace::Span span("stageSystem");
     QList<QPair<QString, QString>> mountMap;
     mountMap = {
         { "/dev/dri", "/dev/dri" },
@@ -245,21 +291,26 @@ auto App::stageSystem() -> int
 
 auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString appRootPath) -> int
 {
+    LaunchTrace::Span span("stageRootfs");
     // overlay 挂载标志
     bool fuseMount = false;
     // wine 应用挂载标志
     bool wineMount = false;
     // 通过info.json中overlay挂载标志
     bool specialCase = false;
-    // other sys overlay 挂载标志
-    bool otherSysMount = false;
 
-    // if use wine runtime, mount with fuse
-    // FIXME(iceyer): use info.json to decide use fuse or not
-    if (runtimeRootPath.contains("org.deepin.Wine")) {
-        wineMount = true;
+    // 转化特殊变量
+    // 获取环境变量LINGLONG_ROOT
+    auto linglongRootPath = util::getLinglongRootPath();
+
+    // runtime 决定的挂载按 runtime 缓存
+    auto runtimeRef = package::Ref(runtime->ref);
+    auto mountTemplate =
+      MountTemplate::forRuntime(runtimeRootPath, repo->rootOfLayer(runtimeRef), linglongRootPath);
+    if (mountTemplate->requiresOverlay()) {
         fuseMount = true;
     }
+    wineMount = mountTemplate->isWine();
 
     r.annotations = {
         { "containerRootPath", container->workingDirectory.toStdString() },
@@ -277,9 +328,6 @@ auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString app
         }
     }
 
-    // 转化特殊变量
-    // 获取环境变量LINGLONG_ROOT
-    auto linglongRootPath = util::getLinglongRootPath();
     QMap<QString, QString> variables = {
         { "APP_ROOT_PATH", appRootPath },
         { "RUNTIME_ROOT_PATH", runtimeRootPath },
@@ -293,29 +341,6 @@ auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString app
         return path;
     };
 
-    // 通过runtime info.json文件获取basicsRootPath路径
-    auto runtimeRef = package::Ref(runtime->ref);
-    QString runtimePath = repo->rootOfLayer(runtimeRef);
-    auto runtimeInfoFile = runtimePath + "/info.json";
-    // basics usr
-    QString basicsUsrRootPath = "";
-    // basics etc
-    QString basicsEtcRootPath = "";
-    if (!linglong::util::isDeepinSysProduct()) {
-        QSharedPointer<package::Info> runtimeInfo;
-        if (util::fileExists(runtimeInfoFile)) {
-            runtimeInfo = util::loadJson<package::Info>(runtimeInfoFile);
-            if (!runtimeInfo->runtime.isEmpty()) {
-                basicsUsrRootPath =
-                  linglongRootPath + "/layers/" + runtimeInfo->runtime + "/files/usr";
-                basicsEtcRootPath =
-                  linglongRootPath + "/layers/" + runtimeInfo->runtime + "/files/etc";
-                fuseMount = true;
-                otherSysMount = true;
-            }
-        }
-    }
-
     // 使用overlayfs挂载debug调试符号
     auto debugRef = package::Ref(package->ref);
     qDebug() << "stageRootfs debugRef " << package->ref;
@@ -323,7 +348,15 @@ auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString app
         fuseMount = true;
     }
 
-    if (fuseMount) {
+    // 只因 runtime 需要 overlay 时绑定同一 runtime 共用的合并目录树，不再每个容器各自叠加
+    QList<QPair<QString, QString>> sharedTree;
+    if (fuseMount && !specialCase && "devel" != debugRef.module) {
+        sharedTree = mountTemplate->prepareSharedTree(
+          util::userRuntimeDir().absoluteFilePath("linglong/runtime-trees"));
+    }
+    const bool overlayMount = fuseMount && sharedTree.isEmpty();
+
+    if (overlayMount) {
         r.annotations->insert({
           "overlayfs",
           {
@@ -347,14 +380,8 @@ auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString app
 
     r.annotations->insert({ "dbusProxyInfo", {} });
 
-    QList<QPair<QString, QString>> mountMap;
-
-    mountMap = {
-        { "/usr", "/usr" },
-        { "/etc", "/etc" },
-        { runtimeRootPath, "/runtime" },
-        { "/usr/share/locale/", "/usr/share/locale/" },
-    };
+    QList<QPair<QString, QString>> mountMap =
+      sharedTree.isEmpty() ? mountTemplate->baseMounts() : sharedTree;
 
     qDebug() << "stageRootfs runtimeRootPath:" << runtimeRootPath << "appRootPath:" << appRootPath;
     // appRootPath/devel/files/debug /usr/lib/debug/opt/apps/appid/files 挂载调试符号
@@ -369,27 +396,18 @@ auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString app
     }
 
     // FIXME(iceyer): extract for wine, remove later
-    if (fuseMount && wineMount) {
-        // NOTE: the override should be behind host /usr
-        mountMap.push_back({ runtimeRootPath + "/bin", "/usr/bin" });
-        mountMap.push_back({ runtimeRootPath + "/include", "/usr/include" });
-        mountMap.push_back({ runtimeRootPath + "/lib", "/usr/lib" });
-        mountMap.push_back({ runtimeRootPath + "/sbin", "/usr/sbin" });
-        mountMap.push_back({ runtimeRootPath + "/share", "/usr/share" });
-        mountMap.push_back({ runtimeRootPath + "/opt/deepinwine", "/opt/deepinwine" });
-        mountMap.push_back(
-          { runtimeRootPath + "/opt/deepin-wine6-stable", "/opt/deepin-wine6-stable" });
+    if (overlayMount && wineMount) {
+        mountMap.append(mountTemplate->wineMounts());
     }
     // overlay mount 通过info.json
-    if (fuseMount && specialCase) {
+    if (overlayMount && specialCase) {
         for (auto mount : info->overlayfs->mounts) {
             mountMap.push_back({ getPath(mount->source), getPath(mount->destination) });
         }
     }
     // overlay mount basics
-    if (fuseMount && otherSysMount) {
-        mountMap.push_back({ basicsUsrRootPath, "/usr" });
-        mountMap.push_back({ basicsEtcRootPath, "/etc" });
+    if (overlayMount) {
+        mountMap.append(mountTemplate->basicsMounts());
     }
 
     for (const auto &pair : mountMap) {
@@ -399,7 +417,7 @@ auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString app
         m["source"] = pair.first.toStdString();
         m["destination"] = pair.second.toStdString();
 
-        if (fuseMount) {
+        if (overlayMount) {
             // overlay mount 顺序是反向的
             if (wineMount) {
                 // wine应用先保持不变（会导致wine应用运行失败），后续整改
@@ -423,7 +441,7 @@ auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString app
     m["source"] = appRootPath.toStdString();
     m["destination"] = appMountPath.toStdString();
 
-    if (fuseMount) {
+    if (overlayMount) {
         // overlay mount 顺序是反向的
         if (wineMount) {
             // wine应用先保持不变（会导致wine应用运行失败），后续整改
@@ -504,12 +522,64 @@ auto App::stageRootfs(QString runtimeRootPath, const QString &appId, QString app
         return -1;
     }
 
+    // 已生成 ld.so.cache 时动态链接器直接查表，无需再逐个目录查找
+    const auto hostPathOf = [&](QString path) {
+        if (path.startsWith("/opt/apps/" + appId)) {
+            return path.replace(0, QString("/opt/apps/" + appId).length(), appRootPath);
+        }
+        if (path.startsWith("/runtime")) {
+            return path.replace(0, QString("/runtime").length(), runtimeRootPath);
+        }
+        return path;
+    };
+    // 应用的库目录仍通过 LD_LIBRARY_PATH 优先于 runtime 及系统的库，不依赖缓存中的顺序
+    QStringList appLibraryPaths;
+    QStringList cachedLibraryPaths;
+    QStringList ldCacheDependencies{ "/etc/ld.so.cache", "/etc/ld.so.conf", "/etc/ld.so.conf.d" };
+    for (const auto &path : fixLdLibraryPath) {
+        (path.startsWith(appLdLibraryPath) ? appLibraryPaths : cachedLibraryPaths).append(path);
+        ldCacheDependencies.append(hostPathOf(path));
+    }
+    LdCache ldCache;
+    // wine 覆盖目录及 basics 会改变容器内的库目录
+    QStringList ldCacheKeyParts{ appRootPath, runtimeRootPath, appRef.arch };
+    for (const auto &mounts : { mountTemplate->baseMounts(),
+                                mountTemplate->wineMounts(),
+                                mountTemplate->basicsMounts() }) {
+        for (const auto &mount : mounts) {
+            ldCacheKeyParts << mount.first << mount.second;
+        }
+    }
+    const auto ldCacheKey = util::cacheKey(ldCacheKeyParts);
+
+    if (ldCache.isReady(ldCacheKey)) {
+        ocppi::runtime::config::types::Mount m;
+        m.type = "bind";
+        m.options = std::vector<std::string>{ "ro", "rbind" };
+        m.source = ldCache.cacheFile(ldCacheKey).toStdString();
+        m.destination = "/etc/ld.so.cache";
+        r.mounts->push_back(m);
+        env.push_back(("LD_LIBRARY_PATH=" + appLibraryPaths.join(":")).toStdString());
+        return 0;
+    }
+
+    if (ldCache.prepare(ldCacheKey, cachedLibraryPaths, ldCacheDependencies)) {
+        ocppi::runtime::config::types::Mount m;
+        m.type = "bind";
+        m.options = std::vector<std::string>{ "rbind" };
+        m.source = ldCache.entryDir(ldCacheKey).toStdString();
+        m.destination = LdCache::kContainerDir;
+        r.mounts->push_back(m);
+        ldCacheCommand = LdCache::generateCommand();
+    }
+
     env.push_back(("LD_LIBRARY_PATH=" + fixLdLibraryPath.join(":")).toStdString());
     return 0;
 }
 
 auto App::stageHost() -> int
 {
+    LaunchTrace::Span span("stageHost");
     QList<QPair<QString, QString>> roMountMap = {
         { "/etc/resolv.conf", "/run/host/network/etc/resolv.conf" },
         { "/run/resolvconf", "/run/resolvconf" },
@@ -525,6 +595,11 @@ auto App::stageHost() -> int
         { "/var/cache/fontconfig", "/run/host/appearance/fonts-cache" },
     };
 
+    // 使用安装后生成的字体缓存覆盖宿主 /var 中版本不同的缓存，并挂载 runtime 图标主题的缓存
+    FontCache fontCache;
+    const auto runtimeLayerPath = repo->rootOfLayer(package::Ref(runtime->ref));
+    roMountMap.append(fontCache.mounts(runtimeLayerPath));
+
     // bind /dev/nvidia*
     for (auto const &item :
          QDir("/dev").entryInfoList({ "nvidia*" }, QDir::AllEntries | QDir::System)) {
@@ -592,6 +667,7 @@ void App::stateDBusProxyArgs(bool enable, const QString &appId, const QString &p
 // Fix to do 当前仅处理session bus
 auto App::stageDBusProxy(const QString &socketPath, bool useDBusProxy) -> int
 {
+    LaunchTrace::Span span("stageDBusProxy");
     QList<QPair<QString, QString>> mountMap;
     auto userRuntimeDir = QString("/run/user/%1/").arg(getuid());
     if (useDBusProxy) {
@@ -620,6 +696,7 @@ auto App::stageDBusProxy(const QString &socketPath, bool useDBusProxy) -> int
 
 auto App::stageUser(const QString &appId) -> int
 {
+    LaunchTrace::Span span("stageUser");
     QList<QPair<QString, QString>> mountMap;
 
     // bind user data
@@ -849,6 +926,7 @@ auto App::stageUser(const QString &appId) -> int
 
 auto App::stageMount() -> int
 {
+    LaunchTrace::Span span("stageMount");
     bool hasMountTmp = false;
 
     if (permissions && !permissions->mounts.isEmpty()) {
@@ -919,6 +997,7 @@ auto App::mountTmp() -> int
 
 auto App::fixMount(QString runtimeRootPath, const QString &appId) -> int
 {
+    LaunchTrace::Span span("fixMount");
     // 360浏览器需要/apps-data/private/com.360.browser-stable目录可写
     // todo:后续360整改
     // 参考：https://gitlabwh.uniontech.com/wuhan/se/deepin-specifications/-/blob/master/unstable/%E5%BA%94%E7%94%A8%E6%95%B0%E6%8D%AE%E7%9B%AE%E5%BD%95%E8%A7%84%E8%8C%83.md
@@ -1065,12 +1144,11 @@ auto App::loadConfig(linglong::repo::Repo *repo,
                      const QString &appId,
                      const QString &appVersion,
                      const QString &channel,
-                     const QString &module) -> QString
+                     const QString &module,
+                     QStringList *dependencies,
+                     QList<package::Ref> *layers) -> QString
 {
-    util::ensureUserDir({ ".linglong", appId });
-
-    auto configPath =
-      linglong::util::getUserFile(QString("%1/%2/app.yaml").arg(".linglong", appId));
+    LaunchTrace::Span span("loadConfig");
 
     // create yaml form info
     // auto appRoot = LocalRepo::get()->rootOfLatest();
@@ -1108,6 +1186,34 @@ auto App::loadConfig(linglong::repo::Repo *repo,
     }
     QString runtimeFullRef = QString("%1/").arg(channel)
       + runtimeRef.toLocalRefString().append(QString("/%1").arg(module));
+
+    // 生成结果依赖的文件：应用及 runtime 的已安装版本、应用权限、用户目录配置
+    if (dependencies) {
+        const QString layersPath = util::getLinglongRootPath() + "/layers/";
+        *dependencies = QStringList{
+            layersPath + latestAppRef.appId,
+            appInfo,
+            layersPath + runtimeRef.appId,
+            layersPath + runtimeRef.appId + "/" + runtimeRef.version,
+            QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + "/user-dirs.dirs",
+        };
+    }
+    if (layers) {
+        *layers = {
+            package::Ref("",
+                         channel,
+                         latestAppRef.appId,
+                         latestAppRef.version,
+                         latestAppRef.arch,
+                         module),
+            package::Ref("",
+                         channel,
+                         runtimeRef.appId,
+                         runtimeRef.version,
+                         runtimeRef.arch,
+                         module),
+        };
+    }
     QMap<QString, QString> variables = {
         { "APP_REF", appRef },
         { "RUNTIME_REF", runtimeFullRef },
@@ -1176,11 +1282,23 @@ auto App::loadConfig(linglong::repo::Repo *repo,
     }
     templateFile.close();
 
+    return writeUserConfig(appId, templateData + permissionMountsData.toLocal8Bit());
+}
+
+auto App::writeUserConfig(const QString &appId, const QByteArray &config) -> QString
+{
+    util::ensureUserDir({ ".linglong", appId });
+    auto configPath =
+      linglong::util::getUserFile(QString("%1/%2/app.yaml").arg(".linglong", appId));
+
+    // 内容未变化时不重写
     QFile configFile(configPath);
+    if (configFile.open(QIODevice::ReadOnly) && configFile.readAll() == config) {
+        return configPath;
+    }
+    configFile.close();
     configFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
-    configFile.write(templateData);
-    if (!permissionMountsData.isEmpty())
-        configFile.write(permissionMountsData.toLocal8Bit());
+    configFile.write(config);
     configFile.close();
 
     return configPath;
@@ -1194,31 +1312,102 @@ App::App(QObject *parent)
 auto App::load(linglong::repo::Repo *repo, const package::Ref &ref, const QStringList &desktopExec)
   -> QSharedPointer<App>
 {
-    QString configPath = loadConfig(repo, ref.appId, ref.version, ref.channel, ref.module);
-    if (!linglong::util::fileExists(configPath)) {
-        return nullptr;
-    }
+    LaunchTrace::Span span("App::load");
+    // 命中缓存时跳过 app.yaml 的生成、解析及 OCI 配置模板的解析
+    // 原地重新安装同一版本时文件状态可能不变，以 layer 的提交区分
+    LaunchSpecCache cache;
+    const auto latestRef = repo->latestOfRef(ref.appId, ref.version);
+    const auto appCommit = repo->commitOfLayer(package::Ref("",
+                                                            ref.channel,
+                                                            latestRef.appId,
+                                                            latestRef.version,
+                                                            latestRef.arch,
+                                                            ref.module));
+    const auto cacheKey =
+      util::cacheKey({ repo->rootOfLayer(latestRef), ref.channel, ref.module, appCommit });
+    const auto hostDigest = LaunchSpecCache::hostDigest();
+    LaunchSpecCache::Entry entry;
+    QSharedPointer<App> app;
+    if (cache.load(cacheKey, hostDigest, entry) && layerCommitsUnchanged(repo, entry.commits)) {
+        app = QVariant(entry.app).value<QSharedPointer<App>>();
+    }
+
+    const bool cached = !app.isNull();
+    if (cached) {
+        qDebug() << "load app config from launch spec cache" << cache.directory();
+        // 与 loadConfig 的副作用保持一致：创建用户目录并写回 app.yaml
+        writeUserConfig(ref.appId, entry.config);
+    } else {
+        QStringList dependencies;
+        QList<package::Ref> layers;
+        QString configPath = loadConfig(repo,
+                                        ref.appId,
+                                        ref.version,
+                                        ref.channel,
+                                        ref.module,
+                                        &dependencies,
+                                        &layers);
+        if (!linglong::util::fileExists(configPath)) {
+            return nullptr;
+        }
 
-    QFile appConfig(configPath);
-    appConfig.open(QIODevice::ReadOnly);
+        QFile appConfig(configPath);
+        appConfig.open(QIODevice::ReadOnly);
 
-    qDebug() << "load app config yaml from" << configPath;
+        qDebug() << "load app config yaml from" << configPath;
 
-    auto [app, err] = util::fromYAML<QSharedPointer<App>>(appConfig.readAll());
-    if (err) {
-        qCritical() << "FIXME: load config failed, use default app config";
+        const auto config = appConfig.readAll();
+        util::Error err;
+        std::tie(app, err) = util::fromYAML<QSharedPointer<App>>(config);
+        if (err) {
+            qCritical() << "FIXME: load config failed, use default app config";
+        } else {
+            entry = LaunchSpecCache::Entry();
+            entry.dependencies = LaunchSpecCache::dependenciesOf(dependencies);
+            for (const auto &layer : layers) {
+                entry.commits.append(
+                  { layer.toOSTreeRefLocalString(), repo->commitOfLayer(layer) });
+            }
+            entry.hostDigest = hostDigest;
+            entry.app = QVariant::fromValue(app).toMap();
+            entry.config = config;
+        }
     }
 
     qDebug() << "app config" << app << app->runtime << app->package << app->version;
     // TODO: maybe set as an arg of init is better
     app->desktopExec = desktopExec;
     app->repo = repo;
-    app->init();
+    app->init(entry.oci);
+
+    if (!cached && !entry.app.isEmpty()) {
+        auto spec = nlohmann::json::to_cbor(toJSON(app->r));
+        entry.oci = QByteArray(reinterpret_cast<const char *>(spec.data()),
+                               static_cast<int>(spec.size()));
+        cache.store(cacheKey, entry);
+    }
 
     return app;
 }
 
 auto App::start() -> util::Error
+{
+    auto err = launch();
+    if (err) {
+        return err;
+    }
+
+    // FIXME: need keep interactive shell
+    auto pid = waitpid(static_cast<pid_t>(container->pid), nullptr, 0);
+    release();
+    // FIXME: 删除代理socket临时文件
+    // FIXME: 清理资源，包括挂载的VFS等
+    qDebug() << "child" << pid << "finish";
+
+    return Success();
+}
+
+auto App::launch() -> util::Error
 {
     r.root->path = container->workingDirectory.toStdString() + "/root";
     util::ensureDir(r.root->path.c_str());
@@ -1232,52 +1421,72 @@ auto App::start() -> util::Error
 
     qDebug() << "start container at" << r.root->path.c_str();
 
+    LaunchTrace::Span serializeSpan("serialize OCI config");
     auto runtimeConfigJSON = toJSON(r);
 
     auto data = runtimeConfigJSON.dump();
-
-    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets) != 0) {
-        return WrapError(NewError(errno, strerror(errno)), "call socketpair failed");
+    serializeSpan.end();
+
+    LaunchTrace::Span boxSpan("fork ll-box");
+    // 优先使用预先启动的 ll-box，池为空或未启用时现场启动
+    BoxPool::Box box;
+    if (boxPool ? !boxPool->acquire(box) : !BoxPool::spawn(BoxPool::kDefaultProgram, box)) {
+        return NewError(-1, "start ll-box failed");
+    }
+    sockets[0] = -1;
+    sockets[1] = box.socket;
+    pid_t boxPid = box.pid;
+
+    qDebug() << "ll-box" << boxPid << "started";
+    // FIXME: handle error
+    (void)write(sockets[1], data.c_str(), data.size());
+    (void)write(sockets[1], "\0", 1); // each data write into sockets should end with '\0'
+    container->pid = boxPid;
+    boxSpan.end();
+
+    // 追踪时等待应用进程出现，记录从 ll-box 启动到执行应用的耗时
+    if (auto *trace = LaunchTrace::current()) {
+        LaunchTrace::Span execSpan("ll-box exec app");
+        if (!LaunchTrace::waitForExec(boxPid, kTraceExecTimeoutMsec)) {
+            qWarning() << "launch trace: app process not found in ll-box" << boxPid;
+        }
+        execSpan.end();
+        trace->finish();
     }
 
-    pid_t parent = getpid();
-
-    pid_t boxPid = fork();
-    if (boxPid < 0) {
-        return WrapError(NewError(errno, strerror(errno)), "fork failed");
+    // 应用启动后在容器内生成 ld.so.cache，供下次启动使用
+    if (!ldCacheCommand.isEmpty()) {
+        if (auto err = exec(ldCacheCommand, {}, "/")) {
+            qWarning() << "generate ld.so.cache failed" << err;
+        }
+        ldCacheCommand.clear();
     }
 
-    if (0 == boxPid) {
-        // child process
-        qDebug() << "start ll-box in child process";
-        prctl(PR_SET_PDEATHSIG, SIGKILL);
-        if (getppid() != parent) {
-            raise(SIGKILL);
-        }
-        (void)close(sockets[1]);
-        auto socket = std::to_string(sockets[0]);
-        char const *const args[] = { "ll-box", socket.c_str(), nullptr };
-        auto ret = execvp(args[0], (char **)args);
-        exit(ret);
-    } else {
-        qDebug() << "wait child" << boxPid << "in parent";
-        close(sockets[0]);
-        // FIXME: handle error
-        (void)write(sockets[1], data.c_str(), data.size());
-        (void)write(sockets[1], "\0", 1); // each data write into sockets should end with '\0'
-        container->pid = boxPid;
-        // FIXME: need keep interactive shell
-        auto pid = waitpid(boxPid, nullptr, 0);
+    return Success();
+}
+
+void App::release()
+{
+    QMutexLocker locker(&execMutex);
+    namespaceExec.reset();
+    if (sockets[1] >= 0) {
         close(sockets[1]);
-        // FIXME: 删除代理socket临时文件
-        // FIXME: 清理资源，包括挂载的VFS等
-        qDebug() << "child" << pid << "finish";
+        sockets[1] = -1;
     }
+}
 
-    return Success();
+void App::setBoxPool(BoxPool *pool)
+{
+    boxPool = pool;
+}
+
+QStringList App::layerRoots() const
+{
+    return { repo->rootOfLayer(package::Ref(package->ref)),
+             repo->rootOfLayer(package::Ref(runtime->ref)) };
 }
 
-void App::exec(const QStringList &cmd, const QStringList &env, QString cwd)
+auto App::exec(const QStringList &cmd, const QStringList &env, QString cwd) -> util::Error
 {
     ocppi::runtime::config::types::Process p;
     p.env = r.process->env;
@@ -1304,25 +1513,22 @@ void App::exec(const QStringList &cmd, const QStringList &env, QString cwd)
           QStringList{ appRootPath, "entries", "applications" }.join(QDir::separator()));
         auto desktopFilenameList = applicationsDir.entryList({ "*.desktop" }, QDir::Files);
         if (desktopFilenameList.length() <= 0) {
-            return;
+            return NewError(-1, "no desktop file in " + applicationsDir.path());
         }
 
         const auto &desktopEntry = utils::xdg::DesktopEntry::New(
           applicationsDir.absoluteFilePath(desktopFilenameList.value(0)));
         if (!desktopEntry.has_value()) {
-            // FIXME(black_desk): return error instead of logging here.
-            qCritical() << "DesktopEntry file path:"
-                        << applicationsDir.absoluteFilePath(desktopFilenameList.value(0));
             qCritical().noquote() << desktopEntry.error().code() << desktopEntry.error().message();
-            return;
+            return NewError(-1,
+                            "invalid desktop file "
+                              + applicationsDir.absoluteFilePath(desktopFilenameList.value(0)));
         }
 
         const auto &exec = desktopEntry->getValue<QString>("Exec");
         if (!exec.has_value()) {
-            // FIXME(black_desk): return error instead of logging here.
-            qCritical() << "Broken desktop file without Exec in main section.";
             qCritical().noquote() << exec.error().code() << exec.error().message();
-            return;
+            return NewError(-1, "broken desktop file without Exec in main section");
         }
 
         const auto &parsedExec = util::parseExec(*exec);
@@ -1341,7 +1547,7 @@ void App::exec(const QStringList &cmd, const QStringList &env, QString cwd)
     }
 
     if (cmd.isEmpty()) {
-        return;
+        return NewError(-1, "no command to exec");
     }
 
     auto args = std::vector<std::string>{};
@@ -1351,19 +1557,42 @@ void App::exec(const QStringList &cmd, const QStringList &env, QString cwd)
 
     qDebug() << "exec" << *r.process->args;
 
+    QMutexLocker locker(&execMutex);
+    // 尚未启动或 ll-box 已退出
+    if (sockets[1] < 0) {
+        return NewError(-1, "container " + container->id + " is not running");
+    }
+
+    // 直接加入容器的命名空间并按容器配置设置限制后启动进程，失败时再交由 ll-box 启动
+    if (!namespaceExec && container->pid > 0) {
+        auto initPid = NamespaceExec::findInit(static_cast<pid_t>(container->pid));
+        if (initPid > 0) {
+            namespaceExec = std::make_unique<NamespaceExec>(initPid, toJSON(r));
+        }
+    }
+    if (namespaceExec && namespaceExec->isValid()
+        && namespaceExec->spawn(args, p.env.value_or(std::vector<std::string>{}), p.cwd)) {
+        return Success();
+    }
+
     p.args = args;
     auto processJSON = toJSON(p);
     auto data = processJSON.dump();
 
-    // FIXME: retry on temporary fail
-    // FIXME: add lock
-    int sizeOfData = data.size();
-    while (sizeOfData) {
-        auto sizeOfWrite = write(sockets[1], data.c_str(), sizeOfData);
-        sizeOfData = sizeOfData - sizeOfWrite;
-        data = data.erase(0, sizeOfWrite);
+    // 每条数据以 '\0' 结尾
+    data.push_back('\0');
+    size_t written = 0;
+    while (written < data.size()) {
+        auto ret = write(sockets[1], data.c_str() + written, data.size() - written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NewError(-1, QString("write to ll-box failed: %1").arg(strerror(errno)));
+        }
+        written += ret;
     }
-    write(sockets[1], "\0", 1);
+    return Success();
 }
 
 void App::saveUserEnvList(const QStringList &userEnvList)
@@ -15,6 +15,10 @@
 #include "linglong/util/file.h"
 #include "ocppi/runtime/config/types/Config.hpp"
 
+#include <QMutex>
+
+#include <memory>
+
 namespace linglong::repo {
 class Repo;
 } // namespace linglong::repo
@@ -63,6 +67,9 @@ Q_JSON_DECLARE_PTR_METATYPE_NM(linglong::runtime, AppPermission)
 
 namespace linglong::runtime {
 
+class BoxPool;
+class NamespaceExec;
+
 class App : public JsonSerialize
 {
     Q_OBJECT;
@@ -81,18 +88,61 @@ public:
                      const linglong::package::Ref &ref,
                      const QStringList &desktopExec) -> QSharedPointer<App>;
 
+    /*
+     * 启动容器并等待 ll-box 退出
+     *
+     * @return util::Error: 启动失败时的错误
+     */
     auto start() -> util::Error;
 
-    void exec(const QStringList &cmd, const QStringList &env, QString cwd);
+    /*
+     * 启动容器，ll-box 收到配置后立即返回，由调用方回收 ll-box 进程并调用 release
+     *
+     * @return util::Error: 启动失败时的错误
+     */
+    auto launch() -> util::Error;
+
+    /*
+     * ll-box 退出后关闭与其通信的 socket
+     */
+    void release();
+
+    /*
+     * 在已启动的容器中运行命令，cmd 为空时运行 desktop 文件中的命令
+     *
+     * @return util::Error: 容器未启动、已退出或命令无法发送给 ll-box 时的错误
+     */
+    auto exec(const QStringList &cmd, const QStringList &env, QString cwd) -> util::Error;
 
     void saveUserEnvList(const QStringList &userEnvList);
 
     void setAppParamMap(const ParamStringMap &paramMap);
 
+    /*
+     * 设置预先启动的 ll-box 进程池，未设置时每次启动都会 fork 新的 ll-box
+     *
+     * @param pool: ll-box 进程池，生命周期需长于 start 调用
+     */
+    void setBoxPool(BoxPool *pool);
+
+    /*
+     * 应用及 runtime 在宿主上的 layer 目录
+     *
+     * @return QStringList: 应用、runtime 的 layer 目录
+     */
+    QStringList layerRoots() const;
+
     QSharedPointer<Container> container = nullptr;
 
 private:
-    auto init() -> bool;
+    /*
+     * 加载 OCI 配置模板并创建容器
+     *
+     * @param cachedSpec: 缓存的 OCI 配置模板（CBOR 编码），为空或无效时解析内置模板
+     *
+     * @return bool: true:成功 false:失败
+     */
+    auto init(const QByteArray &cachedSpec = QByteArray()) -> bool;
 
     auto prepare() -> int;
 
@@ -125,7 +175,12 @@ private:
                            const QString &appId,
                            const QString &appVersion,
                            const QString &channel,
-                           const QString &module) -> QString;
+                           const QString &module,
+                           QStringList *dependencies = nullptr,
+                           QList<package::Ref> *layers = nullptr) -> QString;
+
+    // 创建应用的用户目录并写入 app.yaml，返回 app.yaml 路径
+    static auto writeUserConfig(const QString &appId, const QByteArray &config) -> QString;
 
     static auto toJSON(const ocppi::runtime::config::types::Config &) -> nlohmann::json;
     static auto toJSON(const ocppi::runtime::config::types::Process &) -> nlohmann::json;
@@ -138,7 +193,14 @@ private:
     QSharedPointer<AppConfig> appConfig = nullptr;
 
     repo::Repo *repo = nullptr;
-    int sockets[2]; // save file describers of sockets used to communicate with ll-box
+    BoxPool *boxPool = nullptr;
+    // 启动后在容器内生成 ld.so.cache 的命令，缓存可用时为空
+    QStringList ldCacheCommand;
+    // 保护 sockets[1] 的写入及 namespaceExec 的创建，exec 可能在多个线程中同时调用
+    QMutex execMutex;
+    // 容器内 init 进程的命名空间，首次 exec 时打开
+    std::unique_ptr<NamespaceExec> namespaceExec;
+    int sockets[2] = { -1, -1 }; // save file describers of sockets used to communicate with ll-box
 
     const QString sysLinglongInstalltions = util::getLinglongRootPath() + "/entries/share";
 };
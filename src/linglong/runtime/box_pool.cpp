@@ -0,0 +1,177 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "box_pool.h"
+
+#include <QDebug>
+#include <QThread>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace linglong::runtime {
+
+BoxPool::BoxPool(int size, const QString &program, QObject *parent)
+    : QObject(parent)
+    , boxProgram(program)
+    , poolSize(qMax(0, size))
+{
+    // 不阻塞服务启动
+    QMetaObject::invokeMethod(this, &BoxPool::refill, Qt::QueuedConnection);
+}
+
+BoxPool::~BoxPool()
+{
+    QList<Box> boxes;
+    {
+        QMutexLocker locker(&mutex);
+        boxes.swap(idle);
+    }
+    for (const auto &box : boxes) {
+        release(box);
+    }
+}
+
+bool BoxPool::spawn(const QString &program, Box &box)
+{
+    int sockets[2];
+    // 父进程一端带 CLOEXEC，避免被其它同时启动的 ll-box 继承
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sockets) != 0) {
+        qCritical() << "socketpair failed:" << strerror(errno);
+        return false;
+    }
+
+    const auto programPath = program.toStdString();
+    const auto socket = std::to_string(sockets[0]);
+    const pid_t parent = getpid();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        qCritical() << "fork failed:" << strerror(errno);
+        close(sockets[0]);
+        close(sockets[1]);
+        return false;
+    }
+
+    if (0 == pid) {
+        // child process
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent) {
+            raise(SIGKILL);
+        }
+        (void)close(sockets[1]);
+        // ll-box 一端需要跨 exec 保留
+        (void)fcntl(sockets[0], F_SETFD, 0);
+        char const *const args[] = { programPath.c_str(), socket.c_str(), nullptr };
+        auto ret = execvp(args[0], const_cast<char **>(args));
+        _exit(ret);
+    }
+
+    close(sockets[0]);
+    box.pid = pid;
+    box.socket = sockets[1];
+    return true;
+}
+
+bool BoxPool::take(Box &box)
+{
+    bool found = false;
+    {
+        QMutexLocker locker(&mutex);
+        while (!idle.isEmpty()) {
+            auto candidate = idle.takeFirst();
+            // 空闲期间退出的进程（例如 ll-box 不存在或被杀死）直接回收
+            if (waitpid(candidate.pid, nullptr, WNOHANG) != 0) {
+                close(candidate.socket);
+                continue;
+            }
+            box = candidate;
+            found = true;
+            break;
+        }
+    }
+    QMetaObject::invokeMethod(this, &BoxPool::refill, Qt::QueuedConnection);
+    return found;
+}
+
+bool BoxPool::acquire(Box &box)
+{
+    if (take(box)) {
+        return true;
+    }
+
+    if (QThread::currentThread() == thread()) {
+        return spawn(boxProgram, box);
+    }
+
+    bool ok = false;
+    QMetaObject::invokeMethod(
+      this,
+      [this, &box, &ok]() {
+          ok = spawn(boxProgram, box);
+      },
+      Qt::BlockingQueuedConnection);
+    return ok;
+}
+
+void BoxPool::setSize(int size)
+{
+    QList<Box> surplus;
+    {
+        QMutexLocker locker(&mutex);
+        poolSize = qMax(0, size);
+        while (idle.size() > poolSize) {
+            surplus.append(idle.takeLast());
+        }
+    }
+    for (const auto &box : surplus) {
+        release(box);
+    }
+    QMetaObject::invokeMethod(this, &BoxPool::refill, Qt::QueuedConnection);
+}
+
+int BoxPool::size() const
+{
+    QMutexLocker locker(&mutex);
+    return poolSize;
+}
+
+int BoxPool::idleCount() const
+{
+    QMutexLocker locker(&mutex);
+    return idle.size();
+}
+
+void BoxPool::refill()
+{
+    QMutexLocker locker(&mutex);
+    while (idle.size() < poolSize) {
+        Box box;
+        if (!spawn(boxProgram, box)) {
+            qWarning() << "prespawn" << boxProgram << "failed";
+            return;
+        }
+        idle.append(box);
+    }
+}
+
+void BoxPool::release(const Box &box)
+{
+    // 关闭 socket 后 ll-box 读到 EOF 退出，再以 SIGKILL 兜底
+    close(box.socket);
+    kill(box.pid, SIGKILL);
+    waitpid(box.pid, nullptr, 0);
+}
+
+} // namespace linglong::runtime
@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_BOX_POOL_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_BOX_POOL_H_
+
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+
+#include <sys/types.h>
+
+namespace linglong::runtime {
+
+/**
+ * @brief 预先启动的 ll-box 进程池
+ * @details ll-box 启动后阻塞在 socket 上等待容器配置。池中保持若干已 exec 完成的 ll-box，
+ *          启动应用时取出一个写入配置即可直接进入命名空间的创建，省去 fork、exec 及动态链接的耗时。
+ *          进程由池所在线程（主线程）创建，避免 PR_SET_PDEATHSIG 随线程池中的线程退出而触发
+ */
+class BoxPool : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr auto kDefaultProgram = "ll-box";
+
+    struct Box
+    {
+        pid_t pid = -1;
+        // 与 ll-box 通信的 socket，写入以 '\0' 结尾的配置
+        int socket = -1;
+    };
+
+    /**
+     * @param size 池中保持的空闲进程数，0 表示不预先启动
+     * @param program ll-box 程序路径
+     */
+    explicit BoxPool(int size, const QString &program = kDefaultProgram, QObject *parent = nullptr);
+    ~BoxPool() override;
+
+    /**
+     * @brief 启动一个新的 ll-box 进程，可在任意线程调用
+     *
+     * @param program ll-box 程序路径
+     * @param box 进程号及 socket
+     *
+     * @return bool true:成功 false:失败
+     */
+    static bool spawn(const QString &program, Box &box);
+
+    /**
+     * @brief 取出一个空闲的 ll-box 并在主线程中补充，可在任意线程调用
+     *
+     * @param box 进程号及 socket
+     *
+     * @return bool true:取到空闲进程 false:池为空，调用方需要自行 spawn
+     */
+    bool take(Box &box);
+
+    /**
+     * @brief 取出一个空闲的 ll-box，池为空时在池所在线程中启动新的进程，可在任意线程调用
+     * @details 启动应用的线程在应用运行期间不会保留，由其 fork 的进程会随线程退出收到 PDEATHSIG
+     *
+     * @param box 进程号及 socket
+     *
+     * @return bool true:成功 false:失败
+     */
+    bool acquire(Box &box);
+
+    void setSize(int size);
+    int size() const;
+    int idleCount() const;
+    QString program() const { return boxProgram; }
+
+public Q_SLOTS:
+    /**
+     * @brief 补充空闲进程至设定数量
+     */
+    void refill();
+
+private:
+    static void release(const Box &box);
+
+    QString boxProgram;
+
+    mutable QMutex mutex;
+    int poolSize = 0;
+    QList<Box> idle;
+};
+
+} // namespace linglong::runtime
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "container_reaper.h"
+
+#include <QDebug>
+#include <QSocketNotifier>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace linglong::runtime {
+
+namespace {
+// 所有架构上 pidfd_open 的系统调用号相同，旧版本头文件中没有定义
+#ifdef SYS_pidfd_open
+const long kSysPidfdOpen = SYS_pidfd_open;
+#else
+const long kSysPidfdOpen = 434;
+#endif
+
+int pidfdOpen(pid_t pid)
+{
+    return static_cast<int>(syscall(kSysPidfdOpen, pid, 0));
+}
+} // namespace
+
+ContainerReaper::ContainerReaper(QObject *parent)
+    : QObject(parent)
+{
+    pollTimer.setInterval(kPollIntervalMsec);
+    connect(&pollTimer, &QTimer::timeout, this, &ContainerReaper::pollAll);
+}
+
+ContainerReaper::~ContainerReaper()
+{
+    for (auto &item : watched) {
+        delete item.notifier;
+        if (item.pidfd >= 0) {
+            close(item.pidfd);
+        }
+    }
+}
+
+void ContainerReaper::watch(const QString &id, pid_t pid)
+{
+    QMetaObject::invokeMethod(
+      this,
+      [this, id, pid]() {
+          add(id, pid);
+      },
+      Qt::QueuedConnection);
+}
+
+int ContainerReaper::count() const
+{
+    return watched.size();
+}
+
+void ContainerReaper::add(const QString &id, pid_t pid)
+{
+    Watched item;
+    item.id = id;
+    // 进程已退出但尚未回收时 pidfd 仍可打开，且立即可读
+    item.pidfd = pidfdOpen(pid);
+    if (item.pidfd >= 0) {
+        item.notifier = new QSocketNotifier(item.pidfd, QSocketNotifier::Read, this);
+        connect(item.notifier, &QSocketNotifier::activated, this, [this, pid]() {
+            tryReap(pid);
+        });
+    } else {
+        qWarning() << "pidfd_open" << pid << "failed:" << strerror(errno) << ", poll instead";
+        if (!pollTimer.isActive()) {
+            pollTimer.start();
+        }
+    }
+    watched.insert(pid, item);
+    Q_EMIT containerStarted(id, pid);
+
+    tryReap(pid);
+}
+
+bool ContainerReaper::tryReap(pid_t pid)
+{
+    auto it = watched.find(pid);
+    if (it == watched.end()) {
+        return false;
+    }
+
+    int status = 0;
+    auto ret = waitpid(pid, &status, WNOHANG);
+    if (ret == 0) {
+        return false;
+    }
+    if (ret < 0) {
+        // 已被其它调用回收，无法获取退出状态
+        qWarning() << "waitpid" << pid << "failed:" << strerror(errno);
+        status = -1;
+    }
+
+    auto item = it.value();
+    watched.erase(it);
+    if (item.notifier) {
+        item.notifier->setEnabled(false);
+        item.notifier->deleteLater();
+    }
+    if (item.pidfd >= 0) {
+        close(item.pidfd);
+    }
+
+    qDebug() << "container" << item.id << "pid" << pid << "exited with" << status;
+    Q_EMIT containerExited(item.id, pid, status);
+    return true;
+}
+
+void ContainerReaper::pollAll()
+{
+    bool polling = false;
+    for (auto pid : watched.keys()) {
+        if (watched.value(pid).pidfd >= 0) {
+            continue;
+        }
+        if (!tryReap(pid)) {
+            polling = true;
+        }
+    }
+    if (!polling) {
+        pollTimer.stop();
+    }
+}
+
+} // namespace linglong::runtime
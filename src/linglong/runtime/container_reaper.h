@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_CONTAINER_REAPER_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_CONTAINER_REAPER_H_
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <sys/types.h>
+
+class QSocketNotifier;
+
+namespace linglong::runtime {
+
+/**
+ * @brief 在事件循环中回收 ll-box 子进程
+ * @details 通过 pidfd 监听子进程退出，不再为每个运行中的应用占用一个阻塞在 waitpid 上的线程。
+ *          内核不支持 pidfd_open 时退化为定时 waitpid(WNOHANG) 轮询。
+ *          watch 可在任意线程调用，监听及信号均在对象所属线程（主线程）中进行
+ */
+class ContainerReaper : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int kPollIntervalMsec = 1000;
+
+    explicit ContainerReaper(QObject *parent = nullptr);
+    ~ContainerReaper() override;
+
+    /**
+     * @brief 开始监听容器进程
+     *
+     * @param id 容器 id
+     * @param pid ll-box 进程号，需为本进程的子进程
+     */
+    void watch(const QString &id, pid_t pid);
+
+    /**
+     * @brief 正在监听的容器数量
+     */
+    int count() const;
+
+Q_SIGNALS:
+    /**
+     * @brief 开始监听容器
+     */
+    void containerStarted(const QString &id, qint64 pid);
+
+    /**
+     * @brief 容器进程退出并已回收
+     *
+     * @param status waitpid 返回的状态
+     */
+    void containerExited(const QString &id, qint64 pid, int status);
+
+private:
+    struct Watched
+    {
+        QString id;
+        int pidfd = -1;
+        QSocketNotifier *notifier = nullptr;
+    };
+
+    void add(const QString &id, pid_t pid);
+    // 回收已退出的进程，返回是否已回收
+    bool tryReap(pid_t pid);
+    void pollAll();
+
+    QHash<pid_t, Watched> watched;
+    QTimer pollTimer;
+};
+
+} // namespace linglong::runtime
+
+#endif
@@ -0,0 +1,531 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "font_cache.h"
+
+#include "linglong/package/info.h"
+#include "linglong/runtime/box_pool.h"
+#include "linglong/util/file.h"
+#include "linglong/util/qserializer/json.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThread>
+#include <QUuid>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <string>
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace linglong::runtime {
+
+namespace {
+const auto kStampFileName = ".linglong-fonts";
+// 最近一次检查时宿主字体的摘要，由 update 写入
+const auto kHostDigestFileName = ".host-fonts";
+const int kBuildTimeoutMsec = 1000 * 60 * 5;
+const int kPollIntervalMsec = 100;
+
+QString readStamp(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromLatin1(file.readAll().trimmed());
+}
+
+bool writeStamp(const QString &path, const QString &digest)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(digest.toLatin1());
+    return file.commit();
+}
+
+// ll-box 的 socket 为非阻塞
+bool writeAll(int fd, const std::string &data)
+{
+    size_t written = 0;
+    while (written < data.size()) {
+        auto ret = write(fd, data.data() + written, data.size() - written);
+        if (ret >= 0) {
+            written += ret;
+            continue;
+        }
+        if (errno == EAGAIN) {
+            pollfd pfd = { fd, POLLOUT, 0 };
+            (void)poll(&pfd, 1, kPollIntervalMsec);
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 按原目录结构重建目录，文件硬链接到原文件，符号链接按原内容复制
+bool linkTree(const QString &source, const QString &target)
+{
+    if (!QDir().mkpath(target)) {
+        return false;
+    }
+    QDirIterator it(source,
+                    QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const auto path = it.next();
+        const auto info = it.fileInfo();
+        const auto dest = QFile::encodeName(target + path.mid(source.size()));
+        if (info.isSymLink()) {
+            // 主题内的相对链接在容器内同样有效，不能使用解析后的绝对路径
+            char link[PATH_MAX];
+            auto len = readlink(QFile::encodeName(path).constData(), link, sizeof(link) - 1);
+            if (len < 0 || symlink(std::string(link, len).c_str(), dest.constData()) != 0) {
+                return false;
+            }
+        } else if (info.isDir()) {
+            if (mkdir(dest.constData(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+        } else if (::link(QFile::encodeName(path).constData(), dest.constData()) != 0) {
+            qWarning() << "link" << path << "failed:" << strerror(errno);
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+FontCache::FontCache(const QString &dir, const QStringList &fontDirs)
+    : dir(dir)
+    , fontDirs(fontDirs)
+{
+    if (this->dir.isEmpty()) {
+        this->dir = util::getLinglongRootPath() + "/caches/fontconfig";
+    }
+    if (this->fontDirs.isEmpty()) {
+        this->fontDirs = QStringList{ "/usr/share/fonts", "/usr/local/share/fonts" };
+    }
+}
+
+QString FontCache::baseLayerPath(const QString &layerPath)
+{
+    const auto path = QDir::cleanPath(layerPath);
+    const QFileInfo info(path);
+    if (info.fileName() == "devel" && util::fileExists(info.path() + "/info.json")) {
+        return info.path();
+    }
+    return path;
+}
+
+QString FontCache::filesPath(const QString &layerPath)
+{
+    auto files = baseLayerPath(layerPath) + "/files";
+    return util::dirExists(files) ? files : baseLayerPath(layerPath);
+}
+
+bool FontCache::hasFontconfig(const QString &layerPath)
+{
+    return QFileInfo(filesPath(layerPath) + "/bin/fc-cache").isExecutable();
+}
+
+QStringList FontCache::iconThemes(const QString &layerPath)
+{
+    QStringList themes;
+    const auto icons = filesPath(layerPath) + "/share/icons";
+    for (const auto &theme : QDir(icons).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        const auto themeDir = icons + "/" + theme;
+        if (!util::fileExists(themeDir + "/index.theme")) {
+            continue;
+        }
+        // GTK、Qt 只使用不比主题目录旧的缓存；ostree 签出的文件修改时间为 0，runtime 自带的
+        // 缓存通常因此失效
+        const QFileInfo cache(themeDir + "/icon-theme.cache");
+        if (cache.exists() && cache.lastModified() >= QFileInfo(themeDir).lastModified()) {
+            continue;
+        }
+        themes.append(theme);
+    }
+    return themes;
+}
+
+QString FontCache::iconCacheProgram(const QString &layerPath)
+{
+    if (QFileInfo(filesPath(layerPath) + "/bin/gtk-update-icon-cache").isExecutable()) {
+        return "/runtime/bin/gtk-update-icon-cache";
+    }
+    // 缓存格式与 GTK 版本无关，容器内挂载了宿主的 /usr
+    if (QFileInfo("/usr/bin/gtk-update-icon-cache").isExecutable()) {
+        return "/usr/bin/gtk-update-icon-cache";
+    }
+    return QString();
+}
+
+bool FontCache::isCacheable(const QString &layerPath)
+{
+    return hasFontconfig(layerPath)
+      || (!iconCacheProgram(layerPath).isEmpty() && !iconThemes(layerPath).isEmpty());
+}
+
+QString FontCache::cacheDir(const QString &layerPath) const
+{
+    return dir + "/" + util::cacheKey({ baseLayerPath(layerPath) });
+}
+
+QString FontCache::fontsDigest() const
+{
+    // fontconfig 根据各字体目录的修改时间判断缓存是否有效，这里使用相同的依据
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const auto &fontDir : fontDirs) {
+        QStringList dirs{ fontDir };
+        QDirIterator it(fontDir, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            dirs.append(it.next());
+        }
+        dirs.sort();
+        for (const auto &path : dirs) {
+            hash.addData((path + "=" + util::fileStamp(path) + "\n").toUtf8());
+        }
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString FontCache::stampOf(const QString &layerPath, const QString &digest)
+{
+    // 同一版本原地重新安装后主题目录中的文件可能变化
+    return digest + "@" + util::fileStamp(baseLayerPath(layerPath) + "/info.json");
+}
+
+bool FontCache::isUpToDate(const QString &layerPath) const
+{
+    const auto digest = readStamp(dir + "/" + kHostDigestFileName);
+    return !digest.isEmpty()
+      && readStamp(cacheDir(layerPath) + "/" + kStampFileName) == stampOf(layerPath, digest);
+}
+
+QList<QPair<QString, QString>> FontCache::mounts(const QString &layerPath) const
+{
+    QList<QPair<QString, QString>> result;
+    if (!isUpToDate(layerPath)) {
+        return result;
+    }
+    const auto cache = cacheDir(layerPath);
+    if (util::dirExists(cache + "/fonts")) {
+        result.append({ cache + "/fonts", kContainerDir });
+    }
+    for (const auto &theme : QDir(cache + "/icons").entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        result.append({ cache + "/icons/" + theme, QString(kIconsDir) + "/" + theme });
+    }
+    return result;
+}
+
+nlohmann::json FontCache::containerConfig(const QString &layerPath,
+                                          const QString &workDir,
+                                          const QString &buildDir,
+                                          const QStringList &args) const
+{
+    nlohmann::json config;
+    QFile templateFile(":/config.json");
+    if (templateFile.open(QIODevice::ReadOnly)) {
+        config = nlohmann::json::parse(templateFile.readAll().toStdString(), nullptr, false);
+    }
+    if (!config.is_object()) {
+        config = nlohmann::json::object();
+    }
+
+    // 与应用容器相同，宿主 /usr、/etc 及 runtime 的 files 目录只读挂载
+    const auto files = filesPath(layerPath);
+    QList<QPair<QString, QString>> mounts = {
+        { "/usr", "/usr" },
+        { "/etc", "/etc" },
+        { files, "/runtime" },
+    };
+    for (const auto &fontDir : fontDirs) {
+        if (util::dirExists(fontDir)) {
+            mounts.append({ fontDir, fontDir });
+        }
+    }
+    auto &nativeMounts = config["annotations"]["native"]["mounts"];
+    nativeMounts = nlohmann::json::array();
+    for (const auto &mount : mounts) {
+        nativeMounts.push_back({ { "type", "bind" },
+                                 { "options", nlohmann::json::array_t{ "ro", "rbind" } },
+                                 { "source", mount.first.toStdString() },
+                                 { "destination", mount.second.toStdString() } });
+    }
+    nativeMounts.push_back({ { "type", "bind" },
+                             { "options", nlohmann::json::array_t{ "rw", "rbind" } },
+                             { "source", buildDir.toStdString() },
+                             { "destination", kContainerDir } });
+    config["annotations"]["containerRootPath"] = workDir.toStdString();
+    config["annotations"]["dbusProxyInfo"] = nullptr;
+    config["root"]["path"] = (workDir + "/root").toStdString();
+
+    // 以当前用户身份运行，不继承 ll-package-manager 的其它权限
+    auto idMapping = [](unsigned int hostID) {
+        return nlohmann::json::array_t{
+            { { "hostID", hostID }, { "containerID", 0 }, { "size", 1 } },
+        };
+    };
+    config["linux"]["uidMappings"] = idMapping(getuid());
+    config["linux"]["gidMappings"] = idMapping(getgid());
+
+    auto &process = config["process"];
+    process["args"] = nlohmann::json::array();
+    for (const auto &arg : args) {
+        process["args"].push_back(arg.toStdString());
+    }
+    process["cwd"] = "/";
+    process["env"] = nlohmann::json::array_t{
+        "PATH=/runtime/bin:/usr/bin:/bin",
+        (QString("FONTCONFIG_FILE=%1/fonts/fonts.conf").arg(kContainerDir)).toStdString(),
+    };
+    // 容器内 /usr 来自宿主，runtime 的程序使用 /runtime/lib 中的库，宿主的程序不受影响
+    if (args.value(0).startsWith("/runtime/")) {
+        QStringList libraryPath{ "/runtime/lib" };
+        for (const auto &entry : QDir(files + "/lib").entryList({ "*-linux-gnu*" }, QDir::Dirs)) {
+            libraryPath.append("/runtime/lib/" + entry);
+        }
+        process["env"].push_back(("LD_LIBRARY_PATH=" + libraryPath.join(":")).toStdString());
+    }
+    return config;
+}
+
+bool FontCache::runInContainer(const QString &layerPath,
+                               const QString &buildDir,
+                               const QStringList &args,
+                               const std::function<bool()> &cancelled) const
+{
+    const auto workDir = buildDir + ".box";
+    if (!QDir().mkpath(workDir + "/root")) {
+        return false;
+    }
+    auto cleanup = [&workDir]() {
+        util::removeDir(workDir);
+    };
+
+    BoxPool::Box box;
+    if (!BoxPool::spawn(BoxPool::kDefaultProgram, box)) {
+        cleanup();
+        return false;
+    }
+    // 每条数据以 '\0' 结尾
+    auto data = containerConfig(layerPath, workDir, buildDir, args).dump();
+    data.push_back('\0');
+    if (!writeAll(box.socket, data)) {
+        qWarning() << "send" << args.value(0) << "container config failed:" << strerror(errno);
+        BoxPool::release(box);
+        cleanup();
+        return false;
+    }
+
+    // 容器内的命令退出后 ll-box 随之退出
+    bool exited = false;
+    for (int waited = 0; waited < kBuildTimeoutMsec; waited += kPollIntervalMsec) {
+        if (cancelled && cancelled()) {
+            break;
+        }
+        auto ret = waitpid(box.pid, nullptr, WNOHANG);
+        if (ret == box.pid || (ret < 0 && errno == ECHILD)) {
+            exited = true;
+            break;
+        }
+        QThread::msleep(kPollIntervalMsec);
+    }
+    if (exited) {
+        close(box.socket);
+    } else {
+        qWarning() << args.value(0) << "for" << layerPath << "timed out or cancelled";
+        BoxPool::release(box);
+    }
+    cleanup();
+    return exited;
+}
+
+bool FontCache::build(const QString &layerPath,
+                      const QString &digest,
+                      const std::function<bool()> &cancelled) const
+{
+    if (!isCacheable(layerPath)) {
+        return false;
+    }
+
+    // 生成在临时目录中，完成后替换，避免容器挂载到生成了一半的缓存
+    const auto target = cacheDir(layerPath);
+    const auto building = target + ".building-" + QUuid::createUuid().toString(QUuid::Id128);
+    if (!QDir().mkpath(building)) {
+        return false;
+    }
+
+    if (hasFontconfig(layerPath) && !buildFonts(layerPath, building, cancelled)) {
+        qWarning() << "fc-cache of" << layerPath << "failed";
+        util::removeDir(building);
+        return false;
+    }
+    buildIcons(layerPath, building, cancelled);
+
+    if ((cancelled && cancelled())
+        || !writeStamp(building + "/" + kStampFileName, stampOf(layerPath, digest))) {
+        util::removeDir(building);
+        return false;
+    }
+
+    // 已挂载旧缓存的容器持有原目录，不受替换影响
+    const auto old = target + ".old-" + QUuid::createUuid().toString(QUuid::Id128);
+    if (QFileInfo::exists(target) && !QDir().rename(target, old)) {
+        util::removeDir(building);
+        return false;
+    }
+    if (!QDir().rename(building, target)) {
+        util::removeDir(building);
+        return false;
+    }
+    util::removeDir(old);
+    return true;
+}
+
+bool FontCache::buildFonts(const QString &layerPath,
+                           const QString &buildDir,
+                           const std::function<bool()> &cancelled) const
+{
+    const auto fontsDir = buildDir + "/fonts";
+    if (!QDir().mkpath(fontsDir)) {
+        return false;
+    }
+
+    // 路径均为容器内的路径，生成时 buildDir 挂载在 kContainerDir，启动应用时 fonts 挂载在
+    // kContainerDir，缓存文件按字体目录命名，与所在目录无关
+    QSaveFile config(fontsDir + "/fonts.conf");
+    if (!config.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    config.write("<?xml version=\"1.0\"?>\n<!DOCTYPE fontconfig SYSTEM \"fonts.dtd\">\n"
+                 "<fontconfig>\n");
+    for (const auto &fontDir : fontDirs) {
+        config.write(QString("  <dir>%1</dir>\n").arg(fontDir.toHtmlEscaped()).toUtf8());
+    }
+    config.write(
+      QString("  <cachedir>%1/fonts</cachedir>\n</fontconfig>\n").arg(kContainerDir).toUtf8());
+    if (!config.commit()) {
+        return false;
+    }
+
+    const QStringList args{ "/runtime/bin/fc-cache", "--system-only", "--really-force" };
+    const bool ok = runInContainer(layerPath, buildDir, args, cancelled)
+      && !QDir(fontsDir).entryList({ "*.cache-*" }, QDir::Files).isEmpty();
+    QFile::remove(fontsDir + "/fonts.conf");
+    return ok;
+}
+
+void FontCache::buildIcons(const QString &layerPath,
+                           const QString &buildDir,
+                           const std::function<bool()> &cancelled) const
+{
+    const auto program = iconCacheProgram(layerPath);
+    if (program.isEmpty()) {
+        return;
+    }
+    for (const auto &theme : iconThemes(layerPath)) {
+        if (cancelled && cancelled()) {
+            return;
+        }
+        // 缓存必须位于主题目录中，以硬链接重建主题目录，不复制图标数据
+        const auto tree = buildDir + "/icons/" + theme;
+        if (!linkTree(filesPath(layerPath) + "/share/icons/" + theme, tree)) {
+            qWarning() << "link icon theme" << theme << "of" << layerPath << "failed";
+            util::removeDir(tree);
+            continue;
+        }
+        QFile::remove(tree + "/icon-theme.cache");
+        const QStringList args{ program,
+                                "--force",
+                                "--quiet",
+                                QString("%1/icons/%2").arg(kContainerDir, theme) };
+        if (!runInContainer(layerPath, buildDir, args, cancelled)
+            || !util::fileExists(tree + "/icon-theme.cache")) {
+            qWarning() << "update icon cache of" << theme << "in" << layerPath << "failed";
+            util::removeDir(tree);
+        }
+    }
+}
+
+void FontCache::update(const QString &layersDir, const std::function<bool()> &cancelled) const
+{
+    // 只在这里扫描字体目录，启动应用时比较记录的摘要
+    const auto digest = fontsDigest();
+    if (!QDir().mkpath(dir) || !writeStamp(dir + "/" + kHostDigestFileName, digest)) {
+        qWarning() << "record host fonts digest failed";
+        return;
+    }
+
+    QStringList layers;
+    for (const auto &layerPath : runtimeLayers(layersDir)) {
+        if (!isCacheable(layerPath)) {
+            continue;
+        }
+        layers.append(layerPath);
+        if (cancelled && cancelled()) {
+            continue;
+        }
+        if (!isUpToDate(layerPath) && !build(layerPath, digest, cancelled)) {
+            qWarning() << "update font cache of" << layerPath << "failed";
+        }
+    }
+    prune(layers);
+}
+
+QStringList FontCache::runtimeLayers(const QString &layersDir)
+{
+    QStringList layers;
+    // layers/<appId>/<version>/<arch>
+    const auto filters = QDir::Dirs | QDir::NoDotAndDotDot;
+    for (const auto &appId : QDir(layersDir).entryList(filters)) {
+        const auto appPath = layersDir + "/" + appId;
+        for (const auto &version : QDir(appPath).entryList(filters)) {
+            const auto versionPath = appPath + "/" + version;
+            for (const auto &arch : QDir(versionPath).entryList(filters)) {
+                const auto layerPath = versionPath + "/" + arch;
+                const auto infoFile = layerPath + "/info.json";
+                if (!util::fileExists(infoFile)) {
+                    continue;
+                }
+                auto info = util::loadJson<package::Info>(infoFile);
+                if (info && info->kind == "runtime") {
+                    layers.append(layerPath);
+                }
+            }
+        }
+    }
+    return layers;
+}
+
+void FontCache::prune(const QStringList &layerPaths) const
+{
+    QStringList keep;
+    for (const auto &layerPath : layerPaths) {
+        keep.append(QFileInfo(cacheDir(layerPath)).fileName());
+    }
+    for (const auto &entry : QDir(dir).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (!keep.contains(entry)) {
+            util::removeDir(dir + "/" + entry);
+        }
+    }
+}
+
+} // namespace linglong::runtime
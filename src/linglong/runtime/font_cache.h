@@ -0,0 +1,170 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_FONT_CACHE_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_FONT_CACHE_H_
+
+#include <nlohmann/json.hpp>
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+namespace linglong::runtime {
+
+/**
+ * @brief 按 runtime 预先生成的 fontconfig 及图标主题缓存
+ * @details runtime 自带的 fontconfig 与宿主版本不同时无法使用宿主的字体缓存，应用首次启动会在
+ *          各自的缓存目录中重新扫描所有字体。安装 runtime 后在 runtime 的容器中使用其 fc-cache
+ *          针对宿主的系统字体生成缓存，启动容器时只读挂载到 /var/cache/fontconfig。
+ *          宿主字体的变化只在 ll-package-manager 启动及安装 runtime 时检查，启动应用时不扫描字体目录；
+ *          两次检查之间新增的字体由容器内的 fontconfig 发现目录修改时间变化后扫描到用户缓存中。
+ *          runtime 自带的图标主题没有有效的 icon-theme.cache 时，GTK、Qt 每次启动都要扫描主题目录。
+ *          同一容器任务中将主题目录硬链接到缓存目录并用 gtk-update-icon-cache 生成缓存，GTK 与 Qt
+ *          都读取该格式，启动容器时挂载到 /runtime/share/icons 下对应的主题目录
+ */
+class FontCache
+{
+public:
+    // 容器内的系统字体缓存目录
+    static constexpr auto kContainerDir = "/var/cache/fontconfig";
+    // 容器内 runtime 的图标主题目录
+    static constexpr auto kIconsDir = "/runtime/share/icons";
+
+    /**
+     * @param dir 缓存目录，为空时使用 ${LINGLONG_ROOT}/caches/fontconfig
+     * @param fontDirs 宿主的系统字体目录，为空时使用默认目录
+     */
+    explicit FontCache(const QString &dir = QString(), const QStringList &fontDirs = {});
+    virtual ~FontCache() = default;
+
+    /**
+     * @brief runtime 是否自带 fc-cache
+     *
+     * @param layerPath runtime 的 layer 目录
+     */
+    static bool hasFontconfig(const QString &layerPath);
+
+    /**
+     * @brief runtime 自带的、缺少有效 icon-theme.cache 的图标主题
+     *
+     * @param layerPath runtime 的 layer 目录
+     */
+    static QStringList iconThemes(const QString &layerPath);
+
+    /**
+     * @brief 容器内生成图标主题缓存的程序，优先使用 runtime 自带的，都没有时返回空
+     */
+    static QString iconCacheProgram(const QString &layerPath);
+
+    // runtime 是否有需要预先生成的缓存
+    static bool isCacheable(const QString &layerPath);
+
+    /**
+     * @brief runtime 的缓存是否与最近一次检查时的宿主字体及当前安装的 runtime 一致，只读取记录，
+     *        不扫描字体目录
+     */
+    bool isUpToDate(const QString &layerPath) const;
+
+    /**
+     * @brief 启动容器时的只读挂载，包括字体缓存及各图标主题
+     *
+     * @param layerPath runtime 的 layer 目录
+     *
+     * @return QList<QPair<QString, QString>> (source, destination)，缓存过期时为空
+     */
+    QList<QPair<QString, QString>> mounts(const QString &layerPath) const;
+
+    /**
+     * @brief 检查宿主字体，为需要缓存的 runtime 生成过期的缓存，并删除已卸载 runtime
+     *        的缓存
+     *
+     * @param layersDir ${LINGLONG_ROOT}/layers
+     * @param cancelled 返回 true 时放弃尚未完成的生成
+     */
+    void update(const QString &layersDir, const std::function<bool()> &cancelled = nullptr) const;
+
+    /**
+     * @brief 已安装的 runtime 的 layer 目录
+     *
+     * @param layersDir ${LINGLONG_ROOT}/layers
+     */
+    static QStringList runtimeLayers(const QString &layersDir);
+
+    /**
+     * @brief 删除不在列表中的 runtime 的缓存
+     *
+     * @param layerPaths 已安装 runtime 的 layer 目录
+     */
+    void prune(const QStringList &layerPaths) const;
+
+    // runtime 缓存在宿主上的目录，devel 模块与 runtime 共用；字体缓存位于其中的 fonts，
+    // 图标主题位于 icons
+    QString cacheDir(const QString &layerPath) const;
+
+    /**
+     * @brief 宿主字体目录的摘要，字体目录及其子目录增删文件时改变
+     */
+    QString fontsDigest() const;
+
+    /**
+     * @brief 在 runtime 的容器中生成缓存的 OCI 配置
+     *
+     * @param layerPath runtime 的 layer 目录
+     * @param workDir 容器的工作目录，根目录为其中的 root
+     * @param buildDir 生成缓存的目录，可写挂载到容器内的 kContainerDir
+     * @param args 容器内执行的命令
+     */
+    nlohmann::json containerConfig(const QString &layerPath,
+                                   const QString &workDir,
+                                   const QString &buildDir,
+                                   const QStringList &args) const;
+
+    QString directory() const { return dir; }
+
+protected:
+    /**
+     * @brief 在 runtime 的容器中执行命令，buildDir 挂载到容器内的 kContainerDir
+     *
+     * @return bool true:命令已退出 false:无法启动、超时或被取消
+     */
+    virtual bool runInContainer(const QString &layerPath,
+                                const QString &buildDir,
+                                const QStringList &args,
+                                const std::function<bool()> &cancelled) const;
+
+private:
+    bool build(const QString &layerPath,
+               const QString &digest,
+               const std::function<bool()> &cancelled) const;
+
+    bool buildFonts(const QString &layerPath,
+                    const QString &buildDir,
+                    const std::function<bool()> &cancelled) const;
+
+    // 单个主题失败时不使用其缓存，不影响其它缓存
+    void buildIcons(const QString &layerPath,
+                    const QString &buildDir,
+                    const std::function<bool()> &cancelled) const;
+
+    // 缓存记录的内容：宿主字体摘要及 runtime 的 info.json 状态
+    static QString stampOf(const QString &layerPath, const QString &digest);
+
+    // devel 模块的目录换为 runtime 的 layer 目录
+    static QString baseLayerPath(const QString &layerPath);
+
+    static QString filesPath(const QString &layerPath);
+
+    QString dir;
+    QStringList fontDirs;
+};
+
+} // namespace linglong::runtime
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "launch_spec_cache.h"
+
+#include "linglong/util/file.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace linglong::runtime {
+
+namespace {
+const quint32 kMagic = 0x4c4c5350; // "LLSP"
+// 条目格式变化时递增
+const quint32 kFormatVersion = 3;
+} // namespace
+
+bool LaunchSpecCache::Entry::upToDate() const
+{
+    for (const auto &dependency : dependencies) {
+        if (util::fileStamp(dependency.first) != dependency.second) {
+            qDebug() << "launch spec cache: dependency changed" << dependency.first;
+            return false;
+        }
+    }
+    return true;
+}
+
+LaunchSpecCache::LaunchSpecCache(const QString &dir)
+    : dir(dir)
+{
+    if (this->dir.isEmpty()) {
+        this->dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+          + "/linglong/launch-spec";
+    }
+}
+
+bool LaunchSpecCache::load(const QString &key, const QByteArray &hostDigest, Entry &entry) const
+{
+    QFile file(filePath(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_11);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != kMagic || version != kFormatVersion) {
+        return false;
+    }
+    Entry loaded;
+    in >> loaded.dependencies >> loaded.commits >> loaded.hostDigest >> loaded.app >> loaded.config
+      >> loaded.oci;
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "launch spec cache: broken entry" << file.fileName();
+        return false;
+    }
+    if (loaded.hostDigest != hostDigest || !loaded.upToDate()) {
+        return false;
+    }
+
+    entry = loaded;
+    return true;
+}
+
+void LaunchSpecCache::store(const QString &key, const Entry &entry) const
+{
+    if (!QDir().mkpath(dir)) {
+        qWarning() << "launch spec cache: create" << dir << "failed";
+        return;
+    }
+
+    // 多个实例同时启动时，QSaveFile 保证读到的总是完整的条目
+    QSaveFile file(filePath(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "launch spec cache: write" << file.fileName() << "failed"
+                   << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_11);
+    out << kMagic << kFormatVersion;
+    out << entry.dependencies << entry.commits << entry.hostDigest << entry.app << entry.config
+        << entry.oci;
+    if (!file.commit()) {
+        qWarning() << "launch spec cache: commit" << file.fileName() << "failed"
+                   << file.errorString();
+    }
+}
+
+void LaunchSpecCache::remove(const QString &key) const
+{
+    QFile::remove(filePath(key));
+}
+
+QList<QPair<QString, QString>> LaunchSpecCache::dependenciesOf(const QStringList &paths)
+{
+    QList<QPair<QString, QString>> dependencies;
+    for (const auto &path : paths) {
+        dependencies.append({ path, util::fileStamp(path) });
+    }
+    return dependencies;
+}
+
+QByteArray LaunchSpecCache::hostDigest()
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const auto &resource : { ":/app.yaml", ":/config.json" }) {
+        QFile file(resource);
+        if (file.open(QIODevice::ReadOnly)) {
+            hash.addData(file.readAll());
+        }
+        hash.addData("\0", 1);
+    }
+    hash.addData(QDir::homePath().toUtf8());
+    return hash.result();
+}
+
+QString LaunchSpecCache::filePath(const QString &key) const
+{
+    return dir + "/" + key + ".bin";
+}
+
+} // namespace linglong::runtime
@@ -0,0 +1,87 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_LAUNCH_SPEC_CACHE_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_LAUNCH_SPEC_CACHE_H_
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+namespace linglong::runtime {
+
+/**
+ * @brief 应用启动配置缓存
+ * @details 缓存由 app.yaml 模板生成的应用配置及解析后的 OCI 配置模板，以二进制形式保存。
+ *          条目名包含应用 layer 的提交校验和，每个条目记录 runtime 等 layer 的提交校验和、生成时
+ *          依赖的文件状态（应用及 runtime 的安装目录、info.json、用户目录配置）和宿主配置摘要，
+ *          任一变化时条目失效，安装、升级、卸载及原地重新安装后首次启动会重新生成
+ */
+class LaunchSpecCache
+{
+public:
+    struct Entry
+    {
+        // 生成时依赖的文件及其状态
+        QList<QPair<QString, QString>> dependencies;
+        // 生成时 layer 的 ref（channel/appId/version/arch/module）及提交校验和，由调用方检查
+        QList<QPair<QString, QString>> commits;
+        QByteArray hostDigest;
+        // 应用配置，即 app.yaml 解析后的内容
+        QVariantMap app;
+        // 生成的 app.yaml，命中缓存时写回用户目录
+        QByteArray config;
+        // OCI 配置模板的 CBOR 编码
+        QByteArray oci;
+
+        // 依赖文件与记录的状态是否一致
+        bool upToDate() const;
+    };
+
+    /**
+     * @param dir 缓存目录，为空时使用用户缓存目录
+     */
+    explicit LaunchSpecCache(const QString &dir = QString());
+
+    /**
+     * @brief 读取缓存条目，条目不存在、损坏或已失效时返回 false
+     *
+     * @param key 条目名，由 util::cacheKey 生成
+     * @param hostDigest 当前的宿主配置摘要
+     */
+    bool load(const QString &key, const QByteArray &hostDigest, Entry &entry) const;
+
+    /**
+     * @brief 写入缓存条目，写入失败只影响下次启动速度
+     */
+    void store(const QString &key, const Entry &entry) const;
+
+    void remove(const QString &key) const;
+
+    /**
+     * @brief 根据路径列表生成依赖记录
+     */
+    static QList<QPair<QString, QString>> dependenciesOf(const QStringList &paths);
+
+    /**
+     * @brief 内置模板及宿主环境的摘要，程序升级或环境变化后缓存失效
+     */
+    static QByteArray hostDigest();
+
+    QString directory() const { return dir; }
+
+private:
+    QString filePath(const QString &key) const;
+
+    QString dir;
+};
+
+} // namespace linglong::runtime
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "launch_trace.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include <climits>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace linglong::runtime {
+
+namespace {
+thread_local LaunchTrace *currentTrace = nullptr;
+
+qint64 currentTid()
+{
+    return static_cast<qint64>(syscall(SYS_gettid));
+}
+
+QString exeOf(qint64 pid)
+{
+    char buf[PATH_MAX];
+    const auto link = QString("/proc/%1/exe").arg(pid).toLocal8Bit();
+    auto len = readlink(link.constData(), buf, sizeof(buf) - 1);
+    if (len <= 0) {
+        return QString();
+    }
+    return QString::fromLocal8Bit(buf, static_cast<int>(len));
+}
+
+// 进程已退出或成为僵尸进程
+bool processGone(qint64 pid)
+{
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return true;
+    }
+    const auto data = stat.readAll();
+    // 格式为 "pid (comm) state ..."，comm 中可能包含括号
+    const auto pos = data.lastIndexOf(')');
+    return pos < 0 || pos + 2 >= data.size() || data.at(pos + 2) == 'Z';
+}
+
+QList<qint64> childrenOf(qint64 pid)
+{
+    QList<qint64> children;
+    const auto tasks =
+      QDir(QString("/proc/%1/task").arg(pid)).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const auto &task : tasks) {
+        QFile file(QString("/proc/%1/task/%2/children").arg(pid).arg(task));
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        for (const auto &child : file.readAll().split(' ')) {
+            bool ok = false;
+            auto childPid = child.trimmed().toLongLong(&ok);
+            if (ok) {
+                children.append(childPid);
+            }
+        }
+    }
+    return children;
+}
+} // namespace
+
+LaunchTrace::LaunchTrace(const QString &name, const QString &outputPath)
+    : traceName(name)
+    , path(outputPath)
+    , startEpochUs(QDateTime::currentMSecsSinceEpoch() * 1000)
+    , pid(getpid())
+{
+    timer.start();
+}
+
+bool LaunchTrace::takeFromEnv(QStringList &env, QString &outputPath)
+{
+    const QString prefix = QString(kEnvName) + "=";
+    bool enabled = false;
+    for (auto it = env.begin(); it != env.end();) {
+        if (it->startsWith(prefix)) {
+            outputPath = it->mid(prefix.length());
+            enabled = true;
+            it = env.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (outputPath == "1") {
+        outputPath.clear();
+    }
+    return enabled;
+}
+
+qint64 LaunchTrace::elapsedUs() const
+{
+    return timer.nsecsElapsed() / 1000;
+}
+
+void LaunchTrace::addEvent(const QString &name, qint64 startUs, qint64 durationUs)
+{
+    QMutexLocker locker(&mutex);
+    if (finished) {
+        return;
+    }
+    recorded.append({ name, startUs, durationUs, currentTid() });
+}
+
+void LaunchTrace::finish()
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (finished) {
+            return;
+        }
+        recorded.append({ "launch", 0, elapsedUs(), currentTid() });
+        finished = true;
+    }
+
+    if (path.isEmpty()) {
+        return;
+    }
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "launch trace: open" << path << "failed:" << file.errorString();
+        return;
+    }
+    file.write(toChromeTrace());
+    if (!file.commit()) {
+        qWarning() << "launch trace: write" << path << "failed:" << file.errorString();
+        return;
+    }
+    qInfo() << "launch trace of" << traceName << "written to" << path;
+}
+
+bool LaunchTrace::isFinished() const
+{
+    QMutexLocker locker(&mutex);
+    return finished;
+}
+
+QList<LaunchTrace::Event> LaunchTrace::events() const
+{
+    QMutexLocker locker(&mutex);
+    return recorded;
+}
+
+QByteArray LaunchTrace::toChromeTrace() const
+{
+    QJsonArray traceEvents;
+    traceEvents.append(QJsonObject{
+      { "name", "process_name" },
+      { "ph", "M" },
+      { "pid", pid },
+      { "args", QJsonObject{ { "name", "ll-service: " + traceName } } },
+    });
+    for (const auto &event : events()) {
+        // 完整事件(X)，时间单位为微秒
+        traceEvents.append(QJsonObject{
+          { "name", event.name },
+          { "cat", "launch" },
+          { "ph", "X" },
+          { "ts", startEpochUs + event.startUs },
+          { "dur", event.durationUs },
+          { "pid", pid },
+          { "tid", event.tid },
+        });
+    }
+    return QJsonDocument(QJsonObject{
+                           { "traceEvents", traceEvents },
+                           { "displayTimeUnit", "ms" },
+                         })
+      .toJson(QJsonDocument::Compact);
+}
+
+QJsonObject LaunchTrace::summary() const
+{
+    QJsonObject stages;
+    double total = 0;
+    for (const auto &event : events()) {
+        const double ms = static_cast<double>(event.durationUs) / 1000;
+        if (event.name == "launch") {
+            total = ms;
+            continue;
+        }
+        stages[event.name] = stages.value(event.name).toDouble() + ms;
+    }
+    return QJsonObject{
+        { "name", traceName },
+        { "start", QDateTime::fromMSecsSinceEpoch(startEpochUs / 1000).toString(Qt::ISODate) },
+        { "finished", isFinished() },
+        { "totalMs", total },
+        { "stages", stages },
+        { "trace", path },
+    };
+}
+
+bool LaunchTrace::waitForExec(pid_t boxPid, int timeoutMsec)
+{
+    const QString selfExe = exeOf(getpid());
+    QElapsedTimer elapsed;
+    elapsed.start();
+    while (elapsed.elapsed() < timeoutMsec) {
+        if (processGone(boxPid)) {
+            return false;
+        }
+        // fork 后、exec ll-box 前，box 进程仍是当前程序
+        const QString boxExe = exeOf(boxPid);
+        if (!boxExe.isEmpty() && boxExe != selfExe) {
+            QList<qint64> pending = childrenOf(boxPid);
+            while (!pending.isEmpty()) {
+                const auto pid = pending.takeFirst();
+                const QString exe = exeOf(pid);
+                if (!exe.isEmpty() && exe != boxExe && exe != selfExe) {
+                    return true;
+                }
+                pending.append(childrenOf(pid));
+            }
+        }
+        usleep(1000);
+    }
+    return false;
+}
+
+LaunchTrace *LaunchTrace::current()
+{
+    return currentTrace;
+}
+
+LaunchTrace::Scope::Scope(LaunchTrace *trace)
+    : previous(currentTrace)
+{
+    currentTrace = trace;
+}
+
+LaunchTrace::Scope::~Scope()
+{
+    currentTrace = previous;
+}
+
+LaunchTrace::Span::Span(const char *name)
+    : trace(currentTrace)
+    , name(name)
+{
+    if (trace) {
+        startUs = trace->elapsedUs();
+    }
+}
+
+LaunchTrace::Span::~Span()
+{
+    end();
+}
+
+void LaunchTrace::Span::end()
+{
+    if (!trace) {
+        return;
+    }
+    trace->addEvent(QString::fromLatin1(name), startUs, trace->elapsedUs() - startUs);
+    trace = nullptr;
+}
+
+} // namespace linglong::runtime
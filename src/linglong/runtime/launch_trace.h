@@ -0,0 +1,138 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_LAUNCH_TRACE_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_LAUNCH_TRACE_H_
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+#include <sys/types.h>
+
+namespace linglong::runtime {
+
+/**
+ * @brief 应用启动耗时追踪
+ * @details 记录一次启动中各阶段的耗时，结束时以 Chrome trace（Perfetto 可直接打开）JSON 格式
+ *          写入指定文件。追踪对象通过 Scope 绑定到执行启动流程的线程，未绑定时 Span 不做任何事
+ */
+class LaunchTrace
+{
+public:
+    // 启动参数中携带该环境变量时开启追踪，值为 trace 文件的输出路径
+    static constexpr auto kEnvName = "LINGLONG_TRACE_LAUNCH";
+
+    struct Event
+    {
+        QString name;
+        qint64 startUs = 0;
+        qint64 durationUs = 0;
+        qint64 tid = 0;
+    };
+
+    /**
+     * @param name 追踪名称，通常为应用 id
+     * @param outputPath trace 文件输出路径，为空时只保留在内存中
+     */
+    LaunchTrace(const QString &name, const QString &outputPath);
+
+    /**
+     * @brief 从启动环境变量中取出追踪配置，并从列表中移除该项
+     *
+     * @param env KEY=VALUE 形式的环境变量列表
+     * @param outputPath trace 文件输出路径，值为空或 1 时只在内存中保留
+     *
+     * @return bool 是否开启追踪
+     */
+    static bool takeFromEnv(QStringList &env, QString &outputPath);
+
+    // 距离追踪开始的微秒数
+    qint64 elapsedUs() const;
+
+    void addEvent(const QString &name, qint64 startUs, qint64 durationUs);
+
+    /**
+     * @brief 结束追踪并写入 trace 文件，重复调用无效
+     */
+    void finish();
+    bool isFinished() const;
+
+    QList<Event> events() const;
+    QString name() const { return traceName; }
+    QString outputPath() const { return path; }
+
+    /**
+     * @brief Chrome trace 格式的 JSON
+     */
+    QByteArray toChromeTrace() const;
+
+    /**
+     * @brief 各阶段耗时摘要，同名阶段的耗时累加，单位毫秒
+     */
+    QJsonObject summary() const;
+
+    /**
+     * @brief 等待 ll-box 在容器中执行应用进程，即 box 进程的后代中出现非 ll-box 的可执行文件
+     *
+     * @param boxPid ll-box 进程号
+     * @param timeoutMsec 超时时间
+     *
+     * @return bool true:检测到应用进程 false:超时或 ll-box 已退出
+     */
+    static bool waitForExec(pid_t boxPid, int timeoutMsec);
+
+    // 当前线程绑定的追踪对象，未开启追踪时为空
+    static LaunchTrace *current();
+
+    /**
+     * @brief 在作用域内将追踪对象绑定到当前线程
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(LaunchTrace *trace);
+        ~Scope();
+
+    private:
+        LaunchTrace *previous;
+    };
+
+    /**
+     * @brief 记录从构造到析构（或调用 end）的耗时
+     */
+    class Span
+    {
+    public:
+        explicit Span(const char *name);
+        ~Span();
+        void end();
+
+    private:
+        LaunchTrace *trace;
+        const char *name;
+        qint64 startUs = 0;
+    };
+
+private:
+    QString traceName;
+    QString path;
+    QElapsedTimer timer;
+    qint64 startEpochUs = 0;
+    qint64 pid = 0;
+
+    mutable QMutex mutex;
+    QList<Event> recorded;
+    bool finished = false;
+};
+
+} // namespace linglong::runtime
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "ld_cache.h"
+
+#include "linglong/util/file.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace linglong::runtime {
+
+namespace {
+const auto kDependenciesFileName = "dependencies.json";
+const auto kSystemConfig = "/etc/ld.so.conf";
+} // namespace
+
+LdCache::LdCache(const QString &dir)
+    : dir(dir)
+{
+    if (this->dir.isEmpty()) {
+        this->dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+          + "/linglong/ld-cache";
+    }
+}
+
+bool LdCache::isReady(const QString &key) const
+{
+    if (!QFile::exists(cacheFile(key))) {
+        return false;
+    }
+
+    QFile file(dependenciesFile(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const auto dependencies = QJsonDocument::fromJson(file.readAll()).object();
+    if (dependencies.isEmpty()) {
+        return false;
+    }
+    for (auto it = dependencies.begin(); it != dependencies.end(); ++it) {
+        if (util::fileStamp(it.key()) != it.value().toString()) {
+            qDebug() << "ld cache: dependency changed" << it.key();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LdCache::prepare(const QString &key,
+                      const QStringList &libraryPaths,
+                      const QStringList &dependencies) const
+{
+    if (!QDir().mkpath(entryDir(key))) {
+        return false;
+    }
+    // 依赖已变化，避免新旧记录混用
+    QFile::remove(cacheFile(key));
+
+    QSaveFile config(entryDir(key) + "/" + kConfigFileName);
+    if (!config.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    // ldconfig 按配置中出现的顺序处理目录，同名的库先出现者优先
+    config.write(libraryPaths.join('\n').toUtf8() + "\n");
+    config.write(QByteArray("include ") + kSystemConfig + "\n");
+    if (!config.commit()) {
+        return false;
+    }
+
+    QJsonObject stamps;
+    for (const auto &dependency : dependencies) {
+        stamps.insert(dependency, util::fileStamp(dependency));
+    }
+    QSaveFile file(dependenciesFile(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(stamps).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+QStringList LdCache::generateCommand(const QString &dir)
+{
+    const auto cache = dir + "/" + kCacheFileName;
+    const auto config = dir + "/" + kConfigFileName;
+    // 同时启动的多个实例各自写入临时文件后替换
+    const auto script =
+      QString("PATH=/usr/sbin:/sbin:$PATH; "
+              "ldconfig -X -C \"%1.$$\" -f \"%2\" && mv -f \"%1.$$\" \"%1\" || rm -f \"%1.$$\"")
+        .arg(cache, config);
+    return { "/bin/sh", "-c", script };
+}
+
+QString LdCache::entryDir(const QString &key) const
+{
+    return dir + "/" + key;
+}
+
+QString LdCache::cacheFile(const QString &key) const
+{
+    return entryDir(key) + "/" + kCacheFileName;
+}
+
+QString LdCache::dependenciesFile(const QString &key) const
+{
+    return entryDir(key) + "/" + kDependenciesFileName;
+}
+
+} // namespace linglong::runtime
@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_LD_CACHE_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_LD_CACHE_H_
+
+#include <QString>
+#include <QStringList>
+
+namespace linglong::runtime {
+
+/**
+ * @brief 应用与 runtime 组合对应的 ld.so.cache
+ * @details 首次启动时将缓存目录挂载到容器内，应用启动后在容器中执行 ldconfig 生成缓存。
+ *          之后的启动将缓存挂载为容器的 /etc/ld.so.cache，LD_LIBRARY_PATH 只保留应用自身的
+ *          库目录，动态链接器无需在 runtime 及系统的每个目录中逐一查找依赖库。
+ *          配置中的目录按顺序优先，其后 include 容器内的 /etc/ld.so.conf，保留宿主配置的库目录。
+ *          依赖的库目录或 ld.so.conf 变化后重新生成
+ */
+class LdCache
+{
+public:
+    // 生成缓存时缓存目录在容器内的挂载点
+    static constexpr auto kContainerDir = "/run/linglong/ld-cache";
+    static constexpr auto kCacheFileName = "ld.so.cache";
+    static constexpr auto kConfigFileName = "ld.so.conf";
+
+    /**
+     * @param dir 缓存目录，为空时使用用户缓存目录下的 linglong/ld-cache
+     */
+    explicit LdCache(const QString &dir = QString());
+
+    /**
+     * @brief 缓存是否已生成且依赖未变化
+     *
+     * @param key 应用与 runtime 组合对应的条目名
+     */
+    bool isReady(const QString &key) const;
+
+    /**
+     * @brief 准备生成缓存：写入 ldconfig 的配置及依赖记录，删除过期的缓存
+     *
+     * @param key 条目名
+     * @param libraryPaths 容器内的库目录，按查找优先级排列，优先于 /etc/ld.so.conf 中的目录
+     * @param dependencies 宿主上的依赖路径，变化后缓存失效
+     *
+     * @return bool true:成功 false:失败
+     */
+    bool prepare(const QString &key,
+                 const QStringList &libraryPaths,
+                 const QStringList &dependencies) const;
+
+    /**
+     * @brief 生成缓存的命令，在容器内执行时缓存目录需挂载在 kContainerDir
+     *
+     * @param dir 执行命令时缓存目录所在的路径
+     */
+    static QStringList generateCommand(const QString &dir = kContainerDir);
+
+    // 条目在宿主上的目录
+    QString entryDir(const QString &key) const;
+
+    QString cacheFile(const QString &key) const;
+
+    QString directory() const { return dir; }
+
+private:
+    QString dependenciesFile(const QString &key) const;
+
+    QString dir;
+};
+
+} // namespace linglong::runtime
+
+#endif
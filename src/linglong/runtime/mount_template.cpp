@@ -0,0 +1,264 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "mount_template.h"
+
+#include "linglong/package/info.h"
+#include "linglong/util/file.h"
+#include "linglong/util/runner.h"
+#include "linglong/util/qserializer/json.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QLockFile>
+#include <QMutex>
+
+#include <algorithm>
+
+#include <sys/stat.h>
+
+namespace linglong::runtime {
+
+namespace {
+struct Cached
+{
+    QString stamp;
+    QSharedPointer<const MountTemplate> mountTemplate;
+};
+
+QMutex cacheMutex;
+QHash<QString, Cached> cache;
+
+// 挂载合并目录树的超时时间
+constexpr auto kMountTimeoutMsec = 10 * 1000;
+
+QString normalized(QString path)
+{
+    while (path.size() > 1 && path.endsWith('/')) {
+        path.chop(1);
+    }
+    return path;
+}
+
+bool isMountPoint(const QString &path)
+{
+    struct stat self
+    {
+    };
+    struct stat parent
+    {
+    };
+    return stat(QFile::encodeName(path).constData(), &self) == 0
+      && stat(QFile::encodeName(path + "/..").constData(), &parent) == 0
+      && self.st_dev != parent.st_dev;
+}
+
+// 延迟卸载，已绑定到容器中的挂载在容器退出后才释放
+bool unmount(const QString &mountPoint)
+{
+    for (const auto &program : { "fusermount3", "fusermount" }) {
+        if (!isMountPoint(mountPoint)) {
+            break;
+        }
+        util::Exec(program, { "-u", "-z", mountPoint }, kMountTimeoutMsec);
+    }
+    return !isMountPoint(mountPoint);
+}
+
+// 只删除空目录，卸载失败时不会进入挂载的目录树
+void removeTree(const QString &treeDir)
+{
+    QDir dir(treeDir);
+    for (const auto &entry : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (unmount(dir.filePath(entry))) {
+            dir.rmdir(entry);
+        }
+    }
+    QDir().rmdir(treeDir);
+}
+} // namespace
+
+QSharedPointer<const MountTemplate> MountTemplate::forRuntime(const QString &runtimeRootPath,
+                                                             const QString &runtimeLayerPath,
+                                                             const QString &linglongRootPath)
+{
+    const auto key = QStringList{ runtimeRootPath, runtimeLayerPath, linglongRootPath }.join('\n');
+    const auto stamp = util::fileStamp(runtimeLayerPath + "/info.json");
+
+    QMutexLocker locker(&cacheMutex);
+    auto it = cache.find(key);
+    if (it != cache.end() && it->stamp == stamp) {
+        return it->mountTemplate;
+    }
+
+    auto mountTemplate = build(runtimeRootPath, runtimeLayerPath, linglongRootPath);
+    cache.insert(key, { stamp, mountTemplate });
+    return mountTemplate;
+}
+
+QSharedPointer<const MountTemplate> MountTemplate::build(const QString &runtimeRootPath,
+                                                        const QString &runtimeLayerPath,
+                                                        const QString &linglongRootPath)
+{
+    QSharedPointer<MountTemplate> mountTemplate(new MountTemplate);
+    mountTemplate->runtimeId =
+      util::cacheKey({ runtimeRootPath, runtimeLayerPath, linglongRootPath });
+    mountTemplate->stampId = util::cacheKey({ util::fileStamp(runtimeLayerPath + "/info.json") });
+
+    // if use wine runtime, mount with fuse
+    // FIXME(iceyer): use info.json to decide use fuse or not
+    mountTemplate->wine = runtimeRootPath.contains("org.deepin.Wine");
+
+    // 通过runtime info.json文件获取basicsRootPath路径
+    auto runtimeInfoFile = runtimeLayerPath + "/info.json";
+    if (!linglong::util::isDeepinSysProduct() && util::fileExists(runtimeInfoFile)) {
+        auto runtimeInfo = util::loadJson<package::Info>(runtimeInfoFile);
+        if (!runtimeInfo->runtime.isEmpty()) {
+            mountTemplate->basicsRootPath =
+              linglongRootPath + "/layers/" + runtimeInfo->runtime + "/files";
+        }
+    }
+
+    mountTemplate->base = {
+        { "/usr", "/usr" },
+        { "/etc", "/etc" },
+        { runtimeRootPath, "/runtime" },
+        { "/usr/share/locale/", "/usr/share/locale/" },
+    };
+
+    // FIXME(iceyer): extract for wine, remove later
+    if (mountTemplate->wine) {
+        // NOTE: the override should be behind host /usr
+        mountTemplate->wineOverrides = {
+            { runtimeRootPath + "/bin", "/usr/bin" },
+            { runtimeRootPath + "/include", "/usr/include" },
+            { runtimeRootPath + "/lib", "/usr/lib" },
+            { runtimeRootPath + "/sbin", "/usr/sbin" },
+            { runtimeRootPath + "/share", "/usr/share" },
+            { runtimeRootPath + "/opt/deepinwine", "/opt/deepinwine" },
+            { runtimeRootPath + "/opt/deepin-wine6-stable", "/opt/deepin-wine6-stable" },
+        };
+    }
+
+    // overlay mount basics
+    if (!mountTemplate->basicsRootPath.isEmpty()) {
+        mountTemplate->basics = {
+            { mountTemplate->basicsRootPath + "/usr", "/usr" },
+            { mountTemplate->basicsRootPath + "/etc", "/etc" },
+        };
+    }
+
+    return mountTemplate;
+}
+
+QList<QPair<QString, QStringList>> MountTemplate::mergedLayers() const
+{
+    QList<QPair<QString, QString>> layers = base + wineOverrides + basics;
+    for (auto &layer : layers) {
+        layer = { normalized(layer.first), normalized(layer.second) };
+    }
+
+    QStringList destinations;
+    for (const auto &layer : layers) {
+        if (!destinations.contains(layer.second)) {
+            destinations.append(layer.second);
+        }
+    }
+    std::stable_sort(destinations.begin(),
+                     destinations.end(),
+                     [](const QString &lhs, const QString &rhs) {
+                         return lhs.count('/') < rhs.count('/');
+                     });
+
+    // 挂载点下的内容同样来自挂载到其上级目录的源目录
+    QList<QPair<QString, QStringList>> result;
+    for (const auto &destination : destinations) {
+        QStringList lowers;
+        for (auto it = layers.crbegin(); it != layers.crend(); ++it) {
+            QString source;
+            if (destination == it->second) {
+                source = it->first;
+            } else if (destination.startsWith(it->second + "/")) {
+                source = it->first + destination.mid(it->second.size());
+            } else {
+                continue;
+            }
+            if (!lowers.contains(source)) {
+                lowers.append(source);
+            }
+        }
+        result.append({ destination, lowers });
+    }
+    return result;
+}
+
+QList<QPair<QString, QString>> MountTemplate::prepareSharedTree(const QString &treesDir) const
+{
+    if (!QDir().mkpath(treesDir)) {
+        return {};
+    }
+
+    // 同一 runtime 同时启动多个应用时只挂载一次
+    QLockFile lock(treesDir + "/" + runtimeId + ".lock");
+    if (!lock.lock()) {
+        return {};
+    }
+
+    const auto runtimeDir = treesDir + "/" + runtimeId;
+    for (const auto &entry : QDir(runtimeDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (entry != stampId) {
+            removeTree(runtimeDir + "/" + entry);
+        }
+    }
+
+    QList<QPair<QString, QString>> mounts;
+    for (const auto &layer : mergedLayers()) {
+        QStringList lowers;
+        for (const auto &lower : layer.second) {
+            if (QFileInfo(lower).isDir()) {
+                lowers.append(lower);
+            }
+        }
+        if (lowers.isEmpty()) {
+            continue;
+        }
+        if (lowers.size() == 1) {
+            mounts.append({ lowers.first(), layer.first });
+            continue;
+        }
+        // fuse-overlayfs 的 lowerdir 选项以 ':'、',' 分隔
+        for (const auto &lower : lowers) {
+            if (lower.contains(':') || lower.contains(',')) {
+                return {};
+            }
+        }
+
+        const auto mountPoint = runtimeDir + "/" + stampId + "/" + util::cacheKey(lowers);
+        if (!isMountPoint(mountPoint)) {
+            // 没有 upperdir 时只读挂载
+            QDir().mkpath(mountPoint);
+            util::Exec("fuse-overlayfs",
+                       { "-o", "lowerdir=" + lowers.join(':'), mountPoint },
+                       kMountTimeoutMsec);
+            if (!isMountPoint(mountPoint)) {
+                qWarning() << "mount shared tree" << layer.first << "failed";
+                return {};
+            }
+        }
+        mounts.append({ mountPoint, layer.first });
+    }
+    return mounts;
+}
+
+void MountTemplate::clearCache()
+{
+    QMutexLocker locker(&cacheMutex);
+    cache.clear();
+}
+
+} // namespace linglong::runtime
@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_MOUNT_TEMPLATE_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_MOUNT_TEMPLATE_H_
+
+#include <QList>
+#include <QPair>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+namespace linglong::runtime {
+
+/**
+ * @brief 由 runtime 决定的只读挂载
+ * @details 包括宿主 /usr、/etc、/runtime、locale，wine 覆盖目录及 basics 的 usr、etc，按 runtime
+ *          缓存在进程内，避免每次启动都读取 runtime 的 info.json。overlay 挂载的顺序是反向的，
+ *          三组挂载分开提供，由调用方与应用相关的挂载按原有顺序组合
+ */
+class MountTemplate
+{
+public:
+    /**
+     * @brief 获取 runtime 的挂载模板，runtime 的 info.json 未变化时返回缓存
+     *
+     * @param runtimeRootPath runtime 的 files 目录
+     * @param runtimeLayerPath runtime 的 layer 目录，包含 info.json
+     * @param linglongRootPath 玲珑根目录，用于定位 basics
+     *
+     * @return QSharedPointer<const MountTemplate> 挂载模板
+     */
+    static QSharedPointer<const MountTemplate> forRuntime(const QString &runtimeRootPath,
+                                                         const QString &runtimeLayerPath,
+                                                         const QString &linglongRootPath);
+
+    /**
+     * @brief 按 runtime 信息生成挂载模板，不使用缓存
+     */
+    static QSharedPointer<const MountTemplate> build(const QString &runtimeRootPath,
+                                                    const QString &runtimeLayerPath,
+                                                    const QString &linglongRootPath);
+
+    /**
+     * @brief 清空进程内缓存
+     */
+    static void clearCache();
+
+    // 宿主 /usr、/etc、/runtime 及 locale，按挂载顺序排列的 (source, destination)
+    const QList<QPair<QString, QString>> &baseMounts() const { return base; }
+
+    // wine runtime 覆盖宿主 /usr 的目录，非 wine runtime 时为空
+    const QList<QPair<QString, QString>> &wineMounts() const { return wineOverrides; }
+
+    // basics 的 usr、etc，未依赖 basics 时为空
+    const QList<QPair<QString, QString>> &basicsMounts() const { return basics; }
+
+    // wine runtime 或依赖 basics 时需要 overlay 挂载
+    bool requiresOverlay() const { return wine || !basicsRootPath.isEmpty(); }
+
+    bool isWine() const { return wine; }
+
+    /**
+     * @brief 按 overlay 的叠加效果合并三组挂载，后面的挂载覆盖前面的
+     *
+     * @return QList<QPair<QString, QStringList>> (destination, 由上到下的源目录)，父目录在前
+     */
+    QList<QPair<QString, QStringList>> mergedLayers() const;
+
+    /**
+     * @brief 准备同一 runtime 的容器共用的目录树
+     * @details 有多层源目录的挂载点由 fuse-overlayfs 只读合并，挂载在 treesDir 下按 runtime 及其
+     *          info.json 状态区分的目录中，进程退出后保留给之后启动的容器。runtime 更新后旧的目录树
+     *          延迟卸载，已启动的容器不受影响
+     *
+     * @param treesDir 存放各 runtime 目录树的目录
+     *
+     * @return QList<QPair<QString, QString>> 依次绑定的 (source, destination)，无法准备时为空
+     */
+    QList<QPair<QString, QString>> prepareSharedTree(const QString &treesDir) const;
+
+private:
+    MountTemplate() = default;
+
+    QList<QPair<QString, QString>> base;
+    QList<QPair<QString, QString>> wineOverrides;
+    QList<QPair<QString, QString>> basics;
+    bool wine = false;
+    QString basicsRootPath;
+    // 区分 runtime 及其 info.json 状态，用于共用目录树的路径
+    QString runtimeId;
+    QString stampId;
+};
+
+} // namespace linglong::runtime
+
+#endif
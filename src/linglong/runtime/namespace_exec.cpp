@@ -0,0 +1,419 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "namespace_exec.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+
+#include <fcntl.h>
+#include <grp.h>
+#include <linux/capability.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace linglong::runtime {
+
+namespace {
+// user 命名空间需最先加入，以获得其余命名空间所需的权限
+const struct
+{
+    const char *name;
+    int type;
+} kNamespaces[] = {
+    { "user", CLONE_NEWUSER }, { "mnt", CLONE_NEWNS },   { "ipc", CLONE_NEWIPC },
+    { "uts", CLONE_NEWUTS },   { "net", CLONE_NEWNET },  { "pid", CLONE_NEWPID },
+};
+
+// 下标即 capability 编号
+const char *const kCapabilities[] = {
+    "CAP_CHOWN", "CAP_DAC_OVERRIDE", "CAP_DAC_READ_SEARCH", "CAP_FOWNER", "CAP_FSETID", "CAP_KILL",
+    "CAP_SETGID", "CAP_SETUID", "CAP_SETPCAP", "CAP_LINUX_IMMUTABLE", "CAP_NET_BIND_SERVICE",
+    "CAP_NET_BROADCAST", "CAP_NET_ADMIN", "CAP_NET_RAW", "CAP_IPC_LOCK", "CAP_IPC_OWNER",
+    "CAP_SYS_MODULE", "CAP_SYS_RAWIO", "CAP_SYS_CHROOT", "CAP_SYS_PTRACE", "CAP_SYS_PACCT",
+    "CAP_SYS_ADMIN", "CAP_SYS_BOOT", "CAP_SYS_NICE", "CAP_SYS_RESOURCE", "CAP_SYS_TIME",
+    "CAP_SYS_TTY_CONFIG", "CAP_MKNOD", "CAP_LEASE", "CAP_AUDIT_WRITE", "CAP_AUDIT_CONTROL",
+    "CAP_SETFCAP", "CAP_MAC_OVERRIDE", "CAP_MAC_ADMIN", "CAP_SYSLOG", "CAP_WAKE_ALARM",
+    "CAP_BLOCK_SUSPEND", "CAP_AUDIT_READ", "CAP_PERFMON", "CAP_BPF", "CAP_CHECKPOINT_RESTORE",
+};
+
+const struct
+{
+    const char *name;
+    int resource;
+} kRlimits[] = {
+    { "RLIMIT_CPU", RLIMIT_CPU },
+    { "RLIMIT_FSIZE", RLIMIT_FSIZE },
+    { "RLIMIT_DATA", RLIMIT_DATA },
+    { "RLIMIT_STACK", RLIMIT_STACK },
+    { "RLIMIT_CORE", RLIMIT_CORE },
+    { "RLIMIT_RSS", RLIMIT_RSS },
+    { "RLIMIT_NPROC", RLIMIT_NPROC },
+    { "RLIMIT_NOFILE", RLIMIT_NOFILE },
+    { "RLIMIT_MEMLOCK", RLIMIT_MEMLOCK },
+    { "RLIMIT_AS", RLIMIT_AS },
+    { "RLIMIT_LOCKS", RLIMIT_LOCKS },
+    { "RLIMIT_SIGPENDING", RLIMIT_SIGPENDING },
+    { "RLIMIT_MSGQUEUE", RLIMIT_MSGQUEUE },
+    { "RLIMIT_NICE", RLIMIT_NICE },
+    { "RLIMIT_RTPRIO", RLIMIT_RTPRIO },
+    { "RLIMIT_RTTIME", RLIMIT_RTTIME },
+};
+
+// 生成的配置中未设置的可选字段可能为 null
+bool isSet(const nlohmann::json &object, const char *key)
+{
+    return object.is_object() && object.contains(key) && !object.at(key).is_null();
+}
+
+// 未知的 capability 返回 false，不能忽略
+bool capabilityMask(const nlohmann::json &caps, const char *set, int lastCap, uint64_t &mask)
+{
+    mask = 0;
+    if (!isSet(caps, set)) {
+        return true;
+    }
+    for (const auto &name : caps.at(set)) {
+        int cap = 0;
+        for (const auto *known : kCapabilities) {
+            if (name.get<std::string>() == known) {
+                break;
+            }
+            ++cap;
+        }
+        if (cap >= static_cast<int>(std::size(kCapabilities)) || cap > lastCap) {
+            return false;
+        }
+        mask |= uint64_t(1) << cap;
+    }
+    return true;
+}
+
+bool sameFile(const std::string &lhs, const std::string &rhs)
+{
+    struct stat lhsStat = {};
+    struct stat rhsStat = {};
+    if (stat(lhs.c_str(), &lhsStat) != 0 || stat(rhs.c_str(), &rhsStat) != 0) {
+        return false;
+    }
+    return lhsStat.st_dev == rhsStat.st_dev && lhsStat.st_ino == rhsStat.st_ino;
+}
+} // namespace
+
+NamespaceExec::NamespaceExec(pid_t initPid, const nlohmann::json &config)
+{
+    if (initPid <= 0) {
+        return;
+    }
+    if (!parseRestrictions(config)) {
+        qInfo() << "container config has restrictions not supported by setns, use ll-box instead";
+        return;
+    }
+
+    const auto proc = "/proc/" + std::to_string(initPid);
+    for (const auto &ns : kNamespaces) {
+        const auto path = proc + "/ns/" + ns.name;
+        if (sameFile(path, std::string("/proc/self/ns/") + ns.name)) {
+            continue;
+        }
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            qWarning() << "open" << path.c_str() << "failed:" << strerror(errno);
+            return;
+        }
+        namespaces.push_back({ fd, ns.type });
+    }
+
+    const auto root = proc + "/root";
+    rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        qWarning() << "open" << root.c_str() << "failed:" << strerror(errno);
+        return;
+    }
+    sameRoot = sameFile(root, "/");
+    valid = true;
+}
+
+NamespaceExec::~NamespaceExec()
+{
+    for (const auto &ns : namespaces) {
+        close(ns.fd);
+    }
+    if (rootFd >= 0) {
+        close(rootFd);
+    }
+}
+
+bool NamespaceExec::parseRestrictions(const nlohmann::json &config)
+{
+    // 无法在此实现的限制交由 ll-box 处理
+    if (isSet(config, "linux") && isSet(config.at("linux"), "seccomp")) {
+        return false;
+    }
+    if (!isSet(config, "process")) {
+        return true;
+    }
+    const auto &process = config.at("process");
+    if (isSet(process, "apparmorProfile") || isSet(process, "selinuxLabel")) {
+        return false;
+    }
+
+    auto &r = restrictions;
+    try {
+        if (isSet(process, "rlimits")) {
+            for (const auto &rlimit : process.at("rlimits")) {
+                const auto type = rlimit.at("type").get<std::string>();
+                int resource = -1;
+                for (const auto &known : kRlimits) {
+                    if (type == known.name) {
+                        resource = known.resource;
+                        break;
+                    }
+                }
+                if (resource < 0) {
+                    return false;
+                }
+                r.rlimits.push_back(
+                  { resource, rlimit.at("soft").get<rlim_t>(), rlimit.at("hard").get<rlim_t>() });
+            }
+        }
+
+        if (isSet(process, "user")) {
+            const auto &user = process.at("user");
+            r.setUser = true;
+            r.uid = user.at("uid").get<uid_t>();
+            r.gid = user.at("gid").get<gid_t>();
+            if (isSet(user, "additionalGids")) {
+                r.additionalGids = user.at("additionalGids").get<std::vector<gid_t>>();
+            }
+            if (isSet(user, "umask")) {
+                r.setUmask = true;
+                r.umask = user.at("umask").get<mode_t>();
+            }
+        }
+
+        if (isSet(process, "capabilities")) {
+            QFile lastCapFile("/proc/sys/kernel/cap_last_cap");
+            if (!lastCapFile.open(QIODevice::ReadOnly)) {
+                return false;
+            }
+            r.lastCap = lastCapFile.readAll().trimmed().toInt();
+            const auto &caps = process.at("capabilities");
+            if (!capabilityMask(caps, "bounding", r.lastCap, r.bounding)
+                || !capabilityMask(caps, "effective", r.lastCap, r.effective)
+                || !capabilityMask(caps, "permitted", r.lastCap, r.permitted)
+                || !capabilityMask(caps, "inheritable", r.lastCap, r.inheritable)
+                || !capabilityMask(caps, "ambient", r.lastCap, r.ambient)) {
+                return false;
+            }
+            r.setCapabilities = true;
+        }
+
+        r.noNewPrivileges =
+          isSet(process, "noNewPrivileges") && process.at("noNewPrivileges").get<bool>();
+    } catch (const nlohmann::json::exception &e) {
+        qWarning() << "invalid process config:" << e.what();
+        return false;
+    }
+    return true;
+}
+
+bool NamespaceExec::applyRestrictions() const
+{
+    const auto &r = restrictions;
+    for (const auto &rlimit : r.rlimits) {
+        struct rlimit limit = { rlimit.soft, rlimit.hard };
+        if (setrlimit(rlimit.resource, &limit) != 0) {
+            return false;
+        }
+    }
+
+    // 切换用户前缩小 bounding set，并保留 permitted 以便之后设置
+    if (r.setCapabilities) {
+        for (int cap = 0; cap <= r.lastCap; ++cap) {
+            const bool keep = cap < 64 && (r.bounding & (uint64_t(1) << cap));
+            if (!keep && prctl(PR_CAPBSET_DROP, cap, 0, 0, 0) != 0) {
+                return false;
+            }
+        }
+        if (r.setUser && prctl(PR_SET_KEEPCAPS, 1, 0, 0, 0) != 0) {
+            return false;
+        }
+    }
+
+    if (r.setUser) {
+        if (!r.additionalGids.empty()
+            && setgroups(r.additionalGids.size(), r.additionalGids.data()) != 0) {
+            return false;
+        }
+        if (setresgid(r.gid, r.gid, r.gid) != 0 || setresuid(r.uid, r.uid, r.uid) != 0) {
+            return false;
+        }
+    }
+    if (r.setUmask) {
+        umask(r.umask);
+    }
+
+    if (r.setCapabilities) {
+        struct __user_cap_header_struct header = { _LINUX_CAPABILITY_VERSION_3, 0 };
+        struct __user_cap_data_struct data[2] = {};
+        for (int i = 0; i < 2; ++i) {
+            data[i].effective = static_cast<__u32>(r.effective >> (32 * i));
+            data[i].permitted = static_cast<__u32>(r.permitted >> (32 * i));
+            data[i].inheritable = static_cast<__u32>(r.inheritable >> (32 * i));
+        }
+        if (syscall(SYS_capset, &header, data) != 0) {
+            return false;
+        }
+        for (int cap = 0; cap <= r.lastCap && cap < 64; ++cap) {
+            if ((r.ambient & (uint64_t(1) << cap))
+                && prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_RAISE, cap, 0, 0) != 0) {
+                return false;
+            }
+        }
+    }
+
+    return !r.noNewPrivileges || prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0;
+}
+
+pid_t NamespaceExec::findInit(pid_t boxPid)
+{
+    QFile children(QString("/proc/%1/task/%1/children").arg(boxPid));
+    if (!children.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    auto pid = QString::fromLatin1(children.readAll()).section(' ', 0, 0).toInt();
+    return pid > 0 ? pid : -1;
+}
+
+bool NamespaceExec::isValid() const
+{
+    return valid;
+}
+
+bool NamespaceExec::spawn(const std::vector<std::string> &args,
+                          const std::vector<std::string> &env,
+                          const std::string &cwd) const
+{
+    if (!valid || args.empty()) {
+        return false;
+    }
+
+    // fork 后只调用 async-signal-safe 的函数，参数需提前准备
+    std::vector<char *> argv;
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    std::vector<char *> envp;
+    std::string path = "/usr/local/bin:/usr/bin:/bin";
+    for (const auto &item : env) {
+        envp.push_back(const_cast<char *>(item.c_str()));
+        if (item.rfind("PATH=", 0) == 0) {
+            path = item.substr(5);
+        }
+    }
+    envp.push_back(nullptr);
+
+    // 按容器内的 PATH 查找命令，而不是当前进程的 PATH
+    std::vector<std::string> candidates;
+    if (args.front().find('/') != std::string::npos) {
+        candidates.push_back(args.front());
+    } else {
+        size_t begin = 0;
+        while (begin <= path.size()) {
+            auto end = path.find(':', begin);
+            if (end == std::string::npos) {
+                end = path.size();
+            }
+            auto dir = path.substr(begin, end - begin);
+            candidates.push_back((dir.empty() ? "." : dir) + "/" + args.front());
+            begin = end + 1;
+        }
+    }
+
+    // exec 成功时管道随 CLOEXEC 关闭，失败时写入 errno
+    int errorPipe[2];
+    if (pipe2(errorPipe, O_CLOEXEC) != 0) {
+        return false;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        close(errorPipe[0]);
+        close(errorPipe[1]);
+        return false;
+    }
+
+    if (0 == child) {
+        close(errorPipe[0]);
+        auto fail = [&errorPipe]() {
+            int err = errno;
+            (void)write(errorPipe[1], &err, sizeof(err));
+            _exit(1);
+        };
+
+        for (const auto &ns : namespaces) {
+            if (setns(ns.fd, ns.type) != 0) {
+                fail();
+            }
+        }
+        if (!sameRoot && (fchdir(rootFd) != 0 || chroot(".") != 0)) {
+            fail();
+        }
+
+        // 加入 pid 命名空间后只对子进程生效，再 fork 一次，中间进程退出后由容器 init 回收
+        pid_t grandChild = fork();
+        if (grandChild < 0) {
+            fail();
+        }
+        if (grandChild > 0) {
+            _exit(0);
+        }
+
+        setsid();
+        if (chdir(cwd.empty() ? "/" : cwd.c_str()) != 0) {
+            (void)chdir("/");
+        }
+        if (!applyRestrictions()) {
+            fail();
+        }
+        int lastErrno = ENOENT;
+        for (const auto &candidate : candidates) {
+            execve(candidate.c_str(), argv.data(), envp.data());
+            if (errno != ENOENT && errno != ENOTDIR) {
+                lastErrno = errno;
+            }
+        }
+        errno = lastErrno;
+        fail();
+    }
+
+    close(errorPipe[1]);
+    int err = 0;
+    ssize_t size = 0;
+    do {
+        size = read(errorPipe[0], &err, sizeof(err));
+    } while (size < 0 && errno == EINTR);
+    close(errorPipe[0]);
+    waitpid(child, nullptr, 0);
+
+    if (size > 0) {
+        qWarning() << "exec" << args.front().c_str() << "in container failed:" << strerror(err);
+        return false;
+    }
+    return true;
+}
+
+} // namespace linglong::runtime
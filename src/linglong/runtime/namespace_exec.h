@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_NAMESPACE_EXEC_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_NAMESPACE_EXEC_H_
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+namespace linglong::runtime {
+
+/**
+ * @brief 直接在运行中的容器内启动进程
+ * @details 打开容器内 init 进程的命名空间及根目录并保持，启动进程时在 fork 出的子进程中
+ *          setns 加入这些命名空间后 exec，不再经由 ll-box 的 socket 传递 JSON 格式的进程配置。
+ *          与当前进程相同的命名空间及根目录会被跳过。
+ *          exec 前按容器配置设置 rlimits、用户、capabilities 及 no_new_privs，
+ *          配置中有无法在此应用的限制（如 seccomp）时不可用，由 ll-box 启动进程
+ */
+class NamespaceExec
+{
+public:
+    /**
+     * @param initPid 容器内 init 进程在当前 pid 命名空间中的进程号
+     * @param config 容器的 OCI 配置，为空时不做额外限制
+     */
+    explicit NamespaceExec(pid_t initPid, const nlohmann::json &config = nlohmann::json::object());
+    ~NamespaceExec();
+
+    NamespaceExec(const NamespaceExec &) = delete;
+    NamespaceExec &operator=(const NamespaceExec &) = delete;
+
+    /**
+     * @brief 获取 ll-box 创建的容器 init 进程
+     *
+     * @param boxPid ll-box 进程号
+     *
+     * @return pid_t 容器 init 进程号，不存在时为 -1
+     */
+    static pid_t findInit(pid_t boxPid);
+
+    /**
+     * @brief 命名空间及根目录均已打开，且容器配置中的限制均可应用
+     */
+    bool isValid() const;
+
+    /**
+     * @brief 在容器内启动进程，不等待其退出，进程由容器 init 回收
+     *
+     * @param args 命令及参数，命令需为容器内的绝对路径或可在 PATH 中找到
+     * @param env 环境变量
+     * @param cwd 容器内的工作目录
+     *
+     * @return bool true:已 exec false:失败，调用方可改用 ll-box 启动
+     */
+    bool spawn(const std::vector<std::string> &args,
+               const std::vector<std::string> &env,
+               const std::string &cwd) const;
+
+private:
+    struct Namespace
+    {
+        int fd = -1;
+        int type = 0;
+    };
+
+    struct Rlimit
+    {
+        int resource = 0;
+        rlim_t soft = 0;
+        rlim_t hard = 0;
+    };
+
+    // 与 ll-box 启动的进程保持一致的限制，在 fork 前解析好
+    struct Restrictions
+    {
+        std::vector<Rlimit> rlimits;
+        bool setUser = false;
+        uid_t uid = 0;
+        gid_t gid = 0;
+        std::vector<gid_t> additionalGids;
+        bool setUmask = false;
+        mode_t umask = 0;
+        bool setCapabilities = false;
+        int lastCap = -1;
+        uint64_t bounding = 0;
+        uint64_t effective = 0;
+        uint64_t permitted = 0;
+        uint64_t inheritable = 0;
+        uint64_t ambient = 0;
+        bool noNewPrivileges = false;
+    };
+
+    /**
+     * @brief 解析 OCI 配置中的 process 限制
+     *
+     * @return bool false:含有无法应用的限制
+     */
+    bool parseRestrictions(const nlohmann::json &config);
+
+    /**
+     * @brief 在 exec 前的子进程中应用限制，只调用 async-signal-safe 的函数
+     *
+     * @return bool false:失败，errno 为失败原因
+     */
+    bool applyRestrictions() const;
+
+    Restrictions restrictions;
+    std::vector<Namespace> namespaces;
+    int rootFd = -1;
+    bool sameRoot = false;
+    bool valid = false;
+};
+
+} // namespace linglong::runtime
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "readahead_profile.h"
+
+#include "linglong/util/file.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace linglong::runtime {
+
+namespace {
+const quint32 kMagic = 0x4c4c5241; // "LLRA"
+// 格式变化时递增
+const quint32 kFormatVersion = 2;
+
+// 采样单个文件中已在页缓存中的区间
+QList<QPair<quint64, quint64>> residentRanges(const QString &path, quint64 size)
+{
+    QList<QPair<quint64, quint64>> ranges;
+    int fd = open(path.toLocal8Bit().constData(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0) {
+        // 非文件所有者不能使用 O_NOATIME
+        fd = open(path.toLocal8Bit().constData(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return ranges;
+    }
+
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return ranges;
+    }
+
+    const quint64 pageSize = static_cast<quint64>(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> pages((size + pageSize - 1) / pageSize);
+    if (mincore(addr, size, pages.data()) == 0) {
+        for (quint64 i = 0; i < pages.size(); ++i) {
+            if (!(pages[i] & 1)) {
+                continue;
+            }
+            const quint64 offset = i * pageSize;
+            // 与前一个区间相邻时合并
+            if (!ranges.isEmpty() && ranges.last().first + ranges.last().second == offset) {
+                ranges.last().second += pageSize;
+            } else {
+                ranges.append({ offset, pageSize });
+            }
+        }
+    }
+    munmap(addr, size);
+    return ranges;
+}
+} // namespace
+
+ReadaheadProfile::ReadaheadProfile(const QString &dir)
+    : dir(dir)
+{
+    if (this->dir.isEmpty()) {
+        this->dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+          + "/linglong/readahead";
+    }
+}
+
+QString ReadaheadProfile::keyOf(const QStringList &layerRoots)
+{
+    QStringList parts;
+    for (const auto &root : layerRoots) {
+        // 同一版本重新安装后 info.json 随之更新
+        parts.append(QDir::cleanPath(root) + "@" + util::fileStamp(root + "/info.json"));
+    }
+    return util::cacheKey(parts);
+}
+
+bool ReadaheadProfile::exists(const QString &key) const
+{
+    return QFile::exists(filePath(key));
+}
+
+bool ReadaheadProfile::load(const QString &key, QList<File> &files) const
+{
+    QFile file(filePath(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    QStringList layerRoots;
+    quint32 count = 0;
+    if (!readHeader(in, layerRoots, count)) {
+        return false;
+    }
+
+    files.clear();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        File entry;
+        in >> entry.path >> entry.ranges;
+        files.append(entry);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+bool ReadaheadProfile::save(const QString &key,
+                            const QStringList &layerRoots,
+                            const QList<File> &files) const
+{
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+
+    QSaveFile file(filePath(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_11);
+    out << kMagic << kFormatVersion << layerRoots << static_cast<quint32>(files.size());
+    for (const auto &entry : files) {
+        out << entry.path << entry.ranges;
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+int ReadaheadProfile::prune() const
+{
+    int removed = 0;
+    for (const auto &entry : QDir(dir).entryList({ "*.profile" }, QDir::Files)) {
+        const auto path = dir + "/" + entry;
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QDataStream in(&file);
+        QStringList layerRoots;
+        quint32 count = 0;
+        // 卸载或重新安装后 layer 的 info.json 变化，key 随之改变；旧格式的记录同样删除
+        const bool valid = readHeader(in, layerRoots, count)
+          && keyOf(layerRoots) == QFileInfo(entry).completeBaseName();
+        file.close();
+        if (!valid && QFile::remove(path)) {
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+auto ReadaheadProfile::record(const QStringList &roots) -> QList<File>
+{
+    QList<File> files;
+    for (const auto &root : roots) {
+        QDirIterator it(root, QDir::Files | QDir::NoSymLinks | QDir::Hidden,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext() && files.size() < kMaxFiles) {
+            it.next();
+            const auto info = it.fileInfo();
+            if (info.size() <= 0) {
+                continue;
+            }
+            auto ranges = residentRanges(info.filePath(), static_cast<quint64>(info.size()));
+            if (!ranges.isEmpty()) {
+                files.append({ info.filePath(), ranges });
+            }
+        }
+    }
+    return files;
+}
+
+auto ReadaheadProfile::subtract(const QList<File> &files, const QList<File> &baseline)
+  -> QList<File>
+{
+    QHash<QString, QList<QPair<quint64, quint64>>> resident;
+    for (const auto &entry : baseline) {
+        resident.insert(entry.path, entry.ranges);
+    }
+
+    QList<File> result;
+    for (const auto &entry : files) {
+        const auto it = resident.constFind(entry.path);
+        if (it == resident.constEnd()) {
+            result.append(entry);
+            continue;
+        }
+        // 两侧的区间均按偏移排列且互不重叠
+        File delta{ entry.path, {} };
+        auto base = it->cbegin();
+        for (const auto &range : entry.ranges) {
+            quint64 begin = range.first;
+            const quint64 end = range.first + range.second;
+            while (base != it->cend() && base->first + base->second <= begin) {
+                ++base;
+            }
+            for (auto cur = base; cur != it->cend() && cur->first < end; ++cur) {
+                if (cur->first > begin) {
+                    delta.ranges.append({ begin, cur->first - begin });
+                }
+                begin = qMax(begin, cur->first + cur->second);
+            }
+            if (begin < end) {
+                delta.ranges.append({ begin, end - begin });
+            }
+        }
+        if (!delta.ranges.isEmpty()) {
+            result.append(delta);
+        }
+    }
+    return result;
+}
+
+bool ReadaheadProfile::isWarm(const QList<File> &baseline,
+                              const QList<File> &files,
+                              const QString &root)
+{
+    const auto resident = sizeOf(baseline, root);
+    return resident > 0 && resident * 2 >= sizeOf(files, root);
+}
+
+quint64 ReadaheadProfile::sizeOf(const QList<File> &files, const QString &root)
+{
+    const auto prefix = QDir::cleanPath(root) + "/";
+    quint64 total = 0;
+    for (const auto &entry : files) {
+        if (!root.isEmpty() && !entry.path.startsWith(prefix)) {
+            continue;
+        }
+        for (const auto &range : entry.ranges) {
+            total += range.second;
+        }
+    }
+    return total;
+}
+
+quint64 ReadaheadProfile::replay(const QList<File> &files)
+{
+    quint64 total = 0;
+    for (const auto &entry : files) {
+        int fd = open(entry.path.toLocal8Bit().constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        for (const auto &range : entry.ranges) {
+            if (posix_fadvise(fd,
+                              static_cast<off_t>(range.first),
+                              static_cast<off_t>(range.second),
+                              POSIX_FADV_WILLNEED)
+                == 0) {
+                total += range.second;
+            }
+        }
+        close(fd);
+    }
+    return total;
+}
+
+QString ReadaheadProfile::filePath(const QString &key) const
+{
+    return dir + "/" + key + ".profile";
+}
+
+bool ReadaheadProfile::readHeader(QDataStream &in, QStringList &layerRoots, quint32 &count)
+{
+    in.setVersion(QDataStream::Qt_5_11);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != kMagic || version != kFormatVersion) {
+        return false;
+    }
+    in >> layerRoots >> count;
+    return in.status() == QDataStream::Ok;
+}
+
+} // namespace linglong::runtime
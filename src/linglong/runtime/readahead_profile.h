@@ -0,0 +1,115 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_RUNTIME_READAHEAD_PROFILE_H_
+#define LINGLONG_SRC_MODULE_RUNTIME_READAHEAD_PROFILE_H_
+
+#include <QDataStream>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+namespace linglong::runtime {
+
+/**
+ * @brief 应用冷启动的预读记录
+ * @details 没有记录的应用启动前后各通过 mincore 采样一次 layer 中已进入页缓存的文件区间，
+ *          只保存启动后新增的部分，启动前应用 layer 已大部分在页缓存中时不记录。之后启动时在准备
+ *          容器的同时使用 posix_fadvise(WILLNEED) 并行预读这些区间，减少 HDD、eMMC 上冷启动时的
+ *          缺页等待。页缓存中已有的区间不会产生额外的读取。
+ *          记录中保存 layer 目录，layer 被卸载或重新安装后由 prune 删除
+ */
+class ReadaheadProfile
+{
+public:
+    struct File
+    {
+        QString path;
+        // (偏移, 长度)，单位字节
+        QList<QPair<quint64, quint64>> ranges;
+    };
+
+    static constexpr int kMaxFiles = 20000;
+
+    /**
+     * @param dir 保存目录，为空时使用用户缓存目录下的 linglong/readahead
+     */
+    explicit ReadaheadProfile(const QString &dir = QString());
+
+    /**
+     * @brief 记录的条目名，由 layer 目录及其 info.json 的状态确定应用及 runtime 的版本
+     */
+    static QString keyOf(const QStringList &layerRoots);
+
+    bool exists(const QString &key) const;
+
+    bool load(const QString &key, QList<File> &files) const;
+
+    /**
+     * @param layerRoots 生成 key 的 layer 目录，用于判断记录是否过期
+     */
+    bool save(const QString &key, const QStringList &layerRoots, const QList<File> &files) const;
+
+    /**
+     * @brief 删除 layer 已被卸载或重新安装的记录
+     *
+     * @return int 删除的记录数
+     */
+    int prune() const;
+
+    /**
+     * @brief 采样目录下已在页缓存中的文件区间
+     *
+     * @param roots 采样的目录
+     *
+     * @return QList<File> 按目录遍历顺序排列的文件及区间
+     */
+    static QList<File> record(const QStringList &roots);
+
+    /**
+     * @brief 从采样结果中去掉基准中已有的区间
+     *
+     * @param files 启动后的采样
+     * @param baseline 启动前的采样
+     */
+    static QList<File> subtract(const QList<File> &files, const QList<File> &baseline);
+
+    /**
+     * @brief 启动前 root 下已在页缓存中的数据是否达到启动后的一半，此时增量不能代表冷启动
+     */
+    static bool isWarm(const QList<File> &baseline,
+                       const QList<File> &files,
+                       const QString &root);
+
+    /**
+     * @brief 区间的总字节数
+     *
+     * @param root 不为空时只统计该目录下的文件
+     */
+    static quint64 sizeOf(const QList<File> &files, const QString &root = QString());
+
+    /**
+     * @brief 预读记录中的文件区间，不等待读取完成
+     *
+     * @return quint64 提交预读的字节数
+     */
+    static quint64 replay(const QList<File> &files);
+
+    QString directory() const { return dir; }
+
+private:
+    QString filePath(const QString &key) const;
+
+    // 读取记录的文件头及 layer 目录，in 停在文件列表之前
+    static bool readHeader(QDataStream &in, QStringList &layerRoots, quint32 &count);
+
+    QString dir;
+};
+
+} // namespace linglong::runtime
+
+#endif
@@ -9,11 +9,20 @@
 #include "linglong/repo/ostree_repo.h"
 #include "linglong/repo/vfs_repo.h"
 #include "linglong/runtime/app.h"
+#include "linglong/runtime/launch_trace.h"
+#include "linglong/runtime/readahead_profile.h"
 #include "linglong/util/app_status.h"
+#include "linglong/util/config/config.h"
 #include "linglong/util/file.h"
+#include "linglong/util/installed_app_registry.h"
 #include "linglong/util/runner.h"
 #include "linglong/util/status_code.h"
 #include "linglong/util/sysinfo.h"
+#include "linglong/utils/finally/finally.h"
+
+#include <QDBusConnection>
+#include <QFile>
+#include <QTimer>
 
 #include <csignal>
 
@@ -23,6 +32,8 @@ namespace linglong::service {
 
 AppManager::AppManager()
     : runPool(new QThreadPool)
+    , boxPool(new runtime::BoxPool(util::config::ConfigInstance().boxPoolSize))
+    , containerReaper(new runtime::ContainerReaper)
 {
     // TODO: use config file to set repo backend
     if (qEnvironmentVariable("LINGLONG_REPO_BACKEND") == "vfs") {
@@ -31,11 +42,130 @@ AppManager::AppManager()
         repo = std::make_unique<repo::OSTreeRepo>(util::getLinglongRootPath());
     }
     runPool->setMaxThreadCount(RUN_POOL_MAX_THREAD);
+
+    connect(containerReaper.data(),
+            &runtime::ContainerReaper::containerExited,
+            this,
+            &AppManager::onContainerExited);
+
+    // 已安装软件包由 ll-package-manager 维护，变化时重新加载索引
+    watchPackageManagerPeer();
+    if (!QDBusConnection::systemBus().connect("org.deepin.linglong.PackageManager",
+                                              "/org/deepin/linglong/PackageManager",
+                                              "org.deepin.linglong.PackageManager1",
+                                              "InstalledAppsChanged",
+                                              this,
+                                              SLOT(onInstalledAppsChanged(QString)))) {
+        qWarning() << "failed to watch InstalledAppsChanged:"
+                   << QDBusConnection::systemBus().lastError().message();
+    }
+    // 未运行期间卸载或升级的应用收不到信号
+    pruneReadaheadProfiles();
+}
+
+void AppManager::watchPackageManagerPeer()
+{
+    // ll-package-manager 以 --no-dbus 方式运行时只在点对点 socket 上发出信号
+    const QString socketPath = "/run/linglong/package-manager.socket";
+    const QString connectionName = "ll-package-manager";
+    if (QDBusConnection(connectionName).isConnected() || !QFile::exists(socketPath)) {
+        return;
+    }
+
+    QDBusConnection::disconnectFromPeer(connectionName);
+    auto conn = QDBusConnection::connectToPeer("unix:path=" + socketPath, connectionName);
+    if (!conn.isConnected()) {
+        qDebug() << "failed to connect to" << socketPath << conn.lastError().message();
+        return;
+    }
+    if (!conn.connect("",
+                      "/org/deepin/linglong/PackageManager",
+                      "org.deepin.linglong.PackageManager1",
+                      "InstalledAppsChanged",
+                      this,
+                      SLOT(onInstalledAppsChanged(QString)))) {
+        qWarning() << "failed to watch InstalledAppsChanged on" << socketPath << ":"
+                   << conn.lastError().message();
+        return;
+    }
+    // 连接建立之前的变化收不到信号，重新加载索引
+    linglong::util::InstalledAppRegistry::instance()->invalidate();
+}
+
+void AppManager::onInstalledAppsChanged(const QString &appId)
+{
+    qDebug() << "installed apps changed:" << appId;
+    linglong::util::InstalledAppRegistry::instance()->invalidate();
+    pruneReadaheadProfiles();
+}
+
+void AppManager::pruneReadaheadProfiles()
+{
+    QtConcurrent::run([]() {
+        auto removed = runtime::ReadaheadProfile().prune();
+        if (removed > 0) {
+            qDebug() << "removed" << removed << "stale readahead profiles";
+        }
+    });
+}
+
+void AppManager::onContainerExited(const QString &containerId, qint64 pid, int status)
+{
+    qDebug() << "container" << containerId << "pid" << pid << "exited, status" << status;
+    auto app = apps.remove(containerId);
+    if (app) {
+        // FIXME: 删除代理socket临时文件
+        // FIXME: 清理资源，包括挂载的VFS等
+        app->release();
+    }
+}
+
+void AppManager::recordReadaheadProfile(const QStringList &layerRoots,
+                                        const QString &key,
+                                        const QList<runtime::ReadaheadProfile::File> &baseline,
+                                        int delaySeconds)
+{
+    // 定时器只能在所属线程中启动，采样耗时较长，在线程池中执行
+    QMetaObject::invokeMethod(
+      this,
+      [this, layerRoots, key, baseline, delaySeconds]() {
+          QTimer::singleShot(delaySeconds * 1000, this, [layerRoots, key, baseline]() {
+              QtConcurrent::run([layerRoots, key, baseline]() {
+                  auto files = runtime::ReadaheadProfile::record(layerRoots);
+                  // 启动前应用已在页缓存中时增量不完整，等待下一次冷启动
+                  if (runtime::ReadaheadProfile::isWarm(baseline, files, layerRoots.value(0))) {
+                      qDebug() << "skip readahead profile of warm launch" << layerRoots;
+                      return;
+                  }
+                  files = runtime::ReadaheadProfile::subtract(files, baseline);
+                  if (!runtime::ReadaheadProfile().save(key, layerRoots, files)) {
+                      qWarning() << "save readahead profile of" << layerRoots << "failed";
+                  }
+              });
+          });
+      },
+      Qt::QueuedConnection);
 }
 
 auto AppManager::Start(const RunParamOption &paramOption) -> Reply
 {
     qDebug() << "start" << paramOption.appId;
+    watchPackageManagerPeer();
+
+    // 获取user env list，其中的追踪配置只对本次启动生效，不传给应用
+    QStringList userEnvList = paramOption.appEnv;
+    QSharedPointer<runtime::LaunchTrace> trace;
+    QString tracePath;
+    if (runtime::LaunchTrace::takeFromEnv(userEnvList, tracePath)) {
+        trace.reset(new runtime::LaunchTrace(paramOption.appId.trimmed(), tracePath));
+        QMutexLocker locker(&launchTracesMutex);
+        launchTraces.append(trace);
+        while (launchTraces.size() > kMaxLaunchTraces) {
+            launchTraces.removeFirst();
+        }
+    }
+    runtime::LaunchTrace::Scope traceScope(trace.data());
+    runtime::LaunchTrace::Span checkSpan("AppManager::Start");
 
     QueryReply reply;
     reply.code = 0;
@@ -80,12 +210,6 @@ auto AppManager::Start(const RunParamOption &paramOption) -> Reply
             paramMap.insert(linglong::util::kKeyFilterIface, interfaceFilter);
         }
     }
-    // 获取user env list
-    QStringList userEnvList;
-    if (!paramOption.appEnv.isEmpty()) {
-        userEnvList = paramOption.appEnv;
-    }
-
     // 获取exec参数
     QStringList desktopExec;
     if (!paramOption.exec.isEmpty()) {
@@ -133,18 +257,32 @@ auto AppManager::Start(const RunParamOption &paramOption) -> Reply
         linglong::util::linkDirFiles(appUserServicePath, userSystemdServicePath);
     }
 
+    checkSpan.end();
+    const qint64 queuedUs = trace ? trace->elapsedUs() : 0;
+
     // FIXME: report error here.
     QFuture<void> future = QtConcurrent::run(runPool.data(), [=]() {
+        runtime::LaunchTrace::Scope traceScope(trace.data());
+        if (trace) {
+            trace->addEvent("queue", queuedUs, trace->elapsedUs() - queuedUs);
+        }
+        // 启动失败或应用已在运行时同样结束追踪
+        auto finishTrace = utils::finally::finally([trace]() {
+            if (trace) {
+                trace->finish();
+            }
+        });
+
         // 判断是否存在
         linglong::package::Ref ref("", channel, appId, version, arch, appModule);
 
         // 判断是否是正在运行应用
         auto latestAppRef = repo->latestOfRef(appId, version);
-        for (const auto &app : apps) {
-            if (latestAppRef.toString() == app->container->packageName) {
-                app->exec(desktopExec, {}, "");
-                return;
+        if (auto running = apps.waitByRef(latestAppRef.toString(), kLaunchTimeoutMsec)) {
+            if (auto err = running->exec(desktopExec, {}, "")) {
+                qCritical() << "exec in running app failed" << err;
             }
+            return;
         }
 
         auto app = linglong::runtime::App::load(repo.get(), ref, desktopExec);
@@ -155,12 +293,52 @@ auto AppManager::Start(const RunParamOption &paramOption) -> Reply
         }
         app->saveUserEnvList(userEnvList);
         app->setAppParamMap(paramMap);
-        auto it = apps.insert(app->container->id, app);
-        auto err = app->start();
+        app->setBoxPool(boxPool.data());
+        // 加载期间同一应用可能已被并发启动，等待其启动完成后在其中运行
+        if (!apps.insert(app)) {
+            auto running = apps.waitByRef(app->container->packageName, kLaunchTimeoutMsec);
+            if (!running) {
+                qCritical() << "concurrent launch of" << app->container->packageName << "failed";
+            } else if (auto err = running->exec(desktopExec, {}, "")) {
+                qCritical() << "exec in running app failed" << err;
+            }
+            return;
+        }
+        // 按记录预读应用及 runtime 的文件，与容器的准备并行进行
+        const int readaheadSeconds = util::config::ConfigInstance().readaheadRecordSeconds;
+        const auto layerRoots = app->layerRoots();
+        const auto readaheadKey = runtime::ReadaheadProfile::keyOf(layerRoots);
+        bool recordReadahead = false;
+        QList<runtime::ReadaheadProfile::File> readaheadBaseline;
+        if (readaheadSeconds > 0) {
+            if (runtime::ReadaheadProfile().exists(readaheadKey)) {
+                QtConcurrent::run([readaheadKey]() {
+                    QList<runtime::ReadaheadProfile::File> files;
+                    if (runtime::ReadaheadProfile().load(readaheadKey, files)) {
+                        auto size = runtime::ReadaheadProfile::replay(files);
+                        qDebug() << "readahead" << files.size() << "files," << size << "bytes";
+                    }
+                });
+            } else {
+                // 只记录本次启动读入的数据，排除其它应用已读入的 runtime 等
+                readaheadBaseline = runtime::ReadaheadProfile::record(layerRoots);
+                recordReadahead = true;
+            }
+        }
+
+        // ll-box 由 containerReaper 回收，启动后即释放线程
+        auto err = app->launch();
         if (err) {
             qCritical() << "start app failed" << err;
+            app->release();
+            apps.remove(app->container->id);
+            return;
+        }
+        apps.markLaunched(app->container->id);
+        containerReaper->watch(app->container->id, static_cast<pid_t>(app->container->pid));
+        if (recordReadahead) {
+            recordReadaheadProfile(layerRoots, readaheadKey, readaheadBaseline, readaheadSeconds);
         }
-        apps.erase(it);
     });
     // future.waitForFinished();
     return std::move(reply);
@@ -171,14 +349,16 @@ Reply AppManager::Exec(const ExecParamOption &paramOption)
     Reply reply;
     reply.code = STATUS_CODE(kFail);
     reply.message = "No such container " + paramOption.containerID;
-    auto const &containerID = paramOption.containerID;
-    for (auto it : apps) {
-        if (it->container->id == containerID) {
-            it->exec(paramOption.cmd, paramOption.env, paramOption.cwd);
-            reply.code = STATUS_CODE(kSuccess);
-            reply.message = "Exec successed";
+    auto app = apps.find(paramOption.containerID);
+    if (app) {
+        auto err = app->exec(paramOption.cmd, paramOption.env, paramOption.cwd);
+        if (err) {
+            reply.message = err.message();
+            qCritical() << "exec in" << paramOption.containerID << "failed:" << err;
             return reply;
         }
+        reply.code = STATUS_CODE(kSuccess);
+        reply.message = "Exec successed";
     }
     return reply;
 }
@@ -186,14 +366,13 @@ Reply AppManager::Exec(const ExecParamOption &paramOption)
 Reply AppManager::Stop(const QString &containerId)
 {
     Reply reply;
-    auto it = apps.find(containerId);
-    if (it == apps.end()) {
+    auto app = apps.find(containerId);
+    if (!app) {
         reply.code = STATUS_CODE(kUserInputParamErr);
         reply.message = "containerId:" + containerId + " not exist";
         qCritical() << reply.message;
         return reply;
     }
-    auto app = it->data();
     pid_t pid = app->container->pid;
     int ret = kill(pid, SIGKILL);
     if (ret != 0) {
@@ -207,11 +386,28 @@ Reply AppManager::Stop(const QString &containerId)
     return reply;
 }
 
+QueryReply AppManager::LaunchTraces()
+{
+    QJsonArray jsonArray;
+    {
+        QMutexLocker locker(&launchTracesMutex);
+        for (const auto &trace : launchTraces) {
+            jsonArray.push_back(trace->summary());
+        }
+    }
+
+    QueryReply reply;
+    reply.code = STATUS_CODE(kSuccess);
+    reply.message = "Success";
+    reply.result = QLatin1String(QJsonDocument(jsonArray).toJson(QJsonDocument::Compact));
+    return reply;
+}
+
 QueryReply AppManager::ListContainer()
 {
     QJsonArray jsonArray;
 
-    for (const auto &app : apps) {
+    for (const auto &app : apps.snapshot()) {
         auto container = QSharedPointer<Container>(new Container);
         container->id = app->container->id;
         container->pid = app->container->pid;
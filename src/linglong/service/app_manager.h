@@ -14,11 +14,17 @@
 #include "linglong/package/ref.h"
 #include "linglong/repo/repo.h"
 #include "linglong/runtime/app.h"
+#include "linglong/runtime/box_pool.h"
+#include "linglong/runtime/container_reaper.h"
+#include "linglong/runtime/launch_trace.h"
+#include "linglong/runtime/readahead_profile.h"
+#include "linglong/service/container_registry.h"
 
 #include <QDBusArgument>
 #include <QDBusContext>
 #include <QFuture>
 #include <QList>
+#include <QMutex>
 #include <QObject>
 #include <QScopedPointer>
 #include <QThreadPool>
@@ -86,13 +92,70 @@ public Q_SLOTS:
      */
     auto ListContainer() -> QueryReply;
 
+    /**
+     * @brief 查询最近开启了追踪的启动耗时
+     *
+     * @return QueryReply result 为 JSON 数组，每项包含应用 id、总耗时及各阶段耗时（毫秒）
+     */
+    auto LaunchTraces() -> QueryReply;
+
 public:
     // FIXME: ??? why this public?
     QScopedPointer<QThreadPool> runPool; ///< 启动应用线程池
+    QScopedPointer<linglong::runtime::BoxPool> boxPool; ///< 预先启动的 ll-box
+    QScopedPointer<linglong::runtime::ContainerReaper> containerReaper; ///< 回收 ll-box 进程
+
+private Q_SLOTS:
+    /**
+     * @brief 软件包安装、卸载后刷新已安装软件包索引
+     *
+     * @param appId 发生变化的软件包包名
+     */
+    void onInstalledAppsChanged(const QString &appId);
+
+    /**
+     * @brief 容器退出后移除对应的应用
+     *
+     * @param containerId 容器 id
+     * @param pid ll-box 进程号
+     * @param status waitpid 返回的状态
+     */
+    void onContainerExited(const QString &containerId, qint64 pid, int status);
 
 private:
-    QMap<QString, QSharedPointer<linglong::runtime::App>> apps = {};
+    /**
+     * @brief 连接以 --no-dbus 方式运行的 ll-package-manager，接收已安装软件包变化的信号
+     * @details 点对点 socket 在 ll-package-manager 启动后才出现，每次启动应用时检查，
+     *          已连接时直接返回，需在 DBus 所在线程调用
+     */
+    void watchPackageManagerPeer();
+
+    /**
+     * @brief 应用启动一段时间后记录预读数据，可在任意线程调用
+     *
+     * @param layerRoots 应用及 runtime 的 layer 目录
+     * @param key 预读记录的条目名
+     * @param baseline 启动前的采样，只记录启动后新增的区间
+     * @param delaySeconds 启动后等待的时长
+     */
+    void recordReadaheadProfile(const QStringList &layerRoots,
+                                const QString &key,
+                                const QList<runtime::ReadaheadProfile::File> &baseline,
+                                int delaySeconds);
+
+    // 删除已卸载或升级的应用的预读记录
+    void pruneReadaheadProfiles();
+
+    // 启动线程与 DBus 所在线程都会访问
+    ContainerRegistry apps;
+    // 同一应用正在启动时，后到的启动请求最长等待的时间
+    static constexpr unsigned long kLaunchTimeoutMsec = 30 * 1000;
     std::unique_ptr<linglong::repo::Repo> repo;
+
+    // 最近开启了追踪的启动，在启动线程中更新
+    static constexpr int kMaxLaunchTraces = 16;
+    QMutex launchTracesMutex;
+    QList<QSharedPointer<linglong::runtime::LaunchTrace>> launchTraces;
 };
 
 } // namespace service
@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "container_registry.h"
+
+#include <QElapsedTimer>
+
+namespace linglong::service {
+
+bool ContainerRegistry::insert(const AppPtr &app)
+{
+    const auto &id = app->container->id;
+    const auto &ref = app->container->packageName;
+
+    QWriteLocker locker(&lock);
+    if (byId.contains(id) || idByRef.contains(ref)) {
+        return false;
+    }
+    byId.insert(id, app);
+    idByRef.insert(ref, id);
+    return true;
+}
+
+bool ContainerRegistry::markLaunched(const QString &containerId)
+{
+    QWriteLocker locker(&lock);
+    if (!byId.contains(containerId)) {
+        return false;
+    }
+    launched.insert(containerId);
+    launchFinished.wakeAll();
+    return true;
+}
+
+auto ContainerRegistry::remove(const QString &containerId) -> AppPtr
+{
+    QWriteLocker locker(&lock);
+    auto app = byId.take(containerId);
+    if (!app) {
+        return app;
+    }
+    // 只移除指向该容器的索引
+    auto it = idByRef.find(app->container->packageName);
+    if (it != idByRef.end() && it.value() == containerId) {
+        idByRef.erase(it);
+    }
+    if (!launched.remove(containerId)) {
+        launchFinished.wakeAll();
+    }
+    return app;
+}
+
+auto ContainerRegistry::find(const QString &containerId) const -> AppPtr
+{
+    QReadLocker locker(&lock);
+    if (!launched.contains(containerId)) {
+        return nullptr;
+    }
+    return byId.value(containerId);
+}
+
+auto ContainerRegistry::findByRef(const QString &ref) const -> AppPtr
+{
+    QReadLocker locker(&lock);
+    auto it = idByRef.find(ref);
+    if (it == idByRef.end() || !launched.contains(it.value())) {
+        return nullptr;
+    }
+    return byId.value(it.value());
+}
+
+auto ContainerRegistry::waitByRef(const QString &ref, unsigned long msecs) -> AppPtr
+{
+    QElapsedTimer timer;
+    timer.start();
+    QReadLocker locker(&lock);
+    while (true) {
+        auto it = idByRef.find(ref);
+        if (it == idByRef.end()) {
+            return nullptr;
+        }
+        if (launched.contains(it.value())) {
+            return byId.value(it.value());
+        }
+        const auto elapsed = static_cast<unsigned long>(timer.elapsed());
+        if (elapsed >= msecs || !launchFinished.wait(&lock, msecs - elapsed)) {
+            return nullptr;
+        }
+    }
+}
+
+auto ContainerRegistry::snapshot() const -> QList<AppPtr>
+{
+    QReadLocker locker(&lock);
+    QList<AppPtr> apps;
+    for (const auto &id : launched) {
+        apps.append(byId.value(id));
+    }
+    return apps;
+}
+
+int ContainerRegistry::size() const
+{
+    QReadLocker locker(&lock);
+    return byId.size();
+}
+
+} // namespace linglong::service
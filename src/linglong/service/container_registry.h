@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_SERVICE_CONTAINER_REGISTRY_H_
+#define LINGLONG_SRC_SERVICE_CONTAINER_REGISTRY_H_
+
+#include "linglong/runtime/app.h"
+
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QWaitCondition>
+
+namespace linglong::service {
+
+/**
+ * @brief 运行中的容器索引
+ * @details 按容器 id 及软件包 ref 索引，可在启动线程与 DBus 所在线程中同时访问。
+ *          启动前先登记以占用 ref，启动成功后才能被查询到；
+ *          查询持有读锁，返回的 App 由 QSharedPointer 持有，容器退出后仍可安全使用
+ */
+class ContainerRegistry
+{
+public:
+    using AppPtr = QSharedPointer<linglong::runtime::App>;
+
+    /**
+     * @brief 登记尚未启动的容器，同一 ref 已有容器在运行或启动中时不登记
+     *
+     * @param app 已创建容器的应用
+     *
+     * @return bool true:登记成功 false:该 ref 或容器 id 已存在
+     */
+    bool insert(const AppPtr &app);
+
+    /**
+     * @brief 容器启动成功，此后可被查询到，并唤醒等待该 ref 的线程
+     *
+     * @param containerId 容器 id
+     *
+     * @return bool 容器是否已登记
+     */
+    bool markLaunched(const QString &containerId);
+
+    /**
+     * @brief 移除容器，启动失败时同样唤醒等待该 ref 的线程
+     *
+     * @param containerId 容器 id
+     *
+     * @return AppPtr 被移除的应用，不存在时为空
+     */
+    AppPtr remove(const QString &containerId);
+
+    /**
+     * @brief 查找已启动的容器
+     */
+    AppPtr find(const QString &containerId) const;
+
+    /**
+     * @brief 查找运行中的软件包，启动中的不返回
+     *
+     * @param ref 软件包 ref，与 Container::packageName 一致
+     */
+    AppPtr findByRef(const QString &ref) const;
+
+    /**
+     * @brief 同 findByRef，该 ref 正在启动时等待启动结束
+     *
+     * @param ref 软件包 ref
+     * @param msecs 最长等待时间
+     *
+     * @return AppPtr 启动成功的应用，未登记、启动失败或超时时为空
+     */
+    AppPtr waitByRef(const QString &ref, unsigned long msecs);
+
+    /**
+     * @brief 当前所有已启动容器的快照
+     */
+    QList<AppPtr> snapshot() const;
+
+    /**
+     * @brief 已登记的容器数，包括启动中的容器
+     */
+    int size() const;
+
+private:
+    mutable QReadWriteLock lock;
+    QHash<QString, AppPtr> byId;
+    QHash<QString, QString> idByRef;
+    QSet<QString> launched;
+    QWaitCondition launchFinished;
+};
+
+} // namespace linglong::service
+
+#endif
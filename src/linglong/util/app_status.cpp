@@ -8,6 +8,7 @@
 
 #include "linglong/util/connection.h"
 #include "linglong/util/file.h"
+#include "linglong/util/installed_app_registry.h"
 #include "linglong/util/status_code.h"
 #include "linglong/util/version/version.h"
 
@@ -17,11 +18,111 @@
 // 安装数据库路径
 const QString installedAppInfoPath = linglong::util::getLinglongRootPath();
 // 安装数据库版本
-const QString infoDbVersion = "1.0.0";
+const QString infoDbVersion = "1.1.0";
 
 namespace linglong {
 namespace util {
 
+namespace {
+/*
+ * 追加等值查询条件，条件值通过参数绑定，不拼接进sql语句
+ *
+ * @param sql: 待追加条件的sql语句
+ * @param valueMap: 参数绑定表
+ * @param column: 列名
+ * @param value: 列值，为空时不追加条件
+ */
+void appendCondition(QString &sql,
+                     QVariantMap &valueMap,
+                     const QString &column,
+                     const QString &value)
+{
+    if (value.isEmpty()) {
+        return;
+    }
+    sql.append(QString(" AND %1 = :%1").arg(column));
+    valueMap.insert(":" + column, value);
+}
+
+/*
+ * 1.1.0 版本数据库迁移：增加数值版本排序列及 (appId, module, channel, arch) 复合索引
+ *
+ * @param connection: 数据库连接
+ *
+ * @return int: 0:成功 其它:失败
+ */
+int migrateVersionKey(Connection &connection)
+{
+    QSqlQuery sqlQuery = connection.execute("PRAGMA table_info(installedAppInfo)");
+    bool hasVersionKey = false;
+    while (sqlQuery.next()) {
+        if ("versionKey" == sqlQuery.value(1).toString()) {
+            hasVersionKey = true;
+            break;
+        }
+    }
+
+    if (!hasVersionKey) {
+        sqlQuery = connection.execute(
+          "ALTER TABLE installedAppInfo ADD COLUMN versionKey INTEGER DEFAULT 0");
+        if (QSqlError::NoError != sqlQuery.lastError().type()) {
+            qCritical() << "add versionKey column error:" << sqlQuery.lastError().text();
+            return STATUS_CODE(kFail);
+        }
+    }
+
+    // 回填已安装记录的版本排序键
+    sqlQuery = connection.execute("SELECT DISTINCT version FROM installedAppInfo");
+    QStringList versions;
+    while (sqlQuery.next()) {
+        versions << sqlQuery.value(0).toString().trimmed();
+    }
+    sqlQuery.finish();
+    for (const auto &version : versions) {
+        QVariantMap valueMap;
+        valueMap.insert(":version", version);
+        valueMap.insert(":versionKey", AppVersion(version).sortKey());
+        sqlQuery = connection.execute(
+          "UPDATE installedAppInfo SET versionKey = :versionKey WHERE version = :version",
+          valueMap);
+        if (QSqlError::NoError != sqlQuery.lastError().type()) {
+            qCritical() << "update versionKey error:" << sqlQuery.lastError().text();
+            return STATUS_CODE(kFail);
+        }
+    }
+
+    sqlQuery = connection.execute(
+      "CREATE INDEX IF NOT EXISTS installedAppInfo_ref_index "
+      "ON installedAppInfo(appId, module, channel, arch, versionKey)");
+    if (QSqlError::NoError != sqlQuery.lastError().type()) {
+        qCritical() << "create installedAppInfo index error:" << sqlQuery.lastError().text();
+        return STATUS_CODE(kFail);
+    }
+    return STATUS_CODE(kSuccess);
+}
+
+/*
+ * 读取installedAppInfo表的一行记录
+ *
+ * @param sqlQuery: 指向当前记录的查询结果
+ *
+ * @return QSharedPointer<linglong::package::AppMetaInfo>: 软件包信息
+ */
+QSharedPointer<linglong::package::AppMetaInfo> appMetaInfoFromRecord(const QSqlQuery &sqlQuery)
+{
+    auto info = QSharedPointer<linglong::package::AppMetaInfo>(new linglong::package::AppMetaInfo);
+    info->appId = sqlQuery.value(1).toString().trimmed();
+    info->name = sqlQuery.value(2).toString().trimmed();
+    info->version = sqlQuery.value(3).toString().trimmed();
+    info->arch = sqlQuery.value(4).toString().trimmed();
+    info->description = sqlQuery.value(9).toString().trimmed();
+    info->user = sqlQuery.value(10).toString().trimmed();
+    info->channel = sqlQuery.value(13).toString().trimmed();
+    info->module = sqlQuery.value(14).toString().trimmed();
+    return info;
+}
+} // namespace
+
 /*
  * 检查安装信息数据库表及版本信息表
  *
@@ -44,7 +145,8 @@ int checkInstalledAppDb()
          installType CHAR(16) DEFAULT 'user',\
          size INTEGER,\
          channel VARCHAR(32),\
-         module VARCHAR(32),unique(appId,version,arch,channel,module))";
+         module VARCHAR(32),\
+         versionKey INTEGER DEFAULT 0,unique(appId,version,arch,channel,module))";
     Connection connection;
     QSqlQuery sqlQuery = connection.execute(createInfoTable);
     if (QSqlError::NoError != sqlQuery.lastError().type()) {
@@ -69,10 +171,22 @@ int checkInstalledAppDb()
  * @return int: 0:成功 其它:失败
  */
 int updateInstalledAppInfoDb()
+{
+    Connection connection;
+    return updateInstalledAppInfoDb(connection);
+}
+
+/*
+ * 在指定数据库连接上更新安装数据库版本
+ *
+ * @param connection: 数据库连接
+ *
+ * @return int: 0:成功 其它:失败
+ */
+int updateInstalledAppInfoDb(Connection &connection)
 {
     // 版本升序排列
     QString selectSql = "SELECT * FROM appInfoDbVersion order by version ASC ";
-    Connection connection;
     QSqlQuery sqlQuery = connection.execute(selectSql);
     if (QSqlError::NoError != sqlQuery.lastError().type()) {
         qCritical() << "execute selectSql error:" << sqlQuery.lastError().text();
@@ -80,32 +194,46 @@ int updateInstalledAppInfoDb()
     }
 
     // sqlite3不支持size属性
-    sqlQuery.last();
-    int recordCount = sqlQuery.at() + 1;
-    // 首次安装
-    QString description = "create appinfodb version";
-    QString insertSql = "";
-    if (recordCount < 1) {
-        insertSql = QString("INSERT INTO appInfoDbVersion VALUES('%1','%2')")
-                      .arg(infoDbVersion)
-                      .arg(description);
-    } else {
-        // fix to do update version
-        QString currentVersion = sqlQuery.value(0).toString().trimmed();
-        if (currentVersion < infoDbVersion) {
-            insertSql = QString("INSERT INTO appInfoDbVersion VALUES('%1','%2')")
-                          .arg(infoDbVersion)
-                          .arg(description);
-        }
-        qDebug() << "installedAppInfoDb currentVersion:" << currentVersion
-                 << ", dstVersion:" << infoDbVersion;
+    QString currentVersion = "";
+    if (sqlQuery.last()) {
+        currentVersion = sqlQuery.value(0).toString().trimmed();
     }
-    if (!insertSql.isEmpty()) {
-        sqlQuery = connection.execute(insertSql);
-        if (QSqlError::NoError != sqlQuery.lastError().type()) {
-            qCritical() << "execute insertSql error:" << sqlQuery.lastError().text();
-            return STATUS_CODE(kFail);
-        }
+    sqlQuery.finish();
+    qDebug() << "installedAppInfoDb currentVersion:" << currentVersion
+             << ", dstVersion:" << infoDbVersion;
+    if (!currentVersion.isEmpty() && !(currentVersion < infoDbVersion)) {
+        return STATUS_CODE(kSuccess);
+    }
+
+    // 首次安装或需要升级
+    const QString description =
+      currentVersion.isEmpty() ? "create appinfodb version" : "add versionKey and ref index";
+    sqlQuery = connection.execute("BEGIN IMMEDIATE");
+    if (QSqlError::NoError != sqlQuery.lastError().type()) {
+        qCritical() << "begin migration error:" << sqlQuery.lastError().text();
+        return STATUS_CODE(kFail);
+    }
+    if (STATUS_CODE(kSuccess) != migrateVersionKey(connection)) {
+        connection.execute("ROLLBACK");
+        return STATUS_CODE(kFail);
+    }
+
+    QVariantMap valueMap;
+    valueMap.insert(":version", infoDbVersion);
+    valueMap.insert(":description", description);
+    sqlQuery = connection.execute(
+      "INSERT OR REPLACE INTO appInfoDbVersion VALUES(:version, :description)",
+      valueMap);
+    if (QSqlError::NoError != sqlQuery.lastError().type()) {
+        qCritical() << "execute insertSql error:" << sqlQuery.lastError().text();
+        connection.execute("ROLLBACK");
+        return STATUS_CODE(kFail);
+    }
+    sqlQuery = connection.execute("COMMIT");
+    if (QSqlError::NoError != sqlQuery.lastError().type()) {
+        qCritical() << "commit migration error:" << sqlQuery.lastError().text();
+        connection.execute("ROLLBACK");
+        return STATUS_CODE(kFail);
     }
 
     return STATUS_CODE(kSuccess);
@@ -122,12 +250,11 @@ int updateInstalledAppInfoDb()
  */
 int insertAppRecord(QSharedPointer<linglong::package::AppMetaInfo> package, const QString &userName)
 {
-    Connection connection;
     QString insertSql = "INSERT INTO "
                         "installedAppInfo(appId,name,version,arch,kind,runtime,uabUrl,repoName,"
-                        "description,user,size,channel,module) "
+                        "description,user,size,channel,module,versionKey) "
                         "VALUES(:appId,:name,:version,:arch,:kind,:runtime,:uabUrl,:repoName,:"
-                        "description,:user,:size,:channel,:module)";
+                        "description,:user,:size,:channel,:module,:versionKey)";
     QVariantMap valueMap;
     valueMap.insert(":appId", package->appId);
     valueMap.insert(":name", package->name);
@@ -142,9 +269,17 @@ int insertAppRecord(QSharedPointer<linglong::package::AppMetaInfo> package, cons
     valueMap.insert(":size", package->size);
     valueMap.insert(":channel", package->channel);
     valueMap.insert(":module", package->module);
-    QSqlQuery sqlQuery = connection.execute(insertSql, valueMap);
-    if (QSqlError::NoError != sqlQuery.lastError().type()) {
-        qCritical() << "execute insertSql error:" << sqlQuery.lastError().text();
+    valueMap.insert(":versionKey", AppVersion(package->version).sortKey());
+    auto persist = [&]() -> bool {
+        Connection connection;
+        QSqlQuery sqlQuery = connection.execute(insertSql, valueMap);
+        if (QSqlError::NoError != sqlQuery.lastError().type()) {
+            qCritical() << "execute insertSql error:" << sqlQuery.lastError().text();
+            return false;
+        }
+        return true;
+    };
+    if (!InstalledAppRegistry::instance()->insert(package, userName, persist)) {
         return STATUS_CODE(kFail);
     }
     qDebug() << "insertAppRecord app:" << package->appId << ", version:" << package->version
@@ -171,35 +306,34 @@ int deleteAppRecord(const QString &appId,
                     const QString &module,
                     const QString &userName)
 {
-    // 若未指定版本，则查找最高版本
     QString dstVer = appVer;
-    QString deleteSql =
-      QString("DELETE FROM installedAppInfo WHERE appId = '%1' AND version = '%2'")
-        .arg(appId)
-        .arg(dstVer);
-    QString condition = "";
-    if (!appArch.isEmpty()) {
-        condition.append(QString(" AND arch like '%%1%'").arg(appArch));
-    }
-
-    if (!channel.isEmpty()) {
-        condition.append(QString(" AND channel = '%1'").arg(channel));
-    }
-    if (!module.isEmpty()) {
-        condition.append(QString(" AND module = '%1'").arg(module));
-    }
-
-    if (!userName.isEmpty()) {
-        condition.append(QString(" AND user = '%1'").arg(userName));
-    }
-    deleteSql.append(condition);
+    QString deleteSql = "DELETE FROM installedAppInfo WHERE appId = :appId AND version = :version";
+    QVariantMap valueMap;
+    valueMap.insert(":appId", appId);
+    valueMap.insert(":version", dstVer);
+    appendCondition(deleteSql, valueMap, "arch", appArch);
+    appendCondition(deleteSql, valueMap, "channel", channel);
+    appendCondition(deleteSql, valueMap, "module", module);
+    appendCondition(deleteSql, valueMap, "user", userName);
 
     qDebug().noquote() << "sql:" << deleteSql;
 
-    Connection connection;
-    QSqlQuery sqlQuery = connection.execute(deleteSql);
-    if (QSqlError::NoError != sqlQuery.lastError().type()) {
-        qCritical() << "execute deleteSql error:" << sqlQuery.lastError().text();
+    auto persist = [&]() -> bool {
+        Connection connection;
+        QSqlQuery sqlQuery = connection.execute(deleteSql, valueMap);
+        if (QSqlError::NoError != sqlQuery.lastError().type()) {
+            qCritical() << "execute deleteSql error:" << sqlQuery.lastError().text();
+            return false;
+        }
+        return true;
+    };
+    if (!InstalledAppRegistry::instance()->remove(appId,
+                                                  dstVer,
+                                                  appArch,
+                                                  channel,
+                                                  module,
+                                                  userName,
+                                                  persist)) {
         return STATUS_CODE(kFail);
     }
     qDebug() << "delete app:" << appId << ", version:" << dstVer << ", arch:" << appArch
@@ -244,41 +378,43 @@ bool getAppInstalledStatus(const QString &appId,
                            const QString &module,
                            const QString &userName)
 {
-    QString selectSql = QString("SELECT * FROM installedAppInfo WHERE appId = '%1'").arg(appId);
-    QString condition = "";
     // FIXME: 预装应用类型应该为system，目前未实现
     // 暂时不用区分用户，当前应用安装目录未区分用户
     // 若区分用户，当前升级镜像后切普通用户预装应用可以重复安装
     // runtime不区分用户
-    if (!isRuntime(appId) && !userName.isEmpty()) {
-        condition.append(QString(" AND user = '%1'").arg(userName));
-    }
-    if (!appVer.isEmpty()) {
-        condition.append(QString(" AND version = '%1'").arg(appVer));
-    }
-    if (!appArch.isEmpty()) {
-        condition.append(QString(" AND arch like '%%1%'").arg(appArch));
-    }
-    if (!channel.isEmpty()) {
-        condition.append(QString(" AND channel = '%1'").arg(channel));
-    }
-    if (!module.isEmpty()) {
-        condition.append(QString(" AND module = '%1'").arg(module));
+    const QString user = isRuntime(appId) ? "" : userName;
+    auto registry = InstalledAppRegistry::instance();
+    if (registry->ensureLoaded()) {
+        if (!registry->contains(appId, appVer, appArch, channel, module, user)) {
+            qDebug() << "getAppInstalledStatus app:" + appId + ",version:" + appVer + ",channel:"
+                + channel + ",module:" + module + ",userName:" + userName + " not installed";
+            return false;
+        }
+        return true;
     }
-    selectSql.append(condition);
+
+    // 内存索引不可用时直接查询数据库
+    QString selectSql = "SELECT 1 FROM installedAppInfo WHERE appId = :appId";
+    QVariantMap valueMap;
+    valueMap.insert(":appId", appId);
+    appendCondition(selectSql, valueMap, "module", module);
+    appendCondition(selectSql, valueMap, "channel", channel);
+    appendCondition(selectSql, valueMap, "arch", appArch);
+    appendCondition(selectSql, valueMap, "version", appVer);
+    appendCondition(selectSql, valueMap, "user", user);
+    selectSql.append(" LIMIT 1");
 
     qDebug().noquote() << "sql:" << selectSql;
     Connection connection;
-    QSqlQuery sqlQuery = connection.execute(selectSql);
+    QSqlQuery sqlQuery = connection.execute(selectSql, valueMap);
     if (QSqlError::NoError != sqlQuery.lastError().type()) {
         qCritical() << "execute sql error:" << sqlQuery.lastError().text();
         return false;
     }
     // 指定用户和版本找不到
-    // sqlite3不支持size属性
-    sqlQuery.last();
-    int recordCount = sqlQuery.at() + 1;
-    if (recordCount < 1) {
+    const bool found = sqlQuery.next();
+    sqlQuery.finish();
+    if (!found) {
         qDebug() << "getAppInstalledStatus app:" + appId + ",version:" + appVer + ",channel:"
             + channel + ",module:" + module + ",userName:" + userName + " not installed";
         return false;
@@ -309,43 +445,31 @@ bool getAllVerAppInfo(const QString &appId,
         return false;
     }
 
-    QString selectSql = QString("SELECT * FROM installedAppInfo WHERE appId = '%1'").arg(appId);
-    QString condition = "";
-    if (!userName.isEmpty()) {
-        condition.append(QString(" AND user = '%1'").arg(userName));
-    }
-    if (!appVer.isEmpty()) {
-        condition.append(QString(" AND version = '%1'").arg(appVer));
-    }
-    if (!appArch.isEmpty()) {
-        condition.append(QString(" AND arch like '%%1%'").arg(appArch));
+    auto registry = InstalledAppRegistry::instance();
+    if (registry->ensureLoaded()) {
+        pkgList.append(registry->find(appId, appVer, appArch, "", "", userName));
+        return true;
     }
 
-    selectSql.append(condition);
-    selectSql.append(" order by version ASC");
+    QString selectSql = "SELECT * FROM installedAppInfo WHERE appId = :appId";
+    QVariantMap valueMap;
+    valueMap.insert(":appId", appId);
+    appendCondition(selectSql, valueMap, "arch", appArch);
+    appendCondition(selectSql, valueMap, "version", appVer);
+    appendCondition(selectSql, valueMap, "user", userName);
+    selectSql.append(" order by versionKey ASC");
     qDebug() << selectSql;
 
     Connection connection;
-    QSqlQuery sqlQuery = connection.execute(selectSql);
+    QSqlQuery sqlQuery = connection.execute(selectSql, valueMap);
     if (QSqlError::NoError != sqlQuery.lastError().type()) {
         qCritical() << "execute selectSql error:" << sqlQuery.lastError().text();
         return false;
     }
-    sqlQuery.first();
-    do {
-        auto info =
-          QSharedPointer<linglong::package::AppMetaInfo>(new linglong::package::AppMetaInfo);
-        info->appId = sqlQuery.value(1).toString().trimmed();
-        info->name = sqlQuery.value(2).toString().trimmed();
-        info->arch = sqlQuery.value(4).toString().trimmed();
-        info->description = sqlQuery.value(9).toString().trimmed();
-        info->user = sqlQuery.value(10).toString().trimmed();
-        info->version = sqlQuery.value(3).toString().trimmed();
-        info->channel = sqlQuery.value(13).toString().trimmed();
-        info->module = sqlQuery.value(14).toString().trimmed();
-        pkgList.push_back(info);
-
-    } while (sqlQuery.next());
+    while (sqlQuery.next()) {
+        pkgList.push_back(appMetaInfoFromRecord(sqlQuery));
+    }
+    sqlQuery.finish();
     return true;
 }
 
@@ -370,72 +494,47 @@ bool getInstalledAppInfo(const QString &appId,
                          const QString &userName,
                          QList<QSharedPointer<linglong::package::AppMetaInfo>> &pkgList)
 {
-    if (!getAppInstalledStatus(appId, appVer, appArch, channel, module, userName)) {
-        qCritical() << "getInstalledAppInfo app:" + appId + ",version:" + appVer + ",channel:"
-            + channel + ",module:" + module + ",userName:" + userName + " not installed";
-        return false;
-    }
-
-    QString selectSql = QString("SELECT * FROM installedAppInfo WHERE appId = '%1'").arg(appId);
-    QString condition = "";
-    if (!userName.isEmpty()) {
-        condition.append(QString(" AND user = '%1'").arg(userName));
-    }
-    if (!appVer.isEmpty()) {
-        condition.append(QString(" AND version = '%1'").arg(appVer));
-    }
-    if (!appArch.isEmpty()) {
-        condition.append(QString(" AND arch like '%%1%'").arg(appArch));
-    }
-    if (!channel.isEmpty()) {
-        condition.append(QString(" AND channel = '%1'").arg(channel));
-    }
-    if (!module.isEmpty()) {
-        condition.append(QString(" AND module = '%1'").arg(module));
+    auto registry = InstalledAppRegistry::instance();
+    if (registry->ensureLoaded()) {
+        // 按版本号数值升序排列，多个版本返回最高版本信息
+        auto result = registry->find(appId, appVer, appArch, channel, module, userName);
+        if (result.isEmpty()) {
+            qCritical() << "getInstalledAppInfo app:" + appId + ",version:" + appVer + ",channel:"
+                + channel + ",module:" + module + ",userName:" + userName + " not installed";
+            return false;
+        }
+        pkgList.push_back(result.last());
+        return true;
     }
 
-    selectSql.append(condition);
-    selectSql.append(" order by version ASC");
+    QString selectSql = "SELECT * FROM installedAppInfo WHERE appId = :appId";
+    QVariantMap valueMap;
+    valueMap.insert(":appId", appId);
+    appendCondition(selectSql, valueMap, "module", module);
+    appendCondition(selectSql, valueMap, "channel", channel);
+    appendCondition(selectSql, valueMap, "arch", appArch);
+    appendCondition(selectSql, valueMap, "version", appVer);
+    appendCondition(selectSql, valueMap, "user", userName);
+    // 多个版本返回最高版本信息，versionKey 按数值排序，避免 5.9.1 比 5.10.1 版本高
+    selectSql.append(" order by versionKey DESC LIMIT 1");
     qDebug() << selectSql;
 
     Connection connection;
-    QSqlQuery sqlQuery = connection.execute(selectSql);
+    QSqlQuery sqlQuery = connection.execute(selectSql, valueMap);
     if (QSqlError::NoError != sqlQuery.lastError().type()) {
         qCritical() << "execute selectSql error:" << sqlQuery.lastError().text();
         return false;
     }
 
-    // int fieldNo = sqlQuery.record().indexOf("appId");
-    // 多个版本返回最高版本信息
-    sqlQuery.last();
-    int recordCount = sqlQuery.at() + 1;
-    if (recordCount > 0) {
-        auto info =
-          QSharedPointer<linglong::package::AppMetaInfo>(new linglong::package::AppMetaInfo);
-        info->appId = sqlQuery.value(1).toString().trimmed();
-        info->name = sqlQuery.value(2).toString().trimmed();
-        info->arch = sqlQuery.value(4).toString().trimmed();
-        info->description = sqlQuery.value(9).toString().trimmed();
-        info->user = sqlQuery.value(10).toString().trimmed();
-        info->channel = sqlQuery.value(13).toString().trimmed();
-        info->module = sqlQuery.value(14).toString().trimmed();
-        QString dstVer = sqlQuery.value(3).toString().trimmed();
-        // sqlite逐字符比较导致获取的最高版本号不准，e.g: 5.9.1比5.10.1版本高
-        sqlQuery.first();
-        do {
-            QString verIter = sqlQuery.value(3).toString().trimmed();
-            linglong::util::AppVersion versionIter(verIter);
-            linglong::util::AppVersion dstVersion(dstVer);
-            if (versionIter.isValid() && versionIter.isBigThan(dstVersion)) {
-                dstVer = verIter;
-                info->description = sqlQuery.value(9).toString().trimmed();
-            }
-        } while (sqlQuery.next());
-        info->version = dstVer;
-        pkgList.push_back(info);
-        return true;
+    if (!sqlQuery.next()) {
+        sqlQuery.finish();
+        qCritical() << "getInstalledAppInfo app:" + appId + ",version:" + appVer + ",channel:"
+            + channel + ",module:" + module + ",userName:" + userName + " not installed";
+        return false;
     }
-    return false;
+    pkgList.push_back(appMetaInfoFromRecord(sqlQuery));
+    sqlQuery.finish();
+    return true;
 }
 
 /*
@@ -450,17 +549,13 @@ bool getInstalledAppInfo(const QString &appId,
 bool queryAllInstalledApp(const QString &userName, QString &result, QString &err)
 {
     // 默认不查找版本
-    QString selectSql = "";
-    if (userName.isEmpty()) {
-        selectSql = QString("SELECT * FROM installedAppInfo order by appId,version");
-    } else {
-        selectSql =
-          QString("SELECT * FROM installedAppInfo WHERE user = '%1' order by appId,version")
-            .arg(userName);
-    }
+    QString selectSql = "SELECT * FROM installedAppInfo WHERE 1 = 1";
+    QVariantMap valueMap;
+    appendCondition(selectSql, valueMap, "user", userName);
+    selectSql.append(" order by appId,versionKey");
 
     Connection connection;
-    QSqlQuery sqlQuery = connection.execute(selectSql);
+    QSqlQuery sqlQuery = connection.execute(selectSql, valueMap);
     if (QSqlError::NoError != sqlQuery.lastError().type()) {
         qCritical() << "execute selectSql error:" << sqlQuery.lastError().text();
         err = "SQL error check log for detail";
@@ -483,6 +578,7 @@ bool queryAllInstalledApp(const QString &userName, QString &result, QString &err
         appItem["module"] = sqlQuery.value(14).toString().trimmed();
         appList.append(appItem);
     }
+    sqlQuery.finish();
     QJsonDocument document = QJsonDocument(appList);
     result = QString(document.toJson());
     return true;
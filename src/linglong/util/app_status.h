@@ -31,6 +31,17 @@ int checkInstalledAppDb();
  */
 int updateInstalledAppInfoDb();
 
+class Connection;
+
+/*
+ * 在指定数据库连接上更新安装数据库版本，从旧版本升级时补充 versionKey 列及索引
+ *
+ * @param connection: 数据库连接
+ *
+ * @return int: 0:成功 其它:失败
+ */
+int updateInstalledAppInfoDb(Connection &connection);
+
 /*
  * 增加软件包安装信息
  *
@@ -6,15 +6,201 @@
 
 #include "appinfo_cache.h"
 
+#include "linglong/util/connection.h"
 #include "linglong/util/file.h"
 #include "linglong/util/status_code.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadStorage>
+
+#include <atomic>
+
 // app 缓存有效期 秒为单位
 const int kCacheValidTime = 10 * 60;
 
+// 过期缓存批量清理间隔 秒为单位
+const int kCachePurgeInterval = 60;
+
+// 缓存表结构版本，保存在 PRAGMA user_version 中
+const int kCacheSchemaVersion = 1;
+
 namespace linglong {
 namespace util {
 
+namespace {
+
+QMutex cacheDbPathMutex;
+QString cacheDbPath;
+// 数据库路径变更计数，路径变化后各线程重建连接
+std::atomic<int> cacheDbGeneration{ 0 };
+
+// 上次批量清理过期缓存的时间戳，所有线程共享
+std::atomic<qint64> lastPurgeTime{ 0 };
+
+QString appInfoCacheDbPath()
+{
+    QMutexLocker locker(&cacheDbPathMutex);
+    if (cacheDbPath.isEmpty()) {
+        // 多用户支持 deepin-linglong 无home目录
+        return linglong::util::getLinglongRootPath() + "/.appInfoCache.db";
+    }
+    return cacheDbPath;
+}
+
+/*
+ * 每个线程持有一个长连接以及预编译的查询语句，线程退出时由 QThreadStorage 释放
+ */
+class CacheConnection
+{
+public:
+    CacheConnection()
+        : generation(cacheDbGeneration.load())
+        , name(QString("cache_package_connection_%1")
+                 .arg(reinterpret_cast<quintptr>(QThread::currentThreadId())))
+    {
+    }
+
+    ~CacheConnection()
+    {
+        selectQuery.reset();
+        upsertQuery.reset();
+        purgeQuery.reset();
+        dbConn.close();
+        dbConn = QSqlDatabase();
+        QSqlDatabase::removeDatabase(name);
+    }
+
+    int open()
+    {
+        if (dbConn.isOpen()) {
+            return STATUS_CODE(kSuccess);
+        }
+
+        const QString dbPath = appInfoCacheDbPath();
+        qDebug() << "app cache path:" << dbPath;
+        if (QSqlDatabase::contains(name)) {
+            dbConn = QSqlDatabase::database(name, false);
+        } else {
+            dbConn = QSqlDatabase::addDatabase("QSQLITE", name);
+        }
+        dbConn.setDatabaseName(dbPath);
+        if (!dbConn.open()) {
+            qCritical() << "open" << dbPath << "failed:" << dbConn.lastError().text();
+            return STATUS_CODE(kFail);
+        }
+
+        // 缓存位于 ${LINGLONG_ROOT}，多个进程、用户共同打开，与 linglong.db 相同不使用 WAL 模式
+        setupSharedDatabase(dbConn);
+        // NORMAL 同步级别对缓存数据已经足够
+        QSqlQuery pragma(dbConn);
+        if (!pragma.exec("PRAGMA synchronous=NORMAL")) {
+            qWarning() << "fail to set synchronous" << pragma.lastError().text();
+        }
+        return STATUS_CODE(kSuccess);
+    }
+
+    // 建表后才能预编译语句
+    int prepare()
+    {
+        if (selectQuery) {
+            return STATUS_CODE(kSuccess);
+        }
+
+        QScopedPointer<QSqlQuery> select(new QSqlQuery(dbConn));
+        QScopedPointer<QSqlQuery> upsert(new QSqlQuery(dbConn));
+        QScopedPointer<QSqlQuery> purge(new QSqlQuery(dbConn));
+        if (!select->prepare("SELECT data FROM appInfo WHERE key = ? AND timestamp > ?")
+            || !upsert->prepare(
+              "INSERT OR REPLACE INTO appInfo(key, data, timestamp) VALUES(?, ?, ?)")
+            || !purge->prepare("DELETE FROM appInfo WHERE timestamp <= ?")) {
+            qCritical() << "fail to prepare appInfo cache statements:"
+                        << dbConn.lastError().text();
+            return STATUS_CODE(kFail);
+        }
+
+        selectQuery.reset(select.take());
+        upsertQuery.reset(upsert.take());
+        purgeQuery.reset(purge.take());
+        return STATUS_CODE(kSuccess);
+    }
+
+    const int generation;
+    const QString name;
+    QSqlDatabase dbConn;
+    QScopedPointer<QSqlQuery> selectQuery;
+    QScopedPointer<QSqlQuery> upsertQuery;
+    QScopedPointer<QSqlQuery> purgeQuery;
+};
+
+QThreadStorage<CacheConnection *> cacheConnections;
+
+CacheConnection *threadCacheConnection()
+{
+    if (!cacheConnections.hasLocalData()
+        || cacheConnections.localData()->generation != cacheDbGeneration.load()) {
+        cacheConnections.setLocalData(new CacheConnection());
+    }
+    return cacheConnections.localData();
+}
+
+/*
+ * 获取当前线程已建表并预编译语句的缓存连接
+ *
+ * @return CacheConnection *: 失败返回 nullptr
+ */
+CacheConnection *readyCacheConnection()
+{
+    auto conn = threadCacheConnection();
+    if (!conn->selectQuery && STATUS_CODE(kSuccess) != checkAppCache()) {
+        return nullptr;
+    }
+    return conn;
+}
+
+/*
+ * 批量删除过期缓存，每 kCachePurgeInterval 秒最多执行一次
+ *
+ * @param conn: 当前线程的缓存连接
+ * @param force: 忽略清理间隔
+ */
+void purgeExpiredCache(CacheConnection *conn, bool force)
+{
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    qint64 last = lastPurgeTime.load();
+    if (!force && now - last < kCachePurgeInterval) {
+        return;
+    }
+    if (!lastPurgeTime.compare_exchange_strong(last, now) && !force) {
+        // 其它线程已经在清理
+        return;
+    }
+
+    conn->purgeQuery->bindValue(0, now - kCacheValidTime);
+    if (!conn->purgeQuery->exec()) {
+        qWarning() << "fail to purge expired appInfo cache:"
+                   << conn->purgeQuery->lastError().text();
+    } else {
+        qDebug() << "purged" << conn->purgeQuery->numRowsAffected() << "expired cache records";
+    }
+    conn->purgeQuery->finish();
+}
+
+} // namespace
+
+/*
+ * 设置缓存数据库文件路径，各线程在下次访问缓存时重建连接
+ *
+ * @param path: 数据库文件路径，为空时使用默认路径
+ */
+void setAppCacheDbPath(const QString &path)
+{
+    QMutexLocker locker(&cacheDbPathMutex);
+    cacheDbPath = path;
+    ++cacheDbGeneration;
+}
+
 /*
  * 创建数据库连接
  *
@@ -24,22 +210,11 @@ namespace util {
  */
 int openCacheDbConn(QSqlDatabase &dbConn)
 {
-    // 多用户支持 deepin-linglong 无home目录
-    const QString appInfoCachePath = linglong::util::getLinglongRootPath();
-    qDebug() << "app cache path:" << appInfoCachePath;
-    QString err = "";
-    // 添加数据库驱动，并指定连接名称cache_package_connection
-    if (QSqlDatabase::contains("cache_package_connection")) {
-        dbConn = QSqlDatabase::database("cache_package_connection");
-    } else {
-        dbConn = QSqlDatabase::addDatabase("QSQLITE", "cache_package_connection");
-        dbConn.setDatabaseName(appInfoCachePath + "/.appInfoCache.db");
-    }
-    if (!dbConn.isOpen() && !dbConn.open()) {
-        err = "open " + appInfoCachePath + " .appInfoCache.db failed";
-        qCritical() << err;
+    auto conn = threadCacheConnection();
+    if (STATUS_CODE(kSuccess) != conn->open()) {
         return STATUS_CODE(kFail);
     }
+    dbConn = conn->dbConn;
     return STATUS_CODE(kSuccess);
 }
 
@@ -50,26 +225,45 @@ int openCacheDbConn(QSqlDatabase &dbConn)
  */
 int checkAppCache()
 {
-    QString err = "";
-    QSqlDatabase dbConn;
-    if (STATUS_CODE(kSuccess) != openCacheDbConn(dbConn)) {
+    auto conn = threadCacheConnection();
+    if (STATUS_CODE(kSuccess) != conn->open()) {
         return STATUS_CODE(kFail);
     }
 
-    QString createCacheTable = "CREATE TABLE IF NOT EXISTS appInfo(\
+    QSqlQuery sqlQuery(conn->dbConn);
+    if (!sqlQuery.exec("PRAGMA user_version") || !sqlQuery.next()) {
+        qCritical() << "fail to read cache schema version, err:" << sqlQuery.lastError().text();
+        return STATUS_CODE(kFail);
+    }
+    const int schemaVersion = sqlQuery.value(0).toInt();
+    sqlQuery.finish();
+
+    // 旧版本表的时间戳为字符串且 key 无索引，缓存数据可以直接丢弃重建
+    QStringList statements;
+    if (schemaVersion < kCacheSchemaVersion) {
+        statements << "DROP TABLE IF EXISTS appInfo";
+    }
+    statements << "CREATE TABLE IF NOT EXISTS appInfo(\
          ID INTEGER PRIMARY KEY AUTOINCREMENT,\
          key VARCHAR(32) NOT NULL,\
          data VARCHAR,\
-         timestamp VARCHAR)";
+         timestamp INTEGER NOT NULL)"
+               << "CREATE UNIQUE INDEX IF NOT EXISTS appInfo_key_index ON appInfo(key)"
+               << QString("PRAGMA user_version = %1").arg(kCacheSchemaVersion);
 
-    QSqlQuery sqlQuery(createCacheTable, dbConn);
-    if (!sqlQuery.exec()) {
-        err = "fail to create cache appinfo table, err:" + sqlQuery.lastError().text();
-        qCritical() << err;
-        dbConn.close();
+    for (const auto &sql : statements) {
+        if (!sqlQuery.exec(sql)) {
+            qCritical() << "fail to create cache appinfo table, err:"
+                        << sqlQuery.lastError().text();
+            return STATUS_CODE(kFail);
+        }
+    }
+
+    if (STATUS_CODE(kSuccess) != conn->prepare()) {
         return STATUS_CODE(kFail);
     }
-    dbConn.close();
+
+    purgeExpiredCache(conn, true);
     return STATUS_CODE(kSuccess);
 }
 
@@ -83,56 +277,30 @@ int checkAppCache()
  */
 int queryLocalCache(const QString &key, QString &appData)
 {
-    QString err = "";
-    QString selectSql = QString("SELECT * FROM appInfo WHERE key = '%1'").arg(key);
-    QSqlDatabase dbConn;
-    if (STATUS_CODE(kSuccess) != openCacheDbConn(dbConn)) {
+    auto conn = readyCacheConnection();
+    if (!conn) {
         return STATUS_CODE(kFail);
     }
 
-    QSqlQuery sqlQuery(dbConn);
-    sqlQuery.prepare(selectSql);
+    // 过期记录不在读路径上删除，由 purgeExpiredCache 批量清理
+    auto &sqlQuery = *conn->selectQuery;
+    sqlQuery.bindValue(0, key);
+    sqlQuery.bindValue(1, QDateTime::currentSecsSinceEpoch() - kCacheValidTime);
     if (!sqlQuery.exec()) {
-        err = "queryLocalCache fail to exec sql:" + selectSql
-          + ", error:" + sqlQuery.lastError().text();
-        qCritical() << err;
-        dbConn.close();
+        qCritical() << "queryLocalCache fail to exec sql, error:" << sqlQuery.lastError().text();
+        sqlQuery.finish();
         return STATUS_CODE(kFail);
     }
 
-    sqlQuery.last();
-    int recordCount = sqlQuery.at() + 1;
-    QString insertSql = "";
-    if (recordCount < 1) {
-        err = "queryLocalCache fail key:" + key + " not found";
-        qDebug() << err;
-        dbConn.close();
+    if (!sqlQuery.next()) {
+        sqlQuery.finish();
+        qDebug() << key << " not valid in cache";
         return STATUS_CODE(kFail);
     }
-    // 检查缓存结果是否有效
-    QString recordTime = sqlQuery.value(3).toString().trimmed();
-    QDateTime recordDateTime = QDateTime::fromString(recordTime, "yyyy-MM-dd hh:mm:ss");
-    QDateTime current = QDateTime::currentDateTime();
-    // 10 分钟有效
-    QDateTime validDate = recordDateTime.addSecs(kCacheValidTime);
-    if (current < validDate) {
-        appData = sqlQuery.value(2).toString().trimmed();
-        dbConn.close();
-        return STATUS_CODE(kSuccess);
-    } else {
-        QString deleteSql = QString("DELETE FROM appInfo WHERE key = '%1'").arg(key);
-        sqlQuery.prepare(deleteSql);
-        if (!sqlQuery.exec()) {
-            err = "queryLocalCache fail to exec sql:" + deleteSql
-              + ", error:" + sqlQuery.lastError().text();
-            qCritical() << err;
-            dbConn.close();
-            return STATUS_CODE(kFail);
-        }
-    }
-    dbConn.close();
-    qDebug() << key << " not valid in cache";
-    return STATUS_CODE(kFail);
+
+    appData = sqlQuery.value(0).toString().trimmed();
+    sqlQuery.finish();
+    return STATUS_CODE(kSuccess);
 }
 
 /*
@@ -145,28 +313,23 @@ int queryLocalCache(const QString &key, QString &appData)
  */
 int updateCache(const QString &key, const QString &appData)
 {
-    QString err = "";
-    QSqlDatabase dbConn;
-    if (STATUS_CODE(kSuccess) != openCacheDbConn(dbConn)) {
+    auto conn = readyCacheConnection();
+    if (!conn) {
         return STATUS_CODE(kFail);
     }
-    // 调用方保证插入cache表前已经调用queryLocalCache查询了cache
-    QString currentTime = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
-    QString insertSql = QString("INSERT INTO appInfo(key,data,timestamp) VALUES(?,?,?)");
 
-    QSqlQuery sqlQuery(dbConn);
-    sqlQuery.prepare(insertSql);
+    auto &sqlQuery = *conn->upsertQuery;
     sqlQuery.bindValue(0, key);
     sqlQuery.bindValue(1, appData);
-    sqlQuery.bindValue(2, currentTime);
+    sqlQuery.bindValue(2, QDateTime::currentSecsSinceEpoch());
     if (!sqlQuery.exec()) {
-        err =
-          "updateCache fail to exec sql:" + insertSql + ", error:" + sqlQuery.lastError().text();
-        qCritical() << err;
-        dbConn.close();
+        qCritical() << "updateCache fail to exec sql, error:" << sqlQuery.lastError().text();
+        sqlQuery.finish();
         return STATUS_CODE(kFail);
     }
-    dbConn.close();
+    sqlQuery.finish();
+
+    purgeExpiredCache(conn, false);
     qDebug() << key << " update cache success";
     return STATUS_CODE(kSuccess);
 }
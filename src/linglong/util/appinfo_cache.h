@@ -16,7 +16,14 @@ namespace linglong {
 namespace util {
 
 /*
- * 创建数据库连接
+ * 设置缓存数据库文件路径，各线程在下次访问缓存时重建连接
+ *
+ * @param path: 数据库文件路径，为空时使用默认路径
+ */
+void setAppCacheDbPath(const QString &path);
+
+/*
+ * 获取当前线程的缓存数据库长连接，连接开启 WAL 模式且在线程退出前不会关闭
  *
  * @param dbConn: QSqlDatabase 数据库
  *
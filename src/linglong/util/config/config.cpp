@@ -41,6 +41,14 @@ QSharedPointer<Config> loadConfig()
 
     Q_ASSERT(config->repos.contains(package::kDefaultRepo));
 
+    if (!config->prefetch) {
+        config->prefetch = QSharedPointer<Prefetch>(new Prefetch(config.data()));
+    }
+
+    if (!config->peerCache) {
+        config->peerCache = QSharedPointer<PeerCache>(new PeerCache(config.data()));
+    }
+
     config->self = config;
     config->path = findLinglongConfigPath(kConfigFileName, true);
     return config;
@@ -9,6 +9,8 @@
 
 // yaml/json format config
 
+#include "linglong/util/config/peer_cache.h"
+#include "linglong/util/config/prefetch.h"
 #include "linglong/util/config/repo.h"
 #include "linglong/util/qserializer/deprecated.h"
 
@@ -23,6 +25,28 @@ public:
     Q_PROPERTY(QMap<QString, QSharedPointer<linglong::util::config::Repo>> repos MEMBER repos);
     QMap<QString, QSharedPointer<Repo>> repos;
 
+    Q_PROPERTY(QSharedPointer<linglong::util::config::Prefetch> prefetch MEMBER prefetch);
+    QSharedPointer<Prefetch> prefetch;
+
+    Q_PROPERTY(QSharedPointer<linglong::util::config::PeerCache> peerCache MEMBER peerCache);
+    QSharedPointer<PeerCache> peerCache;
+
+    // 探测仓库镜像延迟的间隔，单位秒，0 表示不探测
+    Q_PROPERTY(qint64 mirrorProbeInterval MEMBER mirrorProbeInterval);
+    qint64 mirrorProbeInterval = 10 * 60;
+
+    // 所有下载任务共享的总速率上限，单位字节每秒，0 表示不限制
+    Q_PROPERTY(quint64 bandwidthLimit MEMBER bandwidthLimit);
+    quint64 bandwidthLimit = 0;
+
+    // ll-service 预先启动的 ll-box 进程数，0 表示每次启动应用时再启动
+    Q_PROPERTY(int boxPoolSize MEMBER boxPoolSize);
+    int boxPoolSize = 2;
+
+    // 应用首次启动后记录预读数据的时长，单位秒，0 表示不记录也不使用预读
+    Q_PROPERTY(int readaheadRecordSeconds MEMBER readaheadRecordSeconds);
+    int readaheadRecordSeconds = 0;
+
 public:
     void save();
 
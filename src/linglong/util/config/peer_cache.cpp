@@ -0,0 +1,13 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "linglong/util/config/peer_cache.h"
+
+namespace linglong::util::config {
+
+QSERIALIZER_IMPL(PeerCache);
+
+}
@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_UTIL_CONFIG_PEER_CACHE_H_
+#define LINGLONG_UTIL_CONFIG_PEER_CACHE_H_
+
+#include "linglong/util/qserializer/deprecated.h"
+
+namespace linglong::util::config {
+
+// 局域网节点间共享 ostree 对象的配置
+class PeerCache : public Serialize
+{
+    Q_OBJECT;
+    Q_SERIALIZE_CONSTRUCTOR(PeerCache);
+
+public:
+    // 是否共享本机的对象并从其他节点下载
+    Q_PROPERTY(bool enabled MEMBER enabled);
+    bool enabled = false;
+
+    // 本机对象服务监听的端口
+    Q_PROPERTY(int port MEMBER port);
+    int port = 48126;
+
+    // 静态配置的节点地址，如 http://192.168.1.10:48126
+    Q_PROPERTY(QStringList peers MEMBER peers);
+    QStringList peers;
+
+    // 是否通过组播发现其他节点
+    Q_PROPERTY(bool multicast MEMBER multicast);
+    bool multicast = true;
+
+    Q_PROPERTY(QString multicastGroup MEMBER multicastGroup);
+    QString multicastGroup = "239.255.76.76";
+
+    Q_PROPERTY(int multicastPort MEMBER multicastPort);
+    int multicastPort = 48127;
+
+    // 组播通告间隔，单位秒，超过三个间隔未收到通告的节点不再使用
+    Q_PROPERTY(qint64 announceInterval MEMBER announceInterval);
+    qint64 announceInterval = 30;
+};
+
+QSERIALIZER_DECLARE(PeerCache);
+
+} // namespace linglong::util::config
+#endif
@@ -0,0 +1,45 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_UTIL_CONFIG_PREFETCH_H_
+#define LINGLONG_UTIL_CONFIG_PREFETCH_H_
+
+#include "linglong/util/qserializer/deprecated.h"
+
+namespace linglong::util::config {
+
+// 后台预取更新配置
+class Prefetch : public Serialize
+{
+    Q_OBJECT;
+    Q_SERIALIZE_CONSTRUCTOR(Prefetch);
+
+public:
+    // 是否启用后台预取
+    Q_PROPERTY(bool enabled MEMBER enabled);
+    bool enabled = false;
+
+    // 检查更新的间隔，单位秒
+    Q_PROPERTY(qint64 interval MEMBER interval);
+    qint64 interval = 6 * 60 * 60;
+
+    // 预取下载速率上限，单位字节每秒，0 表示不限制
+    Q_PROPERTY(quint64 bandwidthLimit MEMBER bandwidthLimit);
+    quint64 bandwidthLimit = 512 * 1024;
+
+    // 按流量计费的网络下是否预取
+    Q_PROPERTY(bool allowMetered MEMBER allowMetered);
+    bool allowMetered = false;
+
+    // 是否只在系统空闲时预取
+    Q_PROPERTY(bool idleOnly MEMBER idleOnly);
+    bool idleOnly = true;
+};
+
+QSERIALIZER_DECLARE(Prefetch);
+
+} // namespace linglong::util::config
+#endif
@@ -19,6 +19,8 @@ class Repo : public Serialize
 public:
     Q_SERIALIZE_PROPERTY(QString, endpoint);
     Q_SERIALIZE_PROPERTY(QString, repoName);
+    // endpoint 之外的镜像地址，按优先级排列
+    Q_SERIALIZE_PROPERTY(QStringList, mirrors);
 };
 
 QSERIALIZER_DECLARE(Repo);
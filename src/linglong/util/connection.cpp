@@ -8,18 +8,95 @@
 
 #include "linglong/util/file.h"
 
+#include <QThreadStorage>
+
 #define DATABASE_TYPE "QSQLITE"
 #define TEST_STATE_SQL "SELECT 1"
 
 Q_LOGGING_CATEGORY(database, "linglong.database", QtWarningMsg)
 
-QMutex linglong::util::Connection::mutex;
-
 namespace linglong {
 namespace util {
+
+namespace {
+// 线程私有的数据库连接及预编译语句
+class ThreadConnection
+{
+public:
+    explicit ThreadConnection(const QString &connectionName)
+        : connectionName(connectionName)
+    {
+    }
+
+    ~ThreadConnection()
+    {
+        statements.clear();
+        connection.close();
+        connection = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connectionName);
+        qCDebug(database) << "remove connection" << connectionName;
+    }
+
+    const QString connectionName;
+    QSqlDatabase connection;
+    QHash<QString, QSqlQuery> statements;
+};
+
+// 线程访问过的各数据库的连接，线程退出时由 QThreadStorage 释放
+class ThreadConnections
+{
+public:
+    ~ThreadConnections() { qDeleteAll(connections); }
+
+    QHash<QString, ThreadConnection *> connections;
+};
+
+QThreadStorage<ThreadConnections *> threadConnections;
+
+ThreadConnection *threadConnection(const QString &databaseName)
+{
+    if (!threadConnections.hasLocalData()) {
+        threadConnections.setLocalData(new ThreadConnections);
+    }
+    auto &connections = threadConnections.localData()->connections;
+    auto holder = connections.value(databaseName);
+    if (!holder) {
+        holder = new ThreadConnection(QStringLiteral("connection_%1_%2")
+                                        .arg(qintptr(QThread::currentThreadId()), 0, 16)
+                                        .arg(connections.size()));
+        connections.insert(databaseName, holder);
+    }
+    return holder;
+}
+} // namespace
+
+void setupSharedDatabase(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    // 以前的版本曾将数据库设为 WAL 模式，由有写权限的进程改回回滚日志模式
+    if (query.exec("PRAGMA journal_mode") && query.next()
+        && query.value(0).toString().compare("wal", Qt::CaseInsensitive) == 0) {
+        query.finish();
+        if (!query.exec("PRAGMA journal_mode=DELETE")) {
+            qCDebug(database) << "keep journal mode of" << db.databaseName()
+                              << query.lastError().text();
+        }
+    }
+    query.finish();
+    // 读写冲突时等待而不是直接失败
+    if (!query.exec("PRAGMA busy_timeout=3000")) {
+        qWarning() << "set busy_timeout error:" << query.lastError().text();
+    }
+}
+
 Connection::Connection(QObject *parent)
+    : Connection(getLinglongRootPath() + "/" + QString(DATABASE_NAME), parent)
+{
+}
+
+Connection::Connection(const QString &databaseName, QObject *parent)
     : QObject(parent)
-    , databaseName(getLinglongRootPath() + "/" + QString(DATABASE_NAME))
+    , databaseName(databaseName)
     , databaseType(DATABASE_TYPE)
     , testStateSql(TEST_STATE_SQL)
 {
@@ -28,51 +105,52 @@ Connection::Connection(QObject *parent)
 
 Connection::~Connection()
 {
-    closeConnection(connection);
-    qCDebug(database) << "close databaseName" << databaseName;
+    // 非查询语句及调用方已 finish() 的查询放回缓存；仍持有结果集的查询不再缓存，
+    // 由调用方释放，避免后续调用重新绑定调用方正在读取的结果
+    auto &statements = threadConnection(databaseName)->statements;
+    for (auto &prepared : preparedQueries) {
+        const auto &query = prepared.second;
+        if ((!query.isActive() || !query.isSelect()) && !statements.contains(prepared.first)) {
+            statements.insert(prepared.first, prepared.second);
+        }
+    }
+    preparedQueries.clear();
+    // 连接由线程复用，这里只释放句柄
+    connection = QSqlDatabase();
 }
 
 QSqlDatabase Connection::getConnection()
 {
-    QSqlDatabase connection;
-    QString connectionName =
-      QStringLiteral("connection_%1").arg(qintptr(QThread::currentThreadId()), 0, 16);
+    auto holder = threadConnection(databaseName);
     // 连接已经创建过了，复用它，而不是重新创建
-    if (QSqlDatabase::contains(connectionName)) {
-        connection = QSqlDatabase::database(connectionName);
-        return connection;
+    if (holder->connection.isOpen()) {
+        return holder->connection;
     }
 
     // 创建一个新的连接
-    connection = QSqlDatabase::addDatabase(databaseType, connectionName);
-    // 设置sqlite数据库路径
-    connection.setDatabaseName(databaseName);
-    if (!connection.open()) {
-        qCritical() << "open database failed:" << connection.lastError().text();
+    if (QSqlDatabase::contains(holder->connectionName)) {
+        holder->connection = QSqlDatabase::database(holder->connectionName, false);
     } else {
-        QSqlQuery query(testStateSql, connection);
-        if (QSqlError::NoError != query.lastError().type()) {
-            qCritical() << "open database error:" << query.lastError().text();
-        }
+        holder->connection = QSqlDatabase::addDatabase(databaseType, holder->connectionName);
+    }
+    // 设置sqlite数据库路径
+    holder->connection.setDatabaseName(databaseName);
+    if (!holder->connection.open()) {
+        qCritical() << "open database failed:" << holder->connection.lastError().text();
+        return holder->connection;
     }
 
-    return connection;
-}
+    QSqlQuery query(testStateSql, holder->connection);
+    if (QSqlError::NoError != query.lastError().type()) {
+        qCritical() << "open database error:" << query.lastError().text();
+    }
+    setupSharedDatabase(holder->connection);
 
-void Connection::closeConnection(QSqlDatabase &connection)
-{
-    QMutexLocker locker(&mutex); // 加锁，加锁不成功则阻塞
-    QString connectionName = connection.connectionName();
-    connection.close();
-    connection = QSqlDatabase();
-    QSqlDatabase::removeDatabase(connectionName);
-    qCDebug(database) << "connectionNames:" << QSqlDatabase::connectionNames();
+    return holder->connection;
 }
 
 QSqlQuery Connection::execute(const QString &sql)
 {
-    QMutexLocker locker(&mutex); // 加锁，加锁不成功则阻塞
-
     connection = getConnection();
     QSqlQuery query(sql, connection);
     if (QSqlError::NoError != query.lastError().type()) {
@@ -83,21 +161,30 @@ QSqlQuery Connection::execute(const QString &sql)
 
 QSqlQuery Connection::execute(const QString &sql, const QVariantMap &valueMap)
 {
-    QMutexLocker locker(&mutex);
     connection = getConnection();
+
+    // 取出缓存的语句，嵌套调用找不到缓存时重新预编译
+    auto &statements = threadConnection(databaseName)->statements;
     QSqlQuery query(connection);
-    query.prepare(sql);
+    if (statements.contains(sql)) {
+        query = statements.take(sql);
+    } else if (!query.prepare(sql)) {
+        qCritical() << "prepare sql error:" << query.lastError().text();
+        return query;
+    }
+
     for (const auto &key : valueMap.keys()) {
         if (":size" == key) {
             query.bindValue(key, valueMap.value(key).toInt());
             continue;
         }
-        query.bindValue(key, valueMap.value(key).toString());
+        query.bindValue(key, valueMap.value(key));
     }
     query.exec();
     if (QSqlError::NoError != query.lastError().type()) {
         qCritical() << "execute pre sql error:" << query.lastError().text();
     }
+    preparedQueries.append(qMakePair(sql, query));
     return query;
 }
 
@@ -17,19 +17,29 @@
 
 namespace linglong {
 namespace util {
+/*
+ * 数据库访问对象
+ *
+ * 每个线程对每个数据库文件复用同一个长连接，连接在线程退出时关闭，不同线程之间无需加锁；
+ * 带参数的sql语句按语句文本缓存预编译结果，语句交给调用方后即从缓存中取出，同一语句的嵌套
+ * 调用会重新预编译，不会影响调用方持有的结果集
+ */
 class Connection : public QObject
 {
     Q_OBJECT
 
 public:
     explicit Connection(QObject *parent = nullptr);
+    /*
+     * @param databaseName: 数据库文件路径
+     */
+    explicit Connection(const QString &databaseName, QObject *parent = nullptr);
     ~Connection();
     QSqlQuery execute(const QString &sql); // 执行sql语句
     QSqlQuery execute(const QString &sql, const QVariantMap &valueMap);
 
 private:
-    QSqlDatabase getConnection();                   // 创建数据库连接
-    void closeConnection(QSqlDatabase &connection); // 关闭连接
+    QSqlDatabase getConnection(); // 获取当前线程的数据库连接
 
 private:
     QString databaseName; // 如果是 SQLite 则为数据库文件名
@@ -39,8 +49,17 @@ private:
 
     QSqlDatabase connection;
 
-    static QMutex mutex;
+    // 本对象取出的预编译语句，析构时将调用方已结束的语句放回缓存，仍在使用的交由调用方释放
+    QList<QPair<QString, QSqlQuery>> preparedQueries;
 };
+
+/*
+ * 设置多个进程、用户共享的 sqlite 数据库连接
+ *
+ * 数据库目录属于 deepin-linglong，以桌面用户运行的 ll-service 只能读取。WAL 模式下读取也要
+ * 创建、写入 -shm 及 -wal 文件，因此保持回滚日志模式，并将以前设置的 WAL 模式改回
+ */
+void setupSharedDatabase(QSqlDatabase &db);
 } // namespace util
 } // namespace linglong
 
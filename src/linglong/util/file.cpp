@@ -10,6 +10,7 @@
 #include "status_code.h"
 
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -58,6 +59,21 @@ bool ensureDir(const QString &path)
     return dir.mkpath(".");
 }
 
+QString cacheKey(const QStringList &parts)
+{
+    return QString::fromLatin1(
+      QCryptographicHash::hash(parts.join('\n').toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+QString fileStamp(const QString &path)
+{
+    QFileInfo info(path);
+    if (!info.exists()) {
+        return "-";
+    }
+    return QString("%1:%2").arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+}
+
 QString createProxySocket(const QString &pattern)
 {
     auto userRuntimeDir = QString("/run/user/%1/").arg(getuid());
@@ -64,6 +64,24 @@ QString fileHash(const QString &path, QCryptographicHash::Algorithm method);
  */
 quint64 sizeOfDir(const QString &srcPath);
 
+/*!
+ * 由多个部分生成的摘要，用作缓存条目名
+ *
+ * @param parts 区分缓存条目的各部分
+ *
+ * @return QString: sha1 十六进制字符串
+ */
+QString cacheKey(const QStringList &parts);
+
+/*!
+ * 文件或目录的状态，目录在增删子项时改变，文件在重写时改变；不存在时为 "-"
+ *
+ * @param path 路径
+ *
+ * @return QString: 大小及修改时间
+ */
+QString fileStamp(const QString &path);
+
 /*!
  * 创建一个pattern格式的随机文件
  *
@@ -6,8 +6,11 @@
 
 #include "http_client.h"
 
+#include "rate_limiter.h"
+
 #include <QEventLoop>
 #include <QNetworkAccessManager>
+#include <QTimer>
 
 namespace linglong {
 namespace util {
@@ -18,6 +21,48 @@ QNetworkAccessManager &networkMgr()
     return manager;
 }
 
+void readThrottled(QNetworkReply *reply,
+                   RateLimitTicket &ticket,
+                   const std::function<void(const QByteArray &)> &sink)
+{
+    // 限制缓冲区大小，暂停读取时由 TCP 窗口向服务端施加背压
+    constexpr qint64 kChunkSize = 64 * 1024;
+    reply->setReadBufferSize(kChunkSize);
+
+    QEventLoop loop;
+    QTimer resumeTimer;
+    resumeTimer.setSingleShot(true);
+    bool waiting = false;
+
+    auto drain = [&]() {
+        while (!waiting && reply->bytesAvailable() > 0) {
+            auto data = reply->read(kChunkSize);
+            sink(data);
+            const qint64 delayUs = ticket.reserve(data.size());
+            if (delayUs > 0) {
+                waiting = true;
+                resumeTimer.start(static_cast<int>(delayUs / 1000) + 1);
+            }
+        }
+        if (!waiting && reply->isFinished()) {
+            loop.quit();
+        }
+    };
+
+    QObject::connect(&resumeTimer, &QTimer::timeout, [&]() {
+        waiting = false;
+        drain();
+    });
+    QObject::connect(reply, &QNetworkReply::readyRead, &loop, drain);
+    QObject::connect(reply, &QNetworkReply::finished, &loop, drain);
+
+    drain();
+    if (!waiting && reply->isFinished()) {
+        return;
+    }
+    loop.exec();
+}
+
 QNetworkReply *HttpRestClient::doRequest(const QByteArray &verb,
                                          QNetworkRequest &request,
                                          QIODevice *device,
@@ -10,11 +10,25 @@
 #include <QNetworkReply>
 #include <QNetworkRequest>
 
+#include <functional>
+
 namespace linglong {
 namespace util {
 
 QNetworkAccessManager &networkMgr();
 
+class RateLimitTicket;
+
+/*!
+ * 按限速器分配的速率读取 reply 的数据，在 reply 结束且数据读完后返回
+ * @param reply
+ * @param ticket: 下载者在限速器中的注册
+ * @param sink: 读取到的数据
+ */
+void readThrottled(QNetworkReply *reply,
+                   RateLimitTicket &ticket,
+                   const std::function<void(const QByteArray &)> &sink);
+
 class HttpRestClient
 {
 public:
@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "rate_limiter.h"
+
+#include <QThread>
+
+namespace linglong::util {
+
+namespace {
+// 每个下载者最多积攒的令牌，避免空闲后突发占满带宽
+constexpr double kBurstSeconds = 0.5;
+constexpr double kMinBurstBytes = 64 * 1024;
+} // namespace
+
+RateLimiter::RateLimiter()
+{
+    clock.start();
+}
+
+void RateLimiter::setRate(quint64 bytesPerSecond)
+{
+    QMutexLocker locker(&mutex);
+    this->bytesPerSecond = bytesPerSecond;
+}
+
+quint64 RateLimiter::rate() const
+{
+    QMutexLocker locker(&mutex);
+    return bytesPerSecond;
+}
+
+int RateLimiter::registerConsumer(int weight, quint64 maxBytesPerSecond)
+{
+    QMutexLocker locker(&mutex);
+    Consumer consumer;
+    consumer.weight = qMax(1, weight);
+    consumer.maxBytesPerSecond = maxBytesPerSecond;
+    consumer.lastRefillUs = clock.nsecsElapsed() / 1000;
+    const int id = nextId++;
+    consumers.insert(id, consumer);
+    totalWeight += consumer.weight;
+    return id;
+}
+
+void RateLimiter::unregisterConsumer(int id)
+{
+    QMutexLocker locker(&mutex);
+    auto it = consumers.find(id);
+    if (it == consumers.end()) {
+        return;
+    }
+    totalWeight -= it->weight;
+    consumers.erase(it);
+}
+
+double RateLimiter::shareOf(const Consumer &consumer) const
+{
+    double share = 0;
+    if (bytesPerSecond > 0 && totalWeight > 0) {
+        share = static_cast<double>(bytesPerSecond) * consumer.weight / totalWeight;
+    }
+    if (consumer.maxBytesPerSecond > 0 && (share == 0 || consumer.maxBytesPerSecond < share)) {
+        share = consumer.maxBytesPerSecond;
+    }
+    return share;
+}
+
+qint64 RateLimiter::reserve(int id, quint64 bytes)
+{
+    QMutexLocker locker(&mutex);
+    auto it = consumers.find(id);
+    if (it == consumers.end()) {
+        return 0;
+    }
+    auto &consumer = it.value();
+    consumer.transferred += bytes;
+    totalTransferred += bytes;
+
+    const qint64 now = clock.nsecsElapsed() / 1000;
+    const double share = shareOf(consumer);
+    if (share <= 0) {
+        consumer.tokens = 0;
+        consumer.lastRefillUs = now;
+        return 0;
+    }
+
+    // 按当前分到的速率补充令牌
+    const double burst = qMax(share * kBurstSeconds, kMinBurstBytes);
+    consumer.tokens =
+      qMin(burst, consumer.tokens + share * (now - consumer.lastRefillUs) / 1000000.0);
+    consumer.lastRefillUs = now;
+
+    consumer.tokens -= static_cast<double>(bytes);
+    if (consumer.tokens >= 0) {
+        return 0;
+    }
+    return static_cast<qint64>(-consumer.tokens / share * 1000000.0);
+}
+
+QVariantMap RateLimiter::statistics() const
+{
+    QMutexLocker locker(&mutex);
+    QVariantList active;
+    for (auto it = consumers.cbegin(); it != consumers.cend(); ++it) {
+        active.append(QVariantMap{
+          { "weight", it->weight },
+          { "maxBytesPerSecond", it->maxBytesPerSecond },
+          { "bytesPerSecond", static_cast<quint64>(shareOf(it.value())) },
+          { "transferred", it->transferred },
+        });
+    }
+    return {
+        { "rate", bytesPerSecond },
+        { "totalWeight", totalWeight },
+        { "transferred", totalTransferred },
+        { "consumers", active },
+    };
+}
+
+RateLimitTicket::RateLimitTicket(int weight, quint64 maxBytesPerSecond, RateLimiter *limiter)
+    : limiter(limiter)
+    , id(limiter->registerConsumer(weight, maxBytesPerSecond))
+{
+}
+
+RateLimitTicket::~RateLimitTicket()
+{
+    limiter->unregisterConsumer(id);
+}
+
+qint64 RateLimitTicket::reserve(quint64 bytes)
+{
+    return limiter->reserve(id, bytes);
+}
+
+void RateLimitTicket::acquire(quint64 bytes)
+{
+    const qint64 delayUs = reserve(bytes);
+    if (delayUs > 0) {
+        QThread::usleep(static_cast<unsigned long>(delayUs));
+    }
+}
+
+} // namespace linglong::util
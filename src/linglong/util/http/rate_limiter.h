@@ -0,0 +1,115 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_UTIL_HTTP_RATE_LIMITER_H_
+#define LINGLONG_SRC_UTIL_HTTP_RATE_LIMITER_H_
+
+#include "linglong/util/singleton.h"
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QVariantMap>
+
+namespace linglong::util {
+
+/**
+ * @brief 进程内共享的下载限速器
+ * @details 令牌桶按活跃下载者的权重分配总速率，每个下载者也可以设置自身的速率上限。
+ *          下载者先消费令牌再等待，欠下的令牌以等待时间偿还
+ */
+class RateLimiter : public Singleton<RateLimiter>
+{
+public:
+    RateLimiter();
+
+    /**
+     * @brief 设置总速率上限，单位字节每秒，0 表示不限制
+     */
+    void setRate(quint64 bytesPerSecond);
+    quint64 rate() const;
+
+    /**
+     * @brief 注册下载者
+     *
+     * @param weight 权重，活跃下载者按权重分配总速率
+     * @param maxBytesPerSecond 下载者自身的速率上限，0 表示不限制
+     *
+     * @return int 下载者标识
+     */
+    int registerConsumer(int weight, quint64 maxBytesPerSecond = 0);
+    void unregisterConsumer(int id);
+
+    /**
+     * @brief 记录已传输的数据量
+     *
+     * @param id 下载者标识
+     * @param bytes 已传输的字节数
+     *
+     * @return qint64 继续传输前需要等待的微秒数
+     */
+    qint64 reserve(int id, quint64 bytes);
+
+    /**
+     * @brief 总速率、活跃下载者数及累计传输量
+     */
+    QVariantMap statistics() const;
+
+private:
+    struct Consumer
+    {
+        int weight = 1;
+        quint64 maxBytesPerSecond = 0;
+        double tokens = 0;
+        qint64 lastRefillUs = 0;
+        quint64 transferred = 0;
+    };
+
+    // 下载者当前分到的速率，0 表示不限制
+    double shareOf(const Consumer &consumer) const;
+
+    mutable QMutex mutex;
+    QElapsedTimer clock;
+    quint64 bytesPerSecond = 0;
+    int totalWeight = 0;
+    int nextId = 1;
+    quint64 totalTransferred = 0;
+    QMap<int, Consumer> consumers;
+};
+
+/**
+ * @brief 下载者注册的 RAII 封装
+ */
+class RateLimitTicket
+{
+public:
+    explicit RateLimitTicket(int weight,
+                             quint64 maxBytesPerSecond = 0,
+                             RateLimiter *limiter = RateLimiter::instance());
+    ~RateLimitTicket();
+
+    RateLimitTicket(const RateLimitTicket &) = delete;
+    RateLimitTicket &operator=(const RateLimitTicket &) = delete;
+
+    /**
+     * @brief 同 RateLimiter::reserve
+     */
+    qint64 reserve(quint64 bytes);
+
+    /**
+     * @brief 记录已传输的数据量并阻塞至可以继续传输
+     */
+    void acquire(quint64 bytes);
+
+private:
+    RateLimiter *limiter;
+    int id;
+};
+
+} // namespace linglong::util
+
+#define RATE_LIMITER linglong::util::RateLimiter::instance()
+#endif
@@ -0,0 +1,242 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "installed_app_registry.h"
+
+#include "linglong/util/connection.h"
+#include "linglong/util/file.h"
+#include "linglong/util/version/version.h"
+
+#include <QReadLocker>
+#include <QWriteLocker>
+
+#include <algorithm>
+
+namespace linglong {
+namespace util {
+
+namespace {
+// 返回给调用方的是副本，避免调用方修改索引中的数据
+QSharedPointer<linglong::package::AppMetaInfo>
+copyAppMetaInfo(const QSharedPointer<linglong::package::AppMetaInfo> &src)
+{
+    auto info = QSharedPointer<linglong::package::AppMetaInfo>(new linglong::package::AppMetaInfo);
+    info->appId = src->appId;
+    info->name = src->name;
+    info->version = src->version;
+    info->arch = src->arch;
+    info->kind = src->kind;
+    info->runtime = src->runtime;
+    info->uabUrl = src->uabUrl;
+    info->repoName = src->repoName;
+    info->description = src->description;
+    info->user = src->user;
+    info->size = src->size;
+    info->channel = src->channel;
+    info->module = src->module;
+    return info;
+}
+
+bool matches(const QString &value, const QString &expected)
+{
+    return expected.isEmpty() || value == expected;
+}
+} // namespace
+
+InstalledAppRegistry::InstalledAppRegistry(const QString &databasePath)
+    : databasePath(databasePath.isEmpty() ? getLinglongRootPath() + "/" + QString(DATABASE_NAME)
+                                          : databasePath)
+{
+}
+
+bool InstalledAppRegistry::ensureLoaded()
+{
+    {
+        QReadLocker locker(&lock);
+        if (loaded) {
+            return true;
+        }
+    }
+    QWriteLocker locker(&lock);
+    return loadLocked();
+}
+
+void InstalledAppRegistry::invalidate()
+{
+    QWriteLocker locker(&lock);
+    loaded = false;
+    records.clear();
+    qDebug() << "installed app registry invalidated";
+}
+
+bool InstalledAppRegistry::loadLocked()
+{
+    if (loaded) {
+        return true;
+    }
+
+    Connection connection(databasePath);
+    QSqlQuery sqlQuery = connection.execute("SELECT * FROM installedAppInfo");
+    if (QSqlError::NoError != sqlQuery.lastError().type()) {
+        qCritical() << "load installed app registry error:" << sqlQuery.lastError().text();
+        return false;
+    }
+
+    QHash<QString, QList<Record>> result;
+    while (sqlQuery.next()) {
+        auto info =
+          QSharedPointer<linglong::package::AppMetaInfo>(new linglong::package::AppMetaInfo);
+        info->appId = sqlQuery.value(1).toString().trimmed();
+        info->name = sqlQuery.value(2).toString().trimmed();
+        info->version = sqlQuery.value(3).toString().trimmed();
+        info->arch = sqlQuery.value(4).toString().trimmed();
+        info->kind = sqlQuery.value(5).toString().trimmed();
+        info->runtime = sqlQuery.value(6).toString().trimmed();
+        info->uabUrl = sqlQuery.value(7).toString().trimmed();
+        info->repoName = sqlQuery.value(8).toString().trimmed();
+        info->description = sqlQuery.value(9).toString().trimmed();
+        info->user = sqlQuery.value(10).toString().trimmed();
+        info->size = sqlQuery.value(12).toString().trimmed();
+        info->channel = sqlQuery.value(13).toString().trimmed();
+        info->module = sqlQuery.value(14).toString().trimmed();
+        result[info->appId].append({ info, AppVersion(info->version).sortKey() });
+    }
+
+    for (auto &list : result) {
+        std::stable_sort(list.begin(), list.end(), [](const Record &a, const Record &b) {
+            return a.versionKey < b.versionKey;
+        });
+    }
+
+    records.swap(result);
+    loaded = true;
+    qDebug() << "installed app registry loaded," << records.size() << "apps";
+    return true;
+}
+
+QList<InstalledAppRegistry::Record>
+InstalledAppRegistry::filterLocked(const QString &appId,
+                                   const QString &appVer,
+                                   const QString &appArch,
+                                   const QString &channel,
+                                   const QString &module,
+                                   const QString &userName) const
+{
+    QList<Record> result;
+    auto it = records.constFind(appId);
+    if (it == records.constEnd()) {
+        return result;
+    }
+    for (const auto &record : it.value()) {
+        const auto &info = record.info;
+        if (matches(info->version, appVer) && matches(info->arch, appArch)
+            && matches(info->channel, channel) && matches(info->module, module)
+            && matches(info->user, userName)) {
+            result.append(record);
+        }
+    }
+    return result;
+}
+
+bool InstalledAppRegistry::contains(const QString &appId,
+                                    const QString &appVer,
+                                    const QString &appArch,
+                                    const QString &channel,
+                                    const QString &module,
+                                    const QString &userName)
+{
+    ensureLoaded();
+    QReadLocker locker(&lock);
+    return !filterLocked(appId, appVer, appArch, channel, module, userName).isEmpty();
+}
+
+QList<QSharedPointer<linglong::package::AppMetaInfo>>
+InstalledAppRegistry::find(const QString &appId,
+                           const QString &appVer,
+                           const QString &appArch,
+                           const QString &channel,
+                           const QString &module,
+                           const QString &userName)
+{
+    ensureLoaded();
+    QReadLocker locker(&lock);
+    QList<QSharedPointer<linglong::package::AppMetaInfo>> result;
+    for (const auto &record : filterLocked(appId, appVer, appArch, channel, module, userName)) {
+        result.append(copyAppMetaInfo(record.info));
+    }
+    return result;
+}
+
+bool InstalledAppRegistry::insert(QSharedPointer<linglong::package::AppMetaInfo> package,
+                                  const QString &userName,
+                                  const std::function<bool()> &persist)
+{
+    {
+        QWriteLocker locker(&lock);
+        if (!persist()) {
+            return false;
+        }
+
+        // 未加载时无需更新，下次访问会从数据库加载
+        if (loaded) {
+            auto info = copyAppMetaInfo(package);
+            info->user = userName;
+            auto &list = records[info->appId];
+            const Record record{ info, AppVersion(info->version).sortKey() };
+            auto pos = std::upper_bound(list.begin(),
+                                        list.end(),
+                                        record,
+                                        [](const Record &a, const Record &b) {
+                                            return a.versionKey < b.versionKey;
+                                        });
+            list.insert(pos, record);
+        }
+    }
+    Q_EMIT changed(package->appId);
+    return true;
+}
+
+bool InstalledAppRegistry::remove(const QString &appId,
+                                  const QString &appVer,
+                                  const QString &appArch,
+                                  const QString &channel,
+                                  const QString &module,
+                                  const QString &userName,
+                                  const std::function<bool()> &persist)
+{
+    {
+        QWriteLocker locker(&lock);
+        if (!persist()) {
+            return false;
+        }
+
+        if (loaded) {
+            auto it = records.find(appId);
+            if (it != records.end()) {
+                auto &list = it.value();
+                list.erase(std::remove_if(list.begin(),
+                                          list.end(),
+                                          [&](const Record &record) {
+                                              const auto &info = record.info;
+                                              return info->version == appVer
+                                                && matches(info->arch, appArch)
+                                                && matches(info->channel, channel)
+                                                && matches(info->module, module)
+                                                && matches(info->user, userName);
+                                          }),
+                           list.end());
+                if (list.isEmpty()) {
+                    records.erase(it);
+                }
+            }
+        }
+    }
+    Q_EMIT changed(appId);
+    return true;
+}
+
+} // namespace util
+} // namespace linglong
@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_UTIL_INSTALLED_APP_REGISTRY_H_
+#define LINGLONG_SRC_MODULE_UTIL_INSTALLED_APP_REGISTRY_H_
+
+#include "linglong/package/package.h"
+#include "linglong/util/singleton.h"
+
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+
+#include <functional>
+
+namespace linglong {
+namespace util {
+
+/*
+ * 已安装软件包的进程内索引
+ *
+ * 首次访问时从安装数据库整体加载，之后的查询只访问内存；安装、卸载在数据库事务提交后同步更新索引，
+ * 其它进程通过 invalidate 标记失效后重新加载
+ */
+class InstalledAppRegistry : public QObject, public Singleton<InstalledAppRegistry>
+{
+    Q_OBJECT
+
+public:
+    /*
+     * @param databasePath: 安装数据库路径，为空时使用默认的安装数据库
+     */
+    explicit InstalledAppRegistry(const QString &databasePath = QString());
+    ~InstalledAppRegistry() override = default;
+
+    /*
+     * 确保索引已从数据库加载
+     *
+     * @return bool: true:索引可用 false:数据库读取失败
+     */
+    bool ensureLoaded();
+
+    /*
+     * 标记索引失效，下次查询时从数据库重新加载
+     */
+    void invalidate();
+
+    /*
+     * 查询软件包是否安装，参数为空时不作为过滤条件
+     *
+     * @return bool: true:已安装 false:未安装
+     */
+    bool contains(const QString &appId,
+                  const QString &appVer,
+                  const QString &appArch,
+                  const QString &channel,
+                  const QString &module,
+                  const QString &userName);
+
+    /*
+     * 查询已安装软件包信息，参数为空时不作为过滤条件
+     *
+     * @return QList<QSharedPointer<linglong::package::AppMetaInfo>>: 按版本号数值升序排列的结果
+     */
+    QList<QSharedPointer<linglong::package::AppMetaInfo>> find(const QString &appId,
+                                                               const QString &appVer,
+                                                               const QString &appArch,
+                                                               const QString &channel,
+                                                               const QString &module,
+                                                               const QString &userName);
+
+    /*
+     * 增加安装记录，persist 在索引写锁内执行数据库事务，提交成功后才更新索引
+     *
+     * @param package: 软件包信息
+     * @param userName: 用户名
+     * @param persist: 数据库写入操作
+     *
+     * @return bool: true:成功 false:失败
+     */
+    bool insert(QSharedPointer<linglong::package::AppMetaInfo> package,
+                const QString &userName,
+                const std::function<bool()> &persist);
+
+    /*
+     * 删除安装记录，参数语义同 deleteAppRecord，persist 语义同 insert
+     *
+     * @return bool: true:成功 false:失败
+     */
+    bool remove(const QString &appId,
+                const QString &appVer,
+                const QString &appArch,
+                const QString &channel,
+                const QString &module,
+                const QString &userName,
+                const std::function<bool()> &persist);
+
+Q_SIGNALS:
+    /*
+     * 已安装软件包发生变化
+     *
+     * @param appId: 发生变化的软件包包名
+     */
+    void changed(const QString &appId);
+
+private:
+    struct Record
+    {
+        QSharedPointer<linglong::package::AppMetaInfo> info;
+        qint64 versionKey;
+    };
+
+    bool loadLocked();
+    QList<Record> filterLocked(const QString &appId,
+                               const QString &appVer,
+                               const QString &appArch,
+                               const QString &channel,
+                               const QString &module,
+                               const QString &userName) const;
+
+    const QString databasePath;
+
+    QReadWriteLock lock;
+    bool loaded = false;
+    // appId -> 按 versionKey 升序排列的安装记录
+    QHash<QString, QList<Record>> records;
+};
+
+} // namespace util
+} // namespace linglong
+
+#endif
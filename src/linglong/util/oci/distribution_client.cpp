@@ -8,6 +8,7 @@
 
 #include "linglong/util/file.h"
 #include "linglong/util/http/http_client.h"
+#include "linglong/util/http/rate_limiter.h"
 #include "linglong/util/qserializer/json.h"
 #include "linglong/util/sysinfo.h"
 
@@ -249,13 +250,19 @@ std::tuple<QByteArray, util::Error> pullBlob(const QString &endpoint,
     auto url = QString("%1/v2/%2/blobs/%3").arg(endpoint, name, digest);
 
     QNetworkRequest request(url);
-    util::HttpRestClient httpClient;
-    auto reply = httpClient.get(request);
+    request.setHeader(QNetworkRequest::UserAgentHeader, "linglong/1.0.0");
+    auto reply = util::networkMgr().get(request);
+
+    // blob 体积较大，与其他下载共享全局速率
+    QByteArray data;
+    util::RateLimitTicket ticket(1);
+    util::readThrottled(reply, ticket, [&data](const QByteArray &chunk) {
+        data.append(chunk);
+    });
     if (reply->error()) {
         return { "", NewNetworkError(reply) };
     }
 
-    auto data = reply->readAll();
     return { data, Success() };
 }
 
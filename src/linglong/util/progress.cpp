@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "progress.h"
+
+#include <QLocale>
+
+namespace linglong {
+namespace util {
+QString progressText(quint64 bytesTransferred,
+                     quint32 fetchedObjects,
+                     quint32 requestedObjects,
+                     quint64 bytesPerSecond,
+                     qint64 etaSeconds)
+{
+    QLocale locale = QLocale::c();
+    QString text = "Receiving objects:";
+    if (requestedObjects > 0) {
+        text += QString(" %1% (%2/%3)")
+                  .arg(fetchedObjects * 100 / requestedObjects)
+                  .arg(fetchedObjects)
+                  .arg(requestedObjects);
+    } else {
+        text += QString(" %1/(estimating)").arg(fetchedObjects);
+    }
+    text += QString(" %1/s %2")
+              .arg(locale.formattedDataSize(static_cast<qint64>(bytesPerSecond)),
+                   locale.formattedDataSize(static_cast<qint64>(bytesTransferred)));
+    if (etaSeconds >= 0) {
+        text += QString(" %1 seconds remaining").arg(etaSeconds);
+    }
+    return text;
+}
+} // namespace util
+} // namespace linglong
@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#ifndef LINGLONG_SRC_MODULE_UTIL_PROGRESS_H_
+#define LINGLONG_SRC_MODULE_UTIL_PROGRESS_H_
+
+#include <QString>
+
+namespace linglong {
+namespace util {
+/*
+ * 将下载进度格式化为可读文本，服务端记录任务状态及客户端显示进度共用
+ *
+ * @param bytesTransferred: 已下载字节数
+ * @param fetchedObjects: 已下载对象数
+ * @param requestedObjects: 需要下载的对象数，为 0 时表示仍在统计
+ * @param bytesPerSecond: 下载速度
+ * @param etaSeconds: 预计剩余时间，小于 0 时不显示
+ *
+ * @return QString: 进度文本
+ */
+QString progressText(quint64 bytesTransferred,
+                     quint32 fetchedObjects,
+                     quint32 requestedObjects,
+                     quint64 bytesPerSecond,
+                     qint64 etaSeconds);
+} // namespace util
+} // namespace linglong
+#endif
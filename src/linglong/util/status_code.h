@@ -37,7 +37,9 @@ enum class StatusCode {
     kErrorPkgQuerySuccess,    ///< 查询成功
     kErrorPkgQueryFailed,     ///< 查询失败
     kErrorModifyRepoFailed,   ///< 更新仓库url失败
-    kErrorModifyRepoSuccess   ///< 更新仓库url成功
+    kErrorModifyRepoSuccess,  ///< 更新仓库url成功
+    kJobPaused,               ///< 任务已暂停
+    kJobCancelled             ///< 任务已取消
 };
 
 template<typename T = int>
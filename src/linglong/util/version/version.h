@@ -70,6 +70,23 @@ public:
         return false;
     }
 
+    /*
+     * 生成可按数值排序的版本键，每段版本号占 16 位，超出范围的段按最大值处理
+     *
+     * @return qint64: 版本排序键，版本号无效时返回 -1
+     */
+    qint64 sortKey() const
+    {
+        if (Major < 0) {
+            return -1;
+        }
+        auto clamp = [](int value, int max) -> qint64 {
+            return value < 0 ? 0 : (value > max ? max : value);
+        };
+        return (clamp(Major, 0x7FFF) << 48) | (clamp(Minor, 0xFFFF) << 32)
+          | (clamp(Revision, 0xFFFF) << 16) | clamp(Build, 0xFFFF);
+    }
+
     /*
      * 版本号转QString
      */
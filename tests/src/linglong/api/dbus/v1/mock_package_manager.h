@@ -26,6 +26,10 @@ public:
                 Install,
                 (linglong::service::InstallParamOption installParamOption),
                 (override));
+    MOCK_METHOD(QDBusPendingReply<linglong::service::Reply>,
+                InstallMany,
+                (QList<linglong::service::InstallParamOption> installParamOptions),
+                (override));
     MOCK_METHOD(QDBusPendingReply<linglong::service::Reply>,
                 ModifyRepo,
                 (const QString &name, const QString &url),
@@ -42,6 +46,10 @@ public:
                 Update,
                 (linglong::service::ParamOption paramOption),
                 (override));
+    MOCK_METHOD(QDBusPendingReply<linglong::service::Reply>,
+                UpdateAll,
+                (QList<linglong::service::ParamOption> paramOptions),
+                (override));
     MOCK_METHOD(QDBusPendingReply<linglong::service::QueryReply>, getRepoInfo, (), (override));
 };
 } // namespace linglong::api::dbus::v1::test
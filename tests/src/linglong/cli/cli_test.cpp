@@ -150,8 +150,7 @@ TEST_F(CLITest, Kill)
 TEST_F(CLITest, Install)
 {
     auto args = parseCommand("ll-cli install \'xxxx\'");
-    EXPECT_CALL(*pkgMan, Install).Times(1).WillOnce(Return(createReply(service::Reply{ 0, "" })));
-    EXPECT_CALL(*pkgMan, GetDownloadStatus)
+    EXPECT_CALL(*pkgMan, Install)
       .Times(1)
       .WillOnce(Return(createReply(service::Reply{ STATUS_CODE(kPkgInstallSuccess), "" })));
 
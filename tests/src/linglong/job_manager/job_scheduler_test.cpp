@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/job_manager/job_scheduler.h"
+
+#include <QSemaphore>
+#include <QtConcurrent/QtConcurrent>
+
+#include <atomic>
+
+using namespace linglong::job_manager;
+
+TEST(JobManagerJobScheduler, Priority)
+{
+    JobScheduler scheduler;
+    scheduler.setMaxThreadCount(1);
+
+    QSemaphore blockerStarted;
+    QSemaphore blocker;
+    QMutex orderMutex;
+    QStringList order;
+    auto record = [&](const QString &name) {
+        QMutexLocker locker(&orderMutex);
+        order.append(name);
+    };
+
+    scheduler.submit(JobPriority::Interactive, "blocker", [&]() {
+        blockerStarted.release();
+        blocker.acquire();
+    });
+    blockerStarted.acquire();
+    scheduler.submit(JobPriority::Prefetch, "prefetch", [&]() {
+        record("prefetch");
+    });
+    scheduler.submit(JobPriority::BackgroundUpdate, "update", [&]() {
+        record("update");
+    });
+    scheduler.submit(JobPriority::Interactive, "install", [&]() {
+        record("install");
+    });
+
+    auto stats = scheduler.statistics();
+    EXPECT_EQ(stats["prefetch"].toMap()["queued"].toInt(), 1);
+    EXPECT_EQ(stats["interactive"].toMap()["running"].toInt(), 1);
+
+    blocker.release();
+    scheduler.waitForDone();
+
+    EXPECT_EQ(order, QStringList({ "install", "update", "prefetch" }));
+    stats = scheduler.statistics();
+    EXPECT_EQ(stats["interactive"].toMap()["finished"].toInt(), 2);
+    EXPECT_EQ(stats["prefetch"].toMap()["queued"].toInt(), 0);
+}
+
+TEST(JobManagerJobScheduler, RunOnce)
+{
+    JobScheduler scheduler;
+    std::atomic<int> calls{ 0 };
+    QSemaphore started;
+    QSemaphore release;
+
+    auto task = [&]() {
+        ++calls;
+        started.release();
+        release.acquire();
+        return linglong::service::Reply{ 0, "installed" };
+    };
+
+    auto first = QtConcurrent::run([&]() {
+        return scheduler.runOnce("runtime/org.deepin.Runtime", task);
+    });
+    started.acquire();
+    auto second = QtConcurrent::run([&]() {
+        return scheduler.runOnce("runtime/org.deepin.Runtime", task);
+    });
+    QThread::msleep(50);
+    release.release(2);
+
+    EXPECT_EQ(first.result().message, "installed");
+    EXPECT_EQ(second.result().message, "installed");
+    EXPECT_EQ(calls.load(), 1);
+}
+
+TEST(JobManagerJobScheduler, ResourceLock)
+{
+    JobScheduler scheduler;
+    scheduler.lockResource("ref:a");
+    auto waiter = QtConcurrent::run([&]() {
+        scheduler.lockResource("ref:a");
+        scheduler.unlockResource("ref:a");
+    });
+    QThread::msleep(50);
+    EXPECT_FALSE(waiter.isFinished());
+    scheduler.unlockResource("ref:a");
+    waiter.waitForFinished();
+    EXPECT_TRUE(scheduler.statistics()["lockedResources"].toStringList().isEmpty());
+}
@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/job_manager/job.h"
+#include "linglong/util/status_code.h"
+
+#include <gio/gio.h>
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+using linglong::job_manager::Job;
+
+TEST(JobManagerJob, PauseResume)
+{
+    Job job("pause-resume");
+    EXPECT_EQ(Job::find("pause-resume").data(), &job);
+    EXPECT_EQ(Job::find(job.path()).data(), &job);
+
+    g_autoptr(GCancellable) before = job.cancellable();
+    job.pause();
+    EXPECT_TRUE(g_cancellable_is_cancelled(before));
+    EXPECT_EQ(job.GetState().code, STATUS_CODE(kJobPaused));
+
+    auto waiter = QtConcurrent::run([&job]() {
+        return job.waitWhilePaused();
+    });
+    QThread::msleep(50);
+    EXPECT_FALSE(waiter.isFinished());
+
+    job.resume();
+    EXPECT_TRUE(waiter.result());
+
+    g_autoptr(GCancellable) after = job.cancellable();
+    EXPECT_FALSE(g_cancellable_is_cancelled(after));
+}
+
+TEST(JobManagerJob, CancelWakesPausedWaiter)
+{
+    Job job("cancel");
+    job.pause();
+
+    auto waiter = QtConcurrent::run([&job]() {
+        return job.waitWhilePaused();
+    });
+    job.cancel();
+    EXPECT_FALSE(waiter.result());
+    EXPECT_TRUE(job.isCancelled());
+
+    g_autoptr(GCancellable) cancellable = job.cancellable();
+    EXPECT_TRUE(g_cancellable_is_cancelled(cancellable));
+
+    job.finish({ STATUS_CODE(kJobCancelled), "cancelled" });
+    EXPECT_TRUE(job.IsFinished());
+    // 结束后的暂停、恢复请求不再改变状态
+    job.resume();
+    EXPECT_EQ(job.GetState().code, STATUS_CODE(kJobCancelled));
+}
+
+TEST(JobManagerJob, JobTable)
+{
+    {
+        Job job("table");
+        EXPECT_TRUE(Job::list().contains("table"));
+    }
+    EXPECT_FALSE(Job::list().contains("table"));
+    EXPECT_TRUE(Job::find("table").isNull());
+}
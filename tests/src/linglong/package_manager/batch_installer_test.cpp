@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/package_manager/batch_installer.h"
+#include "linglong/util/status_code.h"
+
+#include <QMutex>
+
+using namespace linglong::service;
+
+namespace {
+struct Recorder
+{
+    QMutex mutex;
+    QStringList dependencies;
+    QStringList deployed;
+};
+
+BatchInstaller makeInstaller(Recorder &recorder,
+                             const QStringList &failingDeps = {},
+                             const QStringList &failingApps = {})
+{
+    BatchInstaller installer;
+    installer.installDependency = [&recorder, failingDeps](const QString &dep, QString &err) {
+        QMutexLocker locker(&recorder.mutex);
+        recorder.dependencies << dep;
+        if (failingDeps.contains(dep)) {
+            err = "install " + dep + " failed";
+            return false;
+        }
+        return true;
+    };
+    installer.deploy = [&recorder, failingApps](const QString &appId) {
+        {
+            QMutexLocker locker(&recorder.mutex);
+            recorder.deployed << appId;
+        }
+        Reply reply;
+        if (failingApps.contains(appId)) {
+            reply.code = STATUS_CODE(kLoadPkgDataFailed);
+            reply.message = "deploy " + appId + " failed";
+        } else {
+            reply.code = STATUS_CODE(kPkgInstallSuccess);
+            reply.message = "install " + appId + " success";
+        }
+        return reply;
+    };
+    installer.dependencyErrorCode = [](const QString &dep) {
+        return dep.startsWith("base") ? STATUS_CODE(kInstallBaseFailed)
+                                      : STATUS_CODE(kInstallRuntimeFailed);
+    };
+    return installer;
+}
+} // namespace
+
+TEST(PackageManagerBatchInstaller, SharedDependenciesInstalledOnce)
+{
+    Recorder recorder;
+    auto installer = makeInstaller(recorder);
+
+    auto results = installer.run({ { "org.deepin.a", { "runtime-1", "base-1" } },
+                                   { "org.deepin.b", { "runtime-1", "base-1" } },
+                                   { "org.deepin.c", { "runtime-2" } } },
+                                 { "runtime-1", "base-1", "runtime-1", "runtime-2" });
+
+    recorder.dependencies.sort();
+    EXPECT_EQ(recorder.dependencies, QStringList({ "base-1", "runtime-1", "runtime-2" }));
+    recorder.deployed.sort();
+    EXPECT_EQ(recorder.deployed, QStringList({ "org.deepin.a", "org.deepin.b", "org.deepin.c" }));
+    ASSERT_EQ(results.size(), 3);
+    for (const auto &reply : results) {
+        EXPECT_EQ(reply.code, STATUS_CODE(kPkgInstallSuccess));
+    }
+}
+
+TEST(PackageManagerBatchInstaller, PartialFailure)
+{
+    Recorder recorder;
+    auto installer = makeInstaller(recorder, { "runtime-2", "base-1" }, { "org.deepin.d" });
+
+    auto results = installer.run({ { "org.deepin.a", { "runtime-1" } },
+                                   { "org.deepin.b", { "runtime-2" } },
+                                   { "org.deepin.c", { "runtime-1", "base-1" } },
+                                   { "org.deepin.d", { "runtime-1" } },
+                                   { "org.deepin.e", { "runtime-3" } } },
+                                 { "runtime-1", "runtime-2", "base-1" },
+                                 { { "runtime-3", "runtime-3 not found" } });
+
+    ASSERT_EQ(results.size(), 5);
+    EXPECT_EQ(results.value("org.deepin.a").code, STATUS_CODE(kPkgInstallSuccess));
+
+    // 依赖失败的应用不部署，返回依赖的错误
+    EXPECT_EQ(results.value("org.deepin.b").code, STATUS_CODE(kInstallRuntimeFailed));
+    EXPECT_EQ(results.value("org.deepin.b").message, "install runtime-2 failed");
+    EXPECT_EQ(results.value("org.deepin.c").code, STATUS_CODE(kInstallBaseFailed));
+    EXPECT_EQ(results.value("org.deepin.e").code, STATUS_CODE(kInstallRuntimeFailed));
+    EXPECT_EQ(results.value("org.deepin.e").message, "runtime-3 not found");
+
+    // 单个应用部署失败不影响其它应用
+    EXPECT_EQ(results.value("org.deepin.d").code, STATUS_CODE(kLoadPkgDataFailed));
+
+    recorder.deployed.sort();
+    EXPECT_EQ(recorder.deployed, QStringList({ "org.deepin.a", "org.deepin.d" }));
+    EXPECT_FALSE(recorder.dependencies.contains("runtime-3"));
+}
+
+TEST(PackageManagerBatchInstaller, Empty)
+{
+    Recorder recorder;
+    auto installer = makeInstaller(recorder);
+    EXPECT_TRUE(installer.run({}, {}).isEmpty());
+    EXPECT_TRUE(recorder.dependencies.isEmpty());
+}
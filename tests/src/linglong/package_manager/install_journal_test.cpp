@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/package_manager/install_journal.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+using namespace linglong::service;
+
+namespace {
+InstallJournal::Transaction demoTransaction()
+{
+    InstallJournal::Transaction transaction;
+    transaction.kind = "app";
+    transaction.ref = "main/org.deepin.demo/1.0.0/x86_64/runtime";
+    transaction.installPath = "/nonexistent/layers/org.deepin.demo/1.0.0/x86_64";
+    transaction.user = "deepin-linglong";
+    transaction.appInfo = QJsonObject{ { "appId", "org.deepin.demo" } };
+    return transaction;
+}
+} // namespace
+
+TEST(PackageManagerInstallJournal, Steps)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    InstallJournal journal(dir.path());
+
+    const auto id = journal.begin(demoTransaction());
+    ASSERT_FALSE(id.isEmpty());
+    journal.complete(id, InstallJournal::Fetch);
+    journal.complete(id, InstallJournal::Fetch);
+    journal.complete(id, InstallJournal::Checkout);
+
+    // 新建的日志对象读到同样的状态，模拟服务重启
+    auto interrupted = InstallJournal(dir.path()).interrupted();
+    ASSERT_EQ(interrupted.size(), 1);
+    const auto &transaction = interrupted.at(0);
+    EXPECT_EQ(transaction.id, id);
+    EXPECT_EQ(transaction.ref, demoTransaction().ref);
+    EXPECT_EQ(transaction.appInfo.value("appId").toString(), "org.deepin.demo");
+    EXPECT_EQ(transaction.completed,
+              QList<InstallJournal::Step>({ InstallJournal::Resolve,
+                                            InstallJournal::Fetch,
+                                            InstallJournal::Checkout }));
+    EXPECT_FALSE(transaction.done(InstallJournal::Erofs));
+
+    journal.finish(id);
+    EXPECT_TRUE(journal.interrupted().isEmpty());
+    EXPECT_TRUE(QDir(dir.path()).isEmpty());
+}
+
+TEST(PackageManagerInstallJournal, ResumeTmpRepo)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    InstallJournal journal(dir.path() + "/journal");
+    const QString tmpRepo = dir.path() + "/linglong-cache-demo";
+    ASSERT_TRUE(QDir().mkpath(tmpRepo + "/repoTmp"));
+
+    auto id = journal.begin(demoTransaction());
+    journal.setTmpRepoDir(id, tmpRepo);
+    journal.rollBack(id);
+    EXPECT_TRUE(journal.interrupted().isEmpty());
+
+    // 重试同一 ref 时继承上次的临时仓库
+    auto retry = journal.begin(demoTransaction());
+    EXPECT_NE(retry, id);
+    EXPECT_EQ(journal.tmpRepoDir(retry), tmpRepo);
+    EXPECT_EQ(journal.interrupted().size(), 1);
+
+    // 超过保留时间的回滚事务连同临时仓库一起删除
+    journal.rollBack(retry);
+    journal.expireRolledBack(QDateTime::currentDateTime());
+    EXPECT_TRUE(QDir(tmpRepo).exists());
+    journal.expireRolledBack(
+      QDateTime::currentDateTime().addDays(InstallJournal::kRolledBackExpireDays));
+    EXPECT_FALSE(QDir(tmpRepo).exists());
+    EXPECT_TRUE(journal.tmpRepoDir(retry).isEmpty());
+}
+
+TEST(PackageManagerInstallJournal, RollBackWithoutTmpRepo)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    InstallJournal journal(dir.path());
+
+    auto id = journal.begin(demoTransaction());
+    journal.rollBack(id);
+    EXPECT_TRUE(QDir(dir.path()).isEmpty());
+}
+
+TEST(PackageManagerInstallJournal, RemoveCheckoutKeepsDevel)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString installPath = dir.filePath("org.deepin.demo/1.0.0/x86_64");
+    ASSERT_TRUE(QDir().mkpath(installPath + "/files/bin"));
+    ASSERT_TRUE(QDir().mkpath(installPath + "/devel/files/include"));
+    QFile info(installPath + "/info.json");
+    ASSERT_TRUE(info.open(QIODevice::WriteOnly));
+    info.close();
+
+    // 中断的 runtime 模块安装不能删除已安装的 devel 模块
+    auto transaction = demoTransaction();
+    transaction.installPath = installPath;
+    InstallJournal::removeCheckout(transaction);
+    EXPECT_TRUE(QDir(installPath + "/devel/files/include").exists());
+    EXPECT_FALSE(QDir(installPath + "/files").exists());
+    EXPECT_FALSE(QFile::exists(installPath + "/info.json"));
+
+    transaction.ref = "main/org.deepin.demo/1.0.0/x86_64/devel";
+    transaction.installPath = installPath + "/devel";
+    InstallJournal::removeCheckout(transaction);
+    EXPECT_FALSE(QDir(installPath + "/devel").exists());
+}
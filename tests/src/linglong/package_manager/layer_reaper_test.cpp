@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/package_manager/layer_reaper.h"
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+using namespace linglong::service;
+
+namespace {
+void makeTree(const QString &root)
+{
+    for (const auto &sub : { "files/bin", "files/lib", "entries/share/applications" }) {
+        ASSERT_TRUE(QDir().mkpath(root + "/" + sub));
+        QFile file(root + "/" + sub + "/data");
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+        file.write("linglong");
+    }
+}
+} // namespace
+
+TEST(PackageManagerLayerReaper, RemoveAndPrune)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString layer = dir.path() + "/layers/org.deepin.demo/1.0.0";
+    makeTree(layer);
+
+    QAtomicInt pruned;
+    LayerReaper reaper(dir.path() + "/.trash", [&pruned]() {
+        pruned.ref();
+    });
+
+    EXPECT_TRUE(reaper.remove(layer));
+    EXPECT_FALSE(QDir(layer).exists());
+    reaper.requestPrune();
+    reaper.requestPrune();
+    reaper.waitForIdle();
+
+    EXPECT_TRUE(QDir(reaper.trashDir()).isEmpty());
+    EXPECT_GE(pruned.loadAcquire(), 1);
+    EXPECT_LE(pruned.loadAcquire(), 2);
+
+    // 不存在的目录视为已删除
+    EXPECT_TRUE(reaper.remove(layer));
+}
+
+TEST(PackageManagerLayerReaper, ReapLeftovers)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    makeTree(dir.path() + "/.trash/leftover");
+
+    LayerReaper reaper(dir.path() + "/.trash");
+    reaper.reap();
+    reaper.waitForIdle();
+    EXPECT_TRUE(QDir(reaper.trashDir()).isEmpty());
+}
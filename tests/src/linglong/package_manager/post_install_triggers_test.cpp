@@ -0,0 +1,75 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/package_manager/post_install_triggers.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+using namespace linglong::service;
+
+namespace {
+class RecordingTriggers : public PostInstallTriggers
+{
+public:
+    using PostInstallTriggers::PostInstallTriggers;
+
+    QList<Trigger> executed;
+
+protected:
+    void runTrigger(Trigger trigger) override { executed.append(trigger); }
+};
+
+void touch(const QString &path)
+{
+    QDir().mkpath(QFileInfo(path).path());
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+}
+} // namespace
+
+TEST(PackageManagerPostInstallTriggers, TriggersFor)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    EXPECT_EQ(PostInstallTriggers::triggersFor(dir.path()), PostInstallTriggers::Triggers());
+
+    QDir(dir.path()).mkpath("mime/packages");
+    touch(dir.path() + "/applications/org.deepin.demo.desktop");
+    EXPECT_EQ(PostInstallTriggers::triggersFor(dir.path()),
+              PostInstallTriggers::Triggers(PostInstallTriggers::DesktopDatabase));
+
+    touch(dir.path() + "/glib-2.0/schemas/org.deepin.demo.gschema.xml");
+    EXPECT_EQ(PostInstallTriggers::triggersFor(dir.path()),
+              PostInstallTriggers::DesktopDatabase | PostInstallTriggers::GSettingsSchemas);
+}
+
+TEST(PackageManagerPostInstallTriggers, Coalesce)
+{
+    RecordingTriggers triggers("/nonexistent");
+
+    for (int i = 0; i < 30; ++i) {
+        triggers.markDirty(PostInstallTriggers::DesktopDatabase);
+    }
+    triggers.markDirty(PostInstallTriggers::MimeDatabase);
+    triggers.markDirty({});
+    EXPECT_EQ(triggers.pending(),
+              PostInstallTriggers::DesktopDatabase | PostInstallTriggers::MimeDatabase);
+
+    triggers.flush();
+    EXPECT_EQ(triggers.executed,
+              QList<PostInstallTriggers::Trigger>(
+                { PostInstallTriggers::DesktopDatabase, PostInstallTriggers::MimeDatabase }));
+    EXPECT_EQ(triggers.pending(), PostInstallTriggers::Triggers());
+
+    triggers.flush();
+    EXPECT_EQ(triggers.executed.size(), 2);
+}
@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/package_manager/prefetch_record.h"
+
+#include <QTemporaryDir>
+
+using namespace linglong::service;
+
+namespace {
+const QString kDemoV2 = "main/org.deepin.demo/2.0.0/x86_64/runtime";
+const QString kDemoV3 = "main/org.deepin.demo/3.0.0/x86_64/runtime";
+const QString kOther = "main/org.deepin.other/1.0.0/x86_64/runtime";
+} // namespace
+
+TEST(PackageManagerPrefetchRecord, Persist)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString path = dir.filePath("prefetch.json");
+
+    {
+        PrefetchRecord record(path);
+        record.add(kDemoV2);
+        record.add(kDemoV2);
+        record.add(kOther);
+    }
+
+    // 重启后仍能清理之前预取的数据
+    PrefetchRecord record(path);
+    EXPECT_EQ(record.refs(), QStringList({ kDemoV2, kOther }));
+    EXPECT_TRUE(record.take(kOther));
+    EXPECT_FALSE(record.take(kOther));
+    EXPECT_EQ(PrefetchRecord(path).refs(), QStringList({ kDemoV2 }));
+}
+
+TEST(PackageManagerPrefetchRecord, TakeIf)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    PrefetchRecord record(dir.filePath("prefetch.json"));
+    record.add(kDemoV2);
+    record.add(kDemoV3);
+    record.add(kOther);
+
+    EXPECT_EQ(PrefetchRecord::packageOf(kDemoV2), "main/org.deepin.demo/x86_64/runtime");
+    EXPECT_EQ(PrefetchRecord::versionOf(kDemoV3), "3.0.0");
+    EXPECT_TRUE(PrefetchRecord::packageOf("invalid").isEmpty());
+
+    // 安装 3.0.0 后同一软件包的旧预取数据不再需要
+    const auto stale = record.takeIf([](const QString &ref) {
+        return PrefetchRecord::packageOf(ref) == PrefetchRecord::packageOf(kDemoV3)
+          && ref != kDemoV3;
+    });
+    EXPECT_EQ(stale, QStringList({ kDemoV2 }));
+    EXPECT_EQ(record.refs(), QStringList({ kDemoV3, kOther }));
+    EXPECT_TRUE(record.takeIf([](const QString &) {
+                          return false;
+                      })
+                  .isEmpty());
+}
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/repo/mirror_list.h"
+
+using namespace linglong::repo;
+
+namespace {
+const QString kRepo = "deepin";
+const QString kPrimary = "https://primary.example";
+const QString kMirrorA = "https://a.example";
+const QString kMirrorB = "https://b.example";
+} // namespace
+
+TEST(RepoMirrorList, ConfiguredOrder)
+{
+    MirrorList mirrors;
+    mirrors.setMirrors(kRepo, { kPrimary, kMirrorA, " ", kMirrorA, kMirrorB }, "/config");
+
+    // 未测量前保持配置顺序并去重
+    EXPECT_EQ(mirrors.endpoints(kRepo), QStringList({ kPrimary, kMirrorA, kMirrorB }));
+    EXPECT_EQ(mirrors.best(kRepo), kPrimary);
+    EXPECT_TRUE(mirrors.endpoints("unknown").isEmpty());
+}
+
+TEST(RepoMirrorList, LatencySelection)
+{
+    MirrorList mirrors;
+    mirrors.setMirrors(kRepo, { kPrimary, kMirrorA, kMirrorB }, "/config");
+
+    mirrors.reportSuccess(kRepo, kPrimary, 300);
+    mirrors.reportSuccess(kRepo, kMirrorA, 40);
+    EXPECT_EQ(mirrors.endpoints(kRepo), QStringList({ kMirrorA, kPrimary, kMirrorB }));
+
+    // 吞吐量低的镜像下载大对象更慢
+    mirrors.reportSuccess(kRepo, kMirrorA, -1, 1024 * 1024, 10 * 1000);
+    mirrors.reportSuccess(kRepo, kPrimary, -1, 8 * 1024 * 1024, 1000);
+    EXPECT_EQ(mirrors.best(kRepo), kPrimary);
+}
+
+TEST(RepoMirrorList, Failover)
+{
+    MirrorList mirrors;
+    mirrors.setMirrors(kRepo, { kPrimary, kMirrorA }, "/config");
+    mirrors.reportSuccess(kRepo, kPrimary, 10);
+    mirrors.reportSuccess(kRepo, kMirrorA, 100);
+
+    for (int i = 0; i < MirrorList::kMaxConsecutiveFailures; ++i) {
+        EXPECT_EQ(mirrors.best(kRepo), kPrimary);
+        mirrors.reportFailure(kRepo, kPrimary, "timeout");
+    }
+    EXPECT_EQ(mirrors.endpoints(kRepo), QStringList({ kMirrorA, kPrimary }));
+
+    auto status = mirrors.statistics()[kRepo].toList();
+    ASSERT_EQ(status.size(), 2);
+    auto primary = status.at(1).toMap();
+    EXPECT_EQ(primary["endpoint"].toString(), kPrimary);
+    EXPECT_FALSE(primary["available"].toBool());
+    EXPECT_EQ(primary["failures"].toInt(), MirrorList::kMaxConsecutiveFailures);
+    EXPECT_EQ(primary["lastError"].toString(), "timeout");
+
+    // 恢复后重新参与排序，修改配置时保留统计
+    mirrors.reportSuccess(kRepo, kPrimary, 10);
+    mirrors.setMirrors(kRepo, { kMirrorA, kPrimary }, "/config");
+    EXPECT_EQ(mirrors.best(kRepo), kPrimary);
+}
@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/repo/ostree_repohelper.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <sys/stat.h>
+
+using linglong::CommitEntry;
+using linglong::OstreeRepoHelper;
+
+namespace {
+void writeFile(const QString &path, const QByteArray &data)
+{
+    QDir().mkpath(QFileInfo(path).path());
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(data);
+}
+
+ino_t inodeOf(const QString &path)
+{
+    struct stat st;
+    if (lstat(QFile::encodeName(path).constData(), &st) != 0) {
+        return 0;
+    }
+    return st.st_ino;
+}
+
+CommitEntry dirEntry(const QString &path, quint32 mode = 0755)
+{
+    return { path, true, mode };
+}
+
+CommitEntry fileEntry(const QString &path)
+{
+    return { path, false, 0644 };
+}
+} // namespace
+
+TEST(RepoOstreeRepoHelper, LinkUnchangedEntries)
+{
+    QTemporaryDir tmp;
+    ASSERT_TRUE(tmp.isValid());
+    const QString base = tmp.filePath("base");
+    const QString dst = tmp.filePath("dst");
+    QDir().mkpath(dst);
+
+    // 旧版本签出目录，除提交中的文件外还有 devel 模块及安装后生成的文件
+    writeFile(base + "/info.json", "unchanged");
+    writeFile(base + "/files/bin/app", "changed");
+    writeFile(base + "/files/lib/libfoo.so", "unchanged");
+    writeFile(base + "/files/share/removed/data", "removed");
+    writeFile(base + "/files/lib/generated.cache", "extra");
+    writeFile(base + "/devel/files/include/foo.h", "extra");
+
+    const QList<CommitEntry> entries = {
+        fileEntry("info.json"),
+        dirEntry("files"),
+        dirEntry("files/bin"),
+        fileEntry("files/bin/app"),
+        dirEntry("files/lib", 0750),
+        fileEntry("files/lib/libfoo.so"),
+        dirEntry("files/share"),
+        dirEntry("files/share/removed"),
+        fileEntry("files/share/removed/data"),
+    };
+
+    QString err;
+    ASSERT_TRUE(OstreeRepoHelper::linkUnchangedEntries(base,
+                                                       dst,
+                                                       entries,
+                                                       { "files/bin/app", "files/share/removed" },
+                                                       err))
+      << err.toStdString();
+
+    // 未变化的文件与旧版本共享 inode
+    EXPECT_EQ(inodeOf(dst + "/info.json"), inodeOf(base + "/info.json"));
+    EXPECT_EQ(inodeOf(dst + "/files/lib/libfoo.so"), inodeOf(base + "/files/lib/libfoo.so"));
+    const auto libPermissions = QFileInfo(dst + "/files/lib").permissions();
+    EXPECT_TRUE(libPermissions.testFlag(QFile::ExeGroup));
+    EXPECT_FALSE(libPermissions.testFlag(QFile::ReadOther));
+
+    // 变化及删除的路径留给签出流程，目录本身仍按提交重建
+    EXPECT_TRUE(QFileInfo(dst + "/files/bin").isDir());
+    EXPECT_FALSE(QFileInfo::exists(dst + "/files/bin/app"));
+    EXPECT_FALSE(QFileInfo::exists(dst + "/files/share/removed"));
+
+    // 不属于旧版本提交的文件不会被链接
+    EXPECT_FALSE(QFileInfo::exists(dst + "/files/lib/generated.cache"));
+    EXPECT_FALSE(QFileInfo::exists(dst + "/devel"));
+}
+
+TEST(RepoOstreeRepoHelper, LinkUnchangedEntriesMissingSource)
+{
+    QTemporaryDir tmp;
+    ASSERT_TRUE(tmp.isValid());
+    QDir().mkpath(tmp.filePath("base"));
+    QDir().mkpath(tmp.filePath("dst"));
+
+    // 旧版本签出目录与提交不一致时报错，由调用方退回完整签出
+    QString err;
+    EXPECT_FALSE(OstreeRepoHelper::linkUnchangedEntries(tmp.filePath("base"),
+                                                        tmp.filePath("dst"),
+                                                        { fileEntry("info.json") },
+                                                        {},
+                                                        err));
+    EXPECT_FALSE(err.isEmpty());
+}
+
+TEST(RepoOstreeRepoHelper, MirrorErrorClassification)
+{
+    g_autoptr(GError) timeout = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "timeout");
+    g_autoptr(GError) refMissing =
+      g_error_new_literal(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No such branch");
+    g_autoptr(GError) cancelled =
+      g_error_new_literal(G_IO_ERROR, G_IO_ERROR_CANCELLED, "Operation was cancelled");
+
+    // 只有镜像本身的异常计入镜像的失败次数
+    EXPECT_TRUE(OstreeRepoHelper::isMirrorError(timeout));
+    EXPECT_FALSE(OstreeRepoHelper::isMirrorError(refMissing));
+    EXPECT_FALSE(OstreeRepoHelper::isMirrorError(cancelled));
+    EXPECT_FALSE(OstreeRepoHelper::isMirrorError(nullptr));
+}
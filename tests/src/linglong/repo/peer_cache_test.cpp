@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/repo/peer_cache_server.h"
+#include "linglong/repo/peer_discovery.h"
+
+#include <QCoreApplication>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QtConcurrent/QtConcurrent>
+
+using namespace linglong::repo;
+
+TEST(RepoPeerCache, Route)
+{
+    const QString checksum = "ab" + QString(62, 'c');
+
+    auto route = PeerCacheServer::route("/config");
+    EXPECT_EQ(route.kind, PeerCacheServer::Route::Config);
+
+    route = PeerCacheServer::route("/objects/ab/" + checksum.mid(2) + ".filez");
+    EXPECT_EQ(route.kind, PeerCacheServer::Route::Object);
+    EXPECT_EQ(route.checksum, checksum);
+    EXPECT_EQ(route.objectType, "filez");
+
+    route = PeerCacheServer::route("/refs/heads/main/org.deepin.demo/1.0.0/x86_64/runtime");
+    EXPECT_EQ(route.kind, PeerCacheServer::Route::Ref);
+    EXPECT_EQ(route.ref, "main/org.deepin.demo/1.0.0/x86_64/runtime");
+
+    EXPECT_EQ(PeerCacheServer::route("/refs/heads/../../etc/passwd").kind,
+              PeerCacheServer::Route::NotFound);
+    EXPECT_EQ(PeerCacheServer::route("/objects/ab/" + checksum.mid(2) + ".file").kind,
+              PeerCacheServer::Route::NotFound);
+    EXPECT_EQ(PeerCacheServer::route("/summary").kind, PeerCacheServer::Route::NotFound);
+}
+
+TEST(RepoPeerCache, Discovery)
+{
+    PeerDiscovery first(48126);
+    PeerDiscovery second(48128);
+    second.setStaticPeers({ "http://192.168.1.10:48126/" });
+
+    // 忽略自身及格式错误的通告
+    second.handleAnnouncement(PeerDiscovery::announcement(second.instanceId(), 48128),
+                              QHostAddress::LocalHost);
+    second.handleAnnouncement("linglong-peer/1 broken", QHostAddress::LocalHost);
+    EXPECT_EQ(second.peers(), QStringList{ "http://192.168.1.10:48126" });
+
+    second.handleAnnouncement(PeerDiscovery::announcement(first.instanceId(), 48126),
+                              QHostAddress("::ffff:127.0.0.1"));
+    EXPECT_EQ(second.peers(),
+              QStringList({ "http://192.168.1.10:48126", "http://127.0.0.1:48126" }));
+}
+
+TEST(RepoPeerCache, ServeOnLoopback)
+{
+    int argc = 0;
+    char *argv = nullptr;
+    QCoreApplication app(argc, &argv);
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    PeerCacheServer server(dir.path() + "/repo");
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost, 0));
+
+    auto request = [](QTcpSocket &socket, const QByteArray &path) {
+        socket.write("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        QByteArray response;
+        while (!response.contains("\r\n\r\n") && socket.waitForReadyRead(5000)) {
+            response += socket.readAll();
+        }
+        return response;
+    };
+
+    auto ret = QtConcurrent::run([&]() {
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, server.serverPort());
+        EXPECT_TRUE(socket.waitForConnected(5000));
+
+        // 同一连接上依次处理多个请求
+        auto response = request(socket, "/config");
+        EXPECT_TRUE(response.startsWith("HTTP/1.1 200 OK"));
+        while (!response.endsWith("mode=archive-z2\n") && socket.waitForReadyRead(5000)) {
+            response += socket.readAll();
+        }
+        EXPECT_TRUE(response.endsWith("mode=archive-z2\n"));
+
+        response = request(socket, "/objects/ab/" + QByteArray(62, 'c') + ".filez");
+        EXPECT_TRUE(response.startsWith("HTTP/1.1 404 Not Found"));
+        QCoreApplication::exit(0);
+    });
+
+    QCoreApplication::exec();
+    ret.waitForFinished();
+}
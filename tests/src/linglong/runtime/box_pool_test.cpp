@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/box_pool.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <csignal>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace linglong::runtime;
+
+namespace {
+// 模拟 ll-box：读完 socket 中的配置后退出
+QString fakeBox(const QTemporaryDir &dir)
+{
+    const auto path = dir.filePath("ll-box");
+    QFile file(path);
+    file.open(QIODevice::WriteOnly);
+    file.write("#!/bin/sh\nexec cat <&$1 >/dev/null\n");
+    file.close();
+    file.setPermissions(file.permissions() | QFileDevice::ExeOwner);
+    return path;
+}
+
+// 写入配置并等待进程退出，返回是否正常退出
+bool run(const BoxPool::Box &box)
+{
+    const char data[] = "{}";
+    EXPECT_EQ(write(box.socket, data, sizeof(data)), static_cast<ssize_t>(sizeof(data)));
+    close(box.socket);
+    int status = 0;
+    return waitpid(box.pid, &status, 0) == box.pid && WIFEXITED(status)
+      && WEXITSTATUS(status) == 0;
+}
+} // namespace
+
+TEST(RuntimeBoxPool, TakeAndRefill)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    BoxPool pool(2, fakeBox(dir));
+    EXPECT_EQ(pool.idleCount(), 0);
+    pool.refill();
+    EXPECT_EQ(pool.idleCount(), 2);
+
+    BoxPool::Box box;
+    ASSERT_TRUE(pool.take(box));
+    EXPECT_EQ(pool.idleCount(), 1);
+    EXPECT_TRUE(run(box));
+
+    pool.refill();
+    EXPECT_EQ(pool.idleCount(), 2);
+
+    pool.setSize(1);
+    EXPECT_EQ(pool.idleCount(), 1);
+}
+
+TEST(RuntimeBoxPool, DiscardDeadBox)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    BoxPool pool(1, fakeBox(dir));
+    pool.refill();
+    ASSERT_EQ(pool.idleCount(), 1);
+
+    BoxPool::Box box;
+    ASSERT_TRUE(pool.take(box));
+    kill(box.pid, SIGKILL);
+    waitpid(box.pid, nullptr, 0);
+    close(box.socket);
+
+    pool.refill();
+    ASSERT_TRUE(pool.take(box));
+    EXPECT_TRUE(run(box));
+
+    BoxPool empty(0, fakeBox(dir));
+    EXPECT_FALSE(empty.take(box));
+}
+
+// 对比冷启动（fork + exec）与使用池中已启动进程时，从开始启动到 ll-box 读完配置并退出的耗时，
+// 只输出结果，不作为断言
+TEST(RuntimeBoxPool, ColdVersusWarmStart)
+{
+    if (!qEnvironmentVariableIsSet("LINGLONG_TEST_ALL")) {
+        return;
+    }
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const auto program = fakeBox(dir);
+    constexpr int rounds = 20;
+
+    qint64 coldNsec = 0;
+    for (int i = 0; i < rounds; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        BoxPool::Box box;
+        ASSERT_TRUE(BoxPool::spawn(program, box));
+        EXPECT_TRUE(run(box));
+        coldNsec += timer.nsecsElapsed();
+    }
+
+    BoxPool pool(1, program);
+    qint64 warmNsec = 0;
+    for (int i = 0; i < rounds; ++i) {
+        // 补充进程在启动之外完成，与服务中后台补充的时机一致
+        pool.refill();
+        QElapsedTimer timer;
+        timer.start();
+        BoxPool::Box box;
+        ASSERT_TRUE(pool.take(box));
+        EXPECT_TRUE(run(box));
+        warmNsec += timer.nsecsElapsed();
+    }
+
+    qInfo() << "config write to exit, cold start:" << coldNsec / rounds / 1000
+            << "us, warm start:" << warmNsec / rounds / 1000 << "us";
+}
@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/container_reaper.h"
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QTimer>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace linglong::runtime;
+
+TEST(RuntimeContainerReaper, ReapManyChildren)
+{
+    int argc = 0;
+    char *argv = nullptr;
+    QCoreApplication app(argc, &argv);
+
+    constexpr int children = 200;
+    ContainerReaper reaper;
+    QHash<QString, int> exitCodes;
+    QObject::connect(&reaper,
+                     &ContainerReaper::containerExited,
+                     [&](const QString &id, qint64, int status) {
+                         EXPECT_TRUE(WIFEXITED(status));
+                         exitCodes.insert(id, WEXITSTATUS(status));
+                         if (exitCodes.size() == children) {
+                             QCoreApplication::exit(0);
+                         }
+                     });
+
+    for (int i = 0; i < children; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            usleep(1000 * (i % 20));
+            _exit(i % 8);
+        }
+        reaper.watch(QString::number(i), pid);
+    }
+
+    QTimer::singleShot(10000, []() {
+        QCoreApplication::exit(1);
+    });
+    EXPECT_EQ(QCoreApplication::exec(), 0);
+
+    ASSERT_EQ(exitCodes.size(), children);
+    for (int i = 0; i < children; ++i) {
+        EXPECT_EQ(exitCodes.value(QString::number(i), -1), i % 8);
+    }
+    EXPECT_EQ(reaper.count(), 0);
+}
@@ -0,0 +1,242 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/font_cache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QTemporaryDir>
+
+#include <algorithm>
+
+#include <sys/stat.h>
+
+using namespace linglong::runtime;
+
+namespace {
+void writeFile(const QString &path, const QByteArray &data)
+{
+    QDir().mkpath(QFileInfo(path).path());
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(data);
+}
+
+void writeProgram(const QString &path)
+{
+    writeFile(path, "#!/bin/sh\n");
+    QFile::setPermissions(path, QFile::permissions(path) | QFileDevice::ExeOwner);
+}
+
+void makeRuntime(const QString &layerPath, bool withFontconfig)
+{
+    writeFile(layerPath + "/info.json", R"({"appid":"org.deepin.Runtime","kind":"runtime"})");
+    if (withFontconfig) {
+        writeProgram(layerPath + "/files/bin/fc-cache");
+    }
+}
+
+// 不启动 ll-box，直接在容器内路径对应的目录中写入缓存文件
+class FakeFontCache : public FontCache
+{
+public:
+    using FontCache::FontCache;
+
+    mutable int runs = 0;
+    mutable QStringList programs;
+
+protected:
+    bool runInContainer(const QString &,
+                        const QString &buildDir,
+                        const QStringList &args,
+                        const std::function<bool()> &) const override
+    {
+        ++runs;
+        programs.append(QFileInfo(args.value(0)).fileName());
+        QString output;
+        if (args.value(0).endsWith("/fc-cache")) {
+            output = buildDir + "/fonts/fonts-le64.cache-9";
+        } else {
+            const auto theme = args.last().mid(QString(kContainerDir).size());
+            output = buildDir + theme + "/icon-theme.cache";
+        }
+        QFile file(output);
+        return file.open(QIODevice::WriteOnly) && file.write("cache") > 0;
+    }
+};
+} // namespace
+
+TEST(RuntimeFontCache, RuntimeLayers)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto layers = dir.filePath("layers");
+    makeRuntime(layers + "/org.deepin.Runtime/23.0.0.0/x86_64", true);
+    writeFile(layers + "/org.deepin.demo/1.0.0.0/x86_64/info.json", R"({"kind":"app"})");
+
+    EXPECT_EQ(FontCache::runtimeLayers(layers),
+              QStringList{ layers + "/org.deepin.Runtime/23.0.0.0/x86_64" });
+    EXPECT_TRUE(FontCache::hasFontconfig(layers + "/org.deepin.Runtime/23.0.0.0/x86_64"));
+    EXPECT_FALSE(FontCache::hasFontconfig(layers + "/org.deepin.demo/1.0.0.0/x86_64"));
+}
+
+TEST(RuntimeFontCache, UpdateAndInvalidate)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto layers = dir.filePath("layers");
+    auto fonts = dir.filePath("fonts");
+    ASSERT_TRUE(QDir().mkpath(fonts + "/truetype"));
+    auto runtime = layers + "/org.deepin.Runtime/23.0.0.0/x86_64";
+    makeRuntime(runtime, true);
+    makeRuntime(layers + "/org.deepin.Other/23.0.0.0/x86_64", false);
+
+    FakeFontCache cache(dir.filePath("cache"), { fonts });
+    EXPECT_FALSE(cache.isUpToDate(runtime));
+    EXPECT_EQ(cache.cacheDir(runtime), cache.cacheDir(runtime + "/"));
+    // devel 模块与 runtime 共用缓存
+    EXPECT_EQ(cache.cacheDir(runtime + "/devel"), cache.cacheDir(runtime));
+
+    cache.update(layers);
+    EXPECT_EQ(cache.runs, 1);
+    EXPECT_TRUE(cache.isUpToDate(runtime));
+    EXPECT_TRUE(cache.isUpToDate(runtime + "/devel"));
+    EXPECT_TRUE(QFile::exists(cache.cacheDir(runtime) + "/fonts/fonts-le64.cache-9"));
+    EXPECT_FALSE(QFile::exists(cache.cacheDir(runtime) + "/fonts/fonts.conf"));
+    EXPECT_EQ(cache.mounts(runtime),
+              (QList<QPair<QString, QString>>{
+                { cache.cacheDir(runtime) + "/fonts", FontCache::kContainerDir } }));
+    EXPECT_EQ(QDir(cache.directory()).entryList(QDir::Dirs | QDir::NoDotAndDotDot).size(), 1);
+
+    // 宿主字体只在 update 时检查，启动应用时不扫描字体目录
+    const auto digest = cache.fontsDigest();
+    writeFile(fonts + "/truetype/demo/demo.ttf", "font");
+    EXPECT_NE(cache.fontsDigest(), digest);
+    EXPECT_TRUE(cache.isUpToDate(runtime));
+    cache.update(layers);
+    EXPECT_EQ(cache.runs, 2);
+    EXPECT_TRUE(cache.isUpToDate(runtime));
+    cache.update(layers);
+    EXPECT_EQ(cache.runs, 2);
+
+    // 取消时不再生成
+    writeFile(fonts + "/truetype/demo/other.ttf", "font");
+    cache.update(layers, []() {
+        return true;
+    });
+    EXPECT_EQ(cache.runs, 2);
+    EXPECT_FALSE(cache.isUpToDate(runtime));
+
+    // runtime 卸载后删除缓存
+    QDir(layers + "/org.deepin.Runtime").removeRecursively();
+    cache.update(layers);
+    EXPECT_TRUE(QDir(cache.directory()).entryList(QDir::Dirs | QDir::NoDotAndDotDot).isEmpty());
+}
+
+TEST(RuntimeFontCache, ContainerConfig)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto fonts = dir.filePath("fonts");
+    ASSERT_TRUE(QDir().mkpath(fonts));
+    auto runtime = dir.filePath("layers/org.deepin.Runtime/23.0.0.0/x86_64");
+    makeRuntime(runtime, true);
+    ASSERT_TRUE(QDir().mkpath(runtime + "/files/lib/x86_64-linux-gnu"));
+
+    FontCache cache(dir.filePath("cache"), { fonts });
+    const QStringList args{ "/runtime/bin/fc-cache", "--system-only", "--really-force" };
+    auto config =
+      cache.containerConfig(runtime, dir.filePath("box"), dir.filePath("build"), args);
+
+    EXPECT_EQ(config["root"]["path"], dir.filePath("box/root").toStdString());
+    EXPECT_EQ(config["process"]["args"][0], "/runtime/bin/fc-cache");
+    const auto ldLibraryPath = "LD_LIBRARY_PATH=/runtime/lib:/runtime/lib/x86_64-linux-gnu";
+    auto env = config["process"]["env"].get<std::vector<std::string>>();
+    EXPECT_NE(std::find(env.begin(), env.end(), ldLibraryPath), env.end());
+
+    // 只有缓存目录可写
+    QMap<QString, QString> mounts;
+    for (const auto &mount : config["annotations"]["native"]["mounts"]) {
+        const auto options = mount["options"].get<std::vector<std::string>>();
+        const auto source = mount["source"].get<std::string>();
+        mounts.insert(QString::fromStdString(mount["destination"].get<std::string>()),
+                      QString::fromStdString(options.front() + ":" + source));
+    }
+    EXPECT_EQ(mounts.value("/runtime"), "ro:" + runtime + "/files");
+    EXPECT_EQ(mounts.value(fonts), "ro:" + fonts);
+    EXPECT_EQ(mounts.value(FontCache::kContainerDir), "rw:" + dir.filePath("build"));
+
+    // 宿主的程序不使用 runtime 的库
+    config = cache.containerConfig(runtime,
+                                   dir.filePath("box"),
+                                   dir.filePath("build"),
+                                   { "/usr/bin/gtk-update-icon-cache", "--force" });
+    EXPECT_EQ(config["process"]["args"][1], "--force");
+    env = config["process"]["env"].get<std::vector<std::string>>();
+    EXPECT_EQ(std::find(env.begin(), env.end(), ldLibraryPath), env.end());
+}
+
+TEST(RuntimeFontCache, IconThemes)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto layers = dir.filePath("layers");
+    auto runtime = layers + "/org.deepin.Runtime/23.0.0.0/x86_64";
+    makeRuntime(runtime, false);
+    const auto icons = runtime + "/files/share/icons";
+    writeFile(icons + "/hicolor/index.theme", "[Icon Theme]\n");
+    writeFile(icons + "/hicolor/48x48/apps/demo.png", "png");
+    ASSERT_TRUE(QFile::link("48x48", icons + "/hicolor/scalable"));
+    writeFile(icons + "/Cached/index.theme", "[Icon Theme]\n");
+    writeFile(icons + "/Cached/icon-theme.cache", "cache");
+    writeFile(icons + "/default/cursors/left_ptr", "cursor");
+
+    // 有效的缓存不比主题目录旧，没有 index.theme 的不是图标主题
+    EXPECT_EQ(FontCache::iconThemes(runtime), QStringList{ "hicolor" });
+    if (!QFileInfo("/usr/bin/gtk-update-icon-cache").isExecutable()) {
+        EXPECT_FALSE(FontCache::isCacheable(runtime));
+    }
+    writeProgram(runtime + "/files/bin/gtk-update-icon-cache");
+    EXPECT_EQ(FontCache::iconCacheProgram(runtime), "/runtime/bin/gtk-update-icon-cache");
+    EXPECT_TRUE(FontCache::isCacheable(runtime));
+    EXPECT_FALSE(FontCache::hasFontconfig(runtime));
+
+    FakeFontCache cache(dir.filePath("cache"), { dir.filePath("fonts") });
+    cache.update(layers);
+    EXPECT_EQ(cache.programs, QStringList{ "gtk-update-icon-cache" });
+    ASSERT_TRUE(cache.isUpToDate(runtime));
+
+    // 主题目录以硬链接重建，不复制图标
+    const auto tree = cache.cacheDir(runtime) + "/icons/hicolor";
+    EXPECT_EQ(cache.mounts(runtime),
+              (QList<QPair<QString, QString>>{
+                { tree, QString(FontCache::kIconsDir) + "/hicolor" } }));
+    EXPECT_TRUE(QFile::exists(tree + "/icon-theme.cache"));
+    struct stat source
+    {
+    };
+    struct stat linked
+    {
+    };
+    ASSERT_EQ(stat(QFile::encodeName(icons + "/hicolor/48x48/apps/demo.png"), &source), 0);
+    ASSERT_EQ(stat(QFile::encodeName(tree + "/48x48/apps/demo.png"), &linked), 0);
+    EXPECT_EQ(source.st_ino, linked.st_ino);
+    EXPECT_EQ(QFileInfo(tree + "/scalable").symLinkTarget(), tree + "/48x48");
+    EXPECT_FALSE(QFileInfo::exists(cache.cacheDir(runtime) + "/fonts"));
+
+    // 重新安装同一版本后重新生成
+    cache.update(layers);
+    EXPECT_EQ(cache.runs, 1);
+    writeFile(runtime + "/info.json", R"({"appid":"org.deepin.Runtime", "kind":"runtime"})");
+    EXPECT_FALSE(cache.isUpToDate(runtime));
+    EXPECT_TRUE(cache.mounts(runtime).isEmpty());
+    cache.update(layers);
+    EXPECT_EQ(cache.runs, 2);
+}
@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/app.h"
+#include "linglong/runtime/launch_spec_cache.h"
+#include "linglong/util/file.h"
+#include "linglong/util/qserializer/yaml.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+using namespace linglong::runtime;
+
+namespace {
+void writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(data);
+}
+} // namespace
+
+TEST(RuntimeLaunchSpecCache, RoundTrip)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString info = dir.path() + "/info.json";
+    writeFile(info, "{}");
+
+    auto app = std::get<0>(linglong::util::fromYAML<QSharedPointer<App>>(
+      QString("data/demo/app-test.yaml")));
+    ASSERT_NE(app, nullptr);
+
+    LaunchSpecCache cache(dir.path() + "/cache");
+    LaunchSpecCache::Entry entry;
+    entry.dependencies = LaunchSpecCache::dependenciesOf({ info, dir.path() + "/missing" });
+    entry.commits = { { "main/org.deepin.Runtime/23.0.0.0/x86_64/runtime", "0123abcd" } };
+    entry.hostDigest = "host";
+    entry.app = QVariant::fromValue(app).toMap();
+    entry.config = "package:\n  ref: demo\n";
+    entry.oci = QByteArray("\xa0", 1);
+
+    const auto key =
+      linglong::util::cacheKey({ "org.deepin.calculator", "main", "runtime", "0123abcd" });
+    EXPECT_NE(key,
+              linglong::util::cacheKey({ "org.deepin.calculator", "main", "devel", "0123abcd" }));
+    // 原地重新安装后提交不同
+    EXPECT_NE(key,
+              linglong::util::cacheKey({ "org.deepin.calculator", "main", "runtime", "4567ef01" }));
+    cache.store(key, entry);
+
+    LaunchSpecCache::Entry loaded;
+    ASSERT_TRUE(cache.load(key, "host", loaded));
+    EXPECT_EQ(loaded.oci, entry.oci);
+    EXPECT_EQ(loaded.config, entry.config);
+    EXPECT_EQ(loaded.commits, entry.commits);
+    auto loadedApp = QVariant(loaded.app).value<QSharedPointer<App>>();
+    ASSERT_NE(loadedApp, nullptr);
+    EXPECT_EQ(loadedApp->package->ref, app->package->ref);
+    EXPECT_EQ(loadedApp->runtime->ref, app->runtime->ref);
+    ASSERT_NE(loadedApp->permissions, nullptr);
+    EXPECT_EQ(loadedApp->permissions->mounts.size(), app->permissions->mounts.size());
+
+    // 宿主配置变化
+    EXPECT_FALSE(cache.load(key, "other host", loaded));
+
+    // 依赖文件变化，例如升级后重写了 info.json
+    writeFile(info, "{ \"version\": \"2.0\" }");
+    EXPECT_FALSE(cache.load(key, "host", loaded));
+
+    // 原来不存在的依赖出现
+    entry.dependencies = LaunchSpecCache::dependenciesOf({ info, dir.path() + "/missing" });
+    cache.store(key, entry);
+    EXPECT_TRUE(cache.load(key, "host", loaded));
+    ASSERT_TRUE(QDir(dir.path()).mkdir("missing"));
+    EXPECT_FALSE(cache.load(key, "host", loaded));
+
+    cache.remove(key);
+    EXPECT_FALSE(QFile::exists(cache.directory() + "/" + key + ".bin"));
+}
+
+TEST(RuntimeLaunchSpecCache, BrokenEntry)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    LaunchSpecCache cache(dir.path());
+
+    const auto key = linglong::util::cacheKey({ "broken" });
+    writeFile(dir.path() + "/" + key + ".bin", "not a cache entry");
+    LaunchSpecCache::Entry entry;
+    EXPECT_FALSE(cache.load(key, LaunchSpecCache::hostDigest(), entry));
+}
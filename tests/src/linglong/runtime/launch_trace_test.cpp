@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/launch_trace.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QTemporaryDir>
+
+using namespace linglong::runtime;
+
+TEST(RuntimeLaunchTrace, TakeFromEnv)
+{
+    QStringList env{ "DISPLAY=:0", "LINGLONG_TRACE_LAUNCH=/tmp/trace.json" };
+    QString path;
+    EXPECT_TRUE(LaunchTrace::takeFromEnv(env, path));
+    EXPECT_EQ(path, "/tmp/trace.json");
+    EXPECT_EQ(env, QStringList{ "DISPLAY=:0" });
+
+    EXPECT_FALSE(LaunchTrace::takeFromEnv(env, path));
+
+    env.append("LINGLONG_TRACE_LAUNCH=1");
+    path.clear();
+    EXPECT_TRUE(LaunchTrace::takeFromEnv(env, path));
+    EXPECT_TRUE(path.isEmpty());
+}
+
+TEST(RuntimeLaunchTrace, Spans)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString path = dir.path() + "/trace.json";
+
+    {
+        // 未绑定追踪对象时不记录
+        LaunchTrace::Span span("ignored");
+    }
+    EXPECT_EQ(LaunchTrace::current(), nullptr);
+
+    LaunchTrace trace("org.deepin.demo", path);
+    {
+        LaunchTrace::Scope scope(&trace);
+        EXPECT_EQ(LaunchTrace::current(), &trace);
+        LaunchTrace::Span outer("prepare");
+        for (int i = 0; i < 2; ++i) {
+            LaunchTrace::Span inner("stageMount");
+        }
+        outer.end();
+        outer.end();
+    }
+    EXPECT_EQ(LaunchTrace::current(), nullptr);
+    EXPECT_EQ(trace.events().size(), 3);
+
+    trace.finish();
+    EXPECT_TRUE(trace.isFinished());
+    trace.addEvent("late", 0, 1);
+    EXPECT_EQ(trace.events().size(), 4);
+
+    const auto summary = trace.summary();
+    EXPECT_EQ(summary.value("name").toString(), "org.deepin.demo");
+    const auto stages = summary.value("stages").toObject();
+    EXPECT_TRUE(stages.contains("prepare"));
+    EXPECT_TRUE(stages.contains("stageMount"));
+    EXPECT_FALSE(stages.contains("launch"));
+    EXPECT_GE(summary.value("totalMs").toDouble(), stages.value("prepare").toDouble());
+
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    const auto doc = QJsonDocument::fromJson(file.readAll());
+    const auto events = doc.object().value("traceEvents").toArray();
+    // 进程名元数据及 4 个完整事件
+    ASSERT_EQ(events.size(), 5);
+    EXPECT_EQ(events.at(0).toObject().value("ph").toString(), "M");
+    EXPECT_EQ(events.at(1).toObject().value("ph").toString(), "X");
+}
+
+TEST(RuntimeLaunchTrace, WaitForExec)
+{
+    QProcess box;
+    box.start("sh", { "-c", "sleep 2 & wait" });
+    ASSERT_TRUE(box.waitForStarted());
+    EXPECT_TRUE(LaunchTrace::waitForExec(static_cast<pid_t>(box.processId()), 5000));
+    box.kill();
+    box.waitForFinished();
+
+    QProcess exited;
+    exited.start("sh", { "-c", "exit 0" });
+    ASSERT_TRUE(exited.waitForFinished());
+    EXPECT_FALSE(LaunchTrace::waitForExec(static_cast<pid_t>(exited.processId()), 200));
+}
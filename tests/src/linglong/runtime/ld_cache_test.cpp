@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/ld_cache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTemporaryDir>
+
+using namespace linglong::runtime;
+
+TEST(RuntimeLdCache, PrepareAndInvalidate)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    LdCache cache(dir.filePath("cache"));
+    auto libDir = dir.filePath("lib");
+    ASSERT_TRUE(QDir().mkpath(libDir));
+
+    EXPECT_FALSE(cache.isReady("key"));
+    ASSERT_TRUE(cache.prepare("key", { "/opt/apps/demo/files/lib", "/runtime/lib" }, { libDir }));
+
+    QFile config(cache.entryDir("key") + "/" + LdCache::kConfigFileName);
+    ASSERT_TRUE(config.open(QIODevice::ReadOnly));
+    EXPECT_EQ(config.readAll(),
+              "/opt/apps/demo/files/lib\n/runtime/lib\ninclude /etc/ld.so.conf\n");
+
+    // 缓存由容器内的 ldconfig 生成
+    EXPECT_FALSE(cache.isReady("key"));
+    QFile file(cache.cacheFile("key"));
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.close();
+    EXPECT_TRUE(cache.isReady("key"));
+
+    // 库目录增加文件后失效
+    QFile lib(libDir + "/libdemo.so.1");
+    ASSERT_TRUE(lib.open(QIODevice::WriteOnly));
+    lib.close();
+    EXPECT_FALSE(cache.isReady("key"));
+
+    ASSERT_TRUE(cache.prepare("key", { "/runtime/lib" }, { libDir }));
+    EXPECT_FALSE(QFile::exists(cache.cacheFile("key")));
+}
+
+TEST(RuntimeLdCache, GenerateCommand)
+{
+    auto command = LdCache::generateCommand();
+    ASSERT_EQ(command.size(), 3);
+    EXPECT_EQ(command.at(0), "/bin/sh");
+    EXPECT_TRUE(command.at(2).contains(QString(LdCache::kContainerDir) + "/"
+                                       + LdCache::kConfigFileName));
+}
+
+// 对比使用完整的 LD_LIBRARY_PATH 与使用生成的 ld.so.cache 时动态链接器的查找次数及启动耗时，
+// 需要 ldconfig 及非特权的 user 命名空间，用于将生成的缓存挂载为 /etc/ld.so.cache
+TEST(RuntimeLdCache, LibraryPathVersusCache)
+{
+    if (!qEnvironmentVariableIsSet("LINGLONG_TEST_ALL")) {
+        return;
+    }
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QStringList appLibraryPaths{ dir.filePath("app/lib"),
+                                       dir.filePath("app/lib/x86_64-linux-gnu") };
+    const QStringList cachedLibraryPaths{
+        dir.filePath("runtime/lib"),
+        dir.filePath("runtime/lib/x86_64-linux-gnu"),
+        dir.filePath("runtime/lib/i386-linux-gnu"),
+        "/usr/lib",
+        "/usr/lib/x86_64-linux-gnu",
+    };
+    for (const auto &path : appLibraryPaths + cachedLibraryPaths) {
+        ASSERT_TRUE(QDir().mkpath(path));
+    }
+
+    // 与容器内执行的命令相同，只是缓存目录不在 kContainerDir
+    LdCache cache(dir.filePath("cache"));
+    ASSERT_TRUE(cache.prepare("key", cachedLibraryPaths, {}));
+    auto command = LdCache::generateCommand(cache.entryDir("key"));
+    ASSERT_EQ(QProcess::execute(command.takeFirst(), command), 0);
+    ASSERT_TRUE(QFile::exists(cache.cacheFile("key")));
+
+    const QString program = "/bin/ls";
+    constexpr int rounds = 20;
+    struct Output
+    {
+        int exitCode = -1;
+        QByteArray out;
+        QByteArray err;
+    };
+    struct Result
+    {
+        int probes = 0;
+        QStringList libraries;
+        qint64 nsec = 0;
+    };
+
+    // 环境变量只设置给被测程序，不影响 unshare 及 sh
+    auto run = [&](bool withCache, const QStringList &env) {
+        const QString script = withCache ? R"(mount --bind "$0" /etc/ld.so.cache && exec "$@")"
+                                         : R"(exec "$@")";
+        QProcess process;
+        process.start("unshare",
+                      QStringList{ "-rm", "sh", "-c", script, cache.cacheFile("key"), "env" }
+                        + env + QStringList{ program, "/" });
+        process.waitForFinished();
+        return Output{ process.exitCode(),
+                       process.readAllStandardOutput(),
+                       process.readAllStandardError() };
+    };
+    auto measure = [&](bool withCache) {
+        const QStringList env{
+            "LD_LIBRARY_PATH="
+            + (withCache ? appLibraryPaths : appLibraryPaths + cachedLibraryPaths).join(":")
+        };
+
+        Result result;
+        result.probes =
+          run(withCache, env + QStringList{ "LD_DEBUG=libs" }).err.count("trying file=");
+
+        // /lib 可能是 /usr/lib 的链接，比较实际的文件
+        const auto trace = run(withCache, env + QStringList{ "LD_TRACE_LOADED_OBJECTS=1" }).out;
+        for (const auto &line : QString::fromUtf8(trace).split('\n')) {
+            const auto library = line.section(" => ", 1).section(" (", 0, 0).trimmed();
+            if (!library.isEmpty()) {
+                result.libraries.append(QFileInfo(library).canonicalFilePath());
+            }
+        }
+
+        for (int i = 0; i < rounds; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            run(withCache, env);
+            result.nsec += timer.nsecsElapsed();
+        }
+        result.nsec /= rounds;
+        return result;
+    };
+
+    const auto probe = run(true, {});
+    if (probe.exitCode != 0) {
+        qInfo() << "unshare unavailable, skip:" << probe.err;
+        return;
+    }
+
+    const auto path = measure(false);
+    const auto cached = measure(true);
+    qInfo().noquote() << QString("LD_LIBRARY_PATH: %1 probes, %2us; ld.so.cache: %3 probes, %4us")
+                           .arg(path.probes)
+                           .arg(path.nsec / 1000)
+                           .arg(cached.probes)
+                           .arg(cached.nsec / 1000);
+    // 解析到的库相同，查找次数减少
+    EXPECT_FALSE(path.libraries.isEmpty());
+    EXPECT_EQ(path.libraries, cached.libraries);
+    EXPECT_GT(path.probes, cached.probes);
+}
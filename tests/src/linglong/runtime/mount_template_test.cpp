@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/mount_template.h"
+
+#include <QFile>
+#include <QMap>
+#include <QTemporaryDir>
+
+using namespace linglong::runtime;
+
+TEST(RuntimeMountTemplate, Build)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    auto runtimeRoot = dir.filePath("layers/org.deepin.Runtime/23.0.0.0/x86_64/files");
+    auto mountTemplate =
+      MountTemplate::build(runtimeRoot, dir.filePath("layers/org.deepin.Runtime"), dir.path());
+    ASSERT_EQ(mountTemplate->baseMounts().size(), 4);
+    EXPECT_EQ(mountTemplate->baseMounts().at(2), qMakePair(runtimeRoot, QString("/runtime")));
+    EXPECT_TRUE(mountTemplate->wineMounts().isEmpty());
+    EXPECT_TRUE(mountTemplate->basicsMounts().isEmpty());
+    EXPECT_FALSE(mountTemplate->isWine());
+
+    auto wineRoot = dir.filePath("layers/org.deepin.Wine/7.0.0.0/x86_64/files");
+    auto wineTemplate =
+      MountTemplate::build(wineRoot, dir.filePath("layers/org.deepin.Wine"), dir.path());
+    EXPECT_TRUE(wineTemplate->isWine());
+    EXPECT_TRUE(wineTemplate->requiresOverlay());
+    EXPECT_EQ(wineTemplate->baseMounts().size(), mountTemplate->baseMounts().size());
+    ASSERT_FALSE(wineTemplate->wineMounts().isEmpty());
+    EXPECT_EQ(wineTemplate->wineMounts().first(),
+              qMakePair(wineRoot + "/bin", QString("/usr/bin")));
+}
+
+TEST(RuntimeMountTemplate, Cache)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    MountTemplate::clearCache();
+
+    auto runtimeRoot = dir.filePath("files");
+    auto first = MountTemplate::forRuntime(runtimeRoot, dir.path(), dir.path());
+    auto second = MountTemplate::forRuntime(runtimeRoot, dir.path(), dir.path());
+    EXPECT_EQ(first.data(), second.data());
+
+    // runtime 的 info.json 变化后重新生成
+    QFile info(dir.filePath("info.json"));
+    ASSERT_TRUE(info.open(QIODevice::WriteOnly));
+    info.write("{}");
+    info.close();
+    auto third = MountTemplate::forRuntime(runtimeRoot, dir.path(), dir.path());
+    EXPECT_NE(first.data(), third.data());
+
+    auto other = MountTemplate::forRuntime(dir.filePath("other"), dir.path(), dir.path());
+    EXPECT_NE(other->baseMounts(), third->baseMounts());
+}
+
+TEST(RuntimeMountTemplate, MergedLayers)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    auto wineRoot = dir.filePath("layers/org.deepin.Wine/7.0.0.0/x86_64/files");
+    auto wineTemplate =
+      MountTemplate::build(wineRoot, dir.filePath("layers/org.deepin.Wine"), dir.path());
+    const auto layers = wineTemplate->mergedLayers();
+    ASSERT_FALSE(layers.isEmpty());
+
+    // 父目录在前，后面的挂载覆盖前面的
+    EXPECT_EQ(layers.first(), qMakePair(QString("/usr"), QStringList{ "/usr" }));
+    QMap<QString, QStringList> lowers;
+    for (const auto &layer : layers) {
+        lowers.insert(layer.first, layer.second);
+    }
+    EXPECT_EQ(lowers.value("/usr/bin"), (QStringList{ wineRoot + "/bin", "/usr/bin" }));
+    EXPECT_EQ(lowers.value("/usr/share/locale"),
+              (QStringList{ wineRoot + "/share/locale", "/usr/share/locale" }));
+    EXPECT_EQ(lowers.value("/runtime"), QStringList{ wineRoot });
+    EXPECT_GT(layers.indexOf(qMakePair(QString("/usr/share/locale"),
+                                       lowers.value("/usr/share/locale"))),
+              layers.indexOf(qMakePair(QString("/usr/share"), lowers.value("/usr/share"))));
+}
+
+TEST(RuntimeMountTemplate, SharedTree)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    // runtime 的目录都不存在时只剩宿主目录，直接绑定，无需 fuse-overlayfs
+    auto wineRoot = dir.filePath("layers/org.deepin.Wine/7.0.0.0/x86_64/files");
+    auto wineTemplate =
+      MountTemplate::build(wineRoot, dir.filePath("layers/org.deepin.Wine"), dir.path());
+    const auto mounts = wineTemplate->prepareSharedTree(dir.filePath("trees"));
+    EXPECT_TRUE(mounts.contains(qMakePair(QString("/usr"), QString("/usr"))));
+    EXPECT_TRUE(mounts.contains(qMakePair(QString("/usr/bin"), QString("/usr/bin"))));
+    for (const auto &mount : mounts) {
+        EXPECT_NE(mount.second, "/runtime");
+        EXPECT_FALSE(mount.first.startsWith(dir.filePath("trees")));
+    }
+}
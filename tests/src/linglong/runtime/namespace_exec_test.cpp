@@ -0,0 +1,130 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/namespace_exec.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <csignal>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace linglong::runtime;
+
+namespace {
+// 模拟 ll-box 及容器 init
+pid_t forkBox()
+{
+    pid_t box = fork();
+    if (box == 0) {
+        if (fork() == 0) {
+            pause();
+        }
+        pause();
+        _exit(0);
+    }
+    return box;
+}
+
+pid_t waitInit(pid_t box)
+{
+    pid_t init = -1;
+    for (int i = 0; i < 100 && init < 0; ++i) {
+        init = NamespaceExec::findInit(box);
+        QThread::msleep(10);
+    }
+    return init;
+}
+
+void killBox(pid_t box, pid_t init)
+{
+    if (init > 0) {
+        kill(init, SIGKILL);
+    }
+    kill(box, SIGKILL);
+    waitpid(box, nullptr, 0);
+}
+
+QByteArray waitOutput(const QString &path)
+{
+    QFile file(path);
+    for (int i = 0; i < 100 && file.size() == 0; ++i) {
+        QThread::msleep(10);
+    }
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+} // namespace
+
+// 目标进程与当前进程处于相同的命名空间时，相当于普通的进程启动
+TEST(RuntimeNamespaceExec, SpawnInSameNamespaces)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    pid_t box = forkBox();
+    ASSERT_GE(box, 0);
+    pid_t init = waitInit(box);
+    ASSERT_GT(init, 0);
+
+    NamespaceExec namespaceExec(init);
+    ASSERT_TRUE(namespaceExec.isValid());
+
+    EXPECT_TRUE(namespaceExec.spawn({ "sh", "-c", "echo $FOO > output" },
+                                    { "FOO=bar", "PATH=/usr/bin:/bin" },
+                                    dir.path().toStdString()));
+    EXPECT_FALSE(namespaceExec.spawn({ "linglong-nonexistent-command" }, { "PATH=/usr/bin" }, "/"));
+    EXPECT_EQ(waitOutput(dir.filePath("output")), "bar\n");
+
+    killBox(box, init);
+}
+
+// 与 ll-box 启动的进程一样应用容器配置中的限制
+TEST(RuntimeNamespaceExec, Restrictions)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    pid_t box = forkBox();
+    ASSERT_GE(box, 0);
+    pid_t init = waitInit(box);
+    ASSERT_GT(init, 0);
+
+    NamespaceExec namespaceExec(init, nlohmann::json::parse(R"({
+        "process": {
+            "rlimits": [ { "type": "RLIMIT_NOFILE", "soft": 64, "hard": 64 } ],
+            "noNewPrivileges": true,
+            "user": null
+        }
+    })"));
+    ASSERT_TRUE(namespaceExec.isValid());
+    EXPECT_TRUE(namespaceExec.spawn(
+      { "sh", "-c", "echo $(ulimit -n) $(grep NoNewPrivs /proc/self/status | cut -f2) > output" },
+      { "PATH=/usr/bin:/bin" },
+      dir.path().toStdString()));
+    EXPECT_EQ(waitOutput(dir.filePath("output")), "64 1\n");
+
+    // 无法在此应用的限制交由 ll-box 处理
+    EXPECT_FALSE(NamespaceExec(init, nlohmann::json::parse(R"({
+        "linux": { "seccomp": { "defaultAction": "SCMP_ACT_ALLOW" } }
+    })")).isValid());
+    EXPECT_FALSE(NamespaceExec(init, nlohmann::json::parse(R"({
+        "process": { "capabilities": { "bounding": [ "CAP_NONEXISTENT" ] } }
+    })")).isValid());
+
+    killBox(box, init);
+}
+
+TEST(RuntimeNamespaceExec, Invalid)
+{
+    NamespaceExec namespaceExec(-1);
+    EXPECT_FALSE(namespaceExec.isValid());
+    EXPECT_FALSE(namespaceExec.spawn({ "true" }, {}, "/"));
+}
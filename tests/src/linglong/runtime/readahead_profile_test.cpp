@@ -0,0 +1,141 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/runtime/readahead_profile.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+using namespace linglong::runtime;
+
+TEST(RuntimeReadaheadProfile, RecordSaveReplay)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto layer = dir.filePath("layer");
+    ASSERT_TRUE(QDir().mkpath(layer + "/files/lib"));
+
+    // 刚写入的文件位于页缓存中
+    QFile lib(layer + "/files/lib/libdemo.so");
+    ASSERT_TRUE(lib.open(QIODevice::WriteOnly));
+    lib.write(QByteArray(64 * 1024, 'x'));
+    lib.close();
+    QFile empty(layer + "/files/empty");
+    ASSERT_TRUE(empty.open(QIODevice::WriteOnly));
+    empty.close();
+
+    auto files = ReadaheadProfile::record({ layer });
+    ASSERT_EQ(files.size(), 1);
+    EXPECT_EQ(files.first().path, lib.fileName());
+    ASSERT_FALSE(files.first().ranges.isEmpty());
+    EXPECT_EQ(files.first().ranges.first().first, 0u);
+
+    ReadaheadProfile profile(dir.filePath("profiles"));
+    auto key = ReadaheadProfile::keyOf({ layer });
+    EXPECT_EQ(key, ReadaheadProfile::keyOf({ layer + "/" }));
+    EXPECT_FALSE(profile.exists(key));
+    ASSERT_TRUE(profile.save(key, { layer }, files));
+    EXPECT_TRUE(profile.exists(key));
+
+    QList<ReadaheadProfile::File> loaded;
+    ASSERT_TRUE(profile.load(key, loaded));
+    ASSERT_EQ(loaded.size(), files.size());
+    EXPECT_EQ(loaded.first().path, files.first().path);
+    EXPECT_EQ(loaded.first().ranges, files.first().ranges);
+
+    EXPECT_GT(ReadaheadProfile::replay(loaded), 0u);
+
+    // 文件被删除后跳过
+    QFile::remove(lib.fileName());
+    EXPECT_EQ(ReadaheadProfile::replay(loaded), 0u);
+}
+
+TEST(RuntimeReadaheadProfile, KeyChangesWithInfo)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto key = ReadaheadProfile::keyOf({ dir.path() });
+
+    QFile info(dir.filePath("info.json"));
+    ASSERT_TRUE(info.open(QIODevice::WriteOnly));
+    info.write("{}");
+    info.close();
+    EXPECT_NE(ReadaheadProfile::keyOf({ dir.path() }), key);
+}
+
+TEST(RuntimeReadaheadProfile, SubtractBaseline)
+{
+    const quint64 page = 4096;
+    const QList<ReadaheadProfile::File> baseline = {
+        { "/layers/runtime/files/lib/libc.so", { { 0, 4 * page } } },
+        { "/layers/app/files/bin/demo", { { page, page }, { 3 * page, 2 * page } } },
+    };
+    const QList<ReadaheadProfile::File> files = {
+        { "/layers/runtime/files/lib/libc.so", { { 0, 4 * page } } },
+        { "/layers/app/files/bin/demo", { { 0, 6 * page } } },
+        { "/layers/app/files/lib/libdemo.so", { { 0, page } } },
+    };
+
+    // 启动前已在页缓存中的区间不记录
+    auto delta = ReadaheadProfile::subtract(files, baseline);
+    ASSERT_EQ(delta.size(), 2);
+    EXPECT_EQ(delta[0].path, "/layers/app/files/bin/demo");
+    const QList<QPair<quint64, quint64>> expected = {
+        { 0, page },
+        { 2 * page, page },
+        { 5 * page, page },
+    };
+    EXPECT_EQ(delta[0].ranges, expected);
+    EXPECT_EQ(delta[1].path, "/layers/app/files/lib/libdemo.so");
+
+    EXPECT_EQ(ReadaheadProfile::sizeOf(files), 11 * page);
+    EXPECT_EQ(ReadaheadProfile::sizeOf(files, "/layers/app"), 7 * page);
+    EXPECT_EQ(ReadaheadProfile::sizeOf(files, "/layers/app/"), 7 * page);
+
+    // runtime 已被其它应用读入不影响判断，应用自身已大部分读入时视为热启动
+    EXPECT_FALSE(ReadaheadProfile::isWarm({ baseline[0] }, files, "/layers/app"));
+    EXPECT_TRUE(ReadaheadProfile::isWarm(baseline, files, "/layers/app"));
+    EXPECT_FALSE(ReadaheadProfile::isWarm({}, {}, "/layers/app"));
+}
+
+TEST(RuntimeReadaheadProfile, Prune)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto writeInfo = [](const QString &layer, const QByteArray &data) {
+        QDir().mkpath(layer);
+        QFile info(layer + "/info.json");
+        ASSERT_TRUE(info.open(QIODevice::WriteOnly));
+        info.write(data);
+    };
+    auto app = dir.filePath("layers/org.deepin.demo/1.0.0/x86_64");
+    auto other = dir.filePath("layers/org.deepin.other/1.0.0/x86_64");
+    auto runtime = dir.filePath("layers/org.deepin.Runtime/23.0.0/x86_64");
+    writeInfo(app, "{}");
+    writeInfo(other, "{}");
+    writeInfo(runtime, "{}");
+
+    ReadaheadProfile profile(dir.filePath("profiles"));
+    auto appKey = ReadaheadProfile::keyOf({ app, runtime });
+    auto otherKey = ReadaheadProfile::keyOf({ other, runtime });
+    ASSERT_TRUE(profile.save(appKey, { app, runtime }, {}));
+    ASSERT_TRUE(profile.save(otherKey, { other, runtime }, {}));
+    EXPECT_EQ(profile.prune(), 0);
+
+    // 卸载后删除
+    QDir(dir.filePath("layers/org.deepin.other")).removeRecursively();
+    EXPECT_EQ(profile.prune(), 1);
+    EXPECT_FALSE(profile.exists(otherKey));
+    EXPECT_TRUE(profile.exists(appKey));
+
+    // 同一版本重新安装后删除
+    writeInfo(app, R"({"version":"1.0.0"})");
+    EXPECT_EQ(profile.prune(), 1);
+    EXPECT_FALSE(profile.exists(appKey));
+}
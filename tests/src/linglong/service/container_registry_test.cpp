@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/service/container_registry.h"
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+using namespace linglong::service;
+
+namespace {
+ContainerRegistry::AppPtr makeApp(const QString &id, const QString &ref)
+{
+    ContainerRegistry::AppPtr app(new linglong::runtime::App);
+    app->container.reset(new Container);
+    app->container->id = id;
+    app->container->packageName = ref;
+    return app;
+}
+} // namespace
+
+TEST(ServiceContainerRegistry, Index)
+{
+    ContainerRegistry registry;
+    auto app = makeApp("c1", "main:org.deepin.demo/1.0.0.0/x86_64");
+    EXPECT_TRUE(registry.insert(app));
+    // 启动完成前只占用 ref，不能被查询到
+    EXPECT_FALSE(registry.find("c1"));
+    EXPECT_FALSE(registry.findByRef("main:org.deepin.demo/1.0.0.0/x86_64"));
+    EXPECT_TRUE(registry.snapshot().isEmpty());
+    EXPECT_TRUE(registry.markLaunched("c1"));
+    EXPECT_FALSE(registry.markLaunched("c2"));
+    EXPECT_EQ(registry.find("c1"), app);
+    EXPECT_EQ(registry.findByRef("main:org.deepin.demo/1.0.0.0/x86_64"), app);
+    EXPECT_FALSE(registry.findByRef("main:org.deepin.other/1.0.0.0/x86_64"));
+
+    // 同一 ref 只登记一个容器
+    EXPECT_FALSE(registry.insert(makeApp("c2", "main:org.deepin.demo/1.0.0.0/x86_64")));
+    EXPECT_EQ(registry.size(), 1);
+
+    EXPECT_EQ(registry.remove("c1"), app);
+    EXPECT_FALSE(registry.remove("c1"));
+    EXPECT_FALSE(registry.findByRef("main:org.deepin.demo/1.0.0.0/x86_64"));
+    EXPECT_TRUE(registry.snapshot().isEmpty());
+}
+
+TEST(ServiceContainerRegistry, WaitByRef)
+{
+    ContainerRegistry registry;
+    const QString ref = "main:org.deepin.demo/1.0.0.0/x86_64";
+    EXPECT_FALSE(registry.waitByRef(ref, 1000));
+
+    auto app = makeApp("c1", ref);
+    ASSERT_TRUE(registry.insert(app));
+    EXPECT_FALSE(registry.waitByRef(ref, 10));
+
+    // 并发启动的请求等待先到的请求启动完成
+    auto waiter = QtConcurrent::run([&]() {
+        return registry.waitByRef(ref, 10 * 1000);
+    });
+    QThread::msleep(50);
+    registry.markLaunched("c1");
+    EXPECT_EQ(waiter.result(), app);
+
+    // 启动失败时等待的请求立即返回
+    registry.remove("c1");
+    ASSERT_TRUE(registry.insert(makeApp("c2", ref)));
+    waiter = QtConcurrent::run([&]() {
+        return registry.waitByRef(ref, 10 * 1000);
+    });
+    QThread::msleep(50);
+    registry.remove("c2");
+    EXPECT_FALSE(waiter.result());
+}
+
+TEST(ServiceContainerRegistry, Concurrent)
+{
+    ContainerRegistry registry;
+    constexpr int count = 1000;
+
+    auto writer = QtConcurrent::run([&]() {
+        for (int i = 0; i < count; ++i) {
+            auto id = QString::number(i);
+            EXPECT_TRUE(registry.insert(makeApp(id, "ref" + id)));
+            EXPECT_TRUE(registry.markLaunched(id));
+            if (i % 2) {
+                EXPECT_TRUE(registry.remove(id));
+            }
+        }
+    });
+    auto reader = QtConcurrent::run([&]() {
+        while (!writer.isFinished()) {
+            for (const auto &app : registry.snapshot()) {
+                EXPECT_FALSE(app->container->id.isEmpty());
+            }
+            registry.findByRef("ref0");
+        }
+    });
+    writer.waitForFinished();
+    reader.waitForFinished();
+
+    EXPECT_EQ(registry.size(), count / 2);
+    EXPECT_TRUE(registry.findByRef("ref0"));
+    EXPECT_FALSE(registry.findByRef("ref1"));
+}
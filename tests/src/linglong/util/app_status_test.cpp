@@ -0,0 +1,190 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/util/app_status.h"
+#include "linglong/util/connection.h"
+#include "linglong/util/status_code.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace linglong::util;
+
+namespace {
+void exec(Connection &connection, const QString &sql)
+{
+    auto query = connection.execute(sql);
+    ASSERT_EQ(query.lastError().type(), QSqlError::NoError) << sql.toStdString();
+}
+} // namespace
+
+TEST(UtilAppStatus, MigrateVersionKey)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    Connection connection(dir.filePath("linglong.db"));
+
+    // 1.0.0 版本的表结构，没有 versionKey 列
+    exec(connection,
+         "CREATE TABLE installedAppInfo(ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "appId VARCHAR(32) NOT NULL, name VARCHAR(32), version VARCHAR(32) NOT NULL,"
+         "arch VARCHAR, kind CHAR(8) DEFAULT 'app', runtime CHAR(32), uabUrl VARCHAR,"
+         "repoName CHAR(16), description NVARCHAR, user VARCHAR,"
+         "installType CHAR(16) DEFAULT 'user', size INTEGER, channel VARCHAR(32),"
+         "module VARCHAR(32), unique(appId,version,arch,channel,module))");
+    exec(connection,
+         "CREATE TABLE appInfoDbVersion(version VARCHAR(32) PRIMARY KEY,description NVARCHAR)");
+    exec(connection, "INSERT INTO appInfoDbVersion VALUES('1.0.0', 'create appinfodb version')");
+    for (const auto &version : { "5.9.1", "5.10.1", "5.2.0" }) {
+        exec(connection,
+             QString("INSERT INTO installedAppInfo(appId, version, arch, channel, module) "
+                     "VALUES('org.deepin.demo', '%1', 'x86_64', 'main', 'runtime')")
+               .arg(version));
+    }
+
+    ASSERT_EQ(updateInstalledAppInfoDb(connection), STATUS_CODE(kSuccess));
+
+    // 回填后按数值排序，5.10.1 为最高版本
+    auto query = connection.execute(
+      "SELECT version FROM installedAppInfo WHERE appId = :appId ORDER BY versionKey DESC",
+      { { ":appId", "org.deepin.demo" } });
+    QStringList versions;
+    while (query.next()) {
+        versions << query.value(0).toString();
+    }
+    query.finish();
+    EXPECT_EQ(versions, QStringList({ "5.10.1", "5.9.1", "5.2.0" }));
+
+    query = connection.execute(
+      "SELECT 1 FROM sqlite_master WHERE type = 'index' AND name = 'installedAppInfo_ref_index'");
+    EXPECT_TRUE(query.next());
+    query.finish();
+
+    query = connection.execute("SELECT version FROM appInfoDbVersion ORDER BY version DESC");
+    ASSERT_TRUE(query.next());
+    EXPECT_EQ(query.value(0).toString(), "1.1.0");
+    query.finish();
+
+    // 已是最新版本时不再迁移
+    EXPECT_EQ(updateInstalledAppInfoDb(connection), STATUS_CODE(kSuccess));
+}
+
+TEST(UtilAppStatus, MigrateRollsBackOnError)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    Connection connection(dir.filePath("linglong.db"));
+
+    // 缺少 installedAppInfo 表时迁移失败，版本号不应被更新
+    exec(connection,
+         "CREATE TABLE appInfoDbVersion(version VARCHAR(32) PRIMARY KEY,description NVARCHAR)");
+    exec(connection, "INSERT INTO appInfoDbVersion VALUES('1.0.0', 'create appinfodb version')");
+
+    EXPECT_NE(updateInstalledAppInfoDb(connection), STATUS_CODE(kSuccess));
+
+    auto query = connection.execute("SELECT count(*) FROM appInfoDbVersion");
+    ASSERT_TRUE(query.next());
+    EXPECT_EQ(query.value(0).toInt(), 1);
+    query.finish();
+
+    // 事务已回滚，可以重新开始新的事务
+    exec(connection, "BEGIN IMMEDIATE");
+    exec(connection, "ROLLBACK");
+}
+
+TEST(UtilAppStatus, NestedStatementsDoNotShareResults)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    Connection connection(dir.filePath("linglong.db"));
+    exec(connection, "CREATE TABLE t(v INTEGER)");
+    for (int i = 0; i < 3; ++i) {
+        exec(connection, QString("INSERT INTO t VALUES(%1)").arg(i));
+    }
+
+    const QString sql = "SELECT v FROM t WHERE v >= :v ORDER BY v";
+    auto outer = connection.execute(sql, { { ":v", 0 } });
+    ASSERT_TRUE(outer.next());
+    EXPECT_EQ(outer.value(0).toInt(), 0);
+
+    // 同一语句的嵌套调用不影响外层结果集
+    {
+        Connection inner(dir.filePath("linglong.db"));
+        auto nested = inner.execute(sql, { { ":v", 2 } });
+        ASSERT_TRUE(nested.next());
+        EXPECT_EQ(nested.value(0).toInt(), 2);
+    }
+
+    ASSERT_TRUE(outer.next());
+    EXPECT_EQ(outer.value(0).toInt(), 1);
+    ASSERT_TRUE(outer.next());
+    EXPECT_EQ(outer.value(0).toInt(), 2);
+    EXPECT_FALSE(outer.next());
+}
+
+TEST(UtilAppStatus, ReadOnlyUser)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const auto path = dir.filePath("linglong.db");
+
+    // 以前的版本留下的 WAL 模式数据库
+    {
+        auto db = QSqlDatabase::addDatabase("QSQLITE", "legacy_wal");
+        db.setDatabaseName(path);
+        ASSERT_TRUE(db.open());
+        QSqlQuery query(db);
+        ASSERT_TRUE(query.exec("PRAGMA journal_mode=WAL"));
+        ASSERT_TRUE(query.exec("CREATE TABLE t(v INTEGER)"));
+        ASSERT_TRUE(query.exec("INSERT INTO t VALUES(1)"));
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("legacy_wal");
+
+    // 数据库的所有者打开后改回回滚日志模式
+    Connection owner(path);
+    auto query = owner.execute("PRAGMA journal_mode");
+    ASSERT_TRUE(query.next());
+    EXPECT_EQ(query.value(0).toString(), "delete");
+    query.finish();
+    EXPECT_FALSE(QFile::exists(path + "-wal"));
+    EXPECT_FALSE(QFile::exists(path + "-shm"));
+
+    // 其它用户对数据库及其目录只有读权限；非 root 运行时去掉目录的写权限模拟
+    const bool isRoot = geteuid() == 0;
+    const auto dirName = QFile::encodeName(dir.path());
+    ASSERT_EQ(chmod(dirName.constData(), isRoot ? 0755 : 0555), 0);
+    ASSERT_EQ(chmod(QFile::encodeName(path).constData(), 0644), 0);
+
+    // 本线程已有该路径的连接，子进程经符号链接打开新的连接
+    const auto link = dir.path() + ".link";
+    ASSERT_TRUE(QFile::link(dir.path(), link));
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        // nobody
+        if (isRoot && (setgid(65534) != 0 || setuid(65534) != 0)) {
+            _exit(2);
+        }
+        Connection reader(link + "/linglong.db");
+        auto result = reader.execute("SELECT v FROM t");
+        _exit(result.next() && result.value(0).toInt() == 1 ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    QFile::remove(link);
+    chmod(dirName.constData(), 0700);
+
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
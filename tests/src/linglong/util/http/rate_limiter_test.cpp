@@ -0,0 +1,55 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/util/http/rate_limiter.h"
+
+using namespace linglong::util;
+
+TEST(UtilRateLimiter, Unlimited)
+{
+    RateLimiter limiter;
+    RateLimitTicket ticket(1, 0, &limiter);
+    EXPECT_EQ(ticket.reserve(64 * 1024 * 1024), 0);
+    EXPECT_EQ(limiter.statistics()["transferred"].toULongLong(), 64 * 1024 * 1024);
+}
+
+TEST(UtilRateLimiter, WeightedShare)
+{
+    RateLimiter limiter;
+    limiter.setRate(1000 * 1000);
+
+    auto interactive = limiter.registerConsumer(8);
+    auto prefetch = limiter.registerConsumer(2);
+
+    // 新注册的下载者没有积攒的令牌，等待时间为数据量除以分到的速率
+    auto interactiveDelay = limiter.reserve(interactive, 500 * 1000);
+    auto prefetchDelay = limiter.reserve(prefetch, 500 * 1000);
+    EXPECT_LT(interactiveDelay, prefetchDelay);
+    EXPECT_NEAR(interactiveDelay, 625 * 1000, 50 * 1000);
+    EXPECT_NEAR(prefetchDelay, 2500 * 1000, 50 * 1000);
+
+    // 高权重的下载者结束后，剩余的下载者独占总速率，之前欠下的令牌按新速率偿还
+    limiter.unregisterConsumer(interactive);
+    EXPECT_EQ(limiter.statistics()["totalWeight"].toInt(), 2);
+    auto soloDelay = limiter.reserve(prefetch, 1000 * 1000);
+    EXPECT_NEAR(soloDelay, 1500 * 1000, 100 * 1000);
+
+    limiter.unregisterConsumer(prefetch);
+}
+
+TEST(UtilRateLimiter, ConsumerCap)
+{
+    RateLimiter limiter;
+    RateLimitTicket capped(1, 100 * 1000, &limiter);
+    EXPECT_NEAR(capped.reserve(200 * 1000), 2000 * 1000, 50 * 1000);
+
+    // 按权重分到的速率低于下载者自身上限时以分到的速率为准
+    limiter.setRate(50 * 1000);
+    RateLimitTicket other(1, 100 * 1000, &limiter);
+    EXPECT_NEAR(other.reserve(50 * 1000), 2000 * 1000, 50 * 1000);
+}
@@ -0,0 +1,184 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/util/connection.h"
+#include "linglong/util/installed_app_registry.h"
+
+#include <QTemporaryDir>
+#include <QtConcurrent/QtConcurrent>
+
+#include <atomic>
+
+using namespace linglong::util;
+
+namespace {
+void exec(Connection &connection, const QString &sql)
+{
+    auto query = connection.execute(sql);
+    ASSERT_EQ(query.lastError().type(), QSqlError::NoError) << sql.toStdString();
+}
+
+void createTable(Connection &connection)
+{
+    exec(connection,
+         "CREATE TABLE installedAppInfo(ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "appId VARCHAR(32) NOT NULL, name VARCHAR(32), version VARCHAR(32) NOT NULL,"
+         "arch VARCHAR, kind CHAR(8) DEFAULT 'app', runtime CHAR(32), uabUrl VARCHAR,"
+         "repoName CHAR(16), description NVARCHAR, user VARCHAR,"
+         "installType CHAR(16) DEFAULT 'user', size INTEGER, channel VARCHAR(32),"
+         "module VARCHAR(32), versionKey INTEGER DEFAULT 0,"
+         "unique(appId,version,arch,channel,module))");
+}
+
+void insertRow(Connection &connection, const QString &appId, const QString &version)
+{
+    exec(connection,
+         QString("INSERT INTO installedAppInfo(appId, version, arch, channel, module, user) "
+                 "VALUES('%1', '%2', 'x86_64', 'main', 'runtime', 'deepin')")
+           .arg(appId, version));
+}
+
+QSharedPointer<linglong::package::AppMetaInfo> package(const QString &appId,
+                                                       const QString &version)
+{
+    auto info = QSharedPointer<linglong::package::AppMetaInfo>(new linglong::package::AppMetaInfo);
+    info->appId = appId;
+    info->version = version;
+    info->arch = "x86_64";
+    info->channel = "main";
+    info->module = "runtime";
+    return info;
+}
+} // namespace
+
+TEST(UtilInstalledAppRegistry, ServesFromMemoryUntilInvalidated)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const auto dbPath = dir.filePath("linglong.db");
+    Connection connection(dbPath);
+    createTable(connection);
+    insertRow(connection, "org.deepin.demo", "5.9.1");
+    insertRow(connection, "org.deepin.demo", "5.10.1");
+
+    InstalledAppRegistry registry(dbPath);
+    ASSERT_TRUE(registry.ensureLoaded());
+    EXPECT_TRUE(registry.contains("org.deepin.demo", "5.9.1", "x86_64", "main", "runtime", ""));
+
+    // 按版本号数值升序排列
+    auto result = registry.find("org.deepin.demo", "", "", "", "", "deepin");
+    ASSERT_EQ(result.size(), 2);
+    EXPECT_EQ(result.first()->version, "5.9.1");
+    EXPECT_EQ(result.last()->version, "5.10.1");
+
+    // 返回的是副本，修改不影响索引
+    result.first()->version = "0.0.0";
+    EXPECT_EQ(registry.find("org.deepin.demo", "", "", "", "", "").first()->version, "5.9.1");
+
+    // 其它进程直接修改数据库后，失效前仍从内存返回旧结果
+    exec(connection, "DELETE FROM installedAppInfo WHERE version = '5.9.1'");
+    EXPECT_TRUE(registry.contains("org.deepin.demo", "5.9.1", "", "", "", ""));
+
+    registry.invalidate();
+    EXPECT_FALSE(registry.contains("org.deepin.demo", "5.9.1", "", "", "", ""));
+    EXPECT_TRUE(registry.contains("org.deepin.demo", "5.10.1", "", "", "", ""));
+}
+
+TEST(UtilInstalledAppRegistry, UpdatesOnlyAfterPersist)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const auto dbPath = dir.filePath("linglong.db");
+    Connection connection(dbPath);
+    createTable(connection);
+
+    InstalledAppRegistry registry(dbPath);
+    ASSERT_TRUE(registry.ensureLoaded());
+    int changed = 0;
+    QObject::connect(&registry, &InstalledAppRegistry::changed, [&changed]() {
+        ++changed;
+    });
+
+    EXPECT_FALSE(registry.insert(package("org.deepin.demo", "1.0.0"), "deepin", []() {
+        return false;
+    }));
+    EXPECT_FALSE(registry.contains("org.deepin.demo", "", "", "", "", ""));
+    EXPECT_EQ(changed, 0);
+
+    EXPECT_TRUE(registry.insert(package("org.deepin.demo", "1.0.0"), "deepin", []() {
+        return true;
+    }));
+    EXPECT_TRUE(registry.contains("org.deepin.demo", "1.0.0", "", "", "", "deepin"));
+    EXPECT_EQ(changed, 1);
+
+    EXPECT_FALSE(
+      registry.remove("org.deepin.demo", "1.0.0", "", "", "", "deepin", []() {
+          return false;
+      }));
+    EXPECT_TRUE(registry.contains("org.deepin.demo", "1.0.0", "", "", "", ""));
+
+    EXPECT_TRUE(registry.remove("org.deepin.demo", "1.0.0", "", "", "", "deepin", []() {
+        return true;
+    }));
+    EXPECT_FALSE(registry.contains("org.deepin.demo", "", "", "", "", ""));
+    EXPECT_EQ(changed, 2);
+}
+
+TEST(UtilInstalledAppRegistry, ConcurrentReads)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const auto dbPath = dir.filePath("linglong.db");
+    {
+        Connection connection(dbPath);
+        createTable(connection);
+        insertRow(connection, "org.deepin.base", "1.0.0");
+    }
+
+    InstalledAppRegistry registry(dbPath);
+    std::atomic<bool> stop{ false };
+    std::atomic<int> inconsistent{ 0 };
+
+    // 写线程不断安装、卸载及使索引失效，读线程应始终看到完整有序的结果
+    auto writer = QtConcurrent::run([&]() {
+        for (int i = 0; i < 200; ++i) {
+            const auto version = QString("1.%1.0").arg(i);
+            registry.insert(package("org.deepin.demo", version), "deepin", []() {
+                return true;
+            });
+            if (i % 20 == 0) {
+                registry.invalidate();
+            }
+            registry.remove("org.deepin.demo", version, "", "", "", "deepin", []() {
+                return true;
+            });
+        }
+        stop = true;
+    });
+
+    QList<QFuture<void>> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers << QtConcurrent::run([&]() {
+            while (!stop) {
+                if (!registry.contains("org.deepin.base", "1.0.0", "", "", "", "")) {
+                    ++inconsistent;
+                }
+                auto result = registry.find("org.deepin.demo", "", "", "", "", "");
+                if (result.size() > 1) {
+                    ++inconsistent;
+                }
+            }
+        });
+    }
+
+    writer.waitForFinished();
+    for (auto &reader : readers) {
+        reader.waitForFinished();
+    }
+    EXPECT_EQ(inconsistent, 0);
+}
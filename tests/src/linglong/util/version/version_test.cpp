@@ -0,0 +1,39 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/util/version/version.h"
+
+using linglong::util::AppVersion;
+
+TEST(UtilVersion, SortKeyOrder)
+{
+    // 按数值而不是字符串比较
+    EXPECT_LT(AppVersion("5.9.1").sortKey(), AppVersion("5.10.1").sortKey());
+    EXPECT_LT(AppVersion("1.2.3.4").sortKey(), AppVersion("1.2.3.10").sortKey());
+    EXPECT_LT(AppVersion("1.2.3.65535").sortKey(), AppVersion("1.2.4").sortKey());
+    EXPECT_LT(AppVersion("1.65535.0.0").sortKey(), AppVersion("2.0.0.0").sortKey());
+    EXPECT_EQ(AppVersion("1.2").sortKey(), AppVersion("1.2.0.0").sortKey());
+
+    const QStringList versions = { "0.0.1", "0.1.0", "1.0.0", "1.0.0.1", "9.9.9", "10.0.0" };
+    for (int i = 1; i < versions.size(); ++i) {
+        EXPECT_LT(AppVersion(versions.at(i - 1)).sortKey(), AppVersion(versions.at(i)).sortKey())
+          << versions.at(i - 1).toStdString() << " < " << versions.at(i).toStdString();
+        EXPECT_EQ(AppVersion(versions.at(i)).isBigThan(AppVersion(versions.at(i - 1))),
+                  AppVersion(versions.at(i)).sortKey()
+                    > AppVersion(versions.at(i - 1)).sortKey());
+    }
+}
+
+TEST(UtilVersion, SortKeyClamp)
+{
+    // 超出 16 位的段按最大值处理，不会溢出到上一段
+    EXPECT_EQ(AppVersion("1.2.3.70000").sortKey(), AppVersion("1.2.3.65535").sortKey());
+    EXPECT_LT(AppVersion("1.2.3.70000").sortKey(), AppVersion("1.2.4.0").sortKey());
+    EXPECT_GT(AppVersion("40000.0.0").sortKey(), AppVersion("32766.0.0").sortKey());
+    EXPECT_GE(AppVersion("0.0.0").sortKey(), 0);
+}
@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include "linglong/util/appinfo_cache.h"
+#include "linglong/util/status_code.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+
+TEST(Module_Util, AppInfoCache)
+{
+    QTemporaryDir tmpDir;
+    ASSERT_TRUE(tmpDir.isValid());
+    linglong::util::setAppCacheDbPath(tmpDir.filePath("appInfoCache.db"));
+
+    EXPECT_EQ(linglong::util::checkAppCache(), STATUS_CODE(kSuccess));
+
+    QString data;
+    EXPECT_NE(linglong::util::queryLocalCache("org.deepin.demo", data), STATUS_CODE(kSuccess));
+
+    EXPECT_EQ(linglong::util::updateCache("org.deepin.demo", "{\"v\":1}"), STATUS_CODE(kSuccess));
+    EXPECT_EQ(linglong::util::queryLocalCache("org.deepin.demo", data), STATUS_CODE(kSuccess));
+    EXPECT_EQ(data, "{\"v\":1}");
+
+    // 同一个 key 更新后覆盖旧记录
+    EXPECT_EQ(linglong::util::updateCache("org.deepin.demo", "{\"v\":2}"), STATUS_CODE(kSuccess));
+    EXPECT_EQ(linglong::util::queryLocalCache("org.deepin.demo", data), STATUS_CODE(kSuccess));
+    EXPECT_EQ(data, "{\"v\":2}");
+
+    // 不留下 WAL 模式的 -wal、-shm 文件，其它用户可以只读打开
+    EXPECT_FALSE(QFile::exists(tmpDir.filePath("appInfoCache.db-wal")));
+    EXPECT_FALSE(QFile::exists(tmpDir.filePath("appInfoCache.db-shm")));
+
+    linglong::util::setAppCacheDbPath("");
+}
+
+TEST(Module_Util, AppInfoCacheBenchmark)
+{
+    if (!qEnvironmentVariableIsSet("LINGLONG_TEST_ALL")) {
+        return;
+    }
+
+    QTemporaryDir tmpDir;
+    ASSERT_TRUE(tmpDir.isValid());
+    linglong::util::setAppCacheDbPath(tmpDir.filePath("appInfoCacheBenchmark.db"));
+    ASSERT_EQ(linglong::util::checkAppCache(), STATUS_CODE(kSuccess));
+
+    const int count = 2000;
+    const QString payload(1024, 'x');
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(linglong::util::updateCache(QString("key-%1").arg(i), payload),
+                  STATUS_CODE(kSuccess));
+    }
+    const auto updateMs = qMax<qint64>(timer.elapsed(), 1);
+
+    QString data;
+    timer.restart();
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(linglong::util::queryLocalCache(QString("key-%1").arg(i), data),
+                  STATUS_CODE(kSuccess));
+    }
+    const auto queryMs = qMax<qint64>(timer.elapsed(), 1);
+
+    qInfo() << "appInfo cache update:" << count * 1000 / updateMs << "ops/s";
+    qInfo() << "appInfo cache query:" << count * 1000 / queryMs << "ops/s";
+
+    linglong::util::setAppCacheDbPath("");
+}
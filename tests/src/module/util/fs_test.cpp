@@ -10,6 +10,8 @@
 
 #include <QDebug>
 #include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
 
 TEST(Module_Util, FS)
 {
@@ -53,3 +55,27 @@ TEST(Module_Util, FS_Layers)
         linglong::util::removeDir(QString("/tmp/deepin-linglong"));
     }
 }
+
+TEST(Module_Util, FS_CacheKeyAndStamp)
+{
+    EXPECT_EQ(linglong::util::cacheKey({ "a", "b" }), linglong::util::cacheKey({ "a", "b" }));
+    EXPECT_NE(linglong::util::cacheKey({ "a", "b" }), linglong::util::cacheKey({ "ab" }));
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const auto path = dir.filePath("info.json");
+    EXPECT_EQ(linglong::util::fileStamp(path), "-");
+
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write("{}");
+    file.close();
+    const auto stamp = linglong::util::fileStamp(path);
+    EXPECT_NE(stamp, "-");
+
+    // 重写后大小变化
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write("{\"version\":\"1.0.0\"}");
+    file.close();
+    EXPECT_NE(linglong::util::fileStamp(path), stamp);
+}